@@ -252,6 +252,37 @@ VLC_API char *aout_DeviceGet (audio_output_t *);
 VLC_API int aout_DeviceSet (audio_output_t *, const char *);
 VLC_API int aout_DevicesList (audio_output_t *, char ***, char ***);
 
+/**
+ * Loudness of an audio output (EBU R 128), as measured by the "loudness"
+ * audio filter.
+ *
+ * Loudness values are in LUFS, the true peak is in dBTP. Unknown values are
+ * -INFINITY.
+ */
+typedef struct
+{
+    float momentary;  /**< over the last 400 ms */
+    float short_term; /**< over the last 3 s */
+    float integrated; /**< gated, since the filter started */
+    float true_peak;  /**< highest inter-sample peak */
+} vlc_audio_loudness_t;
+
+typedef struct vlc_audio_meter vlc_audio_meter_t;
+
+/**
+ * Publishes loudness measurements, or resets them if NULL.
+ * There must be a single writer, typically the audio thread.
+ */
+VLC_API void vlc_audio_meter_Publish(vlc_audio_meter_t *,
+                                     const vlc_audio_loudness_t *);
+
+/**
+ * Gets the latest loudness measurements of an audio output. This neither
+ * locks nor waits for the audio thread, so interfaces can poll it.
+ * \return 0 on success, -1 if no measurements are available.
+ */
+VLC_API int aout_LoudnessGet (audio_output_t *, vlc_audio_loudness_t *);
+
 /**
  * Report change of configured audio volume to the core and UI.
  */
@@ -88,6 +88,12 @@ enum es_out_query_e
     ES_OUT_GET_PCR_SYSTEM, /* arg1=mtime_t *, arg2=mtime_t * res=can fail */
     ES_OUT_MODIFY_PCR_SYSTEM, /* arg1=int is_absolute, arg2=mtime_t, res=can fail */
 
+    /* Account packets received from the network by an access-demux, since
+     * the previous call, in the input statistics */
+    ES_OUT_ADD_RECEPTION_STATS, /* arg1=unsigned received, arg2=size_t bytes,
+                                   arg3=unsigned lost, arg4=unsigned late,
+                                   arg5=unsigned recovered res=cannot fail */
+
     /* First value usable for private control */
     ES_OUT_PRIVATE_START = 0x10000,
 };
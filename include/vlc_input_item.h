@@ -344,6 +344,9 @@ struct input_stats_t
     int64_t i_read_bytes;
     float f_input_bitrate;
     float f_average_input_bitrate;
+    int64_t i_lost_packets;
+    int64_t i_late_packets;
+    int64_t i_recovered_packets;
 
     /* Demux */
     int64_t i_demux_read_packets;
@@ -356,6 +359,9 @@ struct input_stats_t
     /* Decoders */
     int64_t i_decoded_audio;
     int64_t i_decoded_video;
+    int64_t i_packetized_video;
+    int64_t i_packetizer_latency; /* average, in microseconds */
+    int64_t i_decoder_latency; /* average, in microseconds */
 
     /* Vout */
     int64_t i_displayed_pictures;
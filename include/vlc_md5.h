@@ -41,6 +41,15 @@ VLC_API void InitMD5( struct md5_s * );
 VLC_API void AddMD5( struct md5_s *, const void *, size_t );
 VLC_API void EndMD5( struct md5_s * );
 
+/**
+ * Adds the content of a file to the digest, from the current file offset to
+ * the end of the file.
+ *
+ * \param fd file descriptor open for reading
+ * \return 0 on success, -1 on read error (errno is set)
+ */
+VLC_API int AddMD5File( struct md5_s *, int fd );
+
 /**
  * Returns a char representation of the md5 hash, as shown by UNIX md5 or
  * md5sum tools.
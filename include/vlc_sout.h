@@ -110,6 +110,54 @@ static inline bool sout_AccessOutCanControlPace( sout_access_out_t *p_ao )
     return b;
 }
 
+/**
+ * @}
+ * \defgroup sout_pacer Packet pacing
+ * Departure scheduling for network outputs
+ *
+ * A pacer spreads the packets sharing (nearly) the same timestamp at the
+ * output rate measured from the timestamps, instead of sending them in a
+ * burst. It also measures the departure jitter against that schedule,
+ * without any hardware time stamping, and logs it in debug.
+ *
+ * A pacer is not thread-safe; use one per sending thread.
+ * @{
+ */
+
+typedef struct sout_pacer_t sout_pacer_t;
+
+/**
+ * Creates a pacer.
+ *
+ * \param i_delay delay between the packet timestamps and their departure
+ */
+VLC_API sout_pacer_t *sout_PacerNew( vlc_object_t *, mtime_t i_delay ) VLC_USED;
+#define sout_PacerNew( obj, delay ) sout_PacerNew( VLC_OBJECT(obj), delay )
+VLC_API void sout_PacerDelete( sout_pacer_t * );
+
+/**
+ * Forgets the rate and timing history, e.g. after a discontinuity.
+ */
+VLC_API void sout_PacerReset( sout_pacer_t * );
+
+/**
+ * Computes the departure date of a packet.
+ *
+ * \param i_dts packet timestamp
+ * \param i_size packet size in bytes
+ * \return the date to wait for (with mwait()) before sending the packet
+ */
+VLC_API mtime_t sout_PacerSchedule( sout_pacer_t *, mtime_t i_dts,
+                                    size_t i_size );
+
+/**
+ * Records the departure of a packet.
+ *
+ * \param i_date departure date returned by sout_PacerSchedule()
+ * \param i_sent actual departure date
+ */
+VLC_API void sout_PacerSent( sout_pacer_t *, mtime_t i_date, mtime_t i_sent );
+
 /**
  * @}
  * \defgroup sout_mux Multiplexer
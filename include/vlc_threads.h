@@ -771,6 +771,8 @@ mtime_t impossible_deadline( mtime_t deadline )
  * \return 0 on success, a system error code otherwise.
  *
  * \warning Asynchronous timers are processed from an unspecified thread.
+ * The threads are shared by all timers: a callback that blocks delays the
+ * other timers.
  * \note Multiple occurences of a single interval timer are serialized:
  * they cannot run concurrently.
  */
@@ -0,0 +1,85 @@
+/*****************************************************************************
+ * vlc_thumbnailer.h: fast thumbnail extraction
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_THUMBNAILER_H
+#define VLC_THUMBNAILER_H 1
+
+#include <vlc_picture.h>
+
+/**
+ * \file
+ * This file defines functions to extract thumbnails from a media without
+ * an input thread, nor audio or video output.
+ *
+ * The media is opened once, then any number of thumbnails can be requested.
+ * Each request seeks the demuxer to the nearest key frame, using its index
+ * when it has one, and decodes only that frame.
+ */
+
+# ifdef __cplusplus
+extern "C" {
+# endif
+
+typedef struct vlc_thumbnailer_t vlc_thumbnailer_t;
+
+/**
+ * Opens a media for thumbnail extraction.
+ *
+ * \param obj parent object
+ * \param mrl media resource locator of the media
+ * \return a thumbnailer, or NULL if the media could not be opened or has no
+ *         video track
+ */
+VLC_API vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t *obj,
+                                                   const char *mrl ) VLC_USED;
+#define vlc_thumbnailer_Create( a, b ) vlc_thumbnailer_Create( VLC_OBJECT(a), b )
+
+/**
+ * Closes the media.
+ */
+VLC_API void vlc_thumbnailer_Release( vlc_thumbnailer_t * );
+
+/**
+ * Gets the length of the media.
+ *
+ * \return the length in microseconds, or 0 if unknown
+ */
+VLC_API mtime_t vlc_thumbnailer_GetLength( vlc_thumbnailer_t * ) VLC_USED;
+
+/**
+ * Extracts a thumbnail.
+ *
+ * The key frame at or before the given time is decoded, and converted to the
+ * requested chroma and dimensions. If only one of the width and the height
+ * is set, the other one is computed to keep the display aspect ratio.
+ *
+ * \param time media time of the thumbnail (microseconds from the start)
+ * \param fmt requested chroma and dimensions (0 to keep the source ones),
+ *            updated with the actual output format
+ * \return a picture to release with picture_Release(), or NULL on error
+ */
+VLC_API picture_t *vlc_thumbnailer_Get( vlc_thumbnailer_t *, mtime_t time,
+                                        video_format_t *fmt ) VLC_USED;
+
+# ifdef __cplusplus
+}
+# endif
+
+#endif
@@ -185,6 +185,56 @@ VLC_API void var_DelListCallback( vlc_object_t *, const char *, vlc_list_callbac
 #define var_AddListCallback(a,b,c,d) var_AddListCallback( VLC_OBJECT(a), b, c, d )
 #define var_DelListCallback(a,b,c,d) var_DelListCallback( VLC_OBJECT(a), b, c, d )
 
+/*****************************************************************************
+ * Variable handles
+ *****************************************************************************
+ * A handle refers to a variable resolved once by name. It holds a reference
+ * on the variable, like var_Create(), until var_Release(). Scalar values
+ * (boolean, integer and float) are then read without locking nor name
+ * lookup, which is meant for per-frame or per-block code paths.
+ *****************************************************************************/
+typedef struct variable_t vlc_var_handle_t;
+
+VLC_API vlc_var_handle_t *var_Acquire( vlc_object_t *, const char * ) VLC_USED;
+#define var_Acquire(a,b) var_Acquire( VLC_OBJECT(a), b )
+VLC_API void var_Release( vlc_object_t *, vlc_var_handle_t * );
+#define var_Release(a,b) var_Release( VLC_OBJECT(a), b )
+
+VLC_API int var_HandleSet( vlc_object_t *, vlc_var_handle_t *, vlc_value_t );
+#define var_HandleSet(a,b,c) var_HandleSet( VLC_OBJECT(a), b, c )
+
+VLC_API bool var_HandleGetBool( vlc_var_handle_t * ) VLC_USED;
+VLC_API int64_t var_HandleGetInteger( vlc_var_handle_t * ) VLC_USED;
+VLC_API float var_HandleGetFloat( vlc_var_handle_t * ) VLC_USED;
+
+static inline int var_HandleSetInteger( vlc_object_t *p_obj,
+                                        vlc_var_handle_t *p_var, int64_t i )
+{
+    vlc_value_t val;
+    val.i_int = i;
+    return var_HandleSet( p_obj, p_var, val );
+}
+
+static inline int var_HandleSetBool( vlc_object_t *p_obj,
+                                     vlc_var_handle_t *p_var, bool b )
+{
+    vlc_value_t val;
+    val.b_bool = b;
+    return var_HandleSet( p_obj, p_var, val );
+}
+
+static inline int var_HandleSetFloat( vlc_object_t *p_obj,
+                                      vlc_var_handle_t *p_var, float f )
+{
+    vlc_value_t val;
+    val.f_float = f;
+    return var_HandleSet( p_obj, p_var, val );
+}
+
+#define var_HandleSetInteger(a,b,c) var_HandleSetInteger( VLC_OBJECT(a),b,c)
+#define var_HandleSetBool(a,b,c)    var_HandleSetBool( VLC_OBJECT(a),b,c)
+#define var_HandleSetFloat(a,b,c)   var_HandleSetFloat( VLC_OBJECT(a),b,c)
+
 /*****************************************************************************
  * helpers functions
  *****************************************************************************/
@@ -290,6 +290,8 @@ vlc_module_begin()
     set_capability("access", 2)
     add_shortcut("https", "http")
     set_callbacks(Open, Close)
+    /* Idle connections outlive the accesses (see connmgr.c) */
+    cannot_unload_broken_library()
 
     add_bool("http2", false, N_("Force HTTP/2"),
              N_("Force HTTP version 2.0 over TCP."), true)
@@ -23,6 +23,7 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <vlc_common.h>
 #include <vlc_network.h>
 #include <vlc_tls.h>
@@ -158,54 +159,377 @@ static vlc_tls_t *vlc_http_connect_i11e(vlc_object_t *obj,
 }
 
 
-struct vlc_http_mgr
+/** Maximum number of connections kept by one pool */
+#define VLC_HTTP_POOL_MAX_CONNS 8
+/** Delay after which a connection without new request is closed */
+#define VLC_HTTP_POOL_IDLE_TIMEOUT (CLOCK_FREQ * 60)
+
+struct vlc_http_pool_conn
 {
-    vlc_object_t *obj;
+    struct vlc_http_conn *conn;
+    unsigned long id;
+    char *host;
+    unsigned port;
+    bool secure;
+    bool h2;
+    bool opening; /**< a stream is being opened without the pool lock */
+    mtime_t last_used;
+};
+
+/**
+ * Connections shared by all the managers of a LibVLC instance.
+ *
+ * The connections are created on behalf of the instance rather than of the
+ * access that first needed them, since they can outlive it: plain HTTP
+ * connections are kept after the last manager is gone, so that the next
+ * playlist item can reuse them, until they expire.
+ */
+struct vlc_http_pool
+{
+    struct vlc_http_pool *next;
+    vlc_object_t *obj; /**< LibVLC instance */
+    unsigned refs; /**< protected by vlc_http_pools_lock */
+
+    vlc_mutex_t lock;
+    vlc_timer_t timer; /**< closes idle connections */
     vlc_tls_creds_t *creds;
+    struct vlc_http_pool_conn conns[VLC_HTTP_POOL_MAX_CONNS];
+    unsigned conn_count;
+    unsigned long next_id;
+};
+
+static vlc_mutex_t vlc_http_pools_lock = VLC_STATIC_MUTEX;
+static struct vlc_http_pool *vlc_http_pools = NULL;
+
+struct vlc_http_mgr
+{
+    struct vlc_http_pool *pool;
     struct vlc_http_cookie_jar_t *jar;
-    struct vlc_http_conn *conn;
     bool use_h2c;
 };
 
-static struct vlc_http_conn *vlc_http_mgr_find(struct vlc_http_mgr *mgr,
-                                               const char *host, unsigned port)
+/** Removes a connection from the pool (pool lock held) */
+static void vlc_http_pool_release(struct vlc_http_pool *pool, unsigned i)
+{
+    struct vlc_http_pool_conn *c = &pool->conns[i];
+
+    assert(i < pool->conn_count);
+    assert(!c->opening);
+    /* If a stream is still active, the connection is destroyed only once the
+     * stream is closed. */
+    vlc_http_conn_release(c->conn);
+    free(c->host);
+
+    *c = pool->conns[--pool->conn_count];
+}
+
+/** Arms the timer for the next connection to expire (pool lock held) */
+static void vlc_http_pool_arm(struct vlc_http_pool *pool)
+{
+    mtime_t deadline = 0;
+
+    for (unsigned i = 0; i < pool->conn_count; i++)
+    {
+        mtime_t expiry = pool->conns[i].last_used + VLC_HTTP_POOL_IDLE_TIMEOUT;
+
+        if (deadline == 0 || expiry < deadline)
+            deadline = expiry;
+    }
+
+    vlc_timer_schedule(pool->timer, true, deadline ? (deadline + 1) : 0, 0);
+}
+
+/** Closes connections which have not been used for too long */
+static void vlc_http_pool_expire(void *data)
+{
+    struct vlc_http_pool *pool = data;
+    mtime_t now = mdate();
+
+    vlc_mutex_lock(&pool->lock);
+    for (unsigned i = 0; i < pool->conn_count;)
+    {
+        const struct vlc_http_pool_conn *c = &pool->conns[i];
+
+        if (!c->opening && c->last_used + VLC_HTTP_POOL_IDLE_TIMEOUT < now)
+            vlc_http_pool_release(pool, i);
+        else
+            i++;
+    }
+    vlc_http_pool_arm(pool);
+    vlc_mutex_unlock(&pool->lock);
+}
+
+/** Frees a pool (global pools lock held) */
+static void vlc_http_pool_destroy(struct vlc_http_pool *pool)
+{
+    struct vlc_http_pool **pp = &vlc_http_pools;
+    while (*pp != pool)
+        pp = &(*pp)->next;
+    *pp = pool->next;
+
+    vlc_timer_destroy(pool->timer);
+    while (pool->conn_count > 0)
+        vlc_http_pool_release(pool, pool->conn_count - 1);
+    if (pool->creds != NULL)
+        vlc_tls_Delete(pool->creds);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+static struct vlc_http_pool *vlc_http_pool_hold(vlc_object_t *obj)
+{
+    vlc_object_t *libvlc = VLC_OBJECT(obj->p_libvlc);
+    struct vlc_http_pool *pool, *next;
+
+    vlc_mutex_lock(&vlc_http_pools_lock);
+    /* Reap the unused pools whose connections have all expired */
+    for (pool = vlc_http_pools; pool != NULL; pool = next)
+    {
+        next = pool->next;
+        if (pool->refs > 0)
+            continue;
+
+        vlc_mutex_lock(&pool->lock);
+        bool empty = pool->conn_count == 0;
+        vlc_mutex_unlock(&pool->lock);
+
+        if (empty)
+            vlc_http_pool_destroy(pool);
+    }
+
+    for (pool = vlc_http_pools; pool != NULL; pool = pool->next)
+        if (pool->obj == libvlc)
+            break;
+
+    if (pool == NULL)
+    {
+        pool = malloc(sizeof (*pool));
+        if (likely(pool != NULL)
+         && unlikely(vlc_timer_create(&pool->timer, vlc_http_pool_expire,
+                                      pool)))
+        {
+            free(pool);
+            pool = NULL;
+        }
+        if (likely(pool != NULL))
+        {
+            pool->obj = libvlc;
+            pool->refs = 0;
+            vlc_mutex_init(&pool->lock);
+            pool->creds = NULL;
+            pool->conn_count = 0;
+            pool->next_id = 0;
+            pool->next = vlc_http_pools;
+            vlc_http_pools = pool;
+        }
+    }
+
+    if (likely(pool != NULL))
+        pool->refs++;
+    vlc_mutex_unlock(&vlc_http_pools_lock);
+    return pool;
+}
+
+static void vlc_http_pool_drop(struct vlc_http_pool *pool)
 {
-    (void) host; (void) port;
-    return mgr->conn;
+    vlc_mutex_lock(&vlc_http_pools_lock);
+    if (--pool->refs > 0)
+    {
+        vlc_mutex_unlock(&vlc_http_pools_lock);
+        return;
+    }
+
+    /* TLS sessions depend on the credentials, which are an object of the
+     * instance and must not outlive it: only keep plain HTTP connections. */
+    vlc_mutex_lock(&pool->lock);
+    for (unsigned i = 0; i < pool->conn_count;)
+    {
+        if (pool->conns[i].secure)
+            vlc_http_pool_release(pool, i);
+        else
+            i++;
+    }
+    if (pool->creds != NULL)
+    {
+        vlc_tls_Delete(pool->creds);
+        pool->creds = NULL;
+    }
+
+    bool empty = pool->conn_count == 0;
+    vlc_mutex_unlock(&pool->lock);
+
+    if (empty)
+        vlc_http_pool_destroy(pool);
+    vlc_mutex_unlock(&vlc_http_pools_lock);
+}
+
+/** Looks a pooled connection up by identifier (pool lock held) */
+static int vlc_http_pool_find(const struct vlc_http_pool *pool,
+                              unsigned long id)
+{
+    for (unsigned i = 0; i < pool->conn_count; i++)
+        if (pool->conns[i].id == id)
+            return i;
+    return -1;
 }
 
-static void vlc_http_mgr_release(struct vlc_http_mgr *mgr,
-                                 struct vlc_http_conn *conn)
+/**
+ * Waits for the response to a request sent on a pooled connection.
+ * If there is none, the connection is removed from the pool.
+ */
+static struct vlc_http_msg *vlc_http_pool_wait(struct vlc_http_pool *pool,
+                                               struct vlc_http_stream *stream,
+                                               unsigned long id)
 {
-    assert(mgr->conn == conn);
-    mgr->conn = NULL;
+    /* The pool lock is not held: another request may use the connection in
+     * the mean time, or evict it, in which case the connection lingers until
+     * the stream is closed. */
+    struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
+    if (m != NULL)
+        return m;
+
+    /* NOTE: If the request were not idempotent, we would not know if it was
+     * processed by the other end. Thus POST is not used/supported so far, and
+     * CONNECT is treated as if it were idempotent (which works fine here). */
+    vlc_mutex_lock(&pool->lock);
+    int i = vlc_http_pool_find(pool, id);
+    /* Get rid of closing or reset connection, unless another request is
+     * opening a stream on it: that one will find out by itself. */
+    if (i >= 0 && !pool->conns[i].opening)
+        vlc_http_pool_release(pool, i);
+    vlc_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static int vlc_http_mgr_add(struct vlc_http_mgr *mgr, bool secure,
+                            const char *host, unsigned port,
+                            struct vlc_http_conn *conn, bool h2,
+                            const struct vlc_http_msg *req,
+                            struct vlc_http_msg **restrict resp)
+{
+    struct vlc_http_pool *pool = mgr->pool;
+    char *name = strdup(host);
+    if (unlikely(name == NULL))
+        return -1;
+
+    /* Send the request before the connection is in the pool, so that no other
+     * request can take it in the mean time. */
+    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
+    if (stream == NULL)
+    {
+        free(name);
+        return -1;
+    }
 
-    vlc_http_conn_release(conn);
+    vlc_mutex_lock(&pool->lock);
+    if (pool->conn_count == VLC_HTTP_POOL_MAX_CONNS)
+    {   /* Pool full: evict the least recently used connection (the oldest
+         * one if several were last used at the same time) */
+        int lru = -1;
+
+        for (unsigned i = 0; i < pool->conn_count; i++)
+        {
+            const struct vlc_http_pool_conn *c = &pool->conns[i];
+
+            if (c->opening)
+                continue;
+            if (lru < 0 || c->last_used < pool->conns[lru].last_used
+             || (c->last_used == pool->conns[lru].last_used
+              && c->id < pool->conns[lru].id))
+                lru = i;
+        }
+
+        if (lru < 0)
+        {   /* All busy opening streams: do not keep this connection */
+            vlc_mutex_unlock(&pool->lock);
+            free(name);
+            vlc_http_conn_release(conn);
+            *resp = vlc_http_msg_get_initial(stream);
+            return 0;
+        }
+        vlc_http_pool_release(pool, lru);
+    }
+
+    struct vlc_http_pool_conn *c = &pool->conns[pool->conn_count++];
+    unsigned long id = pool->next_id++;
+
+    c->conn = conn;
+    c->id = id;
+    c->host = name;
+    c->port = port;
+    c->secure = secure;
+    c->h2 = h2;
+    c->opening = false;
+    c->last_used = mdate();
+    vlc_http_pool_arm(pool);
+    vlc_mutex_unlock(&pool->lock);
+
+    *resp = vlc_http_pool_wait(pool, stream, id);
+    return 0;
 }
 
 static
-struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr,
+struct vlc_http_msg *vlc_http_mgr_reuse(struct vlc_http_mgr *mgr, bool secure,
                                         const char *host, unsigned port,
                                         const struct vlc_http_msg *req)
 {
-    struct vlc_http_conn *conn = vlc_http_mgr_find(mgr, host, port);
-    if (conn == NULL)
-        return NULL;
+    struct vlc_http_pool *pool = mgr->pool;
 
-    struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
-    if (stream != NULL)
+    vlc_mutex_lock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->conn_count;)
     {
-        struct vlc_http_msg *m = vlc_http_msg_get_initial(stream);
+        struct vlc_http_pool_conn *c = &pool->conns[i];
+
+        if (c->opening || c->secure != secure || c->port != port
+         || strcasecmp(c->host, host))
+        {
+            i++;
+            continue;
+        }
+
+        /* Opening a stream sends the request: do not hold the pool lock in
+         * the mean time. The flag keeps the connection in the pool. */
+        struct vlc_http_conn *conn = c->conn;
+        unsigned long id = c->id;
+        bool h2 = c->h2;
+
+        c->opening = true;
+        c->last_used = mdate();
+        vlc_mutex_unlock(&pool->lock);
+
+        struct vlc_http_stream *stream = vlc_http_stream_open(conn, req);
+        int errnum = errno;
+
+        vlc_mutex_lock(&pool->lock);
+        /* The connection may have moved within the pool in the mean time */
+        int pos = vlc_http_pool_find(pool, id);
+        assert(pos >= 0);
+        i = pos;
+        pool->conns[i].opening = false;
+
+        if (stream == NULL)
+        {
+            if (!h2 && errnum == EBUSY)
+            {   /* HTTP/1.x connection busy with another stream: keep it */
+                i++;
+                continue;
+            }
+            /* Get rid of closing or reset connection */
+            vlc_http_pool_release(pool, i);
+            continue;
+        }
+        vlc_mutex_unlock(&pool->lock);
+
+        struct vlc_http_msg *m = vlc_http_pool_wait(pool, stream, id);
         if (m != NULL)
             return m;
 
-        /* NOTE: If the request were not idempotent, we would not know if it
-         * was processed by the other end. Thus POST is not used/supported so
-         * far, and CONNECT is treated as if it were idempotent (which works
-         * fine here). */
+        /* The pool may have changed while waiting: start over */
+        vlc_mutex_lock(&pool->lock);
+        i = 0;
     }
-    /* Get rid of closing or reset connection */
-    vlc_http_mgr_release(mgr, conn);
+    vlc_mutex_unlock(&pool->lock);
     return NULL;
 }
 
@@ -213,23 +537,23 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
                                               const char *host, unsigned port,
                                               const struct vlc_http_msg *req)
 {
-    if (mgr->creds == NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTP to HTTPS not implemented */
-
-    if (mgr->creds == NULL)
-    {   /* First TLS connection: load x509 credentials */
-        mgr->creds = vlc_tls_ClientCreate(mgr->obj);
-        if (mgr->creds == NULL)
-            return NULL;
-    }
+    struct vlc_http_pool *pool = mgr->pool;
+
+    vlc_mutex_lock(&pool->lock);
+    if (pool->creds == NULL)
+        /* First TLS connection: load x509 credentials */
+        pool->creds = vlc_tls_ClientCreate(pool->obj);
+    vlc_mutex_unlock(&pool->lock);
+    if (pool->creds == NULL)
+        return NULL;
 
     /* TODO? non-idempotent request support */
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, true, host, port, req);
     if (resp != NULL)
         return resp; /* existing connection reused */
 
     bool http2 = true;
-    vlc_tls_t *tls = vlc_https_connect_i11e(mgr->creds, host, port, &http2);
+    vlc_tls_t *tls = vlc_https_connect_i11e(pool->creds, host, port, &http2);
     if (tls == NULL)
         return NULL;
 
@@ -253,23 +577,24 @@ static struct vlc_http_msg *vlc_https_request(struct vlc_http_mgr *mgr,
         return NULL;
     }
 
-    mgr->conn = conn;
-
-    return vlc_http_mgr_reuse(mgr, host, port, req);
+    if (vlc_http_mgr_add(mgr, true, host, port, conn, http2, req, &resp))
+    {
+        vlc_http_conn_release(conn);
+        return NULL;
+    }
+    return resp;
 }
 
 static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
                                              const char *host, unsigned port,
                                              const struct vlc_http_msg *req)
 {
-    if (mgr->creds != NULL && mgr->conn != NULL)
-        return NULL; /* switch from HTTPS to HTTP not implemented */
-
-    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, host, port, req);
+    struct vlc_http_msg *resp = vlc_http_mgr_reuse(mgr, false, host, port,
+                                                   req);
     if (resp != NULL)
         return resp;
 
-    vlc_tls_t *tls = vlc_http_connect_i11e(mgr->obj, host, port);
+    vlc_tls_t *tls = vlc_http_connect_i11e(mgr->pool->obj, host, port);
     if (tls == NULL)
         return NULL;
 
@@ -286,9 +611,13 @@ static struct vlc_http_msg *vlc_http_request(struct vlc_http_mgr *mgr,
         return NULL;
     }
 
-    mgr->conn = conn;
-
-    return vlc_http_mgr_reuse(mgr, host, port, req);
+    if (vlc_http_mgr_add(mgr, false, host, port, conn, mgr->use_h2c, req,
+                         &resp))
+    {
+        vlc_http_conn_release(conn);
+        return NULL;
+    }
+    return resp;
 }
 
 struct vlc_http_msg *vlc_http_mgr_request(struct vlc_http_mgr *mgr, bool https,
@@ -311,19 +640,20 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
     if (unlikely(mgr == NULL))
         return NULL;
 
-    mgr->obj = obj;
-    mgr->creds = NULL;
+    mgr->pool = vlc_http_pool_hold(obj);
+    if (unlikely(mgr->pool == NULL))
+    {
+        free(mgr);
+        return NULL;
+    }
+
     mgr->jar = jar;
-    mgr->conn = NULL;
     mgr->use_h2c = h2c;
     return mgr;
 }
 
 void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr)
 {
-    if (mgr->conn != NULL)
-        vlc_http_mgr_release(mgr, mgr->conn);
-    if (mgr->creds != NULL)
-        vlc_tls_Delete(mgr->creds);
+    vlc_http_pool_drop(mgr->pool);
     free(mgr);
 }
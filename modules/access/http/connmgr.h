@@ -39,6 +39,12 @@ struct vlc_http_cookie_jar_t;
  * establishing a new one. If succesful, the initial HTTP response header is
  * returned.
  *
+ * Connections are kept per origin (scheme, host and port) and reused by later
+ * requests to the same origin, from any manager of the same LibVLC instance.
+ * An HTTP/2 connection is shared by concurrent requests, while an HTTP/1.x
+ * connection is reused only once it is idle. Connections left unused for a
+ * while are closed.
+ *
  * @param mgr HTTP connection manager
  * @param https whether to use HTTPS (true) or unencrypted HTTP (false)
  * @param host name of authoritative HTTP server to send the request to
@@ -56,7 +62,9 @@ struct vlc_http_cookie_jar_t *vlc_http_mgr_get_jar(struct vlc_http_mgr *);
 /**
  * Creates an HTTP connection manager
  *
- * Allocates an HTTP client connections manager.
+ * Allocates an HTTP client connections manager. The connections themselves
+ * are pooled per LibVLC instance, and closed when the last manager of the
+ * instance is destroyed.
  *
  * @param obj parent VLC object
  * @param jar HTTP cookies jar (NULL to disable cookies)
@@ -70,7 +78,8 @@ struct vlc_http_mgr *vlc_http_mgr_create(vlc_object_t *obj,
  * Destroys an HTTP connection manager
  *
  * Deallocates an HTTP client connections manager created by
- * vlc_http_msg_destroy(). Any remaining connection is closed and destroyed.
+ * vlc_http_msg_destroy(). If this was the last manager of its LibVLC instance,
+ * any remaining connection is closed and destroyed.
  */
 void vlc_http_mgr_destroy(struct vlc_http_mgr *mgr);
 
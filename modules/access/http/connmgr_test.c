@@ -0,0 +1,320 @@
+/*****************************************************************************
+ * connmgr_test.c: HTTP connection manager tests
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_tls.h>
+#include "transport.h"
+#include "conn.h"
+#include "connmgr.h"
+#include "message.h"
+
+/* Two LibVLC instances, and the objects of their accesses */
+static vlc_object_t instances[2];
+static vlc_object_t objects[2];
+
+static unsigned connects;
+static unsigned conns_alive;
+static bool reject;
+
+struct test_conn
+{
+    struct vlc_http_conn conn;
+    unsigned streams;
+    bool h2;
+    bool released;
+};
+
+struct test_stream
+{
+    struct vlc_http_stream stream;
+    struct test_conn *conn;
+};
+
+static void conn_destroy(struct test_conn *conn)
+{
+    assert(conn->streams == 0);
+    assert(conn->released);
+    free(conn);
+    conns_alive--;
+}
+
+static struct vlc_http_msg *stream_read_headers(struct vlc_http_stream *s)
+{
+    if (reject)
+        return NULL;
+
+    struct vlc_http_msg *m = vlc_http_resp_create(200);
+    assert(m != NULL);
+    vlc_http_msg_attach(m, s);
+    return m;
+}
+
+static block_t *stream_read(struct vlc_http_stream *s)
+{
+    (void) s;
+    return NULL;
+}
+
+static void stream_close(struct vlc_http_stream *s, bool abort)
+{
+    struct test_stream *ts = (struct test_stream *)s;
+    struct test_conn *conn = ts->conn;
+
+    (void) abort;
+    free(ts);
+    assert(conn->streams > 0);
+    if (--conn->streams == 0 && conn->released)
+        conn_destroy(conn);
+}
+
+static const struct vlc_http_stream_cbs stream_callbacks =
+{
+    stream_read_headers,
+    stream_read,
+    stream_close,
+};
+
+static struct vlc_http_stream *stream_open(struct vlc_http_conn *c,
+                                           const struct vlc_http_msg *req)
+{
+    struct test_conn *conn = (struct test_conn *)c;
+
+    (void) req;
+    assert(!conn->released);
+    if (!conn->h2 && conn->streams > 0)
+    {
+        errno = EBUSY;
+        return NULL;
+    }
+
+    struct test_stream *s = malloc(sizeof (*s));
+    assert(s != NULL);
+    s->stream.cbs = &stream_callbacks;
+    s->conn = conn;
+    conn->streams++;
+    return &s->stream;
+}
+
+static void conn_release(struct vlc_http_conn *c)
+{
+    struct test_conn *conn = (struct test_conn *)c;
+
+    assert(!conn->released);
+    conn->released = true;
+    if (conn->streams == 0)
+        conn_destroy(conn);
+}
+
+static const struct vlc_http_conn_cbs conn_callbacks =
+{
+    stream_open,
+    conn_release,
+};
+
+static struct vlc_http_conn *conn_create(bool h2)
+{
+    struct test_conn *conn = malloc(sizeof (*conn));
+    assert(conn != NULL);
+
+    conn->conn.cbs = &conn_callbacks;
+    conn->conn.tls = NULL;
+    conn->streams = 0;
+    conn->h2 = h2;
+    conn->released = false;
+    conns_alive++;
+    return &conn->conn;
+}
+
+struct vlc_http_conn *vlc_h1_conn_create(vlc_tls_t *tls, bool proxy)
+{
+    (void) tls; (void) proxy;
+    return conn_create(false);
+}
+
+struct vlc_http_conn *vlc_h2_conn_create(vlc_tls_t *tls)
+{
+    (void) tls;
+    return conn_create(true);
+}
+
+static vlc_tls_t fake_tls;
+
+vlc_tls_t *vlc_http_connect(vlc_object_t *obj, const char *name,
+                            unsigned port)
+{
+    /* Connections belong to the instance, not to the requesting access */
+    assert(obj == &instances[0] || obj == &instances[1]);
+    assert(!strcmp(name, "www.example.com"));
+    (void) port;
+    connects++;
+    return &fake_tls;
+}
+
+vlc_tls_t *vlc_https_connect(vlc_tls_creds_t *creds, const char *name,
+                             unsigned port, bool *restrict two)
+{
+    (void) creds; (void) name; (void) port; (void) two;
+    assert(!"HTTPS not tested");
+    return NULL;
+}
+
+vlc_tls_t *vlc_https_connect_proxy(vlc_tls_creds_t *creds,
+                                   const char *name, unsigned port,
+                                   bool *restrict two, const char *proxy)
+{
+    (void) creds; (void) name; (void) port; (void) two; (void) proxy;
+    assert(!"HTTPS not tested");
+    return NULL;
+}
+
+/* Callback for vlc_http_msg_h2_frame */
+#include "h2frame.h"
+
+struct vlc_h2_frame *
+vlc_h2_frame_headers(uint_fast32_t id, uint_fast32_t mtu, bool eos,
+                     unsigned count, const char *const tab[][2])
+{
+    (void) id; (void) mtu; (void) eos; (void) count; (void) tab;
+    assert(!"HTTP/2 frames not tested");
+    return NULL;
+}
+
+static struct vlc_http_msg *request(struct vlc_http_mgr *mgr, unsigned port)
+{
+    struct vlc_http_msg *req = vlc_http_req_create("GET", "http",
+                                                   "www.example.com", "/");
+    assert(req != NULL);
+
+    struct vlc_http_msg *resp = vlc_http_mgr_request(mgr, false,
+                                                     "www.example.com", port,
+                                                     req);
+    vlc_http_msg_destroy(req);
+    return resp;
+}
+
+int main(void)
+{
+    struct vlc_http_msg *m1, *m2;
+
+    for (unsigned i = 0; i < 2; i++)
+        objects[i].p_libvlc = (libvlc_int_t *)&instances[i];
+
+    struct vlc_http_mgr *a = vlc_http_mgr_create(&objects[0], NULL, false);
+    struct vlc_http_mgr *b = vlc_http_mgr_create(&objects[0], NULL, false);
+    struct vlc_http_mgr *other = vlc_http_mgr_create(&objects[1], NULL,
+                                                     false);
+    assert(a != NULL && b != NULL && other != NULL);
+
+    /* First request */
+    m1 = request(a, 80);
+    assert(m1 != NULL);
+    assert(connects == 1);
+
+    /* HTTP/1 connection busy: a second one is opened */
+    m2 = request(b, 80);
+    assert(m2 != NULL);
+    assert(connects == 2);
+    vlc_http_msg_destroy(m1);
+    vlc_http_msg_destroy(m2);
+
+    /* Idle connection reused by the other manager of the same instance */
+    m1 = request(b, 80);
+    assert(m1 != NULL);
+    m2 = request(a, 80);
+    assert(m2 != NULL);
+    assert(connects == 2);
+    vlc_http_msg_destroy(m1);
+    vlc_http_msg_destroy(m2);
+
+    /* Not by another instance, nor for another origin */
+    m1 = request(other, 80);
+    assert(m1 != NULL);
+    assert(connects == 3);
+    vlc_http_msg_destroy(m1);
+    m1 = request(a, 8080);
+    assert(m1 != NULL);
+    assert(connects == 4);
+    vlc_http_msg_destroy(m1);
+    assert(conns_alive == 4);
+
+    /* Failed connections are dropped, the new one too */
+    reject = true;
+    m1 = request(a, 80);
+    assert(m1 == NULL);
+    assert(connects == 5);
+    assert(conns_alive == 2);
+    reject = false;
+    m1 = request(a, 80);
+    assert(m1 != NULL);
+    assert(connects == 6);
+    vlc_http_msg_destroy(m1);
+
+    /* HTTP/2 connection shared by concurrent requests */
+    struct vlc_http_mgr *h2c = vlc_http_mgr_create(&objects[0], NULL, true);
+    assert(h2c != NULL);
+    m1 = request(h2c, 8000);
+    assert(m1 != NULL);
+    m2 = request(h2c, 8000);
+    assert(m2 != NULL);
+    assert(connects == 7);
+
+    /* Pool full: the least recently used connection is evicted, but only
+     * destroyed once its streams are closed */
+    for (unsigned port = 1; port <= 8; port++)
+    {
+        struct vlc_http_msg *m = request(a, port);
+        assert(m != NULL);
+        vlc_http_msg_destroy(m);
+    }
+    assert(connects == 15);
+    assert(conns_alive == 1 + 8 + 1); /* other instance, pooled, evicted */
+    vlc_http_msg_destroy(m1);
+    vlc_http_msg_destroy(m2);
+    assert(conns_alive == 1 + 8);
+
+    /* Plain connections are kept after the last manager of the instance is
+     * gone, for the next one to reuse */
+    vlc_http_mgr_destroy(a);
+    vlc_http_mgr_destroy(b);
+    vlc_http_mgr_destroy(other);
+    vlc_http_mgr_destroy(h2c);
+    assert(conns_alive == 1 + 8);
+
+    a = vlc_http_mgr_create(&objects[0], NULL, false);
+    assert(a != NULL);
+    m1 = request(a, 8);
+    assert(m1 != NULL);
+    assert(connects == 15);
+    vlc_http_msg_destroy(m1);
+    vlc_http_mgr_destroy(a);
+    assert(conns_alive == 1 + 8);
+
+    return 0;
+}
@@ -23,6 +23,7 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -112,14 +113,16 @@ struct vlc_h1_conn
     struct vlc_http_stream stream;
     uintmax_t content_length;
     bool connection_close;
-    bool active;
-    bool released;
+    bool active; /**< protected by lock */
+    bool released; /**< protected by lock */
     bool proxy;
+    vlc_mutex_t lock;
 };
 
 #define CO(conn) ((conn)->conn.tls->obj)
 
 static void vlc_h1_conn_destroy(struct vlc_h1_conn *conn);
+static void vlc_h1_stream_close(struct vlc_http_stream *stream, bool abort);
 
 static void *vlc_h1_stream_fatal(struct vlc_h1_conn *conn)
 {
@@ -147,23 +150,45 @@ static struct vlc_http_stream *vlc_h1_stream_open(struct vlc_http_conn *c,
     size_t len;
     ssize_t val;
 
-    if (conn->active || conn->conn.tls == NULL)
+    /* The connection may be shared by several threads: only the one which
+     * marks it active may use it, until it closes its stream. */
+    vlc_mutex_lock(&conn->lock);
+    if (conn->active)
+    {
+        vlc_mutex_unlock(&conn->lock);
+        errno = EBUSY;
+        return NULL;
+    }
+    if (conn->conn.tls == NULL)
+    {
+        vlc_mutex_unlock(&conn->lock);
+        errno = ENOTCONN;
         return NULL;
+    }
+    conn->active = true;
+    vlc_mutex_unlock(&conn->lock);
+
+    conn->content_length = 0;
+    conn->connection_close = false;
 
     char *payload = vlc_http_msg_format(req, &len, conn->proxy);
     if (unlikely(payload == NULL))
+    {
+        vlc_h1_stream_close(&conn->stream, false);
+        errno = ENOMEM;
         return NULL;
+    }
 
     msg_Dbg(CO(conn), "outgoing request:\n%.*s", (int)len, payload);
     val = vlc_tls_Write(conn->conn.tls, payload, len);
     free(payload);
 
     if (val < (ssize_t)len)
-        return vlc_h1_stream_fatal(conn);
-
-    conn->active = true;
-    conn->content_length = 0;
-    conn->connection_close = false;
+    {
+        vlc_h1_stream_close(&conn->stream, true);
+        errno = ENOTCONN;
+        return NULL;
+    }
     return &conn->stream;
 }
 
@@ -270,9 +295,12 @@ static void vlc_h1_stream_close(struct vlc_http_stream *stream, bool abort)
     if (abort)
         vlc_h1_stream_fatal(conn);
 
+    vlc_mutex_lock(&conn->lock);
     conn->active = false;
+    bool destroy = conn->released;
+    vlc_mutex_unlock(&conn->lock);
 
-    if (conn->released)
+    if (destroy)
         vlc_h1_conn_destroy(conn);
 }
 
@@ -293,6 +321,7 @@ static void vlc_h1_conn_destroy(struct vlc_h1_conn *conn)
         vlc_tls_Shutdown(conn->conn.tls, true);
         vlc_tls_Close(conn->conn.tls);
     }
+    vlc_mutex_destroy(&conn->lock);
     free(conn);
 }
 
@@ -300,10 +329,13 @@ static void vlc_h1_conn_release(struct vlc_http_conn *c)
 {
     struct vlc_h1_conn *conn = (struct vlc_h1_conn *)c;
 
+    vlc_mutex_lock(&conn->lock);
     assert(!conn->released);
     conn->released = true;
+    bool destroy = !conn->active;
+    vlc_mutex_unlock(&conn->lock);
 
-    if (!conn->active)
+    if (destroy)
         vlc_h1_conn_destroy(conn);
 }
 
@@ -325,6 +357,7 @@ struct vlc_http_conn *vlc_h1_conn_create(vlc_tls_t *tls, bool proxy)
     conn->active = false;
     conn->released = false;
     conn->proxy = proxy;
+    vlc_mutex_init(&conn->lock);
 
     return &conn->conn;
 }
@@ -0,0 +1,159 @@
+/**
+ * @file fec-test.c
+ * @brief SMPTE 2022-1 forward error correction test
+ */
+/*****************************************************************************
+ * Copyright © 2016 VLC authors and VideoLAN
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ ****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#undef NDEBUG
+#include <assert.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+
+#include "rtp.h"
+
+/* One row of 5 media packets, protected by one FEC packet */
+#define BASE    100
+#define COUNT   5
+#define MAX_LEN 200
+
+static block_t *media[COUNT];
+
+/* The tested code only logs */
+void vlc_Log(vlc_object_t *obj, int prio, const char *module,
+             const char *file, unsigned line, const char *func,
+             const char *format, ...)
+{
+    (void) obj; (void) prio; (void) module; (void) file; (void) line;
+    (void) func; (void) format;
+}
+
+static block_t *media_packet(unsigned i)
+{
+    size_t len = 100 + 23 * i;
+    block_t *block = block_Alloc(12 + len);
+    assert(block != NULL);
+
+    uint8_t *p = block->p_buffer;
+    p[0] = 0x80;
+    p[1] = ((i == COUNT - 1) ? 0x80 : 0) | 33; /* marker on the last one */
+    SetWBE(p + 2, BASE + i);
+    SetDWBE(p + 4, 90000 + 3003 * i);
+    SetDWBE(p + 8, 0xDEADBEEF);
+    for (size_t j = 0; j < len; j++)
+        p[12 + j] = (j * 7 + i * 13) & 0xFF;
+    return block;
+}
+
+/* XORs the media packets into a FEC packet, as a SMPTE 2022-1 sender does */
+static block_t *fec_packet(void)
+{
+    block_t *block = block_Alloc(12 + 16 + MAX_LEN);
+    assert(block != NULL);
+
+    uint8_t *p = block->p_buffer, *h = p + 12;
+    memset(p, 0, block->i_buffer);
+    p[0] = 0x80;
+    p[1] = 96;
+    SetWBE(h, BASE);
+    h[13] = 1; /* offset: a row */
+    h[14] = COUNT;
+
+    uint16_t length = 0;
+    uint32_t ts = 0;
+
+    for (unsigned i = 0; i < COUNT; i++)
+    {
+        const uint8_t *in = media[i]->p_buffer;
+        size_t len = media[i]->i_buffer - 12;
+
+        p[1] ^= in[1] & 0x80;
+        h[4] ^= in[1] & 0x7F;
+        length ^= len;
+        ts ^= GetDWBE(in + 4);
+        for (size_t j = 0; j < len; j++)
+            h[16 + j] ^= in[12 + j];
+    }
+    SetWBE(h + 2, length);
+    SetDWBE(h + 8, ts);
+    return block;
+}
+
+static void check_recovered(block_t *block, unsigned i)
+{
+    assert(block != NULL);
+    assert(block->i_buffer == media[i]->i_buffer);
+    assert(!memcmp(block->p_buffer, media[i]->p_buffer, block->i_buffer));
+    block_Release(block);
+}
+
+int main(void)
+{
+    demux_t demux;
+    rtp_fec_t *fec;
+
+    for (unsigned i = 0; i < COUNT; i++)
+        media[i] = media_packet(i);
+
+    /* One packet lost: rebuilt from the others */
+    for (unsigned lost = 0; lost < COUNT; lost++)
+    {
+        fec = rtp_fec_create();
+        assert(fec != NULL);
+
+        for (unsigned i = 0; i < COUNT; i++)
+            if (i != lost)
+                rtp_fec_store(fec, media[i]);
+        rtp_fec_add(&demux, fec, fec_packet());
+        check_recovered(rtp_fec_recover(&demux, fec), lost);
+        assert(rtp_fec_recover(&demux, fec) == NULL); /* FEC packet used */
+        rtp_fec_destroy(&demux, fec);
+    }
+
+    /* Two packets lost: the FEC packet waits until one of them arrives */
+    fec = rtp_fec_create();
+    assert(fec != NULL);
+    for (unsigned i = 0; i < COUNT; i++)
+        if (i != 1 && i != 3)
+            rtp_fec_store(fec, media[i]);
+    rtp_fec_add(&demux, fec, fec_packet());
+    assert(rtp_fec_recover(&demux, fec) == NULL);
+    rtp_fec_store(fec, media[3]);
+    check_recovered(rtp_fec_recover(&demux, fec), 1);
+    rtp_fec_destroy(&demux, fec);
+
+    /* Unsupported FEC packets are dropped */
+    fec = rtp_fec_create();
+    assert(fec != NULL);
+    block_t *bad = fec_packet();
+    bad->p_buffer[12 + 12] = 0x08; /* not XOR */
+    rtp_fec_add(&demux, fec, bad);
+    assert(rtp_fec_recover(&demux, fec) == NULL);
+    rtp_fec_destroy(&demux, fec);
+
+    for (unsigned i = 0; i < COUNT; i++)
+        block_Release(media[i]);
+    return 0;
+}
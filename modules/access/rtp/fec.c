@@ -0,0 +1,264 @@
+/**
+ * @file fec.c
+ * @brief SMPTE 2022-1 forward error correction
+ */
+/*****************************************************************************
+ * Copyright © 2016 VLC authors and VideoLAN
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ ****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_demux.h>
+
+#include "rtp.h"
+
+/* Media packets kept for recovery. SMPTE 2022-1 matrices have at most
+ * L x D = 100 packets, this leaves plenty of room for reordering. */
+#define FEC_HISTORY  1024
+/* FEC packets waiting for more media packets */
+#define FEC_PENDING  64
+
+/* RTP header, FEC header (and the XOR payload) */
+#define FEC_HEADER_SIZE (12 + 16)
+
+struct rtp_fec_t
+{
+    block_t  *media[FEC_HISTORY]; /**< copies of the media packets */
+    block_t  *pending[FEC_PENDING]; /**< FEC packets, oldest first */
+    unsigned  pending_count;
+    uint16_t  max_seq; /**< highest media sequence number stored */
+
+    uint64_t  received;
+    uint64_t  recovered;
+    uint64_t  failed;
+};
+
+rtp_fec_t *rtp_fec_create (void)
+{
+    rtp_fec_t *fec = calloc (1, sizeof (*fec));
+    return fec;
+}
+
+void rtp_fec_destroy (demux_t *demux, rtp_fec_t *fec)
+{
+    msg_Dbg (demux, "FEC: %"PRIu64" packets received, %"PRIu64" recovered, "
+             "%"PRIu64" unrecoverable", fec->received, fec->recovered,
+             fec->failed);
+
+    for (unsigned i = 0; i < FEC_HISTORY; i++)
+        if (fec->media[i] != NULL)
+            block_Release (fec->media[i]);
+    for (unsigned i = 0; i < fec->pending_count; i++)
+        block_Release (fec->pending[i]);
+    free (fec);
+}
+
+/**
+ * Keeps a copy of a media packet (including the RTP header and padding),
+ * for later recovery of its neighbours.
+ */
+void rtp_fec_store (rtp_fec_t *fec, block_t *block)
+{
+    assert (block->i_buffer >= 12);
+
+    uint16_t seq = GetWBE (block->p_buffer + 2);
+    block_t **slot = &fec->media[seq % FEC_HISTORY];
+
+    if (*slot != NULL)
+        block_Release (*slot);
+    *slot = block_Duplicate (block);
+
+    if ((int16_t)(seq - fec->max_seq) > 0)
+        fec->max_seq = seq;
+}
+
+static block_t *rtp_fec_lookup (const rtp_fec_t *fec, uint16_t seq)
+{
+    block_t *block = fec->media[seq % FEC_HISTORY];
+
+    if (block != NULL && GetWBE (block->p_buffer + 2) == seq)
+        return block;
+    return NULL;
+}
+
+/**
+ * Queues a FEC packet (column or row).
+ */
+void rtp_fec_add (demux_t *demux, rtp_fec_t *fec, block_t *block)
+{
+    if (block->i_buffer < FEC_HEADER_SIZE
+     || (block->p_buffer[0] >> 6) != 2 /* RTP version */
+     || (block->p_buffer[0] & 0x3F) != 0 /* no padding, extension, CSRC */
+     || (block->p_buffer[12 + 12] & 0x38) != 0 /* XOR type */
+     || block->p_buffer[12 + 13] == 0 /* offset */
+     || block->p_buffer[12 + 14] == 0) /* number of packets */
+    {
+        msg_Dbg (demux, "unsupported FEC packet");
+        block_Release (block);
+        return;
+    }
+
+    fec->received++;
+    if (fec->pending_count == FEC_PENDING)
+    {
+        block_Release (fec->pending[0]);
+        memmove (fec->pending, fec->pending + 1,
+                 (FEC_PENDING - 1) * sizeof (*fec->pending));
+        fec->pending_count--;
+        fec->failed++;
+    }
+    fec->pending[fec->pending_count++] = block;
+}
+
+/**
+ * Rebuilds the only missing packet protected by a FEC packet.
+ */
+static block_t *rtp_fec_rebuild (const rtp_fec_t *fec, const block_t *fb,
+                                 uint16_t missing)
+{
+    const uint8_t *h = fb->p_buffer + 12;
+    const uint16_t base = GetWBE (h);
+    const unsigned offset = h[13], count = h[14];
+    const size_t size = fb->i_buffer - FEC_HEADER_SIZE;
+
+    block_t *block = block_Alloc (12 + size);
+    if (unlikely(block == NULL))
+        return NULL;
+
+    uint8_t *out = block->p_buffer;
+    /* P, X, CC and M are protected through the FEC RTP header */
+    uint8_t b0 = fb->p_buffer[0], b1 = fb->p_buffer[1] & 0x80;
+    uint8_t pt = h[4] & 0x7F;
+    uint16_t length = GetWBE (h + 2);
+    uint32_t ts = GetDWBE (h + 8);
+    const uint8_t *ssrc = NULL;
+
+    memcpy (out + 12, h + 16, size);
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        uint16_t seq = base + i * offset;
+        if (seq == missing)
+            continue;
+
+        const block_t *media = rtp_fec_lookup (fec, seq);
+        assert (media != NULL);
+
+        const uint8_t *in = media->p_buffer;
+        size_t len = media->i_buffer - 12;
+
+        b0 ^= in[0];
+        b1 ^= in[1] & 0x80;
+        pt ^= in[1] & 0x7F;
+        length ^= len;
+        ts ^= GetDWBE (in + 4);
+        ssrc = in + 8;
+
+        if (len > size)
+            len = size;
+        for (size_t j = 0; j < len; j++)
+            out[12 + j] ^= in[12 + j];
+    }
+
+    if (length > size || ssrc == NULL)
+    {
+        block_Release (block);
+        return NULL;
+    }
+
+    out[0] = 0x80 | (b0 & 0x3F);
+    out[1] = b1 | pt;
+    SetWBE (out + 2, missing);
+    SetDWBE (out + 4, ts);
+    memcpy (out + 8, ssrc, 4);
+    block->i_buffer = 12 + length;
+    return block;
+}
+
+/**
+ * Attempts to recover a lost media packet from the pending FEC packets.
+ *
+ * @return a recovered RTP packet, or NULL if none could be recovered
+ */
+block_t *rtp_fec_recover (demux_t *demux, rtp_fec_t *fec)
+{
+    unsigned i = 0;
+
+    while (i < fec->pending_count)
+    {
+        block_t *fb = fec->pending[i];
+        const uint8_t *h = fb->p_buffer + 12;
+        const uint16_t base = GetWBE (h);
+        const unsigned offset = h[13], count = h[14];
+        unsigned missing_count = 0;
+        uint16_t missing = 0;
+        bool stale = false;
+
+        for (unsigned j = 0; j < count; j++)
+        {
+            uint16_t seq = base + j * offset;
+
+            if (rtp_fec_lookup (fec, seq) != NULL)
+                continue;
+            /* Packets too old to still be in the history cannot be used */
+            if ((int16_t)(fec->max_seq - seq) >= FEC_HISTORY / 2)
+            {
+                stale = true;
+                break;
+            }
+            missing = seq;
+            missing_count++;
+        }
+
+        if (!stale && missing_count > 1)
+        {   /* maybe later, once another FEC packet has helped */
+            i++;
+            continue;
+        }
+
+        block_t *block = NULL;
+        if (stale)
+            fec->failed++;
+        else
+        if (missing_count == 1)
+        {
+            block = rtp_fec_rebuild (fec, fb, missing);
+            if (block != NULL)
+            {
+                msg_Dbg (demux, "recovered packet (sequence: %"PRIu16")",
+                         missing);
+                fec->recovered++;
+            }
+            else
+                fec->failed++;
+        }
+
+        block_Release (fb);
+        fec->pending_count--;
+        memmove (fec->pending + i, fec->pending + i + 1,
+                 (fec->pending_count - i) * sizeof (*fec->pending));
+        if (block != NULL)
+            return block;
+    }
+    return NULL;
+}
@@ -80,6 +80,100 @@ drop:
     block_Release (block);
 }
 
+#ifdef SO_RXQ_OVFL
+/**
+ * Reports packets dropped by the kernel (socket receive buffer overflow).
+ */
+static void rtp_check_drops (demux_t *demux, struct msghdr *msg)
+{
+    demux_sys_t *sys = demux->p_sys;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR (msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL)
+            continue;
+
+        uint32_t drops;
+        memcpy (&drops, CMSG_DATA (cmsg), sizeof (drops));
+        if (drops != sys->rx_drops)
+        {
+            msg_Warn (demux, "%"PRIu32" packet(s) dropped by the kernel",
+                      drops - sys->rx_drops);
+            sys->rx_drops = drops;
+        }
+    }
+}
+#endif
+
+/**
+ * Receives all the packets queued on a datagram socket, with as few system
+ * calls as possible, and processes them.
+ * @param ring RTP_BATCH receive buffers of RTP_MRU bytes
+ */
+static void rtp_dgram_recv (demux_t *demux, int fd, uint8_t *ring)
+{
+    struct iovec iov[RTP_BATCH];
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgv[RTP_BATCH];
+#else
+    struct
+    {
+        struct msghdr msg_hdr;
+        unsigned msg_len;
+    } msgv[RTP_BATCH];
+#endif
+#ifdef SO_RXQ_OVFL
+    union
+    {
+        char buf[CMSG_SPACE (sizeof (uint32_t))];
+        struct cmsghdr align;
+    } control[RTP_BATCH];
+#endif
+
+    memset (msgv, 0, sizeof (msgv));
+    for (unsigned i = 0; i < RTP_BATCH; i++)
+    {
+        iov[i].iov_base = ring + i * RTP_MRU;
+        iov[i].iov_len = RTP_MRU;
+        msgv[i].msg_hdr.msg_iov = &iov[i];
+        msgv[i].msg_hdr.msg_iovlen = 1;
+#ifdef SO_RXQ_OVFL
+        msgv[i].msg_hdr.msg_control = control[i].buf;
+        msgv[i].msg_hdr.msg_controllen = sizeof (control[i].buf);
+#endif
+    }
+
+#ifdef HAVE_RECVMMSG
+    int n = recvmmsg (fd, msgv, RTP_BATCH, MSG_DONTWAIT, NULL);
+#else
+    ssize_t len = recvmsg (fd, &msgv[0].msg_hdr, 0);
+    int n = (len == -1) ? -1 : 1;
+    msgv[0].msg_len = len;
+#endif
+    if (n == -1)
+    {
+        if (errno != EAGAIN)
+            msg_Warn (demux, "RTP network error: %s", vlc_strerror_c(errno));
+        return;
+    }
+
+#ifdef SO_RXQ_OVFL
+    /* The counter is cumulative: the last datagram is enough */
+    rtp_check_drops (demux, &msgv[n - 1].msg_hdr);
+#endif
+
+    for (int i = 0; i < n; i++)
+    {
+        block_t *block = block_Alloc (msgv[i].msg_len);
+        if (unlikely(block == NULL))
+            continue;
+
+        memcpy (block->p_buffer, iov[i].iov_base, msgv[i].msg_len);
+        rtp_process (demux, block);
+    }
+}
+
 static int rtp_timeout (mtime_t deadline)
 {
     if (deadline == VLC_TS_INVALID)
@@ -105,13 +199,19 @@ void *rtp_dgram_thread (void *opaque)
     mtime_t deadline = VLC_TS_INVALID;
     int rtp_fd = sys->fd;
 
-    struct pollfd ufd[1];
-    ufd[0].fd = rtp_fd;
-    ufd[0].events = POLLIN;
+    struct pollfd ufd[3];
+    unsigned nfd = 0;
+
+    ufd[nfd++].fd = rtp_fd;
+    for (unsigned i = 0; i < 2; i++)
+        if (sys->fec_fd[i] != -1)
+            ufd[nfd++].fd = sys->fec_fd[i];
+    for (unsigned i = 0; i < nfd; i++)
+        ufd[i].events = POLLIN;
 
     for (;;)
     {
-        int n = poll (ufd, 1, rtp_timeout (deadline));
+        int n = poll (ufd, nfd, rtp_timeout (deadline));
         if (n == -1)
             continue;
 
@@ -125,22 +225,27 @@ void *rtp_dgram_thread (void *opaque)
             if (unlikely(ufd[0].revents & POLLHUP))
                 break; /* RTP socket dead (DCCP only) */
 
-            block_t *block = block_Alloc (0xffff); /* TODO: p_sys->mru */
+            rtp_dgram_recv (demux, rtp_fd, sys->ring);
+        }
+
+        /* FEC packets, after the media packets they may complete */
+        for (unsigned i = 1; i < nfd; i++)
+        {
+            if (!ufd[i].revents)
+                continue;
+
+            block_t *block = block_Alloc (0xffff);
             if (unlikely(block == NULL))
-                break; /* we are totallly screwed */
+                break;
 
-            ssize_t len = recv (rtp_fd, block->p_buffer, block->i_buffer, 0);
+            ssize_t len = recv (ufd[i].fd, block->p_buffer, block->i_buffer, 0);
             if (len != -1)
             {
                 block->i_buffer = len;
-                rtp_process (demux, block);
+                rtp_queue_fec (demux, sys->session, block);
             }
             else
-            {
-                msg_Warn (demux, "RTP network error: %s",
-                          vlc_strerror_c(errno));
                 block_Release (block);
-            }
         }
 
     dequeue:
@@ -75,6 +75,11 @@
     "RTP packets will be discarded if they are too far behind (i.e. in the " \
     "past) by this many packets from the last received packet." )
 
+#define RTP_FEC_TEXT N_("SMPTE 2022-1 FEC")
+#define RTP_FEC_LONGTEXT N_( \
+    "Receive the forward error correction streams (on the RTP port plus 2 " \
+    "for columns, plus 4 for rows) and recover lost packets from them." )
+
 #define RTP_DYNAMIC_PT_TEXT N_("RTP payload format assumed for dynamic " \
                                "payloads")
 #define RTP_DYNAMIC_PT_LONGTEXT N_( \
@@ -122,6 +127,8 @@ vlc_module_begin ()
     add_integer ("rtp-max-misorder", 100, RTP_MAX_MISORDER_TEXT,
                  RTP_MAX_MISORDER_LONGTEXT, true)
         change_integer_range (0, 32767)
+    add_bool ("rtp-fec", false, RTP_FEC_TEXT, RTP_FEC_LONGTEXT, true)
+        change_safe ()
     add_string ("rtp-dynamic-pt", NULL, RTP_DYNAMIC_PT_TEXT,
                 RTP_DYNAMIC_PT_LONGTEXT, true)
         change_string_list (dynamic_pt_list, dynamic_pt_list_text)
@@ -205,7 +212,7 @@ static int Open (vlc_object_t *obj)
     int rtcp_dport = var_CreateGetInteger (obj, "rtcp-port");
 
     /* Try to connect */
-    int fd = -1, rtcp_fd = -1;
+    int fd = -1, rtcp_fd = -1, fec_fd[2] = { -1, -1 };
 
     switch (tp)
     {
@@ -216,6 +223,15 @@ static int Open (vlc_object_t *obj)
                 break;
             if (rtcp_dport > 0) /* XXX: source port is unknown */
                 rtcp_fd = net_OpenDgram (obj, dhost, rtcp_dport, shost, 0, tp);
+            if (var_CreateGetBool (obj, "rtp-fec"))
+                for (unsigned i = 0; i < 2; i++)
+                {
+                    int port = dport + 2 * (i + 1);
+
+                    fec_fd[i] = net_OpenDgram (obj, dhost, port, shost, 0, tp);
+                    if (fec_fd[i] == -1)
+                        msg_Warn (obj, "cannot receive FEC on port %d", port);
+                }
             break;
 
          case IPPROTO_DCCP:
@@ -242,6 +258,10 @@ static int Open (vlc_object_t *obj)
     if (fd == -1)
         return VLC_EGENERIC;
     net_SetCSCov (fd, -1, 12);
+#ifdef SO_RXQ_OVFL
+    if (tp != IPPROTO_TCP)
+        setsockopt (fd, SOL_SOCKET, SO_RXQ_OVFL, &(int){ 1 }, sizeof (int));
+#endif
 
     /* Initializes demux */
     demux_sys_t *p_sys = malloc (sizeof (*p_sys));
@@ -250,6 +270,9 @@ static int Open (vlc_object_t *obj)
         net_Close (fd);
         if (rtcp_fd != -1)
             net_Close (rtcp_fd);
+        for (unsigned i = 0; i < 2; i++)
+            if (fec_fd[i] != -1)
+                net_Close (fec_fd[i]);
         return VLC_EGENERIC;
     }
 
@@ -259,9 +282,16 @@ static int Open (vlc_object_t *obj)
 #endif
     p_sys->fd           = fd;
     p_sys->rtcp_fd      = rtcp_fd;
+    p_sys->fec_fd[0]    = fec_fd[0];
+    p_sys->fec_fd[1]    = fec_fd[1];
+    p_sys->rx_drops     = 0;
+    p_sys->ring         = NULL;
     p_sys->max_src      = var_CreateGetInteger (obj, "rtp-max-src");
     p_sys->timeout      = var_CreateGetInteger (obj, "rtp-timeout")
                         * CLOCK_FREQ;
+    /* Leave at least half of the caching to the decoders */
+    p_sys->max_delay    = var_InheritInteger (obj, "network-caching")
+                        * (CLOCK_FREQ / 2000);
     p_sys->max_dropout  = var_CreateGetInteger (obj, "rtp-max-dropout");
     p_sys->max_misorder = var_CreateGetInteger (obj, "rtp-max-misorder");
     p_sys->thread_ready = false;
@@ -301,6 +331,13 @@ static int Open (vlc_object_t *obj)
     }
 #endif
 
+    if (tp != IPPROTO_TCP)
+    {
+        p_sys->ring = malloc (RTP_BATCH * RTP_MRU);
+        if (unlikely(p_sys->ring == NULL))
+            goto error;
+    }
+
     if (vlc_clone (&p_sys->thread,
                    (tp != IPPROTO_TCP) ? rtp_dgram_thread : rtp_stream_thread,
                    demux, VLC_THREAD_PRIORITY_INPUT))
@@ -336,7 +373,11 @@ static void Close (vlc_object_t *obj)
         rtp_session_destroy (demux, p_sys->session);
     if (p_sys->rtcp_fd != -1)
         net_Close (p_sys->rtcp_fd);
+    for (unsigned i = 0; i < 2; i++)
+        if (p_sys->fec_fd[i] != -1)
+            net_Close (p_sys->fec_fd[i]);
     net_Close (p_sys->fd);
+    free (p_sys->ring);
     free (p_sys);
 }
 
@@ -51,10 +51,31 @@ void xiph_decode (demux_t *demux, void *data, block_t *block);
 rtp_session_t *rtp_session_create (demux_t *);
 void rtp_session_destroy (demux_t *, rtp_session_t *);
 void rtp_queue (demux_t *, rtp_session_t *, block_t *);
+void rtp_queue_fec (demux_t *, rtp_session_t *, block_t *);
 bool rtp_dequeue (demux_t *, const rtp_session_t *, mtime_t *);
 void rtp_dequeue_force (demux_t *, const rtp_session_t *);
 int rtp_add_type (demux_t *demux, rtp_session_t *ses, const rtp_pt_t *pt);
 
+/** @section SMPTE 2022-1 FEC */
+typedef struct rtp_fec_t rtp_fec_t;
+
+rtp_fec_t *rtp_fec_create (void);
+void rtp_fec_destroy (demux_t *, rtp_fec_t *);
+void rtp_fec_store (rtp_fec_t *, block_t *);
+void rtp_fec_add (demux_t *, rtp_fec_t *, block_t *);
+block_t *rtp_fec_recover (demux_t *, rtp_fec_t *);
+
+/* Receive buffer size: no datagram is larger without IPv6 jumbograms,
+ * which RTP does not use */
+#define RTP_MRU 0xffff
+
+/* Datagrams received per system call */
+#ifdef HAVE_RECVMMSG
+# define RTP_BATCH 32
+#else
+# define RTP_BATCH 1
+#endif
+
 void *rtp_dgram_thread (void *data);
 void *rtp_stream_thread (void *data);
 
@@ -68,9 +89,13 @@ struct demux_sys_t
 #endif
     int           fd;
     int           rtcp_fd;
+    int           fec_fd[2]; /**< FEC column and row sockets */
+    uint32_t      rx_drops; /**< Kernel receive drops reported so far */
+    uint8_t      *ring; /**< RTP_BATCH datagram buffers of RTP_MRU bytes */
     vlc_thread_t  thread;
 
     mtime_t       timeout;
+    mtime_t       max_delay; /**< Max adaptive playout delay */
     uint16_t      max_dropout; /**< Max packet forward misordering */
     uint16_t      max_misorder; /**< Max packet backward misordering */
     uint8_t       max_src; /**< Max simultaneous RTP sources */
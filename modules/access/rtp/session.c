@@ -42,6 +42,7 @@ struct rtp_session_t
     unsigned       srcc;
     uint8_t        ptc;
     rtp_pt_t      *ptv;
+    rtp_fec_t     *fec;
 };
 
 static rtp_source_t *
@@ -65,8 +66,18 @@ rtp_session_create (demux_t *demux)
     session->srcc = 0;
     session->ptc = 0;
     session->ptv = NULL;
+    session->fec = NULL;
 
-    (void)demux;
+    demux_sys_t *sys = demux->p_sys;
+    if (sys->fec_fd[0] != -1 || sys->fec_fd[1] != -1)
+    {
+        session->fec = rtp_fec_create ();
+        if (session->fec == NULL)
+        {
+            free (session);
+            return NULL;
+        }
+    }
     return session;
 }
 
@@ -79,10 +90,11 @@ void rtp_session_destroy (demux_t *demux, rtp_session_t *session)
     for (unsigned i = 0; i < session->srcc; i++)
         rtp_source_destroy (demux, session, session->srcv[i]);
 
+    if (session->fec != NULL)
+        rtp_fec_destroy (demux, session->fec);
     free (session->srcv);
     free (session->ptv);
     free (session);
-    (void)demux;
 }
 
 static void *no_init (demux_t *demux)
@@ -149,6 +161,22 @@ struct rtp_source_t
 
     uint16_t last_seq; /* sequence of the next dequeued packet */
     block_t *blocks; /* re-ordered blocks queue */
+
+    mtime_t  extra_delay; /* additional playout delay (from late packets) */
+    mtime_t  last_skip; /* last time a sequence gap was given up on */
+    mtime_t  last_report; /* last statistics report local timestamp */
+    mtime_t  last_stats; /* last input statistics update local timestamp */
+    unsigned stats_received; /* packets not yet in the input statistics */
+    size_t   stats_bytes; /* bytes not yet in the input statistics */
+    struct
+    {
+        uint64_t received;
+        uint64_t lost;
+        uint64_t reordered;
+        uint64_t late;
+        uint64_t duplicate;
+    } stats;
+
     void    *opaque[]; /* Per-source private payload data */
 };
 
@@ -173,6 +201,12 @@ rtp_source_create (demux_t *demux, const rtp_session_t *session,
     source->max_seq = source->bad_seq = init_seq;
     source->last_seq = init_seq - 1;
     source->blocks = NULL;
+    source->extra_delay = 0;
+    source->last_skip = VLC_TS_INVALID;
+    source->last_report = source->last_stats = mdate ();
+    source->stats_received = 0;
+    source->stats_bytes = 0;
+    memset (&source->stats, 0, sizeof (source->stats));
 
     /* Initializes all payload */
     for (unsigned i = 0; i < session->ptc; i++)
@@ -183,6 +217,16 @@ rtp_source_create (demux_t *demux, const rtp_session_t *session,
 }
 
 
+static void rtp_source_report (demux_t *demux, const rtp_source_t *source)
+{
+    msg_Dbg (demux, "RTP source (%08x): %"PRIu64" received, %"PRIu64" lost, "
+             "%"PRIu64" reordered, %"PRIu64" late, %"PRIu64" duplicate, "
+             "jitter %u, extra delay %"PRId64" us", source->ssrc,
+             source->stats.received, source->stats.lost,
+             source->stats.reordered, source->stats.late,
+             source->stats.duplicate, source->jitter, source->extra_delay);
+}
+
 /**
  * Destroys an RTP source and its associated streams.
  */
@@ -190,6 +234,7 @@ static void
 rtp_source_destroy (demux_t *demux, const rtp_session_t *session,
                     rtp_source_t *source)
 {
+    rtp_source_report (demux, source);
     msg_Dbg (demux, "removing RTP source (%08x)", source->ssrc);
 
     for (unsigned i = 0; i < session->ptc; i++)
@@ -246,6 +291,10 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
     if ((block->p_buffer[0] >> 6 ) != 2) /* RTP version number */
         goto drop;
 
+    /* Keep a copy for FEC, which also covers the padding */
+    if (session->fec != NULL)
+        rtp_fec_store (session->fec, block);
+
     /* Remove padding if present */
     if (block->p_buffer[0] & 0x20)
     {
@@ -322,6 +371,26 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
     src->last_rx = now;
     block->i_pts = now; /* store reception time until dequeued */
     src->last_ts = rtp_timestamp (block);
+    src->stats.received++;
+    src->stats_received++;
+    src->stats_bytes += block->i_buffer;
+
+    /* Received packets are accounted in batches, lost, late and recovered
+     * packets as they happen */
+    if (now - src->last_stats >= CLOCK_FREQ / 4)
+    {
+        es_out_Control (demux->out, ES_OUT_ADD_RECEPTION_STATS,
+                        src->stats_received, src->stats_bytes, 0u, 0u, 0u);
+        src->stats_received = 0;
+        src->stats_bytes = 0;
+        src->last_stats = now;
+    }
+
+    if (now - src->last_report >= 10 * CLOCK_FREQ)
+    {
+        rtp_source_report (demux, src);
+        src->last_report = now;
+    }
 
     /* Check sequence number */
     /* NOTE: the sequence number is per-source,
@@ -336,6 +405,7 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
         {
             src->max_seq = src->bad_seq = seq + 1;
             src->last_seq = seq - 0x7fffe; /* hack for rtp_decode() */
+            src->last_skip = VLC_TS_INVALID;
             msg_Warn (demux, "sequence resynchronized");
             block_ChainRelease (src->blocks);
             src->blocks = NULL;
@@ -349,6 +419,8 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
     else
     if (delta_seq >= 0)
         src->max_seq = seq + 1;
+    else
+        src->stats.reordered++;
 
     /* Queues the block in sequence order,
      * hence there is a single queue for all payload types. */
@@ -361,6 +433,7 @@ rtp_queue (demux_t *demux, rtp_session_t *session, block_t *block)
         if (delta_seq == 0)
         {
             msg_Dbg (demux, "duplicate packet (sequence: %"PRIu16")", seq);
+            src->stats.duplicate++;
             goto drop; /* duplicate */
         }
         pp = &prev->p_next;
@@ -375,6 +448,27 @@ drop:
     block_Release (block);
 }
 
+/**
+ * Receives a FEC packet, and queues the media packets it recovers.
+ * Not a cancellation point.
+ */
+void rtp_queue_fec (demux_t *demux, rtp_session_t *session, block_t *block)
+{
+    if (session->fec == NULL)
+    {
+        block_Release (block);
+        return;
+    }
+
+    rtp_fec_add (demux, session->fec, block);
+    while ((block = rtp_fec_recover (demux, session->fec)) != NULL)
+    {
+        es_out_Control (demux->out, ES_OUT_ADD_RECEPTION_STATS,
+                        0u, (size_t)0, 0u, 0u, 1u);
+        rtp_queue (demux, session, block);
+    }
+}
+
 
 static void rtp_decode (demux_t *, const rtp_session_t *, rtp_source_t *);
 
@@ -437,6 +531,10 @@ bool rtp_dequeue (demux_t *demux, const rtp_session_t *session,
             else
                 deadline = 0; /* no jitter estimate with no frequency :( */
 
+            /* Plus the delay learnt from packets that arrived too late
+             * (late by the network, or recovered late by FEC) */
+            deadline += src->extra_delay;
+
             /* Make sure we wait at least for 25 msec */
             if (deadline < (CLOCK_FREQ / 40))
                 deadline = CLOCK_FREQ / 40;
@@ -497,11 +595,41 @@ rtp_decode (demux_t *demux, const rtp_session_t *session, rtp_source_t *src)
         {   /* Trash too late packets (and PIM Assert duplicates) */
             msg_Dbg (demux, "ignoring late packet (sequence: %"PRIu16")",
                       rtp_seq (block));
+            src->stats.late++;
+            es_out_Control (demux->out, ES_OUT_ADD_RECEPTION_STATS,
+                            0u, (size_t)0, 0u, 1u, 0u);
+
+            /* We gave up waiting too early: grow the playout delay by how
+             * late the packet was (block->i_pts is its reception time),
+             * with some margin. */
+            if (src->last_skip != VLC_TS_INVALID)
+            {
+                demux_sys_t *sys = demux->p_sys;
+                mtime_t late = block->i_pts - src->last_skip;
+
+                late += late / 4;
+                if (late > sys->max_delay)
+                    late = sys->max_delay;
+                if (late > src->extra_delay)
+                {
+                    src->extra_delay = late;
+                    msg_Dbg (demux, "playout delay increased to %"PRId64" us",
+                             late);
+                }
+            }
             goto drop;
         }
         msg_Warn (demux, "%"PRIu16" packet(s) lost", delta_seq);
         block->i_flags |= BLOCK_FLAG_DISCONTINUITY;
+        src->stats.lost += delta_seq;
+        es_out_Control (demux->out, ES_OUT_ADD_RECEPTION_STATS,
+                        0u, (size_t)0, (unsigned)delta_seq, 0u, 0u);
+        src->last_skip = mdate ();
     }
+    else
+        /* Slowly shrink the playout delay back while nothing is late,
+         * by at least 1 us so that it does get back to zero */
+        src->extra_delay -= (src->extra_delay + 4095) >> 12;
     src->last_seq = rtp_seq (block);
 
     /* Match the payload type */
@@ -47,6 +47,13 @@
 
 #define MTU 65535
 
+/* Datagrams received per system call */
+#ifdef HAVE_RECVMMSG
+# define BATCH 64
+#else
+# define BATCH 1
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -78,6 +85,8 @@ struct access_sys_t
     block_fifo_t *fifo;
     vlc_sem_t semaphore;
     vlc_thread_t thread;
+    uint8_t *ring; /* BATCH receive buffers of MTU bytes each */
+    uint32_t drops; /* kernel receive queue drops reported so far */
 };
 
 /*****************************************************************************
@@ -169,11 +178,26 @@ static int Open( vlc_object_t *p_this )
     ioctlsocket(sys->fd, FIONBIO, &(unsigned long){ 0 });
 #endif
 
+#ifdef SO_RXQ_OVFL
+    /* Ask the kernel for its count of packets dropped on this socket */
+    setsockopt( sys->fd, SOL_SOCKET, SO_RXQ_OVFL, &(int){ 1 }, sizeof (int) );
+#endif
+    sys->drops = 0;
+
+    /* Only the pages actually written by the kernel become resident */
+    sys->ring = malloc( BATCH * MTU );
+    if( unlikely( sys->ring == NULL ) )
+    {
+        net_Close( sys->fd );
+        goto error;
+    }
+
     /* FIXME: There are no particular reasons to create a FIFO and thread here.
      * Those are just working around bugs in the stream cache. */
     sys->fifo = block_FifoNew();
     if( unlikely( sys->fifo == NULL ) )
     {
+        free( sys->ring );
         net_Close( sys->fd );
         goto error;
     }
@@ -186,6 +210,7 @@ static int Open( vlc_object_t *p_this )
     {
         vlc_sem_destroy( &sys->semaphore );
         block_FifoRelease( sys->fifo );
+        free( sys->ring );
         net_Close( sys->fd );
 error:
         free( sys );
@@ -207,6 +232,7 @@ static void Close( vlc_object_t *p_this )
     vlc_join( sys->thread, NULL );
     vlc_sem_destroy( &sys->semaphore );
     block_FifoRelease( sys->fifo );
+    free( sys->ring );
     net_Close( sys->fd );
     free( sys );
 }
@@ -260,52 +286,132 @@ static block_t *BlockUDP( access_t *p_access )
     return block;
 }
 
+#ifdef SO_RXQ_OVFL
+/*****************************************************************************
+ * CheckDrops: reports packets dropped by the kernel (socket buffer overflow)
+ *****************************************************************************/
+static void CheckDrops( access_t *access, struct msghdr *msg )
+{
+    access_sys_t *sys = access->p_sys;
+
+    for( struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(msg, cmsg) )
+    {
+        if( cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL )
+            continue;
+
+        uint32_t drops;
+        memcpy( &drops, CMSG_DATA(cmsg), sizeof (drops) );
+        if( drops != sys->drops )
+        {
+            msg_Warn( access, "%"PRIu32" packet(s) dropped by the kernel, "
+                      "consider increasing the socket receive buffer",
+                      drops - sys->drops );
+            sys->drops = drops;
+        }
+    }
+}
+#endif
+
 /*****************************************************************************
  * ThreadRead: Pull packets from socket as soon as possible.
+ *
+ * All the datagrams already queued in the socket are received at once, and
+ * passed to the stream as a single block.
  *****************************************************************************/
 static void* ThreadRead( void *data )
 {
     access_t *access = data;
     access_sys_t *sys = access->p_sys;
+    struct iovec iov[BATCH];
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgv[BATCH];
+#else
+    struct
+    {
+        struct msghdr msg_hdr;
+        unsigned msg_len;
+    } msgv[BATCH];
+#endif
+#ifdef SO_RXQ_OVFL
+    union
+    {
+        char buf[CMSG_SPACE(sizeof (uint32_t))];
+        struct cmsghdr align;
+    } control[BATCH];
+#endif
 
-    for(;;)
+    memset( msgv, 0, sizeof (msgv) );
+    for( unsigned i = 0; i < BATCH; i++ )
     {
-        block_t *pkt = block_Alloc(MTU);
-        if (unlikely(pkt == NULL))
-        {   /* OOM - dequeue and discard one packet */
-            char dummy;
-            recv(sys->fd, &dummy, 1, 0);
-            continue;
-        }
+        iov[i].iov_base = sys->ring + i * MTU;
+        iov[i].iov_len = MTU;
+        msgv[i].msg_hdr.msg_iov = &iov[i];
+        msgv[i].msg_hdr.msg_iovlen = 1;
+    }
 
-        ssize_t len;
+    for(;;)
+    {
+        int n;
 
-        block_cleanup_push(pkt);
+#ifdef SO_RXQ_OVFL
+        for( unsigned i = 0; i < BATCH; i++ )
+        {
+            msgv[i].msg_hdr.msg_control = control[i].buf;
+            msgv[i].msg_hdr.msg_controllen = sizeof (control[i].buf);
+        }
+#endif
         do
         {
 #ifndef LIBVLC_USE_PTHREAD
             struct pollfd ufd = { .fd = sys->fd, .events = POLLIN };
             while (poll(&ufd, 1, -1) <= 0); /* cancellation point */
 #endif
-            len = recv(sys->fd, pkt->p_buffer, MTU, 0);
+#ifdef HAVE_RECVMMSG
+            /* Waits for one datagram, then takes whatever else is queued */
+            n = recvmmsg(sys->fd, msgv, BATCH, MSG_WAITFORONE, NULL);
+#else
+            ssize_t len = recvmsg(sys->fd, &msgv[0].msg_hdr, 0);
+            msgv[0].msg_len = len;
+            n = (len == -1) ? -1 : 1;
+#endif
         }
-        while (len == -1);
-        vlc_cleanup_pop();
+        while (n == -1);
 
-        pkt->i_buffer = len;
+        int canc = vlc_savecancel();
+        size_t len = 0;
+        for (int i = 0; i < n; i++)
+            len += msgv[i].msg_len;
+
+#ifdef SO_RXQ_OVFL
+        /* The counter is cumulative: the last datagram is enough */
+        CheckDrops(access, &msgv[n - 1].msg_hdr);
+#endif
+
+        block_t *pkt = block_Alloc(len);
+        if (unlikely(pkt == NULL))
+        {   /* OOM - discard the batch */
+            vlc_restorecancel(canc);
+            continue;
+        }
+
+        uint8_t *p = pkt->p_buffer;
+        for (int i = 0; i < n; i++)
+        {
+            memcpy(p, iov[i].iov_base, msgv[i].msg_len);
+            p += msgv[i].msg_len;
+        }
 
         vlc_fifo_Lock(sys->fifo);
         /* Discard old buffers on overflow */
-        while (vlc_fifo_GetBytes(sys->fifo) + len > sys->fifo_size)
-        {
-            int canc = vlc_savecancel();
+        while (vlc_fifo_GetBytes(sys->fifo) + len > sys->fifo_size
+            && !vlc_fifo_IsEmpty(sys->fifo))
             block_Release(vlc_fifo_DequeueUnlocked(sys->fifo));
-            vlc_restorecancel(canc);
-        }
 
         vlc_fifo_QueueUnlocked(sys->fifo, pkt);
         vlc_fifo_Unlock(sys->fifo);
         vlc_sem_post(&sys->semaphore);
+        vlc_restorecancel(canc);
     }
 
     return NULL;
@@ -121,6 +121,7 @@ struct sout_access_out_sys_t
     block_fifo_t *p_empty_blocks;
     block_t      *p_buffer;
 
+    sout_pacer_t *p_pacer;
     vlc_thread_t  thread;
 };
 
@@ -213,11 +214,21 @@ static int Open( vlc_object_t *p_this )
     p_sys->p_fifo = block_FifoNew();
     p_sys->p_empty_blocks = block_FifoNew();
     p_sys->p_buffer = NULL;
+    p_sys->p_pacer = sout_PacerNew( p_access, p_sys->i_caching );
+    if( unlikely(p_sys->p_pacer == NULL) )
+    {
+        block_FifoRelease( p_sys->p_fifo );
+        block_FifoRelease( p_sys->p_empty_blocks );
+        net_Close (i_handle);
+        free (p_sys);
+        return VLC_ENOMEM;
+    }
 
     if( vlc_clone( &p_sys->thread, ThreadWrite, p_access,
                            VLC_THREAD_PRIORITY_HIGHEST ) )
     {
         msg_Err( p_access, "cannot spawn sout access thread" );
+        sout_PacerDelete( p_sys->p_pacer );
         block_FifoRelease( p_sys->p_fifo );
         block_FifoRelease( p_sys->p_empty_blocks );
         net_Close (i_handle);
@@ -242,6 +253,7 @@ static void Close( vlc_object_t * p_this )
 
     vlc_cancel( p_sys->thread );
     vlc_join( p_sys->thread, NULL );
+    sout_PacerDelete( p_sys->p_pacer );
     block_FifoRelease( p_sys->p_fifo );
     block_FifoRelease( p_sys->p_empty_blocks );
 
@@ -403,12 +415,14 @@ static void* ThreadWrite( void *data )
     const unsigned i_group = var_GetInteger( p_access,
                                              SOUT_CFG_PREFIX "group" );
     mtime_t i_to_send = i_group;
+    /* Paced packets each have their own departure date */
+    const bool b_pacing = var_InheritBool( p_access, "sout-pacing" );
     unsigned i_dropped_packets = 0;
 
     for (;;)
     {
         block_t *p_pk = block_FifoGet( p_sys->p_fifo );
-        mtime_t       i_date, i_sent;
+        mtime_t       i_date, i_sent, i_departure;
 
         i_date = p_sys->i_caching + p_pk->i_dts;
         if( i_date_last > 0 )
@@ -420,6 +434,7 @@ static void* ThreadWrite( void *data )
                              i_date - i_date_last );
 
                 block_FifoPut( p_sys->p_empty_blocks, p_pk );
+                sout_PacerReset( p_sys->p_pacer );
 
                 i_date_last = i_date;
                 i_dropped_packets++;
@@ -433,11 +448,14 @@ static void* ThreadWrite( void *data )
             }
         }
 
+        i_departure = sout_PacerSchedule( p_sys->p_pacer, p_pk->i_dts,
+                                          p_pk->i_buffer );
+
         block_cleanup_push( p_pk );
         i_to_send--;
-        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
+        if( b_pacing || !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
         {
-            mwait( i_date );
+            mwait( i_departure );
             i_to_send = i_group;
         }
         if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
@@ -452,10 +470,11 @@ static void* ThreadWrite( void *data )
 
 #if 1
         i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
+        sout_PacerSent( p_sys->p_pacer, i_departure, i_sent );
+        if ( i_sent > i_departure + 20000 )
         {
             msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
+                     i_sent - i_departure );
         }
 #endif
 
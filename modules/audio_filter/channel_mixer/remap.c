@@ -32,8 +32,13 @@
 #include <vlc_aout.h>
 #include <vlc_filter.h>
 #include <vlc_block.h>
+#include <vlc_cpu.h>
 #include <assert.h>
 
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -110,6 +115,11 @@ struct filter_sys_t
     int nb_in_ch[AOUT_CHAN_MAX];
     uint8_t map_ch[AOUT_CHAN_MAX];
     bool b_normalize;
+#ifdef HAVE_AVX2_INTRINSICS
+    /* Permutations of 24 samples, see RemapCopyFL32_AVX2() */
+    int32_t avx2_idx[3][3][8];
+    int32_t avx2_mask[3][3][8];
+#endif
 };
 
 static const uint32_t valid_channels[] = {
@@ -165,6 +175,9 @@ static inline uint32_t CanonicaliseChannels( uint32_t i_physical_channels )
 /*****************************************************************************
  * Remap*: do remapping
  *****************************************************************************/
+/* Each frame is remapped through a temporary frame, so that the output can
+ * overwrite the input when it has no more channels. The output channels
+ * added by CanonicaliseChannels() are not mapped, and remain silent. */
 #define DEFINE_REMAP( name, type ) \
 static void RemapCopy##name( filter_t *p_filter, \
                     const void *p_srcorig, void *p_destorig, \
@@ -177,13 +190,16 @@ static void RemapCopy##name( filter_t *p_filter, \
  \
     for( int i = 0; i < i_nb_samples; i++ ) \
     { \
+        type tmp[AOUT_CHAN_MAX] = { 0 }; \
+ \
         for( uint8_t in_ch = 0; in_ch < i_nb_in_channels; in_ch++ ) \
         { \
             uint8_t out_ch = p_sys->map_ch[ in_ch ]; \
-            memcpy( p_dest + out_ch, \
-                    p_src  + in_ch, \
+            memcpy( tmp + out_ch, \
+                    p_src + in_ch, \
                     sizeof( type ) ); \
         } \
+        memcpy( p_dest, tmp, sizeof( type ) * i_nb_out_channels ); \
         p_src  += i_nb_in_channels; \
         p_dest += i_nb_out_channels; \
     } \
@@ -200,14 +216,17 @@ static void RemapAdd##name( filter_t *p_filter, \
  \
     for( int i = 0; i < i_nb_samples; i++ ) \
     { \
+        type tmp[AOUT_CHAN_MAX] = { 0 }; \
+ \
         for( uint8_t in_ch = 0; in_ch < i_nb_in_channels; in_ch++ ) \
         { \
             uint8_t out_ch = p_sys->map_ch[ in_ch ]; \
             if( p_sys->b_normalize ) \
-                p_dest[ out_ch ] += p_src[ in_ch ] / p_sys->nb_in_ch[ out_ch ]; \
+                tmp[ out_ch ] += p_src[ in_ch ] / p_sys->nb_in_ch[ out_ch ]; \
             else \
-                p_dest[ out_ch ] += p_src[ in_ch ]; \
+                tmp[ out_ch ] += p_src[ in_ch ]; \
         } \
+        memcpy( p_dest, tmp, sizeof( type ) * i_nb_out_channels ); \
         p_src  += i_nb_in_channels; \
         p_dest += i_nb_out_channels; \
     } \
@@ -221,6 +240,83 @@ DEFINE_REMAP( FL64, double   )
 
 #undef DEFINE_REMAP
 
+#ifdef HAVE_AVX2_INTRINSICS
+/* 24 samples hold a whole number of frames of 1, 2, 3, 4, 6 or 8 channels.
+ * They are remapped as three vectors, each output vector picking its samples
+ * from the three input vectors. This is only a permutation when there are as
+ * many output channels as input ones, i.e. none was added. */
+static bool RemapCopyFL32_AVX2_Init( filter_sys_t *p_sys, unsigned i_in_channels,
+                                     unsigned i_out_channels )
+{
+    const unsigned i_channels = i_in_channels;
+    uint8_t in_ch_of[AOUT_CHAN_MAX];
+
+    if( i_in_channels != i_out_channels || 24 % i_channels != 0 )
+        return false;
+
+    for( unsigned in_ch = 0; in_ch < i_channels; in_ch++ )
+        in_ch_of[ p_sys->map_ch[in_ch] ] = in_ch;
+
+    memset( p_sys->avx2_idx, 0, sizeof( p_sys->avx2_idx ) );
+    memset( p_sys->avx2_mask, 0, sizeof( p_sys->avx2_mask ) );
+    for( unsigned i = 0; i < 24; i++ )
+    {
+        unsigned src = i - i % i_channels + in_ch_of[ i % i_channels ];
+
+        p_sys->avx2_idx[i / 8][src / 8][i % 8] = src % 8;
+        p_sys->avx2_mask[i / 8][src / 8][i % 8] = -1;
+    }
+    return true;
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void RemapCopyFL32_AVX2( filter_t *p_filter,
+                                const void *p_srcorig, void *p_destorig,
+                                int i_nb_samples,
+                                unsigned i_nb_in_channels,
+                                unsigned i_nb_out_channels )
+{
+    filter_sys_t *p_sys = ( filter_sys_t * )p_filter->p_sys;
+    const float *p_src = p_srcorig;
+    float *p_dest = p_destorig;
+    const int i_frames = 24 / i_nb_in_channels;
+    int i = i_nb_samples / i_frames;
+
+    for( ; i > 0; i-- )
+    {
+        const __m256 in[3] = {
+            _mm256_loadu_ps( p_src + 0 ),
+            _mm256_loadu_ps( p_src + 8 ),
+            _mm256_loadu_ps( p_src + 16 ),
+        };
+        __m256 out[3];
+
+        for( unsigned k = 0; k < 3; k++ )
+        {
+            out[k] = _mm256_permutevar8x32_ps( in[0],
+                _mm256_loadu_si256( (const __m256i *)p_sys->avx2_idx[k][0] ) );
+            for( unsigned j = 1; j < 3; j++ )
+            {
+                __m256 v = _mm256_permutevar8x32_ps( in[j],
+                    _mm256_loadu_si256( (const __m256i *)p_sys->avx2_idx[k][j] ) );
+                __m256 mask = _mm256_loadu_ps( (const float *)p_sys->avx2_mask[k][j] );
+                out[k] = _mm256_blendv_ps( out[k], v, mask );
+            }
+        }
+
+        /* All inputs are loaded before storing, for in place remapping */
+        _mm256_storeu_ps( p_dest + 0, out[0] );
+        _mm256_storeu_ps( p_dest + 8, out[1] );
+        _mm256_storeu_ps( p_dest + 16, out[2] );
+        p_src += 24;
+        p_dest += 24;
+    }
+
+    RemapCopyFL32( p_filter, p_src, p_dest, i_nb_samples % i_frames,
+                   i_nb_in_channels, i_nb_out_channels );
+}
+#endif
+
 static inline remap_fun_t GetRemapFun( audio_format_t *p_format, bool b_add )
 {
     if( b_add )
@@ -344,6 +440,12 @@ static int OpenFilter( vlc_object_t *p_this )
         free( p_sys );
         return VLC_EGENERIC;
     }
+#ifdef HAVE_AVX2_INTRINSICS
+    if( p_sys->pf_remap == RemapCopyFL32 && vlc_CPU_AVX2()
+     && RemapCopyFL32_AVX2_Init( p_sys, audio_in->i_channels,
+                                 audio_out->i_channels ) )
+        p_sys->pf_remap = RemapCopyFL32_AVX2;
+#endif
 
     p_filter->pf_audio_filter = Remap;
     return VLC_SUCCESS;
@@ -372,6 +474,20 @@ static block_t *Remap( filter_t *p_filter, block_t *p_block )
         return NULL;
     }
 
+    /* Remap in place, unless channels were added to get a valid layout */
+    if( p_filter->fmt_out.audio.i_channels <= p_filter->fmt_in.audio.i_channels )
+    {
+        p_sys->pf_remap( p_filter,
+                    (const void *)p_block->p_buffer, (void *)p_block->p_buffer,
+                    p_block->i_nb_samples,
+                    p_filter->fmt_in.audio.i_channels,
+                    p_filter->fmt_out.audio.i_channels );
+
+        p_block->i_buffer = p_block->i_nb_samples *
+            p_filter->fmt_out.audio.i_bytes_per_frame;
+        return p_block;
+    }
+
     size_t i_out_size = p_block->i_nb_samples *
         p_filter->fmt_out.audio.i_bytes_per_frame;
 
@@ -387,8 +503,6 @@ static block_t *Remap( filter_t *p_filter, block_t *p_block )
     p_out->i_pts = p_block->i_pts;
     p_out->i_length = p_block->i_length;
 
-    memset( p_out->p_buffer, 0, i_out_size );
-
     p_sys->pf_remap( p_filter,
                 (const void *)p_block->p_buffer, (void *)p_out->p_buffer,
                 p_block->i_nb_samples,
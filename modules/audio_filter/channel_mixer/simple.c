@@ -34,6 +34,8 @@
 #include <vlc_filter.h>
 #include <vlc_block.h>
 
+#include <assert.h>
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -261,6 +263,9 @@ static void DoWork_6_1_to_5_x( filter_t * p_filter,  block_t * p_in_buf, block_t
 #if defined (CAN_COMPILE_ARM)
 #include "simple_neon.h"
 #define GET_WORK(in, out) GET_WORK_##in##_to_##out##_neon()
+#elif defined (HAVE_AVX2_INTRINSICS)
+#include "simple_avx2.h"
+#define GET_WORK(in, out) GET_WORK_##in##_to_##out##_avx2()
 #else
 #define GET_WORK(in, out) DoWork_##in##_to_##out
 #endif
@@ -367,32 +372,15 @@ static block_t *Filter( filter_t *p_filter, block_t *p_block )
         return NULL;
     }
 
-    size_t i_out_size = p_block->i_nb_samples *
-      p_filter->fmt_out.audio.i_bitspersample *
-        p_filter->fmt_out.audio.i_channels / 8;
-
-    block_t *p_out = block_Alloc( i_out_size );
-    if( !p_out )
-    {
-        msg_Warn( p_filter, "can't get output buffer" );
-        block_Release( p_block );
-        return NULL;
-    }
-
-    p_out->i_nb_samples = p_block->i_nb_samples;
-    p_out->i_dts = p_block->i_dts;
-    p_out->i_pts = p_block->i_pts;
-    p_out->i_length = p_block->i_length;
-
+    /* All the conversions reduce the number of channels, and every input
+     * frame is read before its output frame is written: mix in place. */
     int i_input_nb = aout_FormatNbChannels( &p_filter->fmt_in.audio );
     int i_output_nb = aout_FormatNbChannels( &p_filter->fmt_out.audio );
-    p_out->i_nb_samples = p_block->i_nb_samples;
-    p_out->i_buffer = p_block->i_buffer * i_output_nb / i_input_nb;
-
-    work( p_filter, p_block, p_out );
+    assert( i_output_nb <= i_input_nb );
 
-    block_Release( p_block );
+    work( p_filter, p_block, p_block );
 
-    return p_out;
+    p_block->i_buffer = p_block->i_buffer * i_output_nb / i_input_nb;
+    return p_block;
 }
 
@@ -0,0 +1,149 @@
+/*****************************************************************************
+ * simple_avx2.h : simple channel mixer plug-in using AVX2 intrinsics
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <immintrin.h>
+#include <vlc_cpu.h>
+
+/* Only the common 7.1 and 5.1 to stereo conversions right now. Four frames
+ * are loaded before the two output frames are stored, so that the
+ * conversions can be done in place. */
+
+/* Two 128-bits rows of floats, at a and b, as one vector */
+#define LOAD_2x128(a, b) \
+    _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), \
+                         _mm_loadu_ps(b), 1)
+
+__attribute__ ((__target__ ("avx2")))
+static void convert_7_1_to_2_0_avx2( float *p_dest, const float *p_src,
+                                     unsigned i_nb_samples )
+{
+    const __m256 ctr = _mm256_set1_ps( 0.7071f );
+    const __m256 quarter = _mm256_set1_ps( 0.25f );
+    unsigned i = i_nb_samples / 4;
+
+    for( ; i > 0; i-- )
+    {
+        /* Frames 0 and 2, and 1 and 3, in each vector */
+        __m256 lo0 = LOAD_2x128( p_src +  0, p_src + 16 );
+        __m256 lo1 = LOAD_2x128( p_src +  8, p_src + 24 );
+        __m256 hi0 = LOAD_2x128( p_src +  4, p_src + 20 );
+        __m256 hi1 = LOAD_2x128( p_src + 12, p_src + 28 );
+
+        __m256 front = _mm256_shuffle_ps( lo0, lo1, _MM_SHUFFLE(1,0,1,0) );
+        __m256 middle = _mm256_shuffle_ps( lo0, lo1, _MM_SHUFFLE(3,2,3,2) );
+        __m256 rear = _mm256_shuffle_ps( hi0, hi1, _MM_SHUFFLE(1,0,1,0) );
+        __m256 center = _mm256_shuffle_ps( hi0, hi1, _MM_SHUFFLE(2,2,2,2) );
+
+        __m256 out = _mm256_add_ps( _mm256_mul_ps( center, ctr ), front );
+        out = _mm256_add_ps( out, _mm256_mul_ps( middle, quarter ) );
+        out = _mm256_add_ps( out, _mm256_mul_ps( rear, quarter ) );
+        _mm256_storeu_ps( p_dest, out );
+
+        p_src += 32;
+        p_dest += 8;
+    }
+
+    for( i = i_nb_samples % 4; i > 0; i-- )
+    {
+        float f_ctr = p_src[6] * 0.7071f;
+        *p_dest++ = f_ctr + p_src[0] + p_src[2] / 4 + p_src[4] / 4;
+        *p_dest++ = f_ctr + p_src[1] + p_src[3] / 4 + p_src[5] / 4;
+        p_src += 8;
+    }
+}
+
+__attribute__ ((__target__ ("avx2")))
+static void convert_5_1_to_2_0_avx2( float *p_dest, const float *p_src,
+                                     unsigned i_nb_samples )
+{
+    const __m256 ctr = _mm256_set1_ps( 0.7071f );
+    unsigned i = i_nb_samples / 4;
+
+    for( ; i > 0; i-- )
+    {
+        /* Frames 0 and 1 in the low halves, 2 and 3 in the high halves:
+         * L R Ls Rs | C LFE L R | Ls Rs C LFE */
+        __m256 a = LOAD_2x128( p_src + 0, p_src + 12 );
+        __m256 b = LOAD_2x128( p_src + 4, p_src + 16 );
+        __m256 c = LOAD_2x128( p_src + 8, p_src + 20 );
+
+        __m256 front = _mm256_shuffle_ps( a, b, _MM_SHUFFLE(3,2,1,0) );
+        __m256 rear = _mm256_shuffle_ps( a, c, _MM_SHUFFLE(1,0,3,2) );
+        __m256 center = _mm256_shuffle_ps( b, c, _MM_SHUFFLE(2,2,0,0) );
+
+        __m256 out = _mm256_mul_ps( ctr, _mm256_add_ps( center, rear ) );
+        _mm256_storeu_ps( p_dest, _mm256_add_ps( front, out ) );
+
+        p_src += 24;
+        p_dest += 8;
+    }
+
+    for( i = i_nb_samples % 4; i > 0; i-- )
+    {
+        *p_dest++ = p_src[0] + 0.7071f * (p_src[4] + p_src[2]);
+        *p_dest++ = p_src[1] + 0.7071f * (p_src[4] + p_src[3]);
+        p_src += 6;
+    }
+}
+
+#undef LOAD_2x128
+
+/* The vectors assume the LFE channel, the C code handles inputs without it */
+#define AVX2_WRAPPER(in, lfe, out) \
+    static void DoWork_##in##_to_##out##_avx2( filter_t *p_filter, \
+                                block_t *p_in_buf, block_t *p_out_buf ) \
+    { \
+        if( !(p_filter->fmt_in.audio.i_physical_channels & AOUT_CHAN_LFE) ) \
+        { \
+            DoWork_##in##_to_##out( p_filter, p_in_buf, p_out_buf ); \
+            return; \
+        } \
+        convert_##lfe##_to_##out##_avx2( (float *)p_out_buf->p_buffer, \
+                                         (const float *)p_in_buf->p_buffer, \
+                                         p_in_buf->i_nb_samples ); \
+    } \
+    static inline void (*GET_WORK_##in##_to_##out##_avx2(void))(filter_t*, block_t*, block_t*) \
+    { \
+        return vlc_CPU_AVX2() ? DoWork_##in##_to_##out##_avx2 : DoWork_##in##_to_##out; \
+    }
+
+AVX2_WRAPPER(7_x,7_1,2_0)
+AVX2_WRAPPER(5_x,5_1,2_0)
+
+/* The other conversions use the C code */
+
+#define C_WRAPPER(in, out) \
+    static inline void (*GET_WORK_##in##_to_##out##_avx2(void))(filter_t*, block_t*, block_t*) \
+    { \
+        return DoWork_##in##_to_##out; \
+    }
+
+C_WRAPPER(4_0,2_0)
+C_WRAPPER(3_x,2_0)
+C_WRAPPER(6_1,2_0)
+C_WRAPPER(7_x,1_0)
+C_WRAPPER(5_x,1_0)
+C_WRAPPER(4_0,1_0)
+C_WRAPPER(3_x,1_0)
+C_WRAPPER(2_x,1_0)
+C_WRAPPER(7_x,4_0)
+C_WRAPPER(5_x,4_0)
+C_WRAPPER(7_x,5_x)
+C_WRAPPER(6_1,5_x)
@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * loudness.c: EBU R 128 loudness meter
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_cpu.h>
+
+#include "loudness.h"
+
+static int  Open ( vlc_object_t * );
+static void Close( vlc_object_t * );
+
+vlc_module_begin()
+    set_shortname( N_("Loudness") )
+    set_description( N_("EBU R 128 loudness meter") )
+    set_help( N_("Measures the momentary, short-term and integrated "
+                 "loudness, and the true peak, of the audio output. "
+                 "The samples are not modified.") )
+    set_category( CAT_AUDIO )
+    set_subcategory( SUBCAT_AUDIO_AFILTER )
+    set_capability( "audio filter", 0 )
+    set_callbacks( Open, Close )
+vlc_module_end()
+
+struct filter_sys_t
+{
+    loudness_t loudness;
+    vlc_audio_meter_t *meter; /* NULL if not within an audio output */
+};
+
+static block_t *Process( filter_t *p_filter, block_t *p_block )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( loudness_Process( &p_sys->loudness, (const float *)p_block->p_buffer,
+                          p_block->i_nb_samples ) && p_sys->meter != NULL )
+    {
+        const vlc_audio_loudness_t loudness = {
+            .momentary = p_sys->loudness.momentary,
+            .short_term = p_sys->loudness.short_term,
+            .integrated = p_sys->loudness.integrated,
+            .true_peak = p_sys->loudness.true_peak,
+        };
+
+        vlc_audio_meter_Publish( p_sys->meter, &loudness );
+    }
+    return p_block;
+}
+
+static int Open( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    unsigned i_channels = aout_FormatNbChannels( &p_filter->fmt_in.audio );
+
+    if( i_channels == 0 || i_channels > AOUT_CHAN_MAX )
+        return VLC_EGENERIC;
+
+    filter_sys_t *p_sys = malloc( sizeof( *p_sys ) );
+    if( unlikely(p_sys == NULL) )
+        return VLC_ENOMEM;
+
+    loudness_peak_t pf_peak = loudness_Peak_C;
+#ifdef HAVE_AVX2_INTRINSICS
+    if( vlc_CPU_AVX2() )
+        pf_peak = loudness_Peak_AVX2;
+#endif
+    loudness_Init( &p_sys->loudness, p_filter->fmt_in.audio.i_rate,
+                   i_channels, p_filter->fmt_in.audio.i_physical_channels,
+                   pf_peak );
+
+    /* The meters are owned by the audio output, so that they outlive the
+     * filter chain restarts */
+    p_sys->meter = var_InheritAddress( p_filter, "audio-meter" );
+    if( p_sys->meter != NULL )
+        vlc_audio_meter_Publish( p_sys->meter, NULL );
+
+    p_filter->p_sys = p_sys;
+    p_filter->fmt_in.audio.i_format = VLC_CODEC_FL32;
+    p_filter->fmt_out.audio = p_filter->fmt_in.audio;
+    p_filter->pf_audio_filter = Process;
+    return VLC_SUCCESS;
+}
+
+static void Close( vlc_object_t *p_this )
+{
+    filter_t *p_filter = (filter_t *)p_this;
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    msg_Dbg( p_filter, "integrated loudness: %.1f LUFS, true peak: %.1f dBTP",
+             p_sys->loudness.integrated, p_sys->loudness.true_peak );
+    if( p_sys->meter != NULL )
+        vlc_audio_meter_Publish( p_sys->meter, NULL );
+    free( p_sys );
+}
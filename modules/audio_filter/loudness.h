@@ -0,0 +1,335 @@
+/*****************************************************************************
+ * loudness.h: EBU R 128 loudness and true-peak measurement
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_LOUDNESS_H
+#define VLC_LOUDNESS_H 1
+
+#include <math.h>
+#include <string.h>
+
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+
+/* The measurement follows ITU-R BS.1770-4 and EBU Tech 3341: the K-weighted
+ * power is accumulated over 100 ms sub-blocks, from which the 400 ms
+ * (momentary) and 3 s (short-term) windows are derived. The momentary
+ * blocks, overlapping by 75%, feed the gated integrated loudness. */
+#define LOUDNESS_MOMENTARY   4  /* sub-blocks per momentary window */
+#define LOUDNESS_SHORT_TERM 30  /* sub-blocks per short-term window */
+
+/* The gated blocks are kept in 0.1 LU bins, from the absolute gate up to
+ * +10 LUFS, so that memory does not grow with the playback duration. Each
+ * bin sums the exact power of its blocks. */
+#define LOUDNESS_GATE      (-70.)
+#define LOUDNESS_BINS       800
+
+/* The true peak is the peak of the signal oversampled 4 times by a
+ * windowed sinc of 12 taps per phase. */
+#define LOUDNESS_PHASES      4
+#define LOUDNESS_TAPS       12
+#define LOUDNESS_HISTORY    (LOUDNESS_TAPS - 1)
+
+/* Frames deinterleaved at once */
+#define LOUDNESS_CHUNK    1024
+
+typedef float (*loudness_peak_t)(const float *, unsigned,
+                                 const float (*)[LOUDNESS_TAPS]);
+
+typedef struct
+{
+    unsigned channels;
+    double   weights[AOUT_CHAN_MAX];
+
+    /* K-weighting: high shelf, then high-pass (with 1, -2, 1 zeros) */
+    double   shelf_b[3], shelf_a[2], hp_a[2];
+    double   state[AOUT_CHAN_MAX][4];
+
+    /* Current sub-block */
+    unsigned block_size;
+    unsigned block_fill;
+    double   block_sum;
+
+    /* Mean power of the last sub-blocks */
+    double   ring[LOUDNESS_SHORT_TERM];
+    unsigned ring_pos, ring_count;
+
+    /* Gated momentary blocks */
+    double   hist_sum[LOUDNESS_BINS];
+    uint64_t hist_count[LOUDNESS_BINS];
+
+    /* True peak */
+    float    coefs[LOUDNESS_PHASES][LOUDNESS_TAPS];
+    float    planar[AOUT_CHAN_MAX][LOUDNESS_HISTORY + LOUDNESS_CHUNK];
+    float    peak;
+    loudness_peak_t pf_peak;
+
+    /* Measurements in LUFS, true peak in dBTP, -INFINITY if unknown */
+    float    momentary;
+    float    short_term;
+    float    integrated;
+    float    true_peak;
+} loudness_t;
+
+static inline double loudness_FromPower(double power)
+{
+    return power > 0. ? -0.691 + 10. * log10(power) : -INFINITY;
+}
+
+/* Peak of the n interpolated positions following in[LOUDNESS_HISTORY / 2],
+ * in[] holding n + LOUDNESS_HISTORY samples */
+static float loudness_Peak_C(const float *in, unsigned n,
+                             const float (*coefs)[LOUDNESS_TAPS])
+{
+    float peak = 0.f;
+
+    for (unsigned p = 0; p < LOUDNESS_PHASES; p++)
+        for (unsigned i = 0; i < n; i++) {
+            float y = 0.f;
+
+            for (unsigned t = 0; t < LOUDNESS_TAPS; t++)
+                y += coefs[p][t] * in[i + t];
+            peak = fmaxf(peak, fabsf(y));
+        }
+    return peak;
+}
+
+#ifdef HAVE_AVX2_INTRINSICS
+/* AVX2 version of loudness_Peak_C(), 8 positions of a phase at a time */
+__attribute__ ((__target__ ("avx2")))
+static float loudness_Peak_AVX2(const float *in, unsigned n,
+                                const float (*coefs)[LOUDNESS_TAPS])
+{
+    const __m256 sign = _mm256_set1_ps(-0.f);
+    __m256 peak = _mm256_setzero_ps();
+    unsigned i = 0;
+
+    for (; i + 8 <= n; i += 8)
+        for (unsigned p = 0; p < LOUDNESS_PHASES; p++) {
+            __m256 y = _mm256_setzero_ps();
+
+            for (unsigned t = 0; t < LOUDNESS_TAPS; t++)
+                y = _mm256_add_ps(y,
+                        _mm256_mul_ps(_mm256_set1_ps(coefs[p][t]),
+                                      _mm256_loadu_ps(&in[i + t])));
+            peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, y));
+        }
+
+    __m128 max = _mm_max_ps(_mm256_castps256_ps128(peak),
+                            _mm256_extractf128_ps(peak, 1));
+    max = _mm_max_ps(max, _mm_movehl_ps(max, max));
+    max = _mm_max_ss(max, _mm_shuffle_ps(max, max, 1));
+    return fmaxf(_mm_cvtss_f32(max), loudness_Peak_C(&in[i], n - i, coefs));
+}
+#endif
+
+/**
+ * Sets the measurement up for rate Hz samples with the given channels,
+ * in the WG4 order of the physical channels mask.
+ */
+static void loudness_Init(loudness_t *l, unsigned rate, unsigned channels,
+                          uint32_t physical, loudness_peak_t pf_peak)
+{
+    memset(l, 0, sizeof (*l));
+    l->channels = channels;
+    l->pf_peak = pf_peak;
+
+    /* Surround channels count 1.5 dB more, the LFE is ignored */
+    for (unsigned c = 0; c < channels; c++)
+        l->weights[c] = 1.;
+    for (unsigned i = 0, c = 0; pi_vlc_chan_order_wg4[i] && c < channels; i++) {
+        const uint32_t chan = pi_vlc_chan_order_wg4[i];
+
+        if (!(physical & chan))
+            continue;
+        if (chan == AOUT_CHAN_LFE)
+            l->weights[c] = 0.;
+        else if (chan & (AOUT_CHAN_MIDDLELEFT | AOUT_CHAN_MIDDLERIGHT |
+                         AOUT_CHAN_REARLEFT | AOUT_CHAN_REARRIGHT |
+                         AOUT_CHAN_REARCENTER))
+            l->weights[c] = 1.41;
+        c++;
+    }
+
+    /* BS.1770 filters, derived for any sample rate */
+    double f0 = 1681.974450955533, q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / rate);
+    const double vh = pow(10., 3.999843853973347 / 20.);
+    const double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1. + k / q + k * k;
+
+    l->shelf_b[0] = (vh + vb * k / q + k * k) / a0;
+    l->shelf_b[1] = 2. * (k * k - vh) / a0;
+    l->shelf_b[2] = (vh - vb * k / q + k * k) / a0;
+    l->shelf_a[0] = 2. * (k * k - 1.) / a0;
+    l->shelf_a[1] = (1. - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / rate);
+    a0 = 1. + k / q + k * k;
+    l->hp_a[0] = 2. * (k * k - 1.) / a0;
+    l->hp_a[1] = (1. - k / q + k * k) / a0;
+
+    l->block_size = rate >= 10 ? rate / 10 : 1;
+
+    /* Hann windowed sinc, each phase normalized to unity gain */
+    for (unsigned p = 0; p < LOUDNESS_PHASES; p++) {
+        double sum = 0.;
+
+        for (unsigned t = 0; t < LOUDNESS_TAPS; t++) {
+            const double x = (double)p / LOUDNESS_PHASES
+                           + (LOUDNESS_TAPS / 2 - 1) - (double)t;
+            const double sinc = x != 0. ? sin(M_PI * x) / (M_PI * x) : 1.;
+            const double w = .5 + .5 * cos(M_PI * x / (LOUDNESS_TAPS / 2 + .5));
+
+            l->coefs[p][t] = sinc * w;
+            sum += sinc * w;
+        }
+        for (unsigned t = 0; t < LOUDNESS_TAPS; t++)
+            l->coefs[p][t] /= sum;
+    }
+
+    l->momentary = l->short_term = l->integrated = l->true_peak = -INFINITY;
+}
+
+static float loudness_Integrate(const loudness_t *l)
+{
+    double sum = 0.;
+    uint64_t count = 0;
+
+    for (unsigned i = 0; i < LOUDNESS_BINS; i++) {
+        sum += l->hist_sum[i];
+        count += l->hist_count[i];
+    }
+    if (count == 0)
+        return -INFINITY;
+
+    /* Relative gate, 10 LU below the absolute-gated loudness */
+    const double gate = loudness_FromPower(sum / count) - 10.;
+    int first = floor((gate - LOUDNESS_GATE) * 10.);
+    if (first < 0)
+        first = 0;
+
+    sum = 0.;
+    count = 0;
+    for (unsigned i = first; i < LOUDNESS_BINS; i++) {
+        sum += l->hist_sum[i];
+        count += l->hist_count[i];
+    }
+    return count ? loudness_FromPower(sum / count) : -INFINITY;
+}
+
+static void loudness_EndBlock(loudness_t *l)
+{
+    l->ring[l->ring_pos] = l->block_sum / l->block_size;
+    l->ring_pos = (l->ring_pos + 1) % LOUDNESS_SHORT_TERM;
+    if (l->ring_count < LOUDNESS_SHORT_TERM)
+        l->ring_count++;
+    l->block_sum = 0.;
+    l->block_fill = 0;
+
+    /* Keep the filters out of denormals after silence */
+    for (unsigned c = 0; c < l->channels; c++)
+        for (unsigned i = 0; i < 4; i++)
+            if (fabs(l->state[c][i]) < 1e-30)
+                l->state[c][i] = 0.;
+
+    l->true_peak = l->peak > 0.f ? 20. * log10(l->peak) : -INFINITY;
+
+    if (l->ring_count < LOUDNESS_MOMENTARY)
+        return;
+
+    double sum = 0., momentary = 0.;
+    for (unsigned i = 1; i <= l->ring_count; i++) {
+        sum += l->ring[(l->ring_pos + LOUDNESS_SHORT_TERM - i)
+                       % LOUDNESS_SHORT_TERM];
+        if (i == LOUDNESS_MOMENTARY)
+            momentary = sum / LOUDNESS_MOMENTARY;
+    }
+    /* Over the available sub-blocks during the first 3 seconds */
+    l->short_term = loudness_FromPower(sum / l->ring_count);
+    l->momentary = loudness_FromPower(momentary);
+
+    if (l->momentary >= LOUDNESS_GATE) {
+        unsigned bin = (l->momentary - LOUDNESS_GATE) * 10.;
+        if (bin >= LOUDNESS_BINS)
+            bin = LOUDNESS_BINS - 1;
+        l->hist_sum[bin] += momentary;
+        l->hist_count[bin]++;
+        l->integrated = loudness_Integrate(l);
+    }
+}
+
+/**
+ * Measures interleaved samples.
+ * @return whether at least one sub-block was completed, i.e. whether the
+ * measurements were updated
+ */
+static bool loudness_Process(loudness_t *l, const float *samples,
+                             unsigned frames)
+{
+    const unsigned channels = l->channels;
+    bool updated = false;
+
+    while (frames > 0) {
+        unsigned n = l->block_size - l->block_fill;
+        if (n > LOUDNESS_CHUNK)
+            n = LOUDNESS_CHUNK;
+        if (n > frames)
+            n = frames;
+
+        for (unsigned c = 0; c < channels; c++) {
+            float *buf = l->planar[c];
+            double *z = l->state[c];
+            double sum = 0.;
+
+            /* Transposed direct form II, as the filters are recursive the
+             * channels are processed one after the other */
+            for (unsigned i = 0; i < n; i++) {
+                const float x = samples[i * channels + c];
+                const double y = l->shelf_b[0] * x + z[0];
+                const double w = y + z[2];
+
+                buf[LOUDNESS_HISTORY + i] = x;
+                z[0] = l->shelf_b[1] * x - l->shelf_a[0] * y + z[1];
+                z[1] = l->shelf_b[2] * x - l->shelf_a[1] * y;
+                z[2] = -2. * y - l->hp_a[0] * w + z[3];
+                z[3] = y - l->hp_a[1] * w;
+                sum += w * w;
+            }
+            l->block_sum += l->weights[c] * sum;
+
+            l->peak = fmaxf(l->peak, l->pf_peak(buf, n, l->coefs));
+            memmove(buf, buf + n, LOUDNESS_HISTORY * sizeof (*buf));
+        }
+
+        samples += n * channels;
+        frames -= n;
+        l->block_fill += n;
+        if (l->block_fill == l->block_size) {
+            loudness_EndBlock(l);
+            updated = true;
+        }
+    }
+    return updated;
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*****************************************************************************
+ * polyphase.c : windowed sinc polyphase resampler
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <vlc_common.h>
+#include <vlc_aout.h>
+#include <vlc_filter.h>
+#include <vlc_plugin.h>
+#include <vlc_cpu.h>
+
+#include "polyphase.h"
+
+static int Open (vlc_object_t *);
+static int OpenResampler (vlc_object_t *);
+static void Close (vlc_object_t *);
+
+vlc_module_begin ()
+    set_shortname (N_("Polyphase resampler"))
+    set_description (N_("Windowed sinc polyphase resampler"))
+    set_category (CAT_AUDIO)
+    set_subcategory (SUBCAT_AUDIO_MISC)
+    set_capability ("audio converter", 25)
+    set_callbacks (Open, Close)
+
+    add_submodule ()
+    set_capability ("audio resampler", 25)
+    set_callbacks (OpenResampler, Close)
+    add_shortcut ("polyphase")
+vlc_module_end ()
+
+static block_t *Resample (filter_t *, block_t *);
+static block_t *Drain (filter_t *);
+static void Flush (filter_t *);
+
+static int OpenResampler (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+
+    /* Cannot convert format */
+    if (filter->fmt_in.audio.i_format != VLC_CODEC_FL32
+     || filter->fmt_out.audio.i_format != VLC_CODEC_FL32
+    /* Cannot remix */
+     || filter->fmt_in.audio.i_physical_channels
+                                  != filter->fmt_out.audio.i_physical_channels
+     || filter->fmt_in.audio.i_original_channels
+                                  != filter->fmt_out.audio.i_original_channels)
+        return VLC_EGENERIC;
+
+    unsigned channels = aout_FormatNbChannels (&filter->fmt_in.audio);
+    if (channels == 0 || filter->fmt_in.audio.i_rate == 0
+     || filter->fmt_out.audio.i_rate == 0)
+        return VLC_EGENERIC;
+
+    polyphase_t *p = malloc (sizeof (*p));
+    if (unlikely(p == NULL))
+        return VLC_ENOMEM;
+
+    polyphase_frame_t pf_frame = polyphase_Frame_C;
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2 ())
+        pf_frame = polyphase_Frame_AVX2;
+#endif
+    if (polyphase_Init (p, channels, filter->fmt_in.audio.i_rate,
+                        filter->fmt_out.audio.i_rate, pf_frame))
+    {
+        free (p);
+        return VLC_ENOMEM;
+    }
+
+    msg_Dbg (obj, "%u Hz to %u Hz with %u taps", filter->fmt_in.audio.i_rate,
+             filter->fmt_out.audio.i_rate, p->taps);
+
+    filter->p_sys = (filter_sys_t *)p;
+    filter->pf_audio_filter = Resample;
+    filter->pf_audio_drain = Drain;
+    filter->pf_flush = Flush;
+    return VLC_SUCCESS;
+}
+
+static int Open (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+
+    /* Will change rate */
+    if (filter->fmt_in.audio.i_rate == filter->fmt_out.audio.i_rate)
+        return VLC_EGENERIC;
+    return OpenResampler (obj);
+}
+
+static void Close (vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+    polyphase_t *p = (polyphase_t *)filter->p_sys;
+
+    polyphase_Clean (p);
+    free (p);
+}
+
+static block_t *Process (filter_t *filter, const float *in, unsigned frames,
+                         mtime_t pts)
+{
+    polyphase_t *p = (polyphase_t *)filter->p_sys;
+    const unsigned irate = filter->fmt_in.audio.i_rate;
+    const unsigned orate = filter->fmt_out.audio.i_rate;
+    const size_t framesize = filter->fmt_out.audio.i_bytes_per_frame;
+
+    /* Date of the next output, from the input frames before it */
+    const mtime_t delay = polyphase_Delay (p) * CLOCK_FREQ / irate;
+
+    unsigned olen = polyphase_MaxOutput (p, irate, frames);
+    block_t *out = block_Alloc (olen * framesize);
+    if (unlikely(out == NULL))
+        return NULL;
+
+    olen = polyphase_Process (p, irate, in, frames, (float *)out->p_buffer,
+                              olen);
+
+    out->i_buffer = olen * framesize;
+    out->i_nb_samples = olen;
+    out->i_pts = pts > VLC_TS_INVALID ? pts - delay : pts;
+    out->i_length = olen * CLOCK_FREQ / orate;
+    return out;
+}
+
+static block_t *Resample (filter_t *filter, block_t *in)
+{
+    polyphase_t *p = (polyphase_t *)filter->p_sys;
+
+    if (in->i_flags & BLOCK_FLAG_DISCONTINUITY)
+        polyphase_Reset (p);
+
+    block_t *out = Process (filter, (const float *)in->p_buffer,
+                            in->i_nb_samples, in->i_pts);
+    block_Release (in);
+    return out;
+}
+
+static block_t *Drain (filter_t *filter)
+{
+    polyphase_t *p = (polyphase_t *)filter->p_sys;
+    const unsigned frames = p->taps / 2;
+
+    /* Push silence through the filter to get the buffered frames out */
+    float *zeros = calloc (frames * p->channels, sizeof (*zeros));
+    if (unlikely(zeros == NULL))
+        return NULL;
+
+    block_t *out = Process (filter, zeros, frames, VLC_TS_INVALID);
+    free (zeros);
+    polyphase_Reset (p);
+    return out;
+}
+
+static void Flush (filter_t *filter)
+{
+    polyphase_Reset ((polyphase_t *)filter->p_sys);
+}
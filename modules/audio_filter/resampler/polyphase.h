@@ -0,0 +1,328 @@
+/*****************************************************************************
+ * polyphase.h: windowed sinc polyphase resampling
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_POLYPHASE_H
+#define VLC_POLYPHASE_H 1
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+
+/* The filter is a Kaiser windowed sinc, with about 90 dB of stopband
+ * attenuation. At 64 taps, its transition band is 9% of the sampling rate
+ * wide and ends at the Nyquist frequency of the lower rate. When
+ * downsampling, the number of taps grows with the ratio so that the
+ * transition band keeps the same width relative to the output rate. */
+#define POLYPHASE_TAPS       64
+#define POLYPHASE_MAX_TAPS  512
+#define POLYPHASE_BETA      8.96
+#define POLYPHASE_CUTOFF    0.91 /* center of the transition band */
+
+/* The coefficients are tabulated for this many fractional positions between
+ * two input samples, and interpolated linearly in between. Any ratio thus
+ * uses the same table, so that the ratio can change on every block. */
+#define POLYPHASE_PHASES    256
+
+/* Frames deinterleaved at once */
+#define POLYPHASE_CHUNK    1024
+
+/* Computes one interleaved output frame from the planar input windows */
+typedef void (*polyphase_frame_t)(float *, const float *, unsigned, unsigned,
+                                  const float *, const float *, float,
+                                  float *, unsigned);
+
+typedef struct
+{
+    unsigned channels;
+    unsigned taps;
+    unsigned out_rate;
+
+    float   *coefs;    /* POLYPHASE_PHASES + 1 rows of taps */
+    float   *blend;    /* coefficients of the current position */
+    float   *planar;   /* one row of stride input frames per channel */
+    unsigned stride;
+    unsigned avail;    /* frames in each row */
+
+    /* Position of the next output: the filter window starts at the index-th
+     * frame of the rows, and the output lies num / out_rate frames after the
+     * center of the window */
+    unsigned index;
+    unsigned num;
+
+    polyphase_frame_t pf_frame;
+} polyphase_t;
+
+static double polyphase_BesselI0(double x)
+{
+    double sum = 1., term = 1.;
+
+    for (unsigned k = 1; term > sum * 1e-12; k++) {
+        term *= (x / (2. * k)) * (x / (2. * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static void polyphase_Frame_C(float *out, const float *planar,
+                              unsigned stride, unsigned channels,
+                              const float *c0, const float *c1, float frac,
+                              float *blend, unsigned taps)
+{
+    for (unsigned k = 0; k < taps; k++)
+        blend[k] = c0[k] + frac * (c1[k] - c0[k]);
+
+    for (unsigned c = 0; c < channels; c++) {
+        const float *x = &planar[c * stride];
+        float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+
+        /* Independent sums for the pipelines, taps is a multiple of 8 */
+        for (unsigned k = 0; k < taps; k += 4)
+            for (unsigned i = 0; i < 4; i++)
+                sum[i] += blend[k + i] * x[k + i];
+        out[c] = (sum[0] + sum[2]) + (sum[1] + sum[3]);
+    }
+}
+
+#ifdef HAVE_AVX2_INTRINSICS
+/* AVX2 version of polyphase_Frame_C(), 8 taps at a time */
+__attribute__ ((__target__ ("avx2")))
+static void polyphase_Frame_AVX2(float *out, const float *planar,
+                                 unsigned stride, unsigned channels,
+                                 const float *c0, const float *c1, float frac,
+                                 float *blend, unsigned taps)
+{
+    const __m256 f = _mm256_set1_ps(frac);
+
+    for (unsigned k = 0; k < taps; k += 8) {
+        const __m256 a = _mm256_loadu_ps(&c0[k]);
+        const __m256 b = _mm256_loadu_ps(&c1[k]);
+
+        _mm256_storeu_ps(&blend[k],
+                         _mm256_add_ps(a, _mm256_mul_ps(f, _mm256_sub_ps(b, a))));
+    }
+
+    for (unsigned c = 0; c < channels; c++) {
+        const float *x = &planar[c * stride];
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+        unsigned k = 0;
+
+        for (; k + 16 <= taps; k += 16) {
+            sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(&blend[k]),
+                                                     _mm256_loadu_ps(&x[k])));
+            sum1 = _mm256_add_ps(sum1,
+                                 _mm256_mul_ps(_mm256_loadu_ps(&blend[k + 8]),
+                                               _mm256_loadu_ps(&x[k + 8])));
+        }
+        if (k < taps)
+            sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(&blend[k]),
+                                                     _mm256_loadu_ps(&x[k])));
+
+        __m256 sum = _mm256_add_ps(sum0, sum1);
+        __m128 s = _mm_add_ps(_mm256_castps256_ps128(sum),
+                              _mm256_extractf128_ps(sum, 1));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+        out[c] = _mm_cvtss_f32(s);
+    }
+}
+#endif
+
+/**
+ * Drops the buffered input, the next input frame will be the first one.
+ */
+static void polyphase_Reset(polyphase_t *p)
+{
+    /* Zeroes before the first frame, so that the first output matches it */
+    p->avail = p->taps / 2 - 1;
+    memset(p->planar, 0, p->channels * p->stride * sizeof (*p->planar));
+    p->index = 0;
+    p->num = 0;
+}
+
+/**
+ * Sets a resampler up for the nominal rates. The input rate may later vary
+ * around its nominal value without recomputing the coefficients.
+ */
+static int polyphase_Init(polyphase_t *p, unsigned channels,
+                          unsigned in_rate, unsigned out_rate,
+                          polyphase_frame_t pf_frame)
+{
+    const double ratio = in_rate > out_rate ? (double)out_rate / in_rate : 1.;
+
+    unsigned taps = ceil(POLYPHASE_TAPS / ratio);
+    taps = (taps + 7) & ~7u;
+    if (taps > POLYPHASE_MAX_TAPS)
+        taps = POLYPHASE_MAX_TAPS;
+
+    p->channels = channels;
+    p->taps = taps;
+    p->out_rate = out_rate;
+    p->stride = taps + POLYPHASE_CHUNK;
+    p->pf_frame = pf_frame;
+    p->coefs = malloc((POLYPHASE_PHASES + 1) * taps * sizeof (*p->coefs));
+    p->blend = malloc(taps * sizeof (*p->blend));
+    p->planar = malloc(channels * p->stride * sizeof (*p->planar));
+    if (p->coefs == NULL || p->blend == NULL || p->planar == NULL) {
+        free(p->coefs);
+        free(p->blend);
+        free(p->planar);
+        return -1;
+    }
+
+    /* Row i is for outputs i / POLYPHASE_PHASES after the window center */
+    const double cutoff = POLYPHASE_CUTOFF * ratio;
+    const double half = taps / 2.;
+    const double i0 = polyphase_BesselI0(POLYPHASE_BETA);
+    double gain = 0.;
+
+    for (unsigned i = 0; i <= POLYPHASE_PHASES; i++)
+        for (unsigned k = 0; k < taps; k++) {
+            const double t = (double)i / POLYPHASE_PHASES + (half - 1.) - k;
+            const double x = cutoff * t;
+            const double sinc = x != 0. ? sin(M_PI * x) / (M_PI * x) : 1.;
+            const double r = t / half;
+            const double w = r * r < 1.
+                ? polyphase_BesselI0(POLYPHASE_BETA * sqrt(1. - r * r)) / i0
+                : 0.;
+            const double h = cutoff * sinc * w;
+
+            p->coefs[i * taps + k] = h;
+            if (i < POLYPHASE_PHASES)
+                gain += h;
+        }
+
+    /* Unity gain on average over the positions */
+    gain /= POLYPHASE_PHASES;
+    for (unsigned i = 0; i < (POLYPHASE_PHASES + 1) * taps; i++)
+        p->coefs[i] /= gain;
+
+    polyphase_Reset(p);
+    return 0;
+}
+
+static void polyphase_Clean(polyphase_t *p)
+{
+    free(p->coefs);
+    free(p->blend);
+    free(p->planar);
+}
+
+/**
+ * Number of input frames, buffered or yet to come, from the next output to
+ * the end of the buffered input.
+ */
+static double polyphase_Delay(const polyphase_t *p)
+{
+    return (double)p->avail - (p->index + p->taps / 2 - 1)
+         - (double)p->num / p->out_rate;
+}
+
+/**
+ * Upper bound of the output frames of polyphase_Process().
+ */
+static unsigned polyphase_MaxOutput(const polyphase_t *p, unsigned in_rate,
+                                    unsigned frames)
+{
+    return ((uint64_t)(p->avail + frames) * p->out_rate) / in_rate + 1;
+}
+
+/**
+ * Resamples interleaved frames from the current input rate.
+ * @return the number of output frames
+ */
+static unsigned polyphase_Process(polyphase_t *p, unsigned in_rate,
+                                  const float *in, unsigned frames,
+                                  float *out, unsigned max_out)
+{
+    const unsigned channels = p->channels, taps = p->taps;
+    const unsigned center = taps / 2 - 1;
+    const unsigned step = in_rate / p->out_rate;
+    const unsigned step_num = in_rate % p->out_rate;
+    unsigned count = 0;
+
+    for (;;) {
+        while (p->index + taps <= p->avail && count < max_out) {
+            float *frame = &out[count * channels];
+
+            if (p->num == 0 && in_rate == p->out_rate) {
+                /* Same rates and no fractional position (yet): copy */
+                for (unsigned c = 0; c < channels; c++)
+                    frame[c] = p->planar[c * p->stride + p->index + center];
+            } else {
+                const uint64_t pos = (uint64_t)p->num * POLYPHASE_PHASES;
+                const unsigned phase = pos / p->out_rate;
+                const float frac = (float)(pos % p->out_rate) / p->out_rate;
+                const float *c0 = &p->coefs[phase * taps];
+
+                p->pf_frame(frame, &p->planar[p->index], p->stride, channels,
+                            c0, c0 + taps, frac, p->blend, taps);
+            }
+            count++;
+
+            p->index += step;
+            p->num += step_num;
+            if (p->num >= p->out_rate) {
+                p->num -= p->out_rate;
+                p->index++;
+            }
+        }
+        if (frames == 0 || count == max_out)
+            break;
+
+        /* Drop the frames before the window */
+        unsigned drop = p->index < p->avail ? p->index : p->avail;
+        if (drop > 0) {
+            for (unsigned c = 0; c < channels; c++) {
+                float *row = &p->planar[c * p->stride];
+                memmove(row, row + drop, (p->avail - drop) * sizeof (*row));
+            }
+            p->avail -= drop;
+            p->index -= drop;
+        }
+
+        /* When downsampling, the window may start after the buffered frames */
+        if (p->index > 0) {
+            unsigned skip = p->index < frames ? p->index : frames;
+            in += skip * channels;
+            frames -= skip;
+            p->index -= skip;
+            continue;
+        }
+
+        unsigned n = p->stride - p->avail;
+        if (n > frames)
+            n = frames;
+        for (unsigned c = 0; c < channels; c++) {
+            float *row = &p->planar[c * p->stride + p->avail];
+            for (unsigned i = 0; i < n; i++)
+                row[i] = in[i * channels + c];
+        }
+        p->avail += n;
+        in += n * channels;
+        frames -= n;
+    }
+    return count;
+}
+
+#endif
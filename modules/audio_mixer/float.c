@@ -34,6 +34,11 @@
 #include <vlc_plugin.h>
 #include <vlc_aout.h>
 #include <vlc_aout_volume.h>
+#include <vlc_cpu.h>
+
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
 
 /*****************************************************************************
  * Local prototypes
@@ -67,6 +72,37 @@ static void FilterFL32( audio_volume_t *p_volume, block_t *p_buffer,
     (void) p_volume;
 }
 
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__ ((__target__ ("avx2")))
+static void FilterFL32_AVX2( audio_volume_t *p_volume, block_t *p_buffer,
+                             float f_multiplier )
+{
+    if( f_multiplier == 1.f )
+        return; /* nothing to do */
+
+    const __m256 mult = _mm256_set1_ps( f_multiplier );
+    float *p = (float *)p_buffer->p_buffer;
+    size_t i = p_buffer->i_buffer / sizeof(*p);
+
+    for( ; i >= 32; i -= 32, p += 32 )
+    {
+        __m256 a = _mm256_loadu_ps( p );
+        __m256 b = _mm256_loadu_ps( p + 8 );
+        __m256 c = _mm256_loadu_ps( p + 16 );
+        __m256 d = _mm256_loadu_ps( p + 24 );
+
+        _mm256_storeu_ps( p, _mm256_mul_ps( a, mult ) );
+        _mm256_storeu_ps( p + 8, _mm256_mul_ps( b, mult ) );
+        _mm256_storeu_ps( p + 16, _mm256_mul_ps( c, mult ) );
+        _mm256_storeu_ps( p + 24, _mm256_mul_ps( d, mult ) );
+    }
+    for( ; i > 0; i-- )
+        *(p++) *= f_multiplier;
+
+    (void) p_volume;
+}
+#endif
+
 static void FilterFL64( audio_volume_t *p_volume, block_t *p_buffer,
                         float f_multiplier )
 {
@@ -92,6 +128,10 @@ static int Create( vlc_object_t *p_this )
     {
         case VLC_CODEC_FL32:
             p_volume->amplify = FilterFL32;
+#ifdef HAVE_AVX2_INTRINSICS
+            if( vlc_CPU_AVX2() )
+                p_volume->amplify = FilterFL32_AVX2;
+#endif
             break;
         case VLC_CODEC_FL64:
             p_volume->amplify = FilterFL64;
@@ -125,9 +125,17 @@ typedef struct
     int     i_line_count;
     int     i_line;
     char    **line;
+
+    /* Lines read from the stream as they are parsed, instead of loaded */
+    stream_t *s;
+    char     *psz_line;        /* last line read */
+    uint64_t  i_line_offset;   /* stream offset of psz_line */
+    bool      b_pushback;      /* psz_line to be returned again */
+    uint64_t  i_entry_offset;  /* offset of the last subtitle found */
 } text_t;
 
 static int  TextLoad( text_t *, stream_t *s );
+static void TextOpen( text_t *, stream_t *s );
 static void TextUnload( text_t * );
 
 typedef struct
@@ -138,6 +146,19 @@ typedef struct
     char    *psz_text;
 } subtitle_t;
 
+/* Index entry of a subtitle parsed on demand */
+typedef struct
+{
+    int64_t  i_start;
+    int64_t  i_stop;
+    int64_t  i_max_stop; /* highest end (or start) of this and previous entries */
+    uint64_t i_offset;
+    int      i_idx;
+} subtitle_index_t;
+
+/* Above this size, subtitles are indexed and only parsed when played */
+#define SUB_INDEX_MIN_SIZE (1 << 20)
+
 
 struct demux_sys_t
 {
@@ -152,6 +173,8 @@ struct demux_sys_t
     int         i_subtitle;
     int         i_subtitles;
     subtitle_t  *subtitle;
+    subtitle_index_t *index; /* instead of subtitle, if parsed on demand */
+    int         (*pf_read)( demux_t *, subtitle_t*, int );
 
     int64_t     i_length;
 
@@ -197,29 +220,30 @@ static const struct
     int  i_type;
     const char *psz_name;
     int  (*pf_read)( demux_t *, subtitle_t*, int );
+    bool b_indexable; /* entries can be parsed on their own */
 } sub_read_subtitle_function [] =
 {
-    { "microdvd",   SUB_TYPE_MICRODVD,    "MicroDVD",    ParseMicroDvd },
-    { "subrip",     SUB_TYPE_SUBRIP,      "SubRIP",      ParseSubRip },
-    { "subviewer",  SUB_TYPE_SUBVIEWER,   "SubViewer",   ParseSubViewer },
-    { "ssa1",       SUB_TYPE_SSA1,        "SSA-1",       ParseSSA },
-    { "ssa2-4",     SUB_TYPE_SSA2_4,      "SSA-2/3/4",   ParseSSA },
-    { "ass",        SUB_TYPE_ASS,         "SSA/ASS",     ParseSSA },
-    { "vplayer",    SUB_TYPE_VPLAYER,     "VPlayer",     ParseVplayer },
-    { "sami",       SUB_TYPE_SAMI,        "SAMI",        ParseSami },
-    { "dvdsubtitle",SUB_TYPE_DVDSUBTITLE, "DVDSubtitle", ParseDVDSubtitle },
-    { "mpl2",       SUB_TYPE_MPL2,        "MPL2",        ParseMPL2 },
-    { "aqt",        SUB_TYPE_AQT,         "AQTitle",     ParseAQT },
-    { "pjs",        SUB_TYPE_PJS,         "PhoenixSub",  ParsePJS },
-    { "mpsub",      SUB_TYPE_MPSUB,       "MPSub",       ParseMPSub },
-    { "jacosub",    SUB_TYPE_JACOSUB,     "JacoSub",     ParseJSS },
-    { "psb",        SUB_TYPE_PSB,         "PowerDivx",   ParsePSB },
-    { "realtext",   SUB_TYPE_RT,          "RealText",    ParseRealText },
-    { "dks",        SUB_TYPE_DKS,         "DKS",         ParseDKS },
-    { "subviewer1", SUB_TYPE_SUBVIEW1,    "Subviewer 1", ParseSubViewer1 },
-    { "text/vtt",   SUB_TYPE_VTT,         "WebVTT",      ParseCommonVTTSBV },
-    { "sbv",        SUB_TYPE_SBV,         "SBV",         ParseCommonVTTSBV },
-    { NULL,         SUB_TYPE_UNKNOWN,     "Unknown",     NULL }
+    { "microdvd",   SUB_TYPE_MICRODVD,    "MicroDVD",    ParseMicroDvd,    true },
+    { "subrip",     SUB_TYPE_SUBRIP,      "SubRIP",      ParseSubRip,      true },
+    { "subviewer",  SUB_TYPE_SUBVIEWER,   "SubViewer",   ParseSubViewer,   true },
+    { "ssa1",       SUB_TYPE_SSA1,        "SSA-1",       ParseSSA,         true },
+    { "ssa2-4",     SUB_TYPE_SSA2_4,      "SSA-2/3/4",   ParseSSA,         true },
+    { "ass",        SUB_TYPE_ASS,         "SSA/ASS",     ParseSSA,         true },
+    { "vplayer",    SUB_TYPE_VPLAYER,     "VPlayer",     ParseVplayer,     false },
+    { "sami",       SUB_TYPE_SAMI,        "SAMI",        ParseSami,        false },
+    { "dvdsubtitle",SUB_TYPE_DVDSUBTITLE, "DVDSubtitle", ParseDVDSubtitle, false },
+    { "mpl2",       SUB_TYPE_MPL2,        "MPL2",        ParseMPL2,        true },
+    { "aqt",        SUB_TYPE_AQT,         "AQTitle",     ParseAQT,         false },
+    { "pjs",        SUB_TYPE_PJS,         "PhoenixSub",  ParsePJS,         false },
+    { "mpsub",      SUB_TYPE_MPSUB,       "MPSub",       ParseMPSub,       false },
+    { "jacosub",    SUB_TYPE_JACOSUB,     "JacoSub",     ParseJSS,         false },
+    { "psb",        SUB_TYPE_PSB,         "PowerDivx",   ParsePSB,         false },
+    { "realtext",   SUB_TYPE_RT,          "RealText",    ParseRealText,    false },
+    { "dks",        SUB_TYPE_DKS,         "DKS",         ParseDKS,         false },
+    { "subviewer1", SUB_TYPE_SUBVIEW1,    "Subviewer 1", ParseSubViewer1,  false },
+    { "text/vtt",   SUB_TYPE_VTT,         "WebVTT",      ParseCommonVTTSBV, true },
+    { "sbv",        SUB_TYPE_SBV,         "SBV",         ParseCommonVTTSBV, true },
+    { NULL,         SUB_TYPE_UNKNOWN,     "Unknown",     NULL,             false }
 };
 /* When adding support for more formats, be sure to add their file extension
  * to src/input/subtitles.c to enable auto-detection.
@@ -229,6 +253,10 @@ static int Demux( demux_t * );
 static int Control( demux_t *, int, va_list );
 
 static void Fix( demux_t * );
+static int  Index( demux_t * );
+static int  IndexLoad( demux_t *, int, subtitle_t * );
+static int  IndexFindTime( demux_sys_t *, int64_t );
+static int  IndexFindStart( demux_sys_t *, int64_t );
 static char * get_language_from_filename( const char * );
 
 /*****************************************************************************
@@ -242,6 +270,7 @@ static int Open ( vlc_object_t *p_this )
     float          f_fps;
     char           *psz_type;
     int  (*pf_read)( demux_t *, subtitle_t*, int );
+    bool           b_indexable;
     int            i, i_max;
 
     if( !p_demux->b_force )
@@ -252,7 +281,7 @@ static int Open ( vlc_object_t *p_this )
 
     p_demux->pf_demux = Demux;
     p_demux->pf_control = Control;
-    p_demux->p_sys = p_sys = malloc( sizeof( demux_sys_t ) );
+    p_demux->p_sys = p_sys = calloc( 1, sizeof( demux_sys_t ) );
     if( p_sys == NULL )
         return VLC_ENOMEM;
 
@@ -260,6 +289,7 @@ static int Open ( vlc_object_t *p_this )
     p_sys->i_subtitle         = 0;
     p_sys->i_subtitles        = 0;
     p_sys->subtitle           = NULL;
+    p_sys->index              = NULL;
     p_sys->i_microsecperframe = 40000;
 
     p_sys->jss.b_inited       = false;
@@ -503,15 +533,41 @@ static int Open ( vlc_object_t *p_this )
             msg_Dbg( p_demux, "detected %s format",
                      sub_read_subtitle_function[i].psz_name );
             pf_read = sub_read_subtitle_function[i].pf_read;
+            b_indexable = sub_read_subtitle_function[i].b_indexable;
             break;
         }
     }
 
-    msg_Dbg( p_demux, "loading all subtitles..." );
-
     if( unicode ) /* skip BOM */
         stream_Seek( p_demux->s, 3 );
 
+    p_sys->pf_read = pf_read;
+    p_sys->i_length = 0;
+
+    /* Index large files, and only parse the subtitles about to be shown */
+    uint64_t i_size;
+    bool b_seekable;
+    if( b_indexable
+     && stream_Control( p_demux->s, STREAM_CAN_SEEK, &b_seekable ) == VLC_SUCCESS
+     && b_seekable
+     && stream_GetSize( p_demux->s, &i_size ) == VLC_SUCCESS
+     && i_size >= SUB_INDEX_MIN_SIZE )
+    {
+        msg_Dbg( p_demux, "indexing subtitles..." );
+        if( Index( p_demux ) )
+        {
+            TextUnload( &p_sys->txt );
+            free( p_sys->index );
+            free( p_sys->psz_header );
+            free( p_sys );
+            return VLC_ENOMEM;
+        }
+        msg_Dbg( p_demux, "indexed %d subtitles", p_sys->i_subtitles );
+        goto add_es;
+    }
+
+    msg_Dbg( p_demux, "loading all subtitles..." );
+
     /* Load the whole file */
     TextLoad( &p_sys->txt, p_demux->s );
 
@@ -543,7 +599,6 @@ static int Open ( vlc_object_t *p_this )
 
     /* Fix subtitle (order and time) *** */
     p_sys->i_subtitle = 0;
-    p_sys->i_length = 0;
     if( p_sys->i_subtitles > 0 )
     {
         p_sys->i_length = p_sys->subtitle[p_sys->i_subtitles-1].i_stop;
@@ -552,14 +607,17 @@ static int Open ( vlc_object_t *p_this )
             p_sys->i_length = p_sys->subtitle[p_sys->i_subtitles-1].i_start+1;
     }
 
-    /* *** add subtitle ES *** */
     if( p_sys->i_type == SUB_TYPE_SSA1 ||
              p_sys->i_type == SUB_TYPE_SSA2_4 ||
              p_sys->i_type == SUB_TYPE_ASS )
-    {
         Fix( p_demux );
+
+add_es:
+    /* *** add subtitle ES *** */
+    if( p_sys->i_type == SUB_TYPE_SSA1 ||
+             p_sys->i_type == SUB_TYPE_SSA2_4 ||
+             p_sys->i_type == SUB_TYPE_ASS )
         es_format_Init( &fmt, SPU_ES, VLC_CODEC_SSA );
-    }
     else
         es_format_Init( &fmt, SPU_ES, VLC_CODEC_SUBT );
 
@@ -600,14 +658,24 @@ static void Close( vlc_object_t *p_this )
     demux_sys_t *p_sys = p_demux->p_sys;
     int i;
 
-    for( i = 0; i < p_sys->i_subtitles; i++ )
-        free( p_sys->subtitle[i].psz_text );
+    if( p_sys->subtitle != NULL )
+        for( i = 0; i < p_sys->i_subtitles; i++ )
+            free( p_sys->subtitle[i].psz_text );
     free( p_sys->subtitle );
+    free( p_sys->index );
+    TextUnload( &p_sys->txt );
     free( p_sys->psz_header );
 
     free( p_sys );
 }
 
+static int64_t GetStart( demux_sys_t *p_sys, int i_subtitle )
+{
+    if( p_sys->index != NULL )
+        return p_sys->index[i_subtitle].i_start;
+    return p_sys->subtitle[i_subtitle].i_start;
+}
+
 /*****************************************************************************
  * Control:
  *****************************************************************************/
@@ -632,24 +700,29 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             pi64 = (int64_t*)va_arg( args, int64_t * );
             if( p_sys->i_subtitle < p_sys->i_subtitles )
             {
-                *pi64 = p_sys->subtitle[p_sys->i_subtitle].i_start;
+                *pi64 = GetStart( p_sys, p_sys->i_subtitle );
                 return VLC_SUCCESS;
             }
             return VLC_EGENERIC;
 
         case DEMUX_SET_TIME:
             i64 = (int64_t)va_arg( args, int64_t );
-            p_sys->i_subtitle = 0;
-            while( p_sys->i_subtitle < p_sys->i_subtitles )
+            if( p_sys->index != NULL )
+                p_sys->i_subtitle = IndexFindTime( p_sys, i64 );
+            else
             {
-                const subtitle_t *p_subtitle = &p_sys->subtitle[p_sys->i_subtitle];
+                p_sys->i_subtitle = 0;
+                while( p_sys->i_subtitle < p_sys->i_subtitles )
+                {
+                    const subtitle_t *p_subtitle = &p_sys->subtitle[p_sys->i_subtitle];
 
-                if( p_subtitle->i_start > i64 )
-                    break;
-                if( p_subtitle->i_stop > p_subtitle->i_start && p_subtitle->i_stop > i64 )
-                    break;
+                    if( p_subtitle->i_start > i64 )
+                        break;
+                    if( p_subtitle->i_stop > p_subtitle->i_start && p_subtitle->i_stop > i64 )
+                        break;
 
-                p_sys->i_subtitle++;
+                    p_sys->i_subtitle++;
+                }
             }
 
             if( p_sys->i_subtitle >= p_sys->i_subtitles )
@@ -664,8 +737,8 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             }
             else if( p_sys->i_subtitles > 0 )
             {
-                *pf = (double)p_sys->subtitle[p_sys->i_subtitle].i_start /
-                      (double)p_sys->i_length;
+                int64_t i_start = GetStart( p_sys, p_sys->i_subtitle );
+                *pf = (double)i_start / (double)p_sys->i_length;
             }
             else
             {
@@ -677,11 +750,16 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
             f = (double)va_arg( args, double );
             i64 = f * p_sys->i_length;
 
-            p_sys->i_subtitle = 0;
-            while( p_sys->i_subtitle < p_sys->i_subtitles &&
-                   p_sys->subtitle[p_sys->i_subtitle].i_start < i64 )
+            if( p_sys->index != NULL )
+                p_sys->i_subtitle = IndexFindStart( p_sys, i64 );
+            else
             {
-                p_sys->i_subtitle++;
+                p_sys->i_subtitle = 0;
+                while( p_sys->i_subtitle < p_sys->i_subtitles &&
+                       p_sys->subtitle[p_sys->i_subtitle].i_start < i64 )
+                {
+                    p_sys->i_subtitle++;
+                }
             }
             if( p_sys->i_subtitle >= p_sys->i_subtitles )
                 return VLC_EGENERIC;
@@ -721,25 +799,35 @@ static int Demux( demux_t *p_demux )
     if( i_maxdate <= 0 && p_sys->i_subtitle < p_sys->i_subtitles )
     {
         /* Should not happen */
-        i_maxdate = p_sys->subtitle[p_sys->i_subtitle].i_start + 1;
+        i_maxdate = GetStart( p_sys, p_sys->i_subtitle ) + 1;
     }
 
     while( p_sys->i_subtitle < p_sys->i_subtitles &&
-           p_sys->subtitle[p_sys->i_subtitle].i_start < i_maxdate )
+           GetStart( p_sys, p_sys->i_subtitle ) < i_maxdate )
     {
-        const subtitle_t *p_subtitle = &p_sys->subtitle[p_sys->i_subtitle];
-
-        block_t *p_block;
-        int i_len = strlen( p_subtitle->psz_text ) + 1;
+        const subtitle_t *p_subtitle;
+        subtitle_t loaded;
 
-        if( i_len <= 1 || p_subtitle->i_start < 0 )
+        if( p_sys->index != NULL )
         {
-            p_sys->i_subtitle++;
-            continue;
+            if( IndexLoad( p_demux, p_sys->i_subtitle, &loaded ) )
+            {
+                p_sys->i_subtitle++;
+                continue;
+            }
+            p_subtitle = &loaded;
         }
+        else
+            p_subtitle = &p_sys->subtitle[p_sys->i_subtitle];
 
-        if( ( p_block = block_Alloc( i_len ) ) == NULL )
+        block_t *p_block;
+        int i_len = strlen( p_subtitle->psz_text ) + 1;
+
+        if( i_len <= 1 || p_subtitle->i_start < 0 ||
+            ( p_block = block_Alloc( i_len ) ) == NULL )
         {
+            if( p_subtitle == &loaded )
+                free( loaded.psz_text );
             p_sys->i_subtitle++;
             continue;
         }
@@ -750,6 +838,8 @@ static int Demux( demux_t *p_demux )
             p_block->i_length = p_subtitle->i_stop - p_subtitle->i_start;
 
         memcpy( p_block->p_buffer, p_subtitle->psz_text, i_len );
+        if( p_subtitle == &loaded )
+            free( loaded.psz_text );
 
         es_out_Send( p_demux->out, p_sys->es, p_block );
 
@@ -781,6 +871,126 @@ static void Fix( demux_t *p_demux )
     qsort( p_sys->subtitle, p_sys->i_subtitles, sizeof( p_sys->subtitle[0] ), subtitle_cmp);
 }
 
+static int index_cmp( const void *first, const void *second )
+{
+    const subtitle_index_t *a = first, *b = second;
+
+    /* Keep the file order of subtitles starting together */
+    if( a->i_start != b->i_start )
+        return a->i_start > b->i_start ? 1 : -1;
+    return a->i_idx - b->i_idx;
+}
+
+/*****************************************************************************
+ * Index: find the timing and offset of all subtitles
+ *****************************************************************************/
+static int Index( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    subtitle_t subtitle;
+    int i_max = 0;
+
+    TextOpen( &p_sys->txt, p_demux->s );
+
+    /* The whole file is parsed once, but only the timings are kept */
+    for( ;; )
+    {
+        if( p_sys->i_subtitles >= i_max )
+        {
+            i_max += 500 + i_max / 2;
+            subtitle_index_t *p_index = realloc( p_sys->index,
+                                                 sizeof( *p_index ) * i_max );
+            if( p_index == NULL )
+                return VLC_ENOMEM;
+            p_sys->index = p_index;
+        }
+
+        if( p_sys->pf_read( p_demux, &subtitle, p_sys->i_subtitles ) )
+            break;
+        free( subtitle.psz_text );
+
+        subtitle_index_t *p_entry = &p_sys->index[p_sys->i_subtitles];
+        p_entry->i_start  = subtitle.i_start;
+        p_entry->i_stop   = subtitle.i_stop;
+        p_entry->i_offset = p_sys->txt.i_entry_offset;
+        p_entry->i_idx    = p_sys->i_subtitles++;
+    }
+
+    p_sys->i_subtitle = 0;
+    if( p_sys->i_subtitles == 0 )
+        return VLC_SUCCESS;
+
+    qsort( p_sys->index, p_sys->i_subtitles, sizeof( *p_sys->index ),
+           index_cmp );
+
+    /* Running maximum of the end dates, to find the subtitles still
+     * displayed at a given time with a binary search */
+    int64_t i_max_stop = INT64_MIN;
+    for( int i = 0; i < p_sys->i_subtitles; i++ )
+    {
+        subtitle_index_t *p_entry = &p_sys->index[i];
+        int64_t i_stop = p_entry->i_stop > p_entry->i_start ? p_entry->i_stop
+                                                            : p_entry->i_start;
+        if( i_stop > i_max_stop )
+            i_max_stop = i_stop;
+        p_entry->i_max_stop = i_max_stop;
+    }
+
+    const subtitle_index_t *p_last = &p_sys->index[p_sys->i_subtitles - 1];
+    p_sys->i_length = p_last->i_stop > 0 ? p_last->i_stop : p_last->i_start + 1;
+    return VLC_SUCCESS;
+}
+
+/* Parses an indexed subtitle */
+static int IndexLoad( demux_t *p_demux, int i_subtitle, subtitle_t *p_subtitle )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const subtitle_index_t *p_entry = &p_sys->index[i_subtitle];
+
+    TextOpen( &p_sys->txt, p_demux->s );
+    if( stream_Seek( p_demux->s, p_entry->i_offset )
+     || p_sys->pf_read( p_demux, p_subtitle, p_entry->i_idx ) )
+        return VLC_EGENERIC;
+
+    /* Keep the timings of the index, sorted and fixed up */
+    p_subtitle->i_start = p_entry->i_start;
+    p_subtitle->i_stop  = p_entry->i_stop;
+    return VLC_SUCCESS;
+}
+
+/* Returns the first subtitle starting after i_time or still displayed at
+ * i_time, as the linear search of DEMUX_SET_TIME */
+static int IndexFindTime( demux_sys_t *p_sys, int64_t i_time )
+{
+    int i_low = 0, i_high = p_sys->i_subtitles;
+
+    while( i_low < i_high )
+    {
+        int i_mid = i_low + (i_high - i_low) / 2;
+        if( p_sys->index[i_mid].i_max_stop > i_time )
+            i_high = i_mid;
+        else
+            i_low = i_mid + 1;
+    }
+    return i_low;
+}
+
+/* Returns the first subtitle starting at or after i_time */
+static int IndexFindStart( demux_sys_t *p_sys, int64_t i_time )
+{
+    int i_low = 0, i_high = p_sys->i_subtitles;
+
+    while( i_low < i_high )
+    {
+        int i_mid = i_low + (i_high - i_low) / 2;
+        if( p_sys->index[i_mid].i_start < i_time )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
 static int TextLoad( text_t *txt, stream_t *s )
 {
     int   i_line_max;
@@ -789,6 +999,11 @@ static int TextLoad( text_t *txt, stream_t *s )
     i_line_max          = 500;
     txt->i_line_count   = 0;
     txt->i_line         = 0;
+    txt->s              = NULL;
+    txt->psz_line       = NULL;
+    txt->i_line_offset  = 0;
+    txt->b_pushback     = false;
+    txt->i_entry_offset = 0;
     txt->line           = calloc( i_line_max, sizeof( char * ) );
     if( !txt->line )
         return VLC_ENOMEM;
@@ -814,26 +1029,65 @@ static int TextLoad( text_t *txt, stream_t *s )
     if( txt->i_line_count <= 0 )
     {
         free( txt->line );
+        txt->line = NULL;
         return VLC_EGENERIC;
     }
 
     return VLC_SUCCESS;
 }
+/* Reads the lines from the stream, from its current position */
+static void TextOpen( text_t *txt, stream_t *s )
+{
+    if( txt->s != NULL )
+        TextUnload( txt );
+
+    txt->i_line_count   = 0;
+    txt->i_line         = 0;
+    txt->line           = NULL;
+    txt->s              = s;
+    txt->psz_line       = NULL;
+    txt->i_line_offset  = 0;
+    txt->b_pushback     = false;
+    txt->i_entry_offset = 0;
+}
 static void TextUnload( text_t *txt )
 {
     int i;
 
+    if( txt->s != NULL )
+    {
+        free( txt->psz_line );
+        txt->psz_line = NULL;
+        txt->s = NULL;
+        return;
+    }
+
     for( i = 0; i < txt->i_line_count; i++ )
     {
         free( txt->line[i] );
     }
     free( txt->line );
+    txt->line         = NULL;
     txt->i_line       = 0;
     txt->i_line_count = 0;
 }
 
 static char *TextGetLine( text_t *txt )
 {
+    if( txt->s != NULL )
+    {
+        /* The line is only valid until the next call */
+        if( txt->b_pushback )
+        {
+            txt->b_pushback = false;
+            return txt->psz_line;
+        }
+        free( txt->psz_line );
+        txt->i_line_offset = stream_Tell( txt->s );
+        txt->psz_line = stream_ReadLine( txt->s );
+        return txt->psz_line;
+    }
+
     if( txt->i_line >= txt->i_line_count )
         return( NULL );
 
@@ -841,9 +1095,21 @@ static char *TextGetLine( text_t *txt )
 }
 static void TextPreviousLine( text_t *txt )
 {
+    if( txt->s != NULL )
+    {
+        if( txt->psz_line != NULL )
+            txt->b_pushback = true;
+        return;
+    }
+
     if( txt->i_line > 0 )
         txt->i_line--;
 }
+/* Records the line just read as the beginning of a subtitle, for Index() */
+static void TextMarkEntry( text_t *txt )
+{
+    txt->i_entry_offset = txt->i_line_offset;
+}
 
 /*****************************************************************************
  * Specific Subtitle function
@@ -880,7 +1146,10 @@ static int ParseMicroDvd( demux_t *p_demux, subtitle_t *p_subtitle,
             sscanf( s, "{%d}{%d}%[^\r\n]", &i_start, &i_stop, psz_text ) == 3)
         {
             if( i_start != 1 || i_stop != 1 )
+            {
+                TextMarkEntry( txt );
                 break;
+            }
 
             /* We found a possible setting of the framerate "{1}{1}23.976" */
             /* Check if it's usable, and if the sub-fps is not set */
@@ -939,6 +1208,7 @@ static int ParseSubRipSubViewer( demux_t *p_demux, subtitle_t *p_subtitle,
         if( pf_parse_timing( p_subtitle, s) == VLC_SUCCESS &&
             p_subtitle->i_start < p_subtitle->i_stop )
         {
+            TextMarkEntry( txt );
             break;
         }
     }
@@ -1124,6 +1394,8 @@ static int  ParseSSA( demux_t *p_demux, subtitle_t *p_subtitle,
                     &h2, &m2, &s2, &c2,
                     psz_text ) == 10 )
         {
+            TextMarkEntry( txt );
+
             /* The dec expects: ReadOrder, Layer, Style, Name, MarginL, MarginR, MarginV, Effect, Text */
             /* (Layer comes from ASS specs ... it's empty for SSA.) */
             if( p_sys->i_type == SUB_TYPE_SSA1 )
@@ -1441,6 +1713,7 @@ static int ParseMPL2( demux_t *p_demux, subtitle_t *p_subtitle, int i_idx )
         {
             p_subtitle->i_start = (int64_t)i_start * 100000;
             p_subtitle->i_stop  = i_stop >= 0 ? ((int64_t)i_stop  * 100000) : -1;
+            TextMarkEntry( txt );
             break;
         }
         free( psz_text );
@@ -2223,7 +2496,10 @@ static int ParseCommonVTTSBV( demux_t *p_demux, subtitle_t *p_subtitle, int i_id
                                     (int64_t)s2 * 1000 +
                                     (int64_t)d2 ) * 1000;
             if( p_subtitle->i_start < p_subtitle->i_stop )
+            {
+                TextMarkEntry( txt );
                 break;
+            }
         }
     }
 
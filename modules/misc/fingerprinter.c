@@ -22,6 +22,8 @@
 #endif
 
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <vlc_common.h>
 #include <vlc_plugin.h>
@@ -29,6 +31,8 @@
 #include <vlc_modules.h>
 #include <vlc_meta.h>
 #include <vlc_url.h>
+#include <vlc_md5.h>
+#include <vlc_fs.h>
 
 #include <vlc/vlc.h>
 #include <vlc_input.h>
@@ -40,20 +44,32 @@
  * Local prototypes
  *****************************************************************************/
 
+/* Each request spawns an input and a web request, mostly waiting on I/O and
+ * the network: a few of them can run side by side. */
+#define MAX_WORKERS 4
+/* Fingerprints of local files remembered by content */
+#define MAX_CACHED 1024
+
+typedef struct
+{
+    char     *psz_md5;
+    unsigned  i_duration_hint;
+    char     *psz_fingerprint;
+    unsigned  i_duration;
+} fingerprint_cache_entry_t;
+
 struct fingerprinter_sys_t
 {
-    vlc_thread_t thread;
+    vlc_thread_t threads[MAX_WORKERS];
+    unsigned     i_threads;
 
     struct
     {
         vlc_array_t         *queue;
         vlc_mutex_t         lock;
-    } incoming, results;
+    } incoming, results, cache;
 
-    struct
-    {
-        vlc_array_t         *queue;
-    } processing;
+    vlc_cond_t   incoming_wait;
 };
 
 static int  Open            (vlc_object_t *);
@@ -81,22 +97,10 @@ static void EnqueueRequest( fingerprinter_thread_t *f, fingerprint_request_t *r
     fingerprinter_sys_t *p_sys = f->p_sys;
     vlc_mutex_lock( &p_sys->incoming.lock );
     vlc_array_append( p_sys->incoming.queue, r );
+    vlc_cond_signal( &p_sys->incoming_wait );
     vlc_mutex_unlock( &p_sys->incoming.lock );
 }
 
-static void QueueIncomingRequests( fingerprinter_sys_t *p_sys )
-{
-    vlc_mutex_lock( &p_sys->incoming.lock );
-    int i = vlc_array_count( p_sys->incoming.queue );
-    if ( i == 0 ) goto end;
-    while( i )
-        vlc_array_append( p_sys->processing.queue,
-                          vlc_array_item_at_index( p_sys->incoming.queue, --i ) );
-    vlc_array_clear( p_sys->incoming.queue );
-end:
-    vlc_mutex_unlock(&p_sys->incoming.lock);
-}
-
 static fingerprint_request_t * GetResult( fingerprinter_thread_t *f )
 {
     fingerprint_request_t *r = NULL;
@@ -146,6 +150,9 @@ static void DoFingerprint( vlc_object_t *p_this, acoustid_fingerprint_t *fp,
     free( psz_sout_option );
     input_item_AddOption( p_item, "vout=dummy", VLC_INPUT_OPTION_TRUSTED );
     input_item_AddOption( p_item, "aout=dummy", VLC_INPUT_OPTION_TRUSTED );
+    /* only the audio is fingerprinted: do not demux nor decode the rest */
+    input_item_AddOption( p_item, "no-video", VLC_INPUT_OPTION_TRUSTED );
+    input_item_AddOption( p_item, "no-spu", VLC_INPUT_OPTION_TRUSTED );
     if ( fp->i_duration )
     {
         if ( asprintf( &psz_sout_option, "stop-time=%u", fp->i_duration ) == -1 )
@@ -181,6 +188,89 @@ static void DoFingerprint( vlc_object_t *p_this, acoustid_fingerprint_t *fp,
         fp->i_duration = chroma_fingerprint.i_duration;
 }
 
+/*****************************************************************************
+ * Cache: copies of the same file in a library are only decoded once
+ *****************************************************************************/
+static char *HashFile( const char *psz_uri )
+{
+    char *psz_path = vlc_uri2path( psz_uri );
+    if ( psz_path == NULL )
+        return NULL; /* not a local file */
+
+    int fd = vlc_open( psz_path, O_RDONLY );
+    free( psz_path );
+    if ( fd == -1 )
+        return NULL;
+
+    struct md5_s md5;
+    InitMD5( &md5 );
+    int i_ret = AddMD5File( &md5, fd );
+    close( fd );
+    if ( i_ret )
+        return NULL;
+    EndMD5( &md5 );
+    return psz_md5_hash( &md5 );
+}
+
+static bool CacheLookup( fingerprinter_sys_t *p_sys, const char *psz_md5,
+                         acoustid_fingerprint_t *fp )
+{
+    bool b_found = false;
+
+    vlc_mutex_lock( &p_sys->cache.lock );
+    for ( int i = 0; i < vlc_array_count( p_sys->cache.queue ); i++ )
+    {
+        fingerprint_cache_entry_t *p_entry =
+            vlc_array_item_at_index( p_sys->cache.queue, i );
+
+        if ( p_entry->i_duration_hint == fp->i_duration
+          && !strcmp( p_entry->psz_md5, psz_md5 ) )
+        {
+            fp->psz_fingerprint = strdup( p_entry->psz_fingerprint );
+            fp->i_duration = p_entry->i_duration;
+            b_found = fp->psz_fingerprint != NULL;
+            break;
+        }
+    }
+    vlc_mutex_unlock( &p_sys->cache.lock );
+    return b_found;
+}
+
+static void CacheEntryDelete( fingerprint_cache_entry_t *p_entry )
+{
+    free( p_entry->psz_md5 );
+    free( p_entry->psz_fingerprint );
+    free( p_entry );
+}
+
+static void CacheStore( fingerprinter_sys_t *p_sys, const char *psz_md5,
+                        unsigned i_duration_hint,
+                        const acoustid_fingerprint_t *fp )
+{
+    fingerprint_cache_entry_t *p_entry = malloc( sizeof (*p_entry) );
+    if ( unlikely(p_entry == NULL) )
+        return;
+
+    p_entry->psz_md5 = strdup( psz_md5 );
+    p_entry->i_duration_hint = i_duration_hint;
+    p_entry->psz_fingerprint = strdup( fp->psz_fingerprint );
+    p_entry->i_duration = fp->i_duration;
+    if ( unlikely(p_entry->psz_md5 == NULL || p_entry->psz_fingerprint == NULL) )
+    {
+        CacheEntryDelete( p_entry );
+        return;
+    }
+
+    vlc_mutex_lock( &p_sys->cache.lock );
+    if ( vlc_array_count( p_sys->cache.queue ) == MAX_CACHED )
+    {   /* drop the oldest entry */
+        CacheEntryDelete( vlc_array_item_at_index( p_sys->cache.queue, 0 ) );
+        vlc_array_remove( p_sys->cache.queue, 0 );
+    }
+    vlc_array_append( p_sys->cache.queue, p_entry );
+    vlc_mutex_unlock( &p_sys->cache.lock );
+}
+
 /*****************************************************************************
  * Open:
  *****************************************************************************/
@@ -197,26 +287,46 @@ static int Open(vlc_object_t *p_this)
     p_sys->incoming.queue = vlc_array_new();
     vlc_mutex_init( &p_sys->incoming.lock );
 
-    p_sys->processing.queue = vlc_array_new();
+    vlc_cond_init( &p_sys->incoming_wait );
 
     p_sys->results.queue = vlc_array_new();
     vlc_mutex_init( &p_sys->results.lock );
 
+    p_sys->cache.queue = vlc_array_new();
+    vlc_mutex_init( &p_sys->cache.lock );
+
     p_fingerprinter->pf_enqueue = EnqueueRequest;
     p_fingerprinter->pf_getresults = GetResult;
     p_fingerprinter->pf_apply = ApplyResult;
 
     var_Create( p_fingerprinter, "results-available", VLC_VAR_BOOL );
-    if( vlc_clone( &p_sys->thread, Run, p_fingerprinter,
-                   VLC_THREAD_PRIORITY_LOW ) )
+
+    unsigned i_workers = __MIN( vlc_GetCPUCount(), MAX_WORKERS );
+    for( p_sys->i_threads = 0; p_sys->i_threads < i_workers; p_sys->i_threads++ )
+    {
+        if( vlc_clone( &p_sys->threads[p_sys->i_threads], Run, p_fingerprinter,
+                       VLC_THREAD_PRIORITY_LOW ) )
+            break;
+    }
+    if( p_sys->i_threads == 0 )
     {
         msg_Err( p_fingerprinter, "cannot spawn fingerprinter thread" );
         goto error;
     }
+    msg_Dbg( p_fingerprinter, "using %u fingerprinting threads",
+             p_sys->i_threads );
 
     return VLC_SUCCESS;
 
 error:
+    var_Destroy( p_fingerprinter, "results-available" );
+    vlc_cond_destroy( &p_sys->incoming_wait );
+    vlc_array_destroy( p_sys->incoming.queue );
+    vlc_mutex_destroy( &p_sys->incoming.lock );
+    vlc_array_destroy( p_sys->results.queue );
+    vlc_mutex_destroy( &p_sys->results.lock );
+    vlc_array_destroy( p_sys->cache.queue );
+    vlc_mutex_destroy( &p_sys->cache.lock );
     free( p_sys );
     return VLC_EGENERIC;
 }
@@ -229,23 +339,27 @@ static void Close(vlc_object_t *p_this)
     fingerprinter_thread_t   *p_fingerprinter = (fingerprinter_thread_t*) p_this;
     fingerprinter_sys_t *p_sys = p_fingerprinter->p_sys;
 
-    vlc_cancel( p_sys->thread );
-    vlc_join( p_sys->thread, NULL );
+    for( unsigned i = 0; i < p_sys->i_threads; i++ )
+        vlc_cancel( p_sys->threads[i] );
+    for( unsigned i = 0; i < p_sys->i_threads; i++ )
+        vlc_join( p_sys->threads[i], NULL );
 
     for ( int i = 0; i < vlc_array_count( p_sys->incoming.queue ); i++ )
         fingerprint_request_Delete( vlc_array_item_at_index( p_sys->incoming.queue, i ) );
     vlc_array_destroy( p_sys->incoming.queue );
     vlc_mutex_destroy( &p_sys->incoming.lock );
-
-    for ( int i = 0; i < vlc_array_count( p_sys->processing.queue ); i++ )
-        fingerprint_request_Delete( vlc_array_item_at_index( p_sys->processing.queue, i ) );
-    vlc_array_destroy( p_sys->processing.queue );
+    vlc_cond_destroy( &p_sys->incoming_wait );
 
     for ( int i = 0; i < vlc_array_count( p_sys->results.queue ); i++ )
         fingerprint_request_Delete( vlc_array_item_at_index( p_sys->results.queue, i ) );
     vlc_array_destroy( p_sys->results.queue );
     vlc_mutex_destroy( &p_sys->results.lock );
 
+    for ( int i = 0; i < vlc_array_count( p_sys->cache.queue ); i++ )
+        CacheEntryDelete( vlc_array_item_at_index( p_sys->cache.queue, i ) );
+    vlc_array_destroy( p_sys->cache.queue );
+    vlc_mutex_destroy( &p_sys->cache.lock );
+
     free( p_sys );
 }
 
@@ -270,7 +384,7 @@ static void fill_metas_with_results( fingerprint_request_t *p_r, acoustid_finger
 }
 
 /*****************************************************************************
- * Run :
+ * Run : worker thread, processes one request at a time
  *****************************************************************************/
 static void *Run( void *opaque )
 {
@@ -280,53 +394,62 @@ static void *Run( void *opaque )
     /* main loop */
     for (;;)
     {
-        msleep( CLOCK_FREQ );
+        vlc_mutex_lock( &p_sys->incoming.lock );
+        mutex_cleanup_push( &p_sys->incoming.lock );
+        while( vlc_array_count( p_sys->incoming.queue ) == 0 )
+            vlc_cond_wait( &p_sys->incoming_wait, &p_sys->incoming.lock );
+        vlc_cleanup_pop();
 
-        QueueIncomingRequests( p_sys );
+        fingerprint_request_t *p_data =
+            vlc_array_item_at_index( p_sys->incoming.queue, 0 );
+        vlc_array_remove( p_sys->incoming.queue, 0 );
+        vlc_mutex_unlock( &p_sys->incoming.lock );
 
-        for ( int i = 0 ; i < vlc_array_count( p_sys->processing.queue ); i++ )
-        {
-            int canc = vlc_savecancel();
-            fingerprint_request_t *p_data = vlc_array_item_at_index( p_sys->processing.queue, i );
+        int canc = vlc_savecancel();
 
-            char *psz_uri = input_item_GetURI( p_data->p_item );
-            if ( psz_uri != NULL )
-            {
-                 acoustid_fingerprint_t acoustid_print;
+        char *psz_uri = input_item_GetURI( p_data->p_item );
+        if ( psz_uri != NULL )
+        {
+             acoustid_fingerprint_t acoustid_print;
 
-                 memset( &acoustid_print , 0, sizeof (acoustid_print) );
-                /* overwrite with hint, as in this case, fingerprint's session will be truncated */
-                if ( p_data->i_duration )
-                     acoustid_print.i_duration = p_data->i_duration;
+             memset( &acoustid_print , 0, sizeof (acoustid_print) );
+            /* overwrite with hint, as in this case, fingerprint's session will be truncated */
+            if ( p_data->i_duration )
+                 acoustid_print.i_duration = p_data->i_duration;
 
+            /* hashing a file is much faster than decoding it */
+            char *psz_md5 = HashFile( psz_uri );
+            if ( psz_md5 == NULL
+              || !CacheLookup( p_sys, psz_md5, &acoustid_print ) )
+            {
                 DoFingerprint( VLC_OBJECT(p_fingerprinter),
                                &acoustid_print, psz_uri );
-                free( psz_uri );
-
-                DoAcoustIdWebRequest( VLC_OBJECT(p_fingerprinter), &acoustid_print );
-                fill_metas_with_results( p_data, &acoustid_print );
-
-                for( unsigned j = 0; j < acoustid_print.results.count; j++ )
-                     free_acoustid_result_t( &acoustid_print.results.p_results[j] );
-                if( acoustid_print.results.count )
-                    free( acoustid_print.results.p_results );
-                free( acoustid_print.psz_fingerprint );
+                if ( psz_md5 != NULL && acoustid_print.psz_fingerprint != NULL )
+                    CacheStore( p_sys, psz_md5, p_data->i_duration,
+                                &acoustid_print );
             }
-            vlc_restorecancel(canc);
+            free( psz_md5 );
+            free( psz_uri );
 
-            /* copy results */
-            vlc_mutex_lock( &p_sys->results.lock );
-            vlc_array_append( p_sys->results.queue, p_data );
-            vlc_mutex_unlock( &p_sys->results.lock );
+            DoAcoustIdWebRequest( VLC_OBJECT(p_fingerprinter), &acoustid_print );
+            fill_metas_with_results( p_data, &acoustid_print );
 
-            vlc_testcancel();
+            for( unsigned j = 0; j < acoustid_print.results.count; j++ )
+                 free_acoustid_result_t( &acoustid_print.results.p_results[j] );
+            if( acoustid_print.results.count )
+                free( acoustid_print.results.p_results );
+            free( acoustid_print.psz_fingerprint );
         }
 
-        if ( vlc_array_count( p_sys->processing.queue ) )
-        {
-            var_TriggerCallback( p_fingerprinter, "results-available" );
-            vlc_array_clear( p_sys->processing.queue );
-        }
+        /* copy results */
+        vlc_mutex_lock( &p_sys->results.lock );
+        vlc_array_append( p_sys->results.queue, p_data );
+        vlc_mutex_unlock( &p_sys->results.lock );
+
+        var_TriggerCallback( p_fingerprinter, "results-available" );
+        vlc_restorecancel(canc);
+
+        vlc_testcancel();
     }
     vlc_assert_unreachable();
 }
@@ -0,0 +1,151 @@
+/*****************************************************************************
+ * slices.c: work split across a pool of threads
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include <vlc_common.h>
+
+#include "slices.h"
+
+struct slice_pool_t
+{
+    vlc_mutex_t  lock;
+    vlc_cond_t   wait; /* a job was posted, or the pool is deleted */
+    vlc_cond_t   done; /* the last slice of the job was completed */
+
+    void       (*pf)(void *, unsigned, unsigned);
+    void        *opaque;
+    unsigned     i_count;
+    unsigned     i_next; /* next slice to start */
+    unsigned     i_left; /* slices not completed yet */
+    bool         b_quit;
+
+    unsigned     i_threads;
+    vlc_thread_t threads[];
+};
+
+/* Runs the pending slices of the current job, with the lock held */
+static void RunSlices(slice_pool_t *pool)
+{
+    while (pool->i_next < pool->i_count)
+    {
+        unsigned i = pool->i_next++;
+
+        vlc_mutex_unlock(&pool->lock);
+        pool->pf(pool->opaque, i, pool->i_count);
+        vlc_mutex_lock(&pool->lock);
+
+        if (--pool->i_left == 0)
+            vlc_cond_signal(&pool->done);
+    }
+}
+
+static void *Worker(void *data)
+{
+    slice_pool_t *pool = data;
+
+    vlc_mutex_lock(&pool->lock);
+    while (!pool->b_quit)
+    {
+        if (pool->i_next < pool->i_count)
+            RunSlices(pool);
+        else
+            vlc_cond_wait(&pool->wait, &pool->lock);
+    }
+    vlc_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+slice_pool_t *SlicePoolNew(vlc_object_t *obj, unsigned i_threads)
+{
+    unsigned i_cpus = vlc_GetCPUCount();
+
+    if (i_threads > i_cpus)
+        i_threads = i_cpus;
+    if (i_threads < 2)
+        return NULL;
+    i_threads--; /* the calling thread runs slices too */
+
+    slice_pool_t *pool = malloc(sizeof (*pool)
+                                + i_threads * sizeof (pool->threads[0]));
+    if (unlikely(pool == NULL))
+        return NULL;
+
+    vlc_mutex_init(&pool->lock);
+    vlc_cond_init(&pool->wait);
+    vlc_cond_init(&pool->done);
+    pool->i_count = pool->i_next = pool->i_left = 0;
+    pool->b_quit = false;
+
+    for (pool->i_threads = 0; pool->i_threads < i_threads; pool->i_threads++)
+        if (vlc_clone(&pool->threads[pool->i_threads], Worker, pool,
+                      VLC_THREAD_PRIORITY_VIDEO))
+            break;
+
+    if (pool->i_threads == 0)
+    {
+        SlicePoolDelete(pool);
+        return NULL;
+    }
+    msg_Dbg(obj, "using %u threads", pool->i_threads + 1);
+    return pool;
+}
+
+void SlicePoolDelete(slice_pool_t *pool)
+{
+    vlc_mutex_lock(&pool->lock);
+    pool->b_quit = true;
+    vlc_cond_broadcast(&pool->wait);
+    vlc_mutex_unlock(&pool->lock);
+
+    for (unsigned i = 0; i < pool->i_threads; i++)
+        vlc_join(pool->threads[i], NULL);
+
+    vlc_cond_destroy(&pool->done);
+    vlc_cond_destroy(&pool->wait);
+    vlc_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+unsigned SlicePoolCount(const slice_pool_t *pool)
+{
+    return pool->i_threads + 1;
+}
+
+void SlicePoolRun(slice_pool_t *pool, void (*pf)(void *, unsigned, unsigned),
+                  void *opaque, unsigned i_count)
+{
+    vlc_mutex_lock(&pool->lock);
+    pool->pf = pf;
+    pool->opaque = opaque;
+    pool->i_count = pool->i_left = i_count;
+    pool->i_next = 0;
+    vlc_cond_broadcast(&pool->wait);
+
+    RunSlices(pool);
+    while (pool->i_left > 0)
+        vlc_cond_wait(&pool->done, &pool->lock);
+    pool->i_count = pool->i_next = 0;
+    vlc_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,76 @@
+/*****************************************************************************
+ * slices.h: work split across a pool of threads
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef _VLC_MISC_SLICES_H
+#define _VLC_MISC_SLICES_H 1
+
+typedef struct slice_pool_t slice_pool_t;
+
+/* Creates a pool of up to i_threads worker threads (the calling thread
+ * counts as one). Returns NULL if no extra thread is worth starting. */
+slice_pool_t *SlicePoolNew(vlc_object_t *obj, unsigned i_threads);
+void SlicePoolDelete(slice_pool_t *pool);
+
+/* Number of slices to use with SlicePoolRun() */
+unsigned SlicePoolCount(const slice_pool_t *pool);
+
+/* Calls pf(opaque, i, i_count) for every slice i below i_count, from the
+ * workers and the calling thread, and returns when all calls are done. */
+void SlicePoolRun(slice_pool_t *pool, void (*pf)(void *, unsigned, unsigned),
+                  void *opaque, unsigned i_count);
+
+/* Pictures below this size are not worth splitting across threads */
+#define SLICE_MIN_PIXELS (1280 * 720)
+#define SLICE_MAX_THREADS 8
+
+/* Creates a pool for pictures of the given size, or returns NULL if they
+ * are too small to be worth it */
+static inline slice_pool_t *SlicePoolNewForSize(vlc_object_t *obj,
+                                                unsigned i_width,
+                                                unsigned i_height)
+{
+    if ((uint64_t)i_width * i_height < SLICE_MIN_PIXELS)
+        return NULL;
+    return SlicePoolNew(obj, SLICE_MAX_THREADS);
+}
+
+/* Calls pf() for all the slices of the pool, or once for the whole picture
+ * from the calling thread if there is no pool */
+static inline void SlicePoolRunAll(slice_pool_t *pool,
+                                   void (*pf)(void *, unsigned, unsigned),
+                                   void *opaque)
+{
+    if (pool != NULL)
+        SlicePoolRun(pool, pf, opaque, SlicePoolCount(pool));
+    else
+        pf(opaque, 0, 1);
+}
+
+/* First row of slice i_slice out of i_count, for a picture of i_height rows,
+ * rounded to a multiple of i_align */
+static inline unsigned SliceRow(unsigned i_height, unsigned i_slice,
+                                unsigned i_count, unsigned i_align)
+{
+    if (i_slice >= i_count)
+        return i_height;
+    return (unsigned)((uint64_t)i_height * i_slice / i_count) / i_align * i_align;
+}
+
+#endif
@@ -43,6 +43,8 @@
 
 #include "../demux/mp4/libmp4.h"
 #include "libmp4mux.h"
+#include "spill.h"
+#include "../packetizer/hxxx_nal.h"
 
 /*****************************************************************************
  * Module descriptor
@@ -53,6 +55,12 @@
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
 
+#define MOOV_RESERVE_TEXT N_("Reserved moov space (KiB)")
+#define MOOV_RESERVE_LONGTEXT N_(\
+    "Reserve space for the moov header in front of the media data. " \
+    "When the final header fits, it is written in place and the file " \
+    "does not need to be rewritten to create a \"Fast Start\" file.")
+
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
 static int  OpenFrag   (vlc_object_t *);
@@ -69,6 +77,9 @@ vlc_module_begin ()
     add_bool(SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true)
+    add_integer(SOUT_CFG_PREFIX "moov-reserve", 0,
+                MOOV_RESERVE_TEXT, MOOV_RESERVE_LONGTEXT, true)
+        change_integer_range(0, 65536)
     set_capability("sout mux", 5)
     add_shortcut("mp4", "mov", "3gp")
     set_callbacks(Open, Close)
@@ -88,7 +99,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "moov-reserve", NULL
 };
 
 static int Control(sout_mux_t *, int, va_list);
@@ -101,6 +112,9 @@ static int MuxFrag  (sout_mux_t *);
  * Local prototypes
  *****************************************************************************/
 
+/* Maximum in-memory sample entries per track before spilling to disk */
+#define MP4_SPILL_ENTRIES 16384
+
 typedef struct mp4_fragentry_t mp4_fragentry_t;
 
 struct mp4_fragentry_t
@@ -132,6 +146,9 @@ typedef struct
     /* index */
     int64_t      i_length_neg;
 
+    /* entries already flushed to the spill file */
+    mp4mux_spill_t spill;
+
     /* stats */
     int64_t      i_dts_start; /* applies to current segment only */
 
@@ -162,6 +179,9 @@ struct sout_mux_sys_t
 
     uint64_t i_mdat_pos;
     uint64_t i_pos;
+
+    uint64_t i_moov_reserve_pos;
+    uint64_t i_moov_reserve;
     mtime_t  i_read_duration;
 
     unsigned int   i_nb_streams;
@@ -177,11 +197,10 @@ struct sout_mux_sys_t
 static void box_send(sout_mux_t *p_mux,  bo_t *box);
 static bo_t *BuildMoov(sout_mux_t *p_mux);
 
-static block_t *ConvertSUBT(block_t *);
-static block_t *ConvertFromAnnexB(block_t *);
+static bool SpillEntries(mp4_stream_t *);
+static bool LoadSpilledEntries(mp4_stream_t *);
 
-static const char avc1_short_start_code[3] = { 0, 0, 1 };
-static const char avc1_start_code[4] = { 0, 0, 0, 1 };
+static block_t *ConvertSUBT(block_t *);
 
 /*****************************************************************************
  * Open:
@@ -210,6 +229,9 @@ static int Open(vlc_object_t *p_this)
     p_sys->b_3gp        = p_mux->psz_mux && !strcmp(p_mux->psz_mux, "3gp");
     p_sys->i_read_duration   = 0;
     p_sys->b_fragmented = false;
+    p_sys->i_moov_reserve_pos = 0;
+    p_sys->i_moov_reserve = 1024 *
+            var_InheritInteger(p_mux, SOUT_CFG_PREFIX "moov-reserve");
 
     if (!p_sys->b_mov) {
         /* Now add ftyp header */
@@ -235,6 +257,37 @@ static int Open(vlc_object_t *p_this)
         box_send(p_mux, box);
     }
 
+    /* Reserve room for the moov, filled with a free box until Close */
+    if (p_sys->i_moov_reserve > 0) {
+        box = box_new("free");
+        if (!box || !box->b)
+        {
+            if (box)
+                bo_free(box);
+            free(p_sys);
+            return VLC_ENOMEM;
+        }
+        box_fix(box, p_sys->i_moov_reserve);
+        box_send(p_mux, box);
+
+        /* The zeroed payload is written in pieces, as it can be large */
+        for (uint64_t i_left = p_sys->i_moov_reserve - 8; i_left > 0; ) {
+            const size_t i_chunk = __MIN(i_left, 65536);
+            block_t *p_zero = block_Alloc(i_chunk);
+            if (p_zero == NULL) {
+                free(p_sys);
+                return VLC_ENOMEM;
+            }
+            memset(p_zero->p_buffer, 0, i_chunk);
+            sout_AccessOutWrite(p_mux->p_access, p_zero);
+            i_left -= i_chunk;
+        }
+
+        p_sys->i_moov_reserve_pos = p_sys->i_pos;
+        p_sys->i_pos += p_sys->i_moov_reserve;
+        p_sys->i_mdat_pos = p_sys->i_pos;
+    }
+
     /* FIXME FIXME
      * Quicktime actually doesn't like the 64 bits extensions !!! */
     p_sys->b_64_ext = false;
@@ -285,6 +338,18 @@ static void Close(vlc_object_t *p_this)
     sout_AccessOutSeek(p_mux->p_access, p_sys->i_mdat_pos);
     sout_AccessOutWrite(p_mux->p_access, bo.b);
 
+    /* Bring back the sample tables flushed while muxing. The moov is built
+     * in memory as a whole, and is itself as large as the tables, so they are
+     * not streamed from the spill file. A moov missing samples would be
+     * worse than none: leave the file without one. */
+    for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        if (!LoadSpilledEntries(p_sys->pp_streams[i_trak])) {
+            msg_Err(p_mux, "cannot reload sample table of track %u",
+                    p_sys->pp_streams[i_trak]->mux.i_track_id);
+            goto cleanup;
+        }
+    }
+
     /* Create MOOV header */
     const bool b_stco64 = (p_sys->i_pos >= (((uint64_t)0x1) << 32));
     uint64_t i_moov_pos = p_sys->i_pos;
@@ -292,6 +357,32 @@ static void Close(vlc_object_t *p_this)
 
     /* Check we need to create "fast start" files */
     p_sys->b_fast_start = var_GetBool(p_this, SOUT_CFG_PREFIX "faststart");
+
+    /* Write the moov in the reserved area if it fits, so that the media
+     * data does not need to be moved. Chunk offsets are already absolute. */
+    if (p_sys->i_moov_reserve > 0 && moov && moov->b) {
+        const uint64_t i_moov_size = moov->b->i_buffer;
+        if (i_moov_size == p_sys->i_moov_reserve ||
+            i_moov_size + 8 <= p_sys->i_moov_reserve) {
+            i_moov_pos = p_sys->i_moov_reserve_pos;
+            p_sys->b_fast_start = false;
+
+            if (i_moov_size < p_sys->i_moov_reserve) {
+                /* Remaining space is still zeroed, only rewrite the header */
+                bo_t *skip = box_new("free");
+                if (skip) {
+                    box_fix(skip, p_sys->i_moov_reserve - i_moov_size);
+                    sout_AccessOutSeek(p_mux->p_access,
+                                       i_moov_pos + i_moov_size);
+                    box_send(p_mux, skip);
+                }
+            }
+        } else {
+            msg_Warn(p_mux, "moov (%"PRIu64" bytes) does not fit in reserved "
+                     "space (%"PRIu64" bytes)", i_moov_size,
+                     p_sys->i_moov_reserve);
+        }
+    }
     while (p_sys->b_fast_start && moov && moov->b) {
         /* Move data to the end of the file so we can fit the moov header
          * at the start */
@@ -356,6 +447,7 @@ cleanup:
     for (unsigned int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
         mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
         mp4mux_trackinfo_Clear(&p_stream->mux);
+        mp4mux_spill_Clean(&p_stream->spill);
         free(p_stream);
     }
     if (p_sys->i_nb_streams)
@@ -441,6 +533,7 @@ static int AddStream(sout_mux_t *p_mux, sout_input_t *p_input)
     p_stream->mux.i_track_id    = p_sys->i_nb_streams + 1;
     p_stream->i_length_neg  = 0;
     p_stream->i_dts_start   = 0;
+    mp4mux_spill_Init(&p_stream->spill);
     switch( p_stream->mux.fmt.i_cat )
     {
     case AUDIO_ES:
@@ -524,7 +617,7 @@ static int Mux(sout_mux_t *p_mux)
             p_data = block_FifoGet(p_input->p_fifo);
             if (p_stream->mux.fmt.i_codec == VLC_CODEC_H264 ||
                 p_stream->mux.fmt.i_codec == VLC_CODEC_HEVC)
-                p_data = ConvertFromAnnexB(p_data);
+                p_data = hxxx_AnnexB_to_xVC(p_data, 4);
             else if (p_stream->mux.fmt.i_codec == VLC_CODEC_SUBT)
                 p_data = ConvertSUBT(p_data);
             else if (p_stream->mux.fmt.i_codec == VLC_CODEC_A52 ||
@@ -554,7 +647,7 @@ static int Mux(sout_mux_t *p_mux)
                                            p_stream->mux.fmt.video.i_frame_rate_base /
                                            p_stream->mux.fmt.video.i_frame_rate;
                         msg_Dbg( p_mux, "video track %u fixup to %"PRId64" for sample %u",
-                                 p_stream->mux.i_track_id, p_data->i_length, p_stream->mux.i_entry_count );
+                                 p_stream->mux.i_track_id, p_data->i_length, p_stream->spill.count + p_stream->mux.i_entry_count );
                     }
                     else if ( p_stream->mux.fmt.i_cat == AUDIO_ES &&
                               p_stream->mux.fmt.audio.i_rate &&
@@ -563,12 +656,12 @@ static int Mux(sout_mux_t *p_mux)
                         p_data->i_length = CLOCK_FREQ * p_data->i_nb_samples /
                                            p_stream->mux.fmt.audio.i_rate;
                         msg_Dbg( p_mux, "audio track %u fixup to %"PRId64" for sample %u",
-                                 p_stream->mux.i_track_id, p_data->i_length, p_stream->mux.i_entry_count );
+                                 p_stream->mux.i_track_id, p_data->i_length, p_stream->spill.count + p_stream->mux.i_entry_count );
                     }
                     else if ( p_data->i_length <= 0 )
                     {
                         msg_Warn( p_mux, "unknown length for track %u sample %u",
-                                  p_stream->mux.i_track_id, p_stream->mux.i_entry_count );
+                                  p_stream->mux.i_track_id, p_stream->spill.count + p_stream->mux.i_entry_count );
                         p_data->i_length = 1;
                     }
                 }
@@ -620,7 +713,9 @@ static int Mux(sout_mux_t *p_mux)
 
         p_stream->mux.i_entry_count++;
         /* XXX: -1 to always have 2 entry for easy adding of empty SPU */
-        if (p_stream->mux.i_entry_count >= p_stream->mux.i_entry_max - 1) {
+        if (p_stream->mux.i_entry_count >= p_stream->mux.i_entry_max - 1 &&
+            (p_stream->mux.i_entry_max < MP4_SPILL_ENTRIES ||
+             !SpillEntries(p_stream))) {
             p_stream->mux.i_entry_max += 1000;
             p_stream->mux.entry = xrealloc(p_stream->mux.entry,
                          p_stream->mux.i_entry_max * sizeof(mp4mux_entry_t));
@@ -687,6 +782,57 @@ static int Mux(sout_mux_t *p_mux)
     return(VLC_SUCCESS);
 }
 
+/*****************************************************************************
+ * Sample table spilling:
+ *****************************************************************************
+ * Long recordings would otherwise keep every sample entry in memory until
+ * Close. Once the table reaches MP4_SPILL_ENTRIES, all entries but the last
+ * one (which SPU tracks may still fix up) are appended to a temporary file,
+ * in the compact form of spill.h.
+ *****************************************************************************/
+static bool SpillEntries(mp4_stream_t *p_stream)
+{
+    mp4mux_trackinfo_t *p_mux = &p_stream->mux;
+    const unsigned i_spill = p_mux->i_entry_count - 1;
+
+    /* on error, keep the table in memory instead */
+    if (mp4mux_spill_Write(&p_stream->spill, p_mux->entry, i_spill))
+        return false;
+
+    p_mux->entry[0] = p_mux->entry[i_spill];
+    p_mux->i_entry_count = 1;
+    return true;
+}
+
+static bool LoadSpilledEntries(mp4_stream_t *p_stream)
+{
+    mp4mux_trackinfo_t *p_mux = &p_stream->mux;
+    const unsigned i_spilled = p_stream->spill.count;
+
+    if (i_spilled == 0)
+        return true;
+
+    const unsigned i_total = i_spilled + p_mux->i_entry_count;
+    mp4mux_entry_t *entry = malloc((i_total + 1) * sizeof(*entry));
+    if (entry == NULL)
+        return false;
+
+    if (mp4mux_spill_Read(&p_stream->spill, entry)) {
+        free(entry);
+        return false;
+    }
+    memcpy(&entry[i_spilled], p_mux->entry,
+           p_mux->i_entry_count * sizeof(*entry));
+
+    free(p_mux->entry);
+    p_mux->entry = entry;
+    p_mux->i_entry_count = i_total;
+    p_mux->i_entry_max = i_total + 1;
+
+    mp4mux_spill_Clean(&p_stream->spill);
+    return true;
+}
+
 /*****************************************************************************
  *
  *****************************************************************************/
@@ -705,78 +851,6 @@ static block_t *ConvertSUBT(block_t *p_block)
     return p_block;
 }
 
-static block_t *ConvertFromAnnexB(block_t *p_block)
-{
-    if(p_block->i_buffer < 4)
-    {
-        block_Release(p_block);
-        return NULL;
-    }
-
-    if(memcmp(p_block->p_buffer, avc1_start_code, 4))
-    {
-        if(!memcmp(p_block->p_buffer, avc1_short_start_code, 3))
-        {
-            p_block = block_Realloc(p_block, 1, p_block->i_buffer);
-            if( !p_block )
-                return NULL;
-        }
-        else /* No startcode on start */
-        {
-            block_Release(p_block);
-            return NULL;
-        }
-    }
-
-    uint8_t *last = p_block->p_buffer;
-    uint8_t *dat  = &p_block->p_buffer[4];
-    uint8_t *end = &p_block->p_buffer[p_block->i_buffer];
-
-    /* Replace the 4 bytes start code with 4 bytes size */
-    while (dat < end) {
-        while (dat < end - 4) {
-            if (!memcmp(dat, avc1_start_code, 4))
-            {
-                break;
-            }
-            else if(!memcmp(dat, avc1_short_start_code, 3))
-            {
-                /* save offsets as we don't know if realloc will replace buffer */
-                size_t i_last = last - p_block->p_buffer;
-                size_t i_dat = dat - p_block->p_buffer;
-                size_t i_end = end - p_block->p_buffer;
-
-                p_block = block_Realloc(p_block, 0, p_block->i_buffer + 1);
-                if( !p_block )
-                    return NULL;
-
-                /* restore offsets */
-                last = &p_block->p_buffer[i_last];
-                dat = &p_block->p_buffer[i_dat];
-                end = &p_block->p_buffer[i_end];
-
-                /* Shift data */
-                memmove(&dat[4], &dat[3], end - &dat[3]);
-                end++;
-                break;
-            }
-            dat++;
-        }
-        if (dat >= end - 4)
-            dat = end;
-
-        /* Fix size */
-        SetDWBE(last, dat - &last[4]);
-
-        /* Skip blocks with SPS/PPS */
-        //if ((last[4]&0x1f) == 7 || (last[4]&0x1f) == 8)
-        //    ; // FIXME Find a way to skip dat without frelling everything
-        last = dat;
-        dat += 4;
-    }
-    return p_block;
-}
-
 static void box_send(sout_mux_t *p_mux,  bo_t *box)
 {
     assert(box != NULL);
@@ -1388,7 +1462,7 @@ static int MuxFrag(sout_mux_t *p_mux)
     {
     case VLC_CODEC_H264:
     case VLC_CODEC_HEVC:
-        p_currentblock = ConvertFromAnnexB(p_currentblock);
+        p_currentblock = hxxx_AnnexB_to_xVC(p_currentblock, 4);
         break;
     case VLC_CODEC_SUBT:
         p_currentblock = ConvertSUBT(p_currentblock);
@@ -0,0 +1,167 @@
+/*****************************************************************************
+ * spill.h: sample tables spilled to a temporary file
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_MP4MUX_SPILL_H
+#define VLC_MP4MUX_SPILL_H 1
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* libmp4mux.h must be included first */
+
+/* The entries are stored as variable length numbers (7 bits per byte, the
+ * high bit set on all bytes but the last). A sample usually starts where the
+ * previous one ended, and lasts as long, so the position is stored relative
+ * to the end of the previous sample, and the length relative to its length.
+ * An entry then takes 6 to 10 bytes instead of sizeof (mp4mux_entry_t). */
+typedef struct
+{
+    FILE          *file;
+    unsigned       count; /* entries in the file */
+    mp4mux_entry_t last;  /* last entry in the file */
+} mp4mux_spill_t;
+
+static inline void mp4mux_spill_Init(mp4mux_spill_t *spill)
+{
+    spill->file = NULL;
+    spill->count = 0;
+    memset(&spill->last, 0, sizeof (spill->last));
+}
+
+static inline void mp4mux_spill_Clean(mp4mux_spill_t *spill)
+{
+    if (spill->file != NULL)
+        fclose(spill->file);
+    mp4mux_spill_Init(spill);
+}
+
+static inline void mp4mux_spill_PutNumber(FILE *file, int64_t value)
+{
+    /* Zig-zag: small negative values are small numbers too */
+    uint64_t u = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+
+    while (u >= 0x80) {
+        putc(0x80 | (u & 0x7f), file);
+        u >>= 7;
+    }
+    putc(u, file);
+}
+
+static inline int mp4mux_spill_GetNumber(FILE *file, int64_t *value)
+{
+    uint64_t u = 0;
+
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int c = getc(file);
+        if (c == EOF)
+            return -1;
+
+        u |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *value = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Appends entries to the file, creating it first if needed.
+ * On error, the file is left as it was.
+ * @return 0 on success, -1 on error
+ */
+static inline int mp4mux_spill_Write(mp4mux_spill_t *spill,
+                                     const mp4mux_entry_t *entry,
+                                     unsigned count)
+{
+    if (spill->file == NULL) {
+        spill->file = tmpfile();
+        if (spill->file == NULL)
+            return -1;
+    }
+
+    const off_t start = ftello(spill->file);
+    mp4mux_entry_t last = spill->last;
+
+    for (unsigned i = 0; i < count; i++) {
+        mp4mux_spill_PutNumber(spill->file,
+                               entry[i].i_pos - (last.i_pos + last.i_size));
+        mp4mux_spill_PutNumber(spill->file, entry[i].i_size);
+        mp4mux_spill_PutNumber(spill->file, entry[i].i_pts_dts);
+        mp4mux_spill_PutNumber(spill->file,
+                               entry[i].i_length - last.i_length);
+        mp4mux_spill_PutNumber(spill->file, entry[i].i_flags);
+        last = entry[i];
+    }
+
+    /* Write errors are sticky, the buffered ones show up when flushing */
+    if (fflush(spill->file) || ferror(spill->file)) {
+        clearerr(spill->file);
+        fseeko(spill->file, start, SEEK_SET);
+        return -1;
+    }
+
+    spill->last = last;
+    spill->count += count;
+    return 0;
+}
+
+/**
+ * Reads all the entries of the file back.
+ * @param entry array of spill->count entries
+ * @return 0 on success, -1 on error
+ */
+static inline int mp4mux_spill_Read(mp4mux_spill_t *spill,
+                                    mp4mux_entry_t *entry)
+{
+    mp4mux_entry_t last;
+
+    if (spill->count == 0)
+        return 0;
+    if (fflush(spill->file) || fseeko(spill->file, 0, SEEK_SET))
+        return -1;
+
+    memset(&last, 0, sizeof (last));
+    for (unsigned i = 0; i < spill->count; i++) {
+        int64_t pos, size, pts_dts, length, flags;
+
+        if (mp4mux_spill_GetNumber(spill->file, &pos)
+         || mp4mux_spill_GetNumber(spill->file, &size)
+         || mp4mux_spill_GetNumber(spill->file, &pts_dts)
+         || mp4mux_spill_GetNumber(spill->file, &length)
+         || mp4mux_spill_GetNumber(spill->file, &flags))
+            return -1;
+
+        entry[i].i_pos = last.i_pos + last.i_size + pos;
+        entry[i].i_size = size;
+        entry[i].i_pts_dts = pts_dts;
+        entry[i].i_length = last.i_length + length;
+        entry[i].i_flags = flags;
+        last = entry[i];
+    }
+
+    /* Further entries are appended */
+    if (fseeko(spill->file, 0, SEEK_END))
+        return -1;
+    return 0;
+}
+
+#endif
@@ -47,6 +47,7 @@
 #include "csa.h"
 #include "tsutil.h"
 #include "streams.h"
+#include "../../misc/slices.h"
 
 # include <dvbpsi/dvbpsi.h>
 # include <dvbpsi/demux.h>
@@ -172,12 +173,19 @@ static void    Close  ( vlc_object_t * );
 #define CU_LONGTEXT N_("CSA encryption key used. It can be the odd/first/1 " \
   "(default) or the even/second/2 one.")
 
+#define THREADS_TEXT N_("Threads")
+#define THREADS_LONGTEXT N_("Number of threads used to packetize the " \
+    "elementary streams into PES (0 for one per CPU, 1 to disable).")
+
 #define CPKT_TEXT N_("Packet size in bytes to encrypt")
 #define CPKT_LONGTEXT N_("Size of the TS packet to encrypt. " \
     "The encryption routines subtract the TS-header from the value before " \
     "encrypting." )
 
 #define SOUT_CFG_PREFIX "sout-ts-"
+#define PES_MAX_THREADS 8
+/* Below this amount of data, packetizing is not worth waking threads up */
+#define PES_PARALLEL_MIN_SIZE (256 * 1024)
 #define MAX_PMT 64       /* Maximum number of programs. FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
 #define MAX_PMT_PID 64       /* Maximum pids in each pmt.  FIXME: I just chose an arbitrary number. Where is the maximum in the spec? */
 #if MAX_SDT_DESC < MAX_PMT
@@ -223,6 +231,9 @@ vlc_module_begin ()
     add_string( SOUT_CFG_PREFIX "csa-use", "1",  CU_TEXT,   CU_LONGTEXT,   true)
     add_integer(SOUT_CFG_PREFIX "csa-pkt", 188,  CPKT_TEXT, CPKT_LONGTEXT, true)
 
+    add_integer(SOUT_CFG_PREFIX "threads", 0, THREADS_TEXT, THREADS_LONGTEXT, true)
+        change_integer_range( 0, PES_MAX_THREADS )
+
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -234,7 +245,7 @@ static const char *const ppsz_sout_options[] = {
     "netid", "sdtdesc",
     "es-id-pid", "shaping", "pcr", "bmin", "bmax", "use-key-frames",
     "dts-delay", "csa-ck", "csa2-ck", "csa-use", "csa-pkt", "crypt-audio", "crypt-video",
-    "muxpmt", "program-pmt", "alignment",
+    "muxpmt", "program-pmt", "alignment", "threads",
     NULL
 };
 
@@ -310,6 +321,7 @@ static inline void BufferChainClean( sout_buffer_chain_t *c )
 
 typedef struct
 {
+    sout_buffer_chain_t chain_es; /* audio and video blocks not in PES yet */
     sout_buffer_chain_t chain_pes;
     mtime_t             i_pes_dts;
     mtime_t             i_pes_length;
@@ -353,6 +365,10 @@ struct sout_mux_sys_t
 
     sdt_psi_t       sdt;
 
+    /* PSI packets, regenerated only when the tables change */
+    block_t         *p_pat_cache;
+    block_t         *p_pmt_cache;
+
     /* for TS building */
     int64_t         i_bitrate_min;
     int64_t         i_bitrate_max;
@@ -371,6 +387,10 @@ struct sout_mux_sys_t
     int             i_csa_pkt_size;
     bool            b_crypt_audio;
     bool            b_crypt_video;
+
+    /* PES packetization threads */
+    slice_pool_t    *p_pes_pool;
+    unsigned        i_pes_threads;
 };
 
 
@@ -458,6 +478,7 @@ static void DelStream( sout_mux_t *, sout_input_t * );
 static int Mux      ( sout_mux_t * );
 
 static block_t *FixPES( sout_mux_t *p_mux, block_fifo_t *p_fifo );
+static void PacketizeStreams( sout_mux_t *p_mux );
 static block_t *Add_ADTS( block_t *, const es_format_t * );
 static void TSSchedule  ( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
                           mtime_t i_pcr_length, mtime_t i_pcr_dts );
@@ -465,6 +486,7 @@ static void TSDate      ( sout_mux_t *p_mux, sout_buffer_chain_t *p_chain_ts,
                           mtime_t i_pcr_length, mtime_t i_pcr_dts );
 static void GetPAT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
 static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c );
+static void PSICacheFlush( sout_mux_sys_t *p_sys );
 
 static block_t *TSNew( sout_mux_t *p_mux, sout_input_sys_t *p_stream, bool b_pcr );
 static void TSSetPCR( block_t *p_ts, mtime_t i_dts );
@@ -720,6 +742,11 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->b_use_key_frames = var_GetBool( p_mux, SOUT_CFG_PREFIX "use-key-frames" );
 
+    /* The threads are started once there are several streams to packetize */
+    p_sys->i_pes_threads = var_GetInteger( p_mux, SOUT_CFG_PREFIX "threads" );
+    if( p_sys->i_pes_threads == 0 )
+        p_sys->i_pes_threads = PES_MAX_THREADS;
+
     p_mux->p_sys        = p_sys;
 
     p_sys->csa = csaSetup(p_this);
@@ -758,6 +785,9 @@ static void Close( vlc_object_t * p_this )
         free( p_sys->sdt.desc[i].psz_provider );
     }
 
+    if( p_sys->p_pes_pool )
+        SlicePoolDelete( p_sys->p_pes_pool );
+    PSICacheFlush( p_sys );
     free( p_sys );
 }
 
@@ -1086,10 +1116,12 @@ static int AddStream( sout_mux_t *p_mux, sout_input_t *p_input )
     }
 
     /* Init pes chain */
+    BufferChainInit( &p_stream->state.chain_es );
     BufferChainInit( &p_stream->state.chain_pes );
 
     /* We only change PMT version (PAT isn't changed) */
     p_sys->i_pmt_version_number = ( p_sys->i_pmt_version_number + 1 )%32;
+    PSICacheFlush( p_sys );
 
     /* Update pcr_pid */
     if( p_input->p_fmt->i_cat != SPU_ES &&
@@ -1164,6 +1196,7 @@ static void DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
     }
 
     /* Empty all data in chain_pes */
+    BufferChainClean( &p_stream->state.chain_es );
     BufferChainClean( &p_stream->state.chain_pes );
 
     free(p_stream->pes.lang);
@@ -1193,6 +1226,7 @@ static void DelStream( sout_mux_t *p_mux, sout_input_t *p_input )
     /* We only change PMT version (PAT isn't changed) */
     p_sys->i_pmt_version_number++;
     p_sys->i_pmt_version_number %= 32;
+    PSICacheFlush( p_sys );
 }
 
 static void SetHeader( sout_buffer_chain_t *c,
@@ -1287,6 +1321,7 @@ static bool MuxStreams(sout_mux_t *p_mux )
                 if ( ( i_spu_delay >= 100 * CLOCK_FREQ ) ||
                      ( i_spu_delay < CLOCK_FREQ / 100 ) )
                 {
+                    BufferChainClean( &p_stream->state.chain_es );
                     BufferChainClean( &p_stream->state.chain_pes );
                     p_stream->state.i_pes_dts = 0;
                     p_stream->state.i_pes_used = 0;
@@ -1342,6 +1377,7 @@ static bool MuxStreams(sout_mux_t *p_mux )
                       p_pcr_stream->state.i_pes_dts );
             block_Release( p_data );
 
+            BufferChainClean( &p_stream->state.chain_es );
             BufferChainClean( &p_stream->state.chain_pes );
             p_stream->state.i_pes_dts = 0;
             p_stream->state.i_pes_used = 0;
@@ -1349,6 +1385,7 @@ static bool MuxStreams(sout_mux_t *p_mux )
 
             if( p_input->p_fmt->i_cat != SPU_ES )
             {
+                BufferChainClean( &p_pcr_stream->state.chain_es );
                 BufferChainClean( &p_pcr_stream->state.chain_pes );
                 p_pcr_stream->state.i_pes_dts = 0;
                 p_pcr_stream->state.i_pes_used = 0;
@@ -1425,19 +1462,17 @@ static bool MuxStreams(sout_mux_t *p_mux )
             p_data->i_pts = p_data->i_dts;
         }
 
-        if( p_input->p_fmt->i_codec == VLC_CODEC_DIRAC )
+        if( p_input->p_fmt->i_cat == SPU_ES )
         {
-            b_data_alignment = 1;
-            /* dirac pes packets should be unbounded in
-             * length, specify a suitibly large max size */
-            i_max_pes_size = INT_MAX;
-        }
+            EStoPES ( &p_data, p_input->p_fmt, p_stream->pes.i_stream_id,
+                           1, b_data_alignment, i_header_size,
+                           i_max_pes_size, p_sys->first_dts );
 
-        EStoPES ( &p_data, p_input->p_fmt, p_stream->pes.i_stream_id,
-                       1, b_data_alignment, i_header_size,
-                       i_max_pes_size, p_sys->first_dts );
-
-        BufferChainAppend( &p_stream->state.chain_pes, p_data );
+            BufferChainAppend( &p_stream->state.chain_pes, p_data );
+        }
+        else
+            /* Packetized with the other streams, see PacketizeStreams() */
+            BufferChainAppend( &p_stream->state.chain_es, p_data );
 
         if( p_sys->b_use_key_frames && p_stream == p_pcr_stream
             && (p_data->i_flags & BLOCK_FLAG_TYPE_I)
@@ -1449,6 +1484,8 @@ static bool MuxStreams(sout_mux_t *p_mux )
         }
     }
 
+    PacketizeStreams( p_mux );
+
     /* save */
     const mtime_t i_pcr_length = p_pcr_stream->state.i_pes_length;
     p_pcr_stream->state.b_key_frame = 0;
@@ -1571,6 +1608,107 @@ static bool MuxStreams(sout_mux_t *p_mux )
     return false;
 }
 
+/*****************************************************************************
+ * PacketizeStreams: convert the audio and video blocks gathered by
+ * MuxStreams() to PES, each stream on its own thread if it is worth it.
+ *****************************************************************************
+ * The streams do not share anything but first_dts, which is set before any
+ * block is queued. SPU blocks are converted right away: they are small and
+ * their conversion depends on their neighbours.
+ *****************************************************************************/
+typedef struct
+{
+    sout_mux_sys_t *p_sys;
+    sout_input_t   *pp_inputs[];
+} pes_job_t;
+
+static void PacketizeStream( sout_mux_sys_t *p_sys, sout_input_t *p_input )
+{
+    sout_input_sys_t *p_stream = (sout_input_sys_t*)p_input->p_sys;
+    int b_data_alignment = 0;
+    int i_max_pes_size = 0;
+    block_t *p_data;
+
+    if( p_input->p_fmt->i_codec == VLC_CODEC_DIRAC )
+    {
+        b_data_alignment = 1;
+        /* dirac pes packets should be unbounded in
+         * length, specify a suitibly large max size */
+        i_max_pes_size = INT_MAX;
+    }
+
+    while( ( p_data = BufferChainGet( &p_stream->state.chain_es ) ) )
+    {
+        EStoPES ( &p_data, p_input->p_fmt, p_stream->pes.i_stream_id,
+                       1, b_data_alignment, 0,
+                       i_max_pes_size, p_sys->first_dts );
+
+        BufferChainAppend( &p_stream->state.chain_pes, p_data );
+    }
+}
+
+static void PacketizeSlice( void *opaque, unsigned i_slice, unsigned i_count )
+{
+    pes_job_t *p_job = opaque;
+
+    VLC_UNUSED(i_count);
+    PacketizeStream( p_job->p_sys, p_job->pp_inputs[i_slice] );
+}
+
+static void PacketizeStreams( sout_mux_t *p_mux )
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    pes_job_t *p_job = NULL;
+    unsigned i_count = 0;
+    size_t i_size = 0;
+
+    for( int i = 0; i < p_mux->i_nb_inputs; i++ )
+    {
+        sout_input_sys_t *p_stream = (sout_input_sys_t*)p_mux->pp_inputs[i]->p_sys;
+
+        if( p_stream->state.chain_es.p_first == NULL )
+            continue;
+        i_count++;
+        for( block_t *p = p_stream->state.chain_es.p_first; p; p = p->p_next )
+            i_size += p->i_buffer;
+    }
+
+    if( i_count >= 2 && i_size >= PES_PARALLEL_MIN_SIZE &&
+        p_sys->i_pes_threads > 1 )
+    {
+        if( p_sys->p_pes_pool == NULL )
+        {
+            p_sys->p_pes_pool = SlicePoolNew( VLC_OBJECT(p_mux),
+                                              p_sys->i_pes_threads );
+            if( p_sys->p_pes_pool == NULL ) /* single CPU: don't try again */
+                p_sys->i_pes_threads = 1;
+        }
+        if( p_sys->p_pes_pool != NULL )
+            p_job = malloc( sizeof( *p_job )
+                            + i_count * sizeof( p_job->pp_inputs[0] ) );
+    }
+
+    if( p_job == NULL )
+    {
+        for( int i = 0; i < p_mux->i_nb_inputs; i++ )
+            PacketizeStream( p_sys, p_mux->pp_inputs[i] );
+        return;
+    }
+
+    p_job->p_sys = p_sys;
+    i_count = 0;
+    for( int i = 0; i < p_mux->i_nb_inputs; i++ )
+    {
+        sout_input_sys_t *p_stream = (sout_input_sys_t*)p_mux->pp_inputs[i]->p_sys;
+
+        if( p_stream->state.chain_es.p_first != NULL )
+            p_job->pp_inputs[i_count++] = p_mux->pp_inputs[i];
+    }
+
+    SlicePoolRun( p_sys->p_pes_pool, PacketizeSlice, p_job, i_count );
+    free( p_job );
+}
+
 /*****************************************************************************
  * Mux: Call each time there is new data for at least one stream
  *****************************************************************************
@@ -1924,20 +2062,116 @@ static void TSSetPCR( block_t *p_ts, mtime_t i_dts )
     p_ts->p_buffer[11] = 0; /* we don't set PCR extension */
 }
 
+/*****************************************************************************
+ * PSI cache
+ *****************************************************************************
+ * PAT, PMT and SDT only change when streams are added or removed, so the
+ * generated TS packets are kept and replayed with the continuity counter of
+ * their PID patched in, instead of rebuilding and CRCing the sections each
+ * time they are inserted.
+ *****************************************************************************/
+static void PSICacheFlush( sout_mux_sys_t *p_sys )
+{
+    if( p_sys->p_pat_cache )
+        block_ChainRelease( p_sys->p_pat_cache );
+    if( p_sys->p_pmt_cache )
+        block_ChainRelease( p_sys->p_pmt_cache );
+    p_sys->p_pat_cache = NULL;
+    p_sys->p_pmt_cache = NULL;
+}
+
+static ts_stream_t *PSIStreamFromPID( sout_mux_sys_t *p_sys, int i_pid )
+{
+    if( i_pid == p_sys->pat.i_pid )
+        return &p_sys->pat;
+    if( i_pid == p_sys->sdt.ts.i_pid )
+        return &p_sys->sdt.ts;
+    for (unsigned i = 0; i < p_sys->i_num_pmt; i++ )
+        if( i_pid == p_sys->pmt[i].i_pid )
+            return &p_sys->pmt[i];
+    return NULL;
+}
+
+/* Keeps a pristine copy of the packets appended to c past i_depth */
+static block_t *PSICacheStore( const sout_buffer_chain_t *c, int i_depth )
+{
+    block_t *p_cache = NULL;
+    block_t **pp_last = &p_cache;
+
+    block_t *p_ts = c->p_first;
+    for( ; p_ts != NULL && i_depth > 0; p_ts = p_ts->p_next )
+        i_depth--;
+
+    for( ; p_ts != NULL; p_ts = p_ts->p_next )
+    {
+        block_t *p_dup = block_Duplicate( p_ts );
+        if( !p_dup )
+        {
+            if( p_cache )
+                block_ChainRelease( p_cache );
+            return NULL;
+        }
+        p_dup->i_flags = 0;
+        block_ChainLastAppend( &pp_last, p_dup );
+    }
+    return p_cache;
+}
+
+/* Replays cached packets, returns false if there is nothing cached */
+static bool PSICacheReplay( sout_mux_sys_t *p_sys, sout_buffer_chain_t *c,
+                            block_t *p_cache )
+{
+    if( p_cache == NULL )
+        return false;
+
+    for( ; p_cache != NULL; p_cache = p_cache->p_next )
+    {
+        block_t *p_ts = block_Duplicate( p_cache );
+        if( unlikely(p_ts == NULL) )
+            break; /* the tables will be repeated anyway */
+        p_ts->p_next = NULL;
+
+        ts_stream_t *p_ts_stream = PSIStreamFromPID( p_sys,
+                       ( (p_ts->p_buffer[1] & 0x1f) << 8 ) | p_ts->p_buffer[2] );
+        if( p_ts_stream )
+        {
+            p_ts->p_buffer[3] = ( p_ts->p_buffer[3] & 0xf0 ) |
+                                p_ts_stream->i_continuity_counter;
+            p_ts_stream->i_continuity_counter =
+                ( p_ts_stream->i_continuity_counter + 1 ) % 16;
+        }
+        /* discontinuity indicator is only sent once */
+        if( ( p_ts->p_buffer[3] & 0x20 ) && p_ts->p_buffer[4] > 0 )
+            p_ts->p_buffer[5] &= ~0x80;
+
+        BufferChainAppend( c, p_ts );
+    }
+    return true;
+}
+
 void GetPAT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
 {
     sout_mux_sys_t       *p_sys = p_mux->p_sys;
 
+    if( PSICacheReplay( p_sys, c, p_sys->p_pat_cache ) )
+        return;
+
+    int i_depth = c->i_depth;
     BuildPAT( p_sys->p_dvbpsi,
               c, (PEStoTSCallback)BufferChainAppend,
               p_sys->i_tsid, p_sys->i_pat_version_number,
               &p_sys->pat,
               p_sys->i_num_pmt, p_sys->pmt, p_sys->i_pmt_program_number );
+    p_sys->p_pat_cache = PSICacheStore( c, i_depth );
 }
 
 static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
 {
     sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    if( PSICacheReplay( p_sys, c, p_sys->p_pmt_cache ) )
+        return;
+
     pes_mapped_stream_t mappeds[p_mux->i_nb_inputs];
 
     for (int i_stream = 0; i_stream < p_mux->i_nb_inputs; i_stream++ )
@@ -1956,6 +2190,7 @@ static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
         mappeds[i_stream].ts = &p_stream->ts;
     }
 
+    int i_depth = c->i_depth;
     BuildPMT( p_sys->p_dvbpsi, VLC_OBJECT(p_mux),
               c, (PEStoTSCallback)BufferChainAppend,
               p_sys->i_tsid, p_sys->i_pmt_version_number,
@@ -1963,4 +2198,5 @@ static void GetPMT( sout_mux_t *p_mux, sout_buffer_chain_t *c )
               &p_sys->sdt,
               p_sys->i_num_pmt, p_sys->pmt, p_sys->i_pmt_program_number,
               p_mux->i_nb_inputs, mappeds );
+    p_sys->p_pmt_cache = PSICacheStore( c, i_depth );
 }
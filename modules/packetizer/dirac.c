@@ -661,6 +661,21 @@ static block_t *dirac_EmitEOS( decoder_t *p_dec, uint32_t i_prev_parse_offset )
     return p_block;
 }
 
+/* Looks up the 'BBCD' parse code prefix, letting the C library vectorized
+ * memchr() skip over the payload */
+static const uint8_t * dirac_FindParseCode( const uint8_t *p, const uint8_t *end )
+{
+    for( end -= 3; p < end; p++ )
+    {
+        p = memchr( p, 'B', end - p );
+        if( p == NULL )
+            return NULL;
+        if( p[1] == 'B' && p[2] == 'C' && p[3] == 'D' )
+            return p;
+    }
+    return NULL;
+}
+
 /***
  * Bytestream synchronizer
  * maps [Bytes] -> DataUnit
@@ -677,7 +692,8 @@ static block_t *dirac_DoSync( decoder_t *p_dec )
         case NOT_SYNCED:
         {
             if( VLC_SUCCESS !=
-                block_FindStartcodeFromOffset( &p_sys->bytestream, &p_sys->i_offset, p_parsecode, 4, NULL ) )
+                block_FindStartcodeFromOffset( &p_sys->bytestream, &p_sys->i_offset, p_parsecode, 4,
+                                               dirac_FindParseCode ) )
             {
                 /* p_sys->i_offset will have been set to:
                  *   end of bytestream - amount of prefix found
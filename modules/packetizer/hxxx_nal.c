@@ -86,7 +86,7 @@ block_t *hxxx_AnnexB_to_xVC( block_t *p_block, uint8_t i_nal_length_size )
             if(i_nalcount == i_list)
             {
                 i_list += 16;
-                struct nalmoves_e *p_new = malloc( sizeof(*p_new) * i_list );
+                struct nalmoves_e *p_new = realloc( p_list, sizeof(*p_new) * i_list );
                 if(unlikely(!p_new))
                     goto error;
                 p_list = p_new;
@@ -162,8 +162,10 @@ block_t *hxxx_AnnexB_to_xVC( block_t *p_block, uint8_t i_nal_length_size )
         off_t offset = p_list[i - 1].p - p_source + p_list[i - 1].prefix + p_list[i - 1].move;
 //        printf(" move offset %ld, length = %ld  prefix %ld move %ld\n", p_readstart - p_source, i_payload, p_list[i - 1].prefix, p_list[i-1].move);
 
-        /* move in same / copy between buffers */
-        memmove( &p_dest[ offset ], &p_list[i - 1].p[ p_list[i - 1].prefix ], i_payload );
+        /* move in same / copy between buffers, payload already in place
+         * when rewriting 4 bytes startcodes in the same buffer */
+        if( &p_dest[ offset ] != &p_list[i - 1].p[ p_list[i - 1].prefix ] )
+            memmove( &p_dest[ offset ], &p_list[i - 1].p[ p_list[i - 1].prefix ], i_payload );
 
         hxxx_WritePrefix( i_nal_length_size, &p_dest[ offset - i_nal_length_size ] , i_payload );
 
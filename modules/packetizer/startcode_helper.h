@@ -26,6 +26,15 @@
    #include <emmintrin.h>
 #endif
 
+#ifdef HAVE_AVX2_INTRINSICS
+   #include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+   #define STARTCODE_NEON 1
+   #include <arm_neon.h>
+#endif
+
 /* Looks up efficiently for an AnnexB startcode 0x00 0x00 0x01
  * by using a 4 times faster trick than single byte lookup. */
 
@@ -52,7 +61,7 @@ static inline const uint8_t * startcode_FindAnnexB_SSE2( const uint8_t *p, const
     /* First align to 16 */
     /* Skipping this step and doing unaligned loads isn't faster */
     const uint8_t *alignedend = p + 16 - ((intptr_t)p & 15);
-    for (end -= 3; p < alignedend && p < end; p++) {
+    for (end -= 2; p < alignedend && p < end; p++) {
         if (p[0] == 0 && p[1] == 0 && p[2] == 1)
             return p;
     }
@@ -109,19 +118,81 @@ static inline const uint8_t * startcode_FindAnnexB_SSE2( const uint8_t *p, const
 
 #endif
 
+#ifdef HAVE_AVX2_INTRINSICS
+
+/* Compares 32 positions per iteration against the whole 3 bytes pattern,
+ * using overlapping unaligned loads, so that no false positive has to be
+ * checked back with scalar code. */
+__attribute__ ((__target__ ("avx2")))
+static inline const uint8_t * startcode_FindAnnexB_AVX2( const uint8_t *p, const uint8_t *end )
+{
+    const __m256i zeros = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8( 0x01 );
+
+    for( ; end - p >= 32 + 2; p += 32 )
+    {
+        __m256i v0 = _mm256_loadu_si256( (const __m256i *) &p[0] );
+        __m256i v1 = _mm256_loadu_si256( (const __m256i *) &p[1] );
+        __m256i v2 = _mm256_loadu_si256( (const __m256i *) &p[2] );
+        __m256i res = _mm256_and_si256( _mm256_cmpeq_epi8( v0, zeros ),
+                                         _mm256_cmpeq_epi8( v1, zeros ) );
+        res = _mm256_and_si256( res, _mm256_cmpeq_epi8( v2, ones ) );
+        uint32_t match = _mm256_movemask_epi8( res );
+        if( match )
+            return p + __builtin_ctz( match );
+    }
+
+    for( end -= 2; p < end; p++ )
+    {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    return NULL;
+}
+
+#endif
+
+#ifdef STARTCODE_NEON
+
+/* Same pattern match as the AVX2 version, 16 positions at a time.
+ * NEON has no movemask, so matches are located with a scalar pass
+ * over the 16 bytes block once one is known to be there. */
+static inline const uint8_t * startcode_FindAnnexB_NEON( const uint8_t *p, const uint8_t *end )
+{
+    const uint8x16_t zeros = vdupq_n_u8( 0x00 );
+    const uint8x16_t ones = vdupq_n_u8( 0x01 );
+
+    for( ; end - p >= 16 + 2; p += 16 )
+    {
+        uint8x16_t res = vandq_u8( vceqq_u8( vld1q_u8( &p[0] ), zeros ),
+                                   vceqq_u8( vld1q_u8( &p[1] ), zeros ) );
+        res = vandq_u8( res, vceqq_u8( vld1q_u8( &p[2] ), ones ) );
+        uint64x2_t res64 = vreinterpretq_u64_u8( res );
+        if( vgetq_lane_u64( res64, 0 ) | vgetq_lane_u64( res64, 1 ) )
+            break;
+    }
+
+    for( end -= 2; p < end; p++ )
+    {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    return NULL;
+}
+
+#endif
+
 /* That code is adapted from libav's ff_avc_find_startcode_internal
  * and i believe the trick originated from
  * https://graphics.stanford.edu/~seander/bithacks.html#ZeroInWord
  */
-static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint8_t *end )
+static inline const uint8_t * startcode_FindAnnexB_C( const uint8_t *p, const uint8_t *end )
 {
-#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
-    if (vlc_CPU_SSE2())
-        return startcode_FindAnnexB_SSE2(p, end);
-#endif
     const uint8_t *a = p + 4 - ((intptr_t)p & 3);
 
-    for (end -= 3; p < a && p < end; p++) {
+    for (end -= 2; p < a && p < end; p++) {
         if (p[0] == 0 && p[1] == 0 && p[2] == 1)
             return p;
     }
@@ -143,6 +214,25 @@ static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint
     return NULL;
 }
 
+/* Returns the first 0x00 0x00 0x01 sequence in [p, end[, using the best
+ * implementation for the running CPU. */
+static inline const uint8_t * startcode_FindAnnexB( const uint8_t *p, const uint8_t *end )
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        return startcode_FindAnnexB_AVX2(p, end);
+#endif
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    if (vlc_CPU_SSE2())
+        return startcode_FindAnnexB_SSE2(p, end);
+#endif
+#ifdef STARTCODE_NEON
+    return startcode_FindAnnexB_NEON(p, end);
+#else
+    return startcode_FindAnnexB_C(p, end);
+#endif
+}
+
 #undef TRY_MATCH
 
 #endif
@@ -29,7 +29,15 @@
 # include "config.h"
 #endif
 
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_INOTIFY_H
+# include <sys/inotify.h>
+# include <poll.h>
+# include <unistd.h>
+#endif
 
 #define VLC_MODULE_LICENSE VLC_LICENSE_GPL_2_PLUS
 #include <vlc_common.h>
@@ -97,13 +105,44 @@ vlc_module_end ()
 
 static void* Run( void* );
 
-static void input_item_subitem_added( const vlc_event_t*, void* );
 static int onNewFileAdded( vlc_object_t*, char const *,
                            vlc_value_t, vlc_value_t, void *);
 
 static enum type_e fileType( services_discovery_t *p_sd, const char* psz_file );
 static void formatSnapshotItem( input_item_t* );
 
+/* Directories read in parallel: the walkers mostly wait for the disk or
+ * the network file system */
+#define WALKERS 8
+
+struct media_file
+{
+    char         *psz_name;
+    input_item_t *p_item; /* NULL until added to the services discovery */
+};
+
+/* A scanned directory, as saved in the snapshot */
+struct media_dir
+{
+    char              *psz_path;
+    int64_t            i_mtime;
+    dev_t              i_dev;
+    ino_t              i_ino;
+    int                i_watch; /* inotify watch descriptor, or -1 */
+    bool               b_reused;
+
+    int                i_files;
+    struct media_file *p_files;
+    int                i_subdirs;
+    char             **ppsz_subdirs;
+};
+
+struct scan_job
+{
+    struct scan_job *p_next;
+    char            *psz_path;
+};
+
 struct services_discovery_sys_t
 {
     vlc_thread_t thread;
@@ -111,6 +150,32 @@ struct services_discovery_sys_t
 
     char* psz_dir[2];
     const char* psz_var;
+
+    char *psz_ignored; /* comma-separated ignored file extensions */
+    bool  b_hidden;
+
+    /* Directory walkers */
+    vlc_mutex_t      lock;
+    vlc_cond_t       wait;
+    struct scan_job *p_jobs; /* directories waiting to be scanned */
+    unsigned         i_busy; /* walkers scanning a directory */
+    bool             b_stop;
+    unsigned         i_scanned;
+    unsigned         i_reused;
+
+    /* Directories, by path: from the last run, and current ones */
+    vlc_dictionary_t old_dirs;
+    vlc_dictionary_t dirs;
+    vlc_dictionary_t inodes; /* device:inode of the scanned directories */
+    char            *psz_snapshot;
+    bool             b_scanned;
+    bool             b_dirty;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    int              i_inotify;
+    vlc_dictionary_t watches; /* watch descriptor -> directory */
+    bool             b_watch_failed;
+#endif
 };
 
 /*****************************************************************************
@@ -120,6 +185,7 @@ static int Open( vlc_object_t *p_this, enum type_e i_type )
 {
     services_discovery_t *p_sd = ( services_discovery_t* )p_this;
     services_discovery_sys_t *p_sys;
+    const char *psz_name;
 
     p_sd->p_sys = p_sys = calloc( 1, sizeof( *p_sys) );
     if( !p_sys )
@@ -130,23 +196,29 @@ static int Open( vlc_object_t *p_this, enum type_e i_type )
     if( p_sys->i_type == Video )
     {
         p_sys->psz_dir[0] = config_GetUserDir( VLC_VIDEOS_DIR );
-        p_sys->psz_dir[1] = var_CreateGetString( p_sd, "input-record-path" );
+        p_sys->psz_dir[1] =
+            var_CreateGetNonEmptyString( p_sd, "input-record-path" );
 
         p_sys->psz_var = "record-file";
+        psz_name = "video";
     }
     else if( p_sys->i_type == Audio )
     {
         p_sys->psz_dir[0] = config_GetUserDir( VLC_MUSIC_DIR );
-        p_sys->psz_dir[1] = var_CreateGetString( p_sd, "input-record-path" );
+        p_sys->psz_dir[1] =
+            var_CreateGetNonEmptyString( p_sd, "input-record-path" );
 
         p_sys->psz_var = "record-file";
+        psz_name = "audio";
     }
     else if( p_sys->i_type == Picture )
     {
         p_sys->psz_dir[0] = config_GetUserDir( VLC_PICTURES_DIR );
-        p_sys->psz_dir[1] = var_CreateGetString( p_sd, "snapshot-path" );
+        p_sys->psz_dir[1] =
+            var_CreateGetNonEmptyString( p_sd, "snapshot-path" );
 
         p_sys->psz_var = "snapshot-file";
+        psz_name = "picture";
     }
     else
     {
@@ -154,11 +226,42 @@ static int Open( vlc_object_t *p_this, enum type_e i_type )
         return VLC_EGENERIC;
     }
 
+    if( p_sys->i_type == Picture )
+        p_sys->psz_ignored = strdup( "ini,db,lnk,txt" );
+    else
+        p_sys->psz_ignored = var_InheritString( p_sd, "ignore-filetypes" );
+    p_sys->b_hidden = var_InheritBool( p_sd, "show-hiddenfiles" );
+
+    char *psz_cache = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_cache == NULL
+     || asprintf( &p_sys->psz_snapshot, "%s"DIR_SEP"mediadirs-%s.txt",
+                  psz_cache, psz_name ) == -1 )
+        p_sys->psz_snapshot = NULL;
+    free( psz_cache );
+
+    vlc_mutex_init( &p_sys->lock );
+    vlc_cond_init( &p_sys->wait );
+    vlc_dictionary_init( &p_sys->old_dirs, 0 );
+    vlc_dictionary_init( &p_sys->dirs, 0 );
+    vlc_dictionary_init( &p_sys->inodes, 0 );
+#ifdef HAVE_SYS_INOTIFY_H
+    p_sys->i_inotify = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+    vlc_dictionary_init( &p_sys->watches, 0 );
+#endif
+
     var_AddCallback( p_sd->p_libvlc, p_sys->psz_var, onNewFileAdded, p_sd );
 
     if( vlc_clone( &p_sys->thread, Run, p_sd, VLC_THREAD_PRIORITY_LOW ) )
     {
         var_DelCallback( p_sd->p_libvlc, p_sys->psz_var, onNewFileAdded, p_sd );
+#ifdef HAVE_SYS_INOTIFY_H
+        if( p_sys->i_inotify != -1 )
+            close( p_sys->i_inotify );
+#endif
+        vlc_cond_destroy( &p_sys->wait );
+        vlc_mutex_destroy( &p_sys->lock );
+        free( p_sys->psz_snapshot );
+        free( p_sys->psz_ignored );
         free( p_sys->psz_dir[1] );
         free( p_sys->psz_dir[0] );
         free( p_sys );
@@ -169,52 +272,810 @@ static int Open( vlc_object_t *p_this, enum type_e i_type )
 }
 
 /*****************************************************************************
- * Run:
+ * Directories
  *****************************************************************************/
-static void *Run( void *data )
+static struct media_dir *media_dir_New( const char *psz_path, int64_t i_mtime )
+{
+    struct media_dir *p_dir = calloc( 1, sizeof( *p_dir ) );
+    if( unlikely(p_dir == NULL) )
+        return NULL;
+
+    p_dir->psz_path = strdup( psz_path );
+    if( unlikely(p_dir->psz_path == NULL) )
+    {
+        free( p_dir );
+        return NULL;
+    }
+    p_dir->i_mtime = i_mtime;
+    p_dir->i_watch = -1;
+    return p_dir;
+}
+
+static void media_dir_Clean( struct media_dir *p_dir )
+{
+    for( int i = 0; i < p_dir->i_files; i++ )
+    {
+        free( p_dir->p_files[i].psz_name );
+        if( p_dir->p_files[i].p_item != NULL )
+            vlc_gc_decref( p_dir->p_files[i].p_item );
+    }
+    free( p_dir->p_files );
+    for( int i = 0; i < p_dir->i_subdirs; i++ )
+        free( p_dir->ppsz_subdirs[i] );
+    free( p_dir->ppsz_subdirs );
+    p_dir->i_files = p_dir->i_subdirs = 0;
+    p_dir->p_files = NULL;
+    p_dir->ppsz_subdirs = NULL;
+}
+
+static void media_dir_Delete( void *p_data, void *p_obj )
+{
+    struct media_dir *p_dir = p_data;
+
+    (void) p_obj;
+    media_dir_Clean( p_dir );
+    free( p_dir->psz_path );
+    free( p_dir );
+}
+
+/* Deletes the directories of the last run not found again */
+static void media_dir_DeleteUnused( void *p_data, void *p_obj )
+{
+    struct media_dir *p_dir = p_data;
+
+    if( !p_dir->b_reused )
+        media_dir_Delete( p_dir, p_obj );
+}
+
+static int media_dir_AddFile( struct media_dir *p_dir, const char *psz_name )
+{
+    struct media_file *p_files = realloc( p_dir->p_files,
+                                          (p_dir->i_files + 1) * sizeof( *p_files ) );
+    if( unlikely(p_files == NULL) )
+        return VLC_ENOMEM;
+    p_dir->p_files = p_files;
+
+    char *psz_dup = strdup( psz_name );
+    if( unlikely(psz_dup == NULL) )
+        return VLC_ENOMEM;
+    p_files[p_dir->i_files].psz_name = psz_dup;
+    p_files[p_dir->i_files].p_item = NULL;
+    p_dir->i_files++;
+    return VLC_SUCCESS;
+}
+
+static int media_dir_AddSubdir( struct media_dir *p_dir, const char *psz_name )
+{
+    char *psz_dup = strdup( psz_name );
+    if( unlikely(psz_dup == NULL) )
+        return VLC_ENOMEM;
+    TAB_APPEND( p_dir->i_subdirs, p_dir->ppsz_subdirs, psz_dup );
+    return VLC_SUCCESS;
+}
+
+static struct media_file *media_dir_FindFile( const struct media_dir *p_dir,
+                                              const char *psz_name )
+{
+    for( int i = 0; i < p_dir->i_files; i++ )
+        if( !strcmp( p_dir->p_files[i].psz_name, psz_name ) )
+            return &p_dir->p_files[i];
+    return NULL;
+}
+
+static bool media_dir_HasSubdir( const struct media_dir *p_dir,
+                                 const char *psz_name )
+{
+    for( int i = 0; i < p_dir->i_subdirs; i++ )
+        if( !strcmp( p_dir->ppsz_subdirs[i], psz_name ) )
+            return true;
+    return false;
+}
+
+static char *JoinPath( const char *psz_dir, const char *psz_name )
+{
+    char *psz_path;
+
+    if( asprintf( &psz_path, "%s"DIR_SEP"%s", psz_dir, psz_name ) == -1 )
+        psz_path = NULL;
+    return psz_path;
+}
+
+static bool IsIgnored( services_discovery_sys_t *p_sys, const char *psz_name )
+{
+    const char *psz_ext = strrchr( psz_name, '.' );
+    if( psz_ext == NULL || p_sys->psz_ignored == NULL )
+        return false;
+    psz_ext++;
+
+    size_t i_len = strlen( psz_ext );
+    for( const char *p = p_sys->psz_ignored; *p; )
+    {
+        size_t n = strcspn( p, "," );
+        if( n == i_len && !strncasecmp( p, psz_ext, n ) )
+            return true;
+        p += n;
+        p += strspn( p, "," );
+    }
+    return false;
+}
+
+/* Lists the files and subdirectories of a directory */
+static void ReadDir( services_discovery_sys_t *p_sys, struct media_dir *p_dir )
+{
+    DIR *dir = vlc_opendir( p_dir->psz_path );
+    if( dir == NULL )
+        return;
+
+    const char *psz_entry;
+    while( (psz_entry = vlc_readdir( dir )) != NULL )
+    {
+        struct stat st;
+
+        if( !strcmp( psz_entry, "." ) || !strcmp( psz_entry, ".." )
+         || (!p_sys->b_hidden && psz_entry[0] == '.') )
+            continue;
+#ifdef HAVE_OPENAT
+        if( fstatat( dirfd( dir ), psz_entry, &st, 0 ) )
+            continue;
+#else
+        char *psz_path = JoinPath( p_dir->psz_path, psz_entry );
+        if( psz_path == NULL )
+            continue;
+        int i_ret = vlc_stat( psz_path, &st );
+        free( psz_path );
+        if( i_ret )
+            continue;
+#endif
+        if( S_ISDIR( st.st_mode ) )
+            media_dir_AddSubdir( p_dir, psz_entry );
+        else if( S_ISREG( st.st_mode ) && !IsIgnored( p_sys, psz_entry ) )
+            media_dir_AddFile( p_dir, psz_entry );
+    }
+    closedir( dir );
+}
+
+/* Path of a directory relative to its root, used as item category */
+static const char *Category( services_discovery_sys_t *p_sys,
+                             const char *psz_path )
+{
+    for( unsigned i = 0; i < ARRAY_SIZE(p_sys->psz_dir); i++ )
+    {
+        const char *psz_root = p_sys->psz_dir[i];
+        if( psz_root == NULL )
+            continue;
+
+        size_t i_len = strlen( psz_root );
+        if( !strncmp( psz_path, psz_root, i_len )
+         && psz_path[i_len] == DIR_SEP_CHAR )
+            return psz_path + i_len + 1;
+    }
+    return NULL;
+}
+
+static void AddFile( services_discovery_t *p_sd, const struct media_dir *p_dir,
+                     struct media_file *p_file )
+{
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    char *psz_path = JoinPath( p_dir->psz_path, p_file->psz_name );
+    if( psz_path == NULL )
+        return;
+
+    char *psz_uri = vlc_path2uri( psz_path, "file" );
+    free( psz_path );
+    if( psz_uri == NULL )
+        return;
+
+    p_file->p_item = input_item_NewWithType( psz_uri, p_file->psz_name, 0, NULL,
+                                             0, -1, ITEM_TYPE_FILE );
+    free( psz_uri );
+    if( p_file->p_item == NULL )
+        return;
+
+    if( p_sys->i_type == Picture )
+        formatSnapshotItem( p_file->p_item );
+    services_discovery_AddItem( p_sd, p_file->p_item,
+                                Category( p_sys, p_dir->psz_path ) );
+}
+
+static void RemoveFile( services_discovery_t *p_sd, struct media_file *p_file )
+{
+    if( p_file->p_item == NULL )
+        return;
+
+    services_discovery_RemoveItem( p_sd, p_file->p_item );
+    vlc_gc_decref( p_file->p_item );
+    p_file->p_item = NULL;
+}
+
+static void Watch( services_discovery_t *p_sd, struct media_dir *p_dir )
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    if( p_sys->i_inotify == -1 )
+        return;
+
+    int i_watch = inotify_add_watch( p_sys->i_inotify, p_dir->psz_path,
+                                     IN_CREATE | IN_DELETE | IN_MOVED_FROM
+                                   | IN_MOVED_TO | IN_ONLYDIR );
+    vlc_mutex_lock( &p_sys->lock );
+    if( i_watch == -1 )
+    {
+        if( !p_sys->b_watch_failed )
+            msg_Warn( p_sd, "cannot watch %s: %s", p_dir->psz_path,
+                      vlc_strerror_c( errno ) );
+        p_sys->b_watch_failed = true;
+    }
+    else
+    {
+        char psz_key[12];
+        snprintf( psz_key, sizeof( psz_key ), "%d", i_watch );
+        vlc_dictionary_insert( &p_sys->watches, psz_key, p_dir );
+        p_dir->i_watch = i_watch;
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+#else
+    VLC_UNUSED(p_sd); VLC_UNUSED(p_dir);
+#endif
+}
+
+static void Unwatch( services_discovery_t *p_sd, struct media_dir *p_dir )
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    if( p_dir->i_watch == -1 )
+        return;
+
+    char psz_key[12];
+    snprintf( psz_key, sizeof( psz_key ), "%d", p_dir->i_watch );
+    vlc_dictionary_remove_value_for_key( &p_sys->watches, psz_key, NULL, NULL );
+    inotify_rm_watch( p_sys->i_inotify, p_dir->i_watch );
+    p_dir->i_watch = -1;
+#else
+    VLC_UNUSED(p_sd); VLC_UNUSED(p_dir);
+#endif
+}
+
+static void InodeKey( char *psz_key, size_t i_size, dev_t i_dev, ino_t i_ino )
+{
+    snprintf( psz_key, i_size, "%ju:%ju", (uintmax_t)i_dev, (uintmax_t)i_ino );
+}
+
+/* Queues a directory for the walkers, the lock must be held */
+static void QueueDir( services_discovery_sys_t *p_sys, char *psz_path )
+{
+    struct scan_job *p_job = malloc( sizeof( *p_job ) );
+    if( unlikely(p_job == NULL) )
+    {
+        free( psz_path );
+        return;
+    }
+    p_job->psz_path = psz_path;
+    p_job->p_next = p_sys->p_jobs;
+    p_sys->p_jobs = p_job;
+    vlc_cond_signal( &p_sys->wait );
+}
+
+/* Scans a directory (unless it did not change since the last run), adds
+ * its files and queues its subdirectories */
+static void ScanDir( services_discovery_t *p_sd, const char *psz_path )
+{
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    struct stat st;
+    char psz_inode[48];
+
+    if( vlc_stat( psz_path, &st ) || !S_ISDIR( st.st_mode ) )
+        return;
+
+    /* Symbolic links may loop, or link to an already scanned directory */
+    InodeKey( psz_inode, sizeof( psz_inode ), st.st_dev, st.st_ino );
+    vlc_mutex_lock( &p_sys->lock );
+    bool b_seen = vlc_dictionary_value_for_key( &p_sys->inodes, psz_inode )
+                  != kVLCDictionaryNotFound;
+    if( !b_seen )
+        vlc_dictionary_insert( &p_sys->inodes, psz_inode, p_sys );
+    vlc_mutex_unlock( &p_sys->lock );
+    if( b_seen )
+        return;
+
+    struct media_dir *p_dir = vlc_dictionary_value_for_key( &p_sys->old_dirs,
+                                                            psz_path );
+    if( p_dir != NULL && p_dir->i_mtime == st.st_mtime )
+        p_dir->b_reused = true; /* no entry added, removed nor renamed */
+    else
+    {
+        p_dir = media_dir_New( psz_path, st.st_mtime );
+        if( unlikely(p_dir == NULL) )
+            return;
+        ReadDir( p_sys, p_dir );
+    }
+    p_dir->i_dev = st.st_dev;
+    p_dir->i_ino = st.st_ino;
+
+    vlc_mutex_lock( &p_sys->lock );
+    vlc_dictionary_insert( &p_sys->dirs, p_dir->psz_path, p_dir );
+    p_sys->i_scanned++;
+    if( p_dir->b_reused )
+        p_sys->i_reused++;
+    else
+        p_sys->b_dirty = true;
+    for( int i = 0; i < p_dir->i_subdirs; i++ )
+    {
+        char *psz_subdir = JoinPath( p_dir->psz_path, p_dir->ppsz_subdirs[i] );
+        if( likely(psz_subdir != NULL) )
+            QueueDir( p_sys, psz_subdir );
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    Watch( p_sd, p_dir );
+    for( int i = 0; i < p_dir->i_files; i++ )
+        AddFile( p_sd, p_dir, &p_dir->p_files[i] );
+}
+
+/* Removes a directory and its subdirectories, with their files */
+static void RemoveDir( services_discovery_t *p_sd, const char *psz_path )
+{
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    struct media_dir *p_dir = vlc_dictionary_value_for_key( &p_sys->dirs,
+                                                            psz_path );
+    if( p_dir == NULL )
+        return;
+
+    for( int i = 0; i < p_dir->i_subdirs; i++ )
+    {
+        char *psz_subdir = JoinPath( psz_path, p_dir->ppsz_subdirs[i] );
+        if( likely(psz_subdir != NULL) )
+        {
+            RemoveDir( p_sd, psz_subdir );
+            free( psz_subdir );
+        }
+    }
+    for( int i = 0; i < p_dir->i_files; i++ )
+        RemoveFile( p_sd, &p_dir->p_files[i] );
+    Unwatch( p_sd, p_dir );
+
+    char psz_inode[48];
+    InodeKey( psz_inode, sizeof( psz_inode ), p_dir->i_dev, p_dir->i_ino );
+    vlc_dictionary_remove_value_for_key( &p_sys->inodes, psz_inode, NULL, NULL );
+    vlc_dictionary_remove_value_for_key( &p_sys->dirs, psz_path,
+                                         media_dir_Delete, NULL );
+    p_sys->b_dirty = true;
+}
+
+/*****************************************************************************
+ * Walk: directory walker thread
+ *****************************************************************************/
+static void *Walk( void *data )
 {
     services_discovery_t *p_sd = data;
     services_discovery_sys_t *p_sys = p_sd->p_sys;
 
-    int canc = vlc_savecancel();
+    vlc_mutex_lock( &p_sys->lock );
+    for( ;; )
+    {
+        while( p_sys->p_jobs == NULL && p_sys->i_busy > 0 && !p_sys->b_stop )
+            vlc_cond_wait( &p_sys->wait, &p_sys->lock );
+        if( p_sys->p_jobs == NULL || p_sys->b_stop )
+            break;
+
+        struct scan_job *p_job = p_sys->p_jobs;
+        p_sys->p_jobs = p_job->p_next;
+        p_sys->i_busy++;
+        vlc_mutex_unlock( &p_sys->lock );
+
+        ScanDir( p_sd, p_job->psz_path );
+        free( p_job->psz_path );
+        free( p_job );
+
+        vlc_mutex_lock( &p_sys->lock );
+        p_sys->i_busy--;
+    }
+    /* Nothing left to scan: wake the other walkers up */
+    vlc_cond_broadcast( &p_sys->wait );
+    vlc_mutex_unlock( &p_sys->lock );
+    return NULL;
+}
 
-    int num_dir = sizeof( p_sys->psz_dir ) / sizeof( p_sys->psz_dir[0] );
-    for( int i = 0; i < num_dir; i++ )
+/*****************************************************************************
+ * Snapshot of the directories, to only read the modified ones on startup
+ *****************************************************************************/
+static void LoadSnapshot( services_discovery_t *p_sd )
+{
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    if( p_sys->psz_snapshot == NULL )
+        return;
+
+    FILE *file = vlc_fopen( p_sys->psz_snapshot, "rt" );
+    if( file == NULL )
+        return;
+
+    struct media_dir *p_dir = NULL;
+    char *psz_line = NULL;
+    size_t i_size = 0;
+    ssize_t i_len;
+    unsigned i_dirs = 0;
+
+    /* "d <mtime> <path>", then "f <name>" and "s <name>" lines for its
+     * files and subdirectories, all URI-encoded */
+    while( (i_len = getline( &psz_line, &i_size, file )) != -1 )
     {
-        char* psz_dir = p_sys->psz_dir[i];
+        if( i_len < 3 || psz_line[1] != ' ' )
+            continue;
+        if( psz_line[i_len - 1] == '\n' )
+            psz_line[i_len - 1] = '\0';
+
+        if( psz_line[0] == 'd' )
+        {
+            int64_t i_mtime;
+            int i_offset;
+            if( sscanf( psz_line + 2, "%"SCNd64" %n", &i_mtime, &i_offset ) < 1
+             || vlc_uri_decode( psz_line + 2 + i_offset ) == NULL )
+            {
+                p_dir = NULL;
+                continue;
+            }
+            p_dir = media_dir_New( psz_line + 2 + i_offset, i_mtime );
+            if( p_dir != NULL )
+            {
+                vlc_dictionary_insert( &p_sys->old_dirs, p_dir->psz_path, p_dir );
+                i_dirs++;
+            }
+        }
+        else if( p_dir != NULL && vlc_uri_decode( psz_line + 2 ) != NULL )
+        {
+            if( psz_line[0] == 'f' )
+                media_dir_AddFile( p_dir, psz_line + 2 );
+            else if( psz_line[0] == 's' )
+                media_dir_AddSubdir( p_dir, psz_line + 2 );
+        }
+    }
+    free( psz_line );
+    fclose( file );
+    msg_Dbg( p_sd, "loaded %u directories from %s", i_dirs,
+             p_sys->psz_snapshot );
+}
 
-        /* make sure the directory exists */
+static int WriteEncoded( FILE *file, char type, const char *psz_str )
+{
+    char *psz_encoded = vlc_uri_encode( psz_str );
+    if( unlikely(psz_encoded == NULL) )
+        return -1;
+
+    int i_ret = fprintf( file, "%c %s\n", type, psz_encoded );
+    free( psz_encoded );
+    return i_ret;
+}
+
+static void SaveSnapshot( services_discovery_t *p_sd )
+{
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    if( p_sys->psz_snapshot == NULL )
+        return;
+
+    char *psz_cache = config_GetUserDir( VLC_CACHE_DIR );
+    if( psz_cache != NULL )
+        vlc_mkdir( psz_cache, 0700 );
+    free( psz_cache );
+
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.tmp", p_sys->psz_snapshot ) == -1 )
+        return;
+
+    FILE *file = vlc_fopen( psz_tmp, "wt" );
+    if( file == NULL )
+    {
+        msg_Warn( p_sd, "cannot write %s: %s", psz_tmp,
+                  vlc_strerror_c( errno ) );
+        free( psz_tmp );
+        return;
+    }
+
+    bool b_error = false;
+    for( int i = 0; i < p_sys->dirs.i_size && !b_error; i++ )
+        for( vlc_dictionary_entry_t *p_entry = p_sys->dirs.p_entries[i];
+             p_entry != NULL && !b_error; p_entry = p_entry->p_next )
+        {
+            const struct media_dir *p_dir = p_entry->p_value;
+            char *psz_path = vlc_uri_encode( p_dir->psz_path );
+
+            b_error = psz_path == NULL
+                   || fprintf( file, "d %"PRId64" %s\n", p_dir->i_mtime,
+                               psz_path ) < 0;
+            free( psz_path );
+            for( int j = 0; j < p_dir->i_files && !b_error; j++ )
+                b_error = WriteEncoded( file, 'f',
+                                        p_dir->p_files[j].psz_name ) < 0;
+            for( int j = 0; j < p_dir->i_subdirs && !b_error; j++ )
+                b_error = WriteEncoded( file, 's',
+                                        p_dir->ppsz_subdirs[j] ) < 0;
+        }
+
+    if( fclose( file ) )
+        b_error = true;
+    if( b_error || vlc_rename( psz_tmp, p_sys->psz_snapshot ) )
+    {
+        msg_Warn( p_sd, "cannot save %s", p_sys->psz_snapshot );
+        vlc_unlink( psz_tmp );
+    }
+    else
+        p_sys->b_dirty = false;
+    free( psz_tmp );
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+/*****************************************************************************
+ * Live updates
+ *****************************************************************************/
+struct dir_change
+{
+    char             *psz_path;
+    struct media_dir *p_new; /* current content */
+};
+
+/* Updates the changed directories: removals first, so that a directory
+ * moved within the tree is found again at its new location. */
+static void Update( services_discovery_t *p_sd, struct dir_change *p_changes,
+                    int i_changes )
+{
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+
+    for( int i = 0; i < i_changes; i++ )
+    {
+        struct media_dir *p_dir = vlc_dictionary_value_for_key( &p_sys->dirs,
+                                                    p_changes[i].psz_path );
         struct stat st;
-        if( psz_dir == NULL            ||
-            vlc_stat( psz_dir, &st )  ||
-            !S_ISDIR( st.st_mode ) )
+
+        if( p_dir == NULL || vlc_stat( p_dir->psz_path, &st ) )
+            continue; /* removed along with its parent */
+
+        struct media_dir *p_new = media_dir_New( p_dir->psz_path, st.st_mtime );
+        if( unlikely(p_new == NULL) )
             continue;
+        ReadDir( p_sys, p_new );
+
+        for( int j = 0; j < p_dir->i_files; j++ )
+            if( media_dir_FindFile( p_new, p_dir->p_files[j].psz_name ) == NULL )
+                RemoveFile( p_sd, &p_dir->p_files[j] );
+        for( int j = 0; j < p_dir->i_subdirs; j++ )
+            if( !media_dir_HasSubdir( p_new, p_dir->ppsz_subdirs[j] ) )
+            {
+                char *psz_subdir = JoinPath( p_dir->psz_path,
+                                             p_dir->ppsz_subdirs[j] );
+                if( likely(psz_subdir != NULL) )
+                {
+                    RemoveDir( p_sd, psz_subdir );
+                    free( psz_subdir );
+                }
+            }
+        p_changes[i].p_new = p_new;
+    }
 
-        char* psz_uri = vlc_path2uri( psz_dir, "file" );
+    for( int i = 0; i < i_changes; i++ )
+    {
+        struct media_dir *p_new = p_changes[i].p_new;
+        if( p_new == NULL )
+            continue;
+
+        struct media_dir *p_dir = vlc_dictionary_value_for_key( &p_sys->dirs,
+                                                    p_changes[i].psz_path );
+        if( p_dir == NULL )
+        {
+            media_dir_Delete( p_new, NULL );
+            continue;
+        }
+
+        for( int j = 0; j < p_new->i_files; j++ )
+        {
+            struct media_file *p_file = &p_new->p_files[j];
+            struct media_file *p_old = media_dir_FindFile( p_dir,
+                                                           p_file->psz_name );
+            if( p_old != NULL && p_old->p_item != NULL )
+            {
+                p_file->p_item = p_old->p_item;
+                p_old->p_item = NULL;
+            }
+            else
+                AddFile( p_sd, p_dir, p_file );
+        }
+        for( int j = 0; j < p_new->i_subdirs; j++ )
+            if( !media_dir_HasSubdir( p_dir, p_new->ppsz_subdirs[j] ) )
+            {
+                char *psz_subdir = JoinPath( p_dir->psz_path,
+                                             p_new->ppsz_subdirs[j] );
+                if( likely(psz_subdir != NULL) )
+                {
+                    vlc_mutex_lock( &p_sys->lock );
+                    QueueDir( p_sys, psz_subdir );
+                    vlc_mutex_unlock( &p_sys->lock );
+                }
+            }
+
+        /* Swap the contents, the dictionaries point to p_dir */
+        media_dir_Clean( p_dir );
+        p_dir->i_mtime = p_new->i_mtime;
+        p_dir->i_files = p_new->i_files;
+        p_dir->p_files = p_new->p_files;
+        p_dir->i_subdirs = p_new->i_subdirs;
+        p_dir->ppsz_subdirs = p_new->ppsz_subdirs;
+        p_new->i_files = p_new->i_subdirs = 0;
+        p_new->p_files = NULL;
+        p_new->ppsz_subdirs = NULL;
+        media_dir_Delete( p_new, NULL );
+        p_sys->b_dirty = true;
+    }
+
+    /* Scan the new subdirectories from this thread */
+    Walk( p_sd );
+}
+
+/* Directories changed since the last update */
+struct dir_changes
+{
+    struct dir_change *p_changes;
+    int                i_changes;
+    bool               b_overflow; /* some events were lost */
+};
+
+static void AddChange( struct dir_changes *p_changes, const char *psz_path )
+{
+    for( int i = 0; i < p_changes->i_changes; i++ )
+        if( !strcmp( p_changes->p_changes[i].psz_path, psz_path ) )
+            return;
+
+    struct dir_change change = { strdup( psz_path ), NULL };
+    if( likely(change.psz_path != NULL) )
+        TAB_APPEND( p_changes->i_changes, p_changes->p_changes, change );
+}
+
+static void CleanChanges( void *data )
+{
+    struct dir_changes *p_changes = data;
+
+    for( int i = 0; i < p_changes->i_changes; i++ )
+        free( p_changes->p_changes[i].psz_path );
+    free( p_changes->p_changes );
+}
+
+static void ReadEvents( services_discovery_t *p_sd,
+                        struct dir_changes *p_changes )
+{
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t i_len;
+
+    while( (i_len = read( p_sys->i_inotify, buf, sizeof( buf ) )) > 0 )
+    {
+        for( char *p = buf; p < buf + i_len; )
+        {
+            const struct inotify_event *p_event = (void *)p;
+            char psz_key[12];
+
+            p += sizeof( *p_event ) + p_event->len;
+            if( p_event->mask & IN_Q_OVERFLOW )
+            {
+                p_changes->b_overflow = true;
+                continue;
+            }
+
+            snprintf( psz_key, sizeof( psz_key ), "%d", p_event->wd );
+            const struct media_dir *p_dir =
+                vlc_dictionary_value_for_key( &p_sys->watches, psz_key );
+            if( p_dir != NULL )
+                AddChange( p_changes, p_dir->psz_path );
+        }
+    }
+}
+
+static void Monitor( services_discovery_t *p_sd )
+{
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
+    struct pollfd ufd = { .fd = p_sys->i_inotify, .events = POLLIN };
+
+    for( ;; )
+    {
+        struct dir_changes changes = { NULL, 0, false };
+
+        if( poll( &ufd, 1, -1 ) <= 0 )
+            continue;
 
-        input_item_t* p_root = input_item_New( psz_uri, NULL );
-        if( p_sys->i_type == Picture )
-            input_item_AddOption( p_root, "ignore-filetypes=ini,db,lnk,txt",
-                                  VLC_INPUT_OPTION_TRUSTED );
+        /* Let a burst of changes (e.g. a copy) settle, reading the events
+         * as they come so that the queue does not overflow */
+        const mtime_t i_deadline = mdate() + CLOCK_FREQ / 2;
+        mtime_t i_left;
 
-        input_item_AddOption( p_root, "recursive=collapse",
-                              VLC_INPUT_OPTION_TRUSTED );
+        vlc_cleanup_push( CleanChanges, &changes );
+        do
+        {
+            int canc = vlc_savecancel();
+            ReadEvents( p_sd, &changes );
+            vlc_restorecancel( canc );
 
+            i_left = i_deadline - mdate();
+            if( i_left > 0 )
+                poll( &ufd, 1, (i_left + 999) / 1000 );
+        }
+        while( i_left > 0 );
+        vlc_cleanup_pop();
 
-        vlc_event_manager_t *p_em = &p_root->event_manager;
-        vlc_event_attach( p_em, vlc_InputItemSubItemAdded,
-                          input_item_subitem_added, p_sd );
+        int canc = vlc_savecancel();
+        /* Events were lost: any directory may have changed */
+        if( changes.b_overflow )
+        {
+            msg_Warn( p_sd, "too many changes, rescanning" );
+            for( int i = 0; i < p_sys->dirs.i_size; i++ )
+                for( vlc_dictionary_entry_t *p_entry = p_sys->dirs.p_entries[i];
+                     p_entry != NULL; p_entry = p_entry->p_next )
+                    AddChange( &changes, p_entry->psz_key );
+        }
 
-        input_Read( p_sd, p_root );
+        Update( p_sd, changes.p_changes, changes.i_changes );
+        CleanChanges( &changes );
+        vlc_restorecancel( canc );
+    }
+}
+#endif
 
-        vlc_event_detach( p_em, vlc_InputItemSubItemAdded,
-                          input_item_subitem_added, p_sd );
+/*****************************************************************************
+ * Run:
+ *****************************************************************************/
+static void *Run( void *data )
+{
+    services_discovery_t *p_sd = data;
+    services_discovery_sys_t *p_sys = p_sd->p_sys;
 
-        vlc_gc_decref( p_root );
-        free( psz_uri );
+    int canc = vlc_savecancel();
+    mtime_t i_start = mdate();
+
+    LoadSnapshot( p_sd );
+    vlc_mutex_lock( &p_sys->lock );
+    for( unsigned i = 0; i < ARRAY_SIZE(p_sys->psz_dir); i++ )
+    {
+        char *psz_dir = p_sys->psz_dir[i] ? strdup( p_sys->psz_dir[i] ) : NULL;
+        if( psz_dir != NULL )
+            QueueDir( p_sys, psz_dir );
     }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    vlc_thread_t walkers[WALKERS];
+    unsigned i_walkers = 0;
+    while( i_walkers < WALKERS
+        && !vlc_clone( &walkers[i_walkers], Walk, p_sd,
+                       VLC_THREAD_PRIORITY_LOW ) )
+        i_walkers++;
+    if( i_walkers == 0 )
+        Walk( p_sd );
+    for( unsigned i = 0; i < i_walkers; i++ )
+        vlc_join( walkers[i], NULL );
+
+    /* Only left if the scan was interrupted */
+    while( p_sys->p_jobs != NULL )
+    {
+        struct scan_job *p_job = p_sys->p_jobs;
+        p_sys->p_jobs = p_job->p_next;
+        free( p_job->psz_path );
+        free( p_job );
+    }
+    vlc_dictionary_clear( &p_sys->old_dirs, media_dir_DeleteUnused, NULL );
+
+    vlc_mutex_lock( &p_sys->lock );
+    bool b_stop = p_sys->b_stop;
+    vlc_mutex_unlock( &p_sys->lock );
+
+    if( !b_stop )
+    {
+        msg_Dbg( p_sd, "scanned %u directories (%u unchanged) in %"PRId64" ms",
+                 p_sys->i_scanned, p_sys->i_reused,
+                 (mdate() - i_start) / 1000 );
+        p_sys->b_scanned = true;
+        if( p_sys->b_dirty )
+            SaveSnapshot( p_sd );
+    }
+    vlc_restorecancel( canc );
 
-    vlc_restorecancel(canc);
+#ifdef HAVE_SYS_INOTIFY_H
+    /* Close() cancels the monitor if it stops after this point */
+    if( p_sys->i_inotify != -1 && !b_stop )
+        Monitor( p_sd );
+#endif
     return NULL;
 }
 
@@ -226,11 +1087,31 @@ static void Close( vlc_object_t *p_this )
     services_discovery_t *p_sd = (services_discovery_t *)p_this;
     services_discovery_sys_t *p_sys = p_sd->p_sys;
 
+    vlc_mutex_lock( &p_sys->lock );
+    p_sys->b_stop = true;
+    vlc_cond_broadcast( &p_sys->wait );
+    vlc_mutex_unlock( &p_sys->lock );
+
     vlc_cancel( p_sys->thread );
     vlc_join( p_sys->thread, NULL );
 
     var_DelCallback( p_sd->p_libvlc, p_sys->psz_var, onNewFileAdded, p_sd );
 
+    /* Keep the changes seen while monitoring for the next run */
+    if( p_sys->b_scanned && p_sys->b_dirty )
+        SaveSnapshot( p_sd );
+
+    vlc_dictionary_clear( &p_sys->dirs, media_dir_Delete, NULL );
+    vlc_dictionary_clear( &p_sys->inodes, NULL, NULL );
+#ifdef HAVE_SYS_INOTIFY_H
+    vlc_dictionary_clear( &p_sys->watches, NULL, NULL );
+    if( p_sys->i_inotify != -1 )
+        close( p_sys->i_inotify );
+#endif
+    vlc_cond_destroy( &p_sys->wait );
+    vlc_mutex_destroy( &p_sys->lock );
+    free( p_sys->psz_snapshot );
+    free( p_sys->psz_ignored );
     free( p_sys->psz_dir[1] );
     free( p_sys->psz_dir[0] );
     free( p_sys );
@@ -240,21 +1121,6 @@ static void Close( vlc_object_t *p_this )
 /*****************************************************************************
  * Callbacks and helper functions
  *****************************************************************************/
-static void input_item_subitem_added( const vlc_event_t * p_event,
-                                      void * user_data )
-{
-    services_discovery_t *p_sd = user_data;
-    services_discovery_sys_t *p_sys = p_sd->p_sys;
-
-    /* retrieve new item */
-    input_item_t *p_item = p_event->u.input_item_subitem_added.p_new_child;
-
-    if( p_sys->i_type == Picture )
-        formatSnapshotItem( p_item );
-
-    services_discovery_AddItem( p_sd, p_item, NULL );
-}
-
 static int onNewFileAdded( vlc_object_t *p_this, char const *psz_var,
                      vlc_value_t oldval, vlc_value_t newval, void *p_data )
 {
@@ -267,6 +1133,10 @@ static int onNewFileAdded( vlc_object_t *p_this, char const *psz_var,
     char* psz_file = newval.psz_string;
     if( !psz_file || !*psz_file )
         return VLC_EGENERIC;
+#ifdef HAVE_SYS_INOTIFY_H
+    if( p_sys->i_inotify != -1 )
+        return VLC_SUCCESS; /* the directories are monitored */
+#endif
 
     char* psz_uri = vlc_path2uri( psz_file, "file" );
     input_item_t* p_item = input_item_New( psz_uri, NULL );
@@ -388,6 +388,7 @@ struct sout_stream_id_sys_t
     } listen;
 
     block_fifo_t     *p_fifo;
+    sout_pacer_t     *p_pacer;
     int64_t           i_caching;
 };
 
@@ -1187,8 +1188,16 @@ static sout_stream_id_sys_t *Add( sout_stream_t *p_stream,
     id->p_fifo = block_FifoNew();
     if( unlikely(id->p_fifo == NULL) )
         goto error;
+    id->p_pacer = sout_PacerNew( p_stream, id->i_caching );
+    if( unlikely(id->p_pacer == NULL) )
+    {
+        block_FifoRelease( id->p_fifo );
+        id->p_fifo = NULL;
+        goto error;
+    }
     if( vlc_clone( &id->thread, ThreadSend, id, VLC_THREAD_PRIORITY_HIGHEST ) )
     {
+        sout_PacerDelete( id->p_pacer );
         block_FifoRelease( id->p_fifo );
         id->p_fifo = NULL;
         goto error;
@@ -1231,6 +1240,7 @@ static void Del( sout_stream_t *p_stream, sout_stream_id_sys_t *id )
     {
         vlc_cancel( id->thread );
         vlc_join( id->thread, NULL );
+        sout_PacerDelete( id->p_pacer );
         block_FifoRelease( id->p_fifo );
     }
 
@@ -1402,11 +1412,12 @@ static void* ThreadSend( void *data )
 # define EWOULDBLOCK  WSAEWOULDBLOCK
 #endif
     sout_stream_id_sys_t *id = data;
-    unsigned i_caching = id->i_caching;
 
     for (;;)
     {
         block_t *out = block_FifoGet( id->p_fifo );
+        mtime_t i_date = sout_PacerSchedule( id->p_pacer, out->i_dts,
+                                             out->i_buffer );
         block_cleanup_push (out);
 
 #ifdef HAVE_SRTP
@@ -1430,12 +1441,12 @@ static void* ThreadSend( void *data )
                 out->i_buffer = len;
         }
         if (out)
-            mwait (out->i_dts + i_caching);
+            mwait (i_date);
         vlc_cleanup_pop ();
         if (out == NULL)
             continue;
 #else
-        mwait (out->i_dts + i_caching);
+        mwait (i_date);
         vlc_cleanup_pop ();
 #endif
 
@@ -1471,6 +1482,7 @@ static void* ThreadSend( void *data )
         id->i_seq_sent_next = ntohs(((uint16_t *) out->p_buffer)[1]) + 1;
         vlc_mutex_unlock( &id->lock_sink );
         block_Release( out );
+        sout_PacerSent( id->p_pacer, i_date, mdate() );
 
         for( unsigned i = 0; i < deadc; i++ )
         {
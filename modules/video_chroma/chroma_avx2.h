@@ -0,0 +1,445 @@
+/*****************************************************************************
+ * chroma_avx2.h: AVX2 YUV to RGB and packed/planar YUV row conversions
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLC_CHROMA_AVX2_H
+#define VLC_CHROMA_AVX2_H 1
+
+#include <string.h>
+
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+
+/* The YUV to RGB conversion uses the same BT.601 fixed point arithmetic as
+ * the SSE2 i420_rgb module: samples are promoted to 11 bits (8 times the
+ * 8-bits value), then multiplied with pmulhw-like truncation. */
+#define YUV_RGB_Y       0x253f
+#define YUV_RGB_V_R     0x3312
+#define YUV_RGB_U_G     (-0x0c83)
+#define YUV_RGB_V_G     (-0x1a04)
+#define YUV_RGB_U_B     0x4093
+
+/* Layout of an RGB pixel */
+typedef struct
+{
+    bool     b_rgb32; /* 32 bits, else 16 bits */
+    unsigned r_shift, g_shift, b_shift; /* position of the lowest bit */
+    unsigned r_bits, g_bits, b_bits; /* significant bits (16 bits pixels) */
+} rgb_layout_t;
+
+/* Fills the layout from the RGB masks, returns false if not supported */
+static inline bool rgb_layout_Init( rgb_layout_t *p_layout, bool b_rgb32,
+                                    uint32_t i_rmask, uint32_t i_gmask,
+                                    uint32_t i_bmask )
+{
+    const uint32_t masks[3] = { i_rmask, i_gmask, i_bmask };
+    unsigned shifts[3], bits[3];
+
+    for( unsigned i = 0; i < 3; i++ )
+    {
+        if( masks[i] == 0 )
+            return false;
+        shifts[i] = ctz( masks[i] );
+        bits[i] = popcount( masks[i] );
+        /* Contiguous, and byte-aligned for 32 bits pixels */
+        if( (masks[i] >> shifts[i]) != (1u << bits[i]) - 1 || bits[i] > 8
+         || (b_rgb32 && (bits[i] != 8 || shifts[i] % 8))
+         || (!b_rgb32 && shifts[i] + bits[i] > 16) )
+            return false;
+    }
+
+    p_layout->b_rgb32 = b_rgb32;
+    p_layout->r_shift = shifts[0];
+    p_layout->g_shift = shifts[1];
+    p_layout->b_shift = shifts[2];
+    p_layout->r_bits = bits[0];
+    p_layout->g_bits = bits[1];
+    p_layout->b_bits = bits[2];
+    return true;
+}
+
+static inline int yuv_rgb_clip( int v )
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/* Converts one pixel from promoted samples */
+static inline void yuv_rgb_pixel( uint8_t *dst, unsigned i_x, int y, int cb,
+                                  int cr, const rgb_layout_t *p_layout )
+{
+    if( y < 0 )
+        y = 0;
+    y = (y * YUV_RGB_Y) >> 16;
+
+    unsigned r = yuv_rgb_clip( y + ((cr * YUV_RGB_V_R) >> 16) );
+    unsigned g = yuv_rgb_clip( y + ((cb * YUV_RGB_U_G) >> 16)
+                                 + ((cr * YUV_RGB_V_G) >> 16) );
+    unsigned b = yuv_rgb_clip( y + ((cb * YUV_RGB_U_B) >> 16) );
+
+    if( p_layout->b_rgb32 )
+    {
+        uint32_t px = (r << p_layout->r_shift) | (g << p_layout->g_shift)
+                    | (b << p_layout->b_shift);
+        memcpy( &dst[4 * i_x], &px, 4 );
+    }
+    else
+    {
+        uint16_t px = ((r >> (8 - p_layout->r_bits)) << p_layout->r_shift)
+                    | ((g >> (8 - p_layout->g_bits)) << p_layout->g_shift)
+                    | ((b >> (8 - p_layout->b_bits)) << p_layout->b_shift);
+        memcpy( &dst[2 * i_x], &px, 2 );
+    }
+}
+
+/**
+ * Converts a row of 8-bits 4:2:0 or 4:2:2 YUV to RGB, from pixel i_x.
+ * The chroma samples are i_step bytes apart: 1 for planar chroma, 2 for
+ * semi-planar (NV12, NV21) chroma.
+ */
+static inline void YuvRgbRow_C( uint8_t *dst, const uint8_t *y,
+                                const uint8_t *u, const uint8_t *v,
+                                unsigned i_step, unsigned i_x, unsigned width,
+                                const rgb_layout_t *p_layout )
+{
+    for( ; i_x < width; i_x++ )
+    {
+        unsigned c = i_step * (i_x / 2);
+        yuv_rgb_pixel( dst, i_x, (y[i_x] << 3) - 128, (u[c] << 3) - 1024,
+                       (v[c] << 3) - 1024, p_layout );
+    }
+}
+
+/* Same as YuvRgbRow_C() for planar 10-bits samples */
+static inline void Yuv10RgbRow_C( uint8_t *dst, const uint16_t *y,
+                                  const uint16_t *u, const uint16_t *v,
+                                  unsigned i_x, unsigned width,
+                                  const rgb_layout_t *p_layout )
+{
+    for( ; i_x < width; i_x++ )
+        yuv_rgb_pixel( dst, i_x, (y[i_x] << 1) - 128, (u[i_x / 2] << 1) - 1024,
+                       (v[i_x / 2] << 1) - 1024, p_layout );
+}
+
+/**
+ * Packs a row of planar YUV 4:2:2 (or a line of 4:2:0) to YUYV, or to
+ * UYVY if b_uyvy is set. YVYU and VYUY are obtained by swapping u and v.
+ */
+static inline void PlanarToPackedRow_C( uint8_t *dst, const uint8_t *y,
+                                        const uint8_t *u, const uint8_t *v,
+                                        unsigned i_x, unsigned width,
+                                        bool b_uyvy )
+{
+    const unsigned l = b_uyvy ? 1 : 0, c = 1 - l;
+
+    for( ; i_x < width; i_x++ )
+    {
+        dst[2 * i_x + l] = y[i_x];
+        dst[2 * i_x + c] = (i_x & 1) ? v[i_x / 2] : u[i_x / 2];
+    }
+}
+
+/**
+ * Unpacks a row of YUYV (or UYVY if b_uyvy is set) to planar YUV.
+ * The chroma is only written if u and v are not NULL.
+ */
+static inline void PackedToPlanarRow_C( uint8_t *y, uint8_t *u, uint8_t *v,
+                                        const uint8_t *src, unsigned i_x,
+                                        unsigned width, bool b_uyvy )
+{
+    const unsigned l = b_uyvy ? 1 : 0, c = 1 - l;
+
+    for( ; i_x < width; i_x++ )
+    {
+        y[i_x] = src[2 * i_x + l];
+        if( u != NULL )
+        {
+            if( i_x & 1 )
+                v[i_x / 2] = src[2 * i_x + c];
+            else
+                u[i_x / 2] = src[2 * i_x + c];
+        }
+    }
+}
+
+#ifdef HAVE_AVX2_INTRINSICS
+/*****************************************************************************
+ * AVX2
+ *****************************************************************************/
+# define VLC_AVX2 __attribute__ ((__target__ ("avx2")))
+
+/* Converts 16 pixels from promoted samples (16-bits lanes), and stores them */
+VLC_AVX2
+static inline void yuv_rgb_store16( uint8_t *dst, __m256i y, __m256i cb,
+                                    __m256i cr, const rgb_layout_t *p_layout,
+                                    const __m128i *counts )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi16( 255 );
+
+    y = _mm256_mulhi_epi16( _mm256_max_epi16( y, zero ),
+                            _mm256_set1_epi16( YUV_RGB_Y ) );
+
+    __m256i r = _mm256_add_epi16( y, _mm256_mulhi_epi16( cr,
+                                    _mm256_set1_epi16( YUV_RGB_V_R ) ) );
+    __m256i g = _mm256_add_epi16( y, _mm256_add_epi16(
+                    _mm256_mulhi_epi16( cb, _mm256_set1_epi16( YUV_RGB_U_G ) ),
+                    _mm256_mulhi_epi16( cr, _mm256_set1_epi16( YUV_RGB_V_G ) ) ) );
+    __m256i b = _mm256_add_epi16( y, _mm256_mulhi_epi16( cb,
+                                    _mm256_set1_epi16( YUV_RGB_U_B ) ) );
+
+    r = _mm256_min_epi16( _mm256_max_epi16( r, zero ), max );
+    g = _mm256_min_epi16( _mm256_max_epi16( g, zero ), max );
+    b = _mm256_min_epi16( _mm256_max_epi16( b, zero ), max );
+
+    if( p_layout->b_rgb32 )
+    {
+        /* Low and high halves of the pixels: a shift by 16 or more
+         * clears the components of the other half */
+        __m256i lo = _mm256_or_si256( _mm256_sll_epi16( r, counts[0] ),
+                     _mm256_or_si256( _mm256_sll_epi16( g, counts[1] ),
+                                      _mm256_sll_epi16( b, counts[2] ) ) );
+        __m256i hi = _mm256_or_si256( _mm256_sll_epi16( r, counts[3] ),
+                     _mm256_or_si256( _mm256_sll_epi16( g, counts[4] ),
+                                      _mm256_sll_epi16( b, counts[5] ) ) );
+        __m256i p0 = _mm256_unpacklo_epi16( lo, hi ); /* 0-3, 8-11 */
+        __m256i p1 = _mm256_unpackhi_epi16( lo, hi ); /* 4-7, 12-15 */
+
+        _mm256_storeu_si256( (__m256i *)dst,
+                             _mm256_permute2x128_si256( p0, p1, 0x20 ) );
+        _mm256_storeu_si256( (__m256i *)(dst + 32),
+                             _mm256_permute2x128_si256( p0, p1, 0x31 ) );
+    }
+    else
+    {
+        r = _mm256_sll_epi16( _mm256_srl_epi16( r, counts[0] ), counts[3] );
+        g = _mm256_sll_epi16( _mm256_srl_epi16( g, counts[1] ), counts[4] );
+        b = _mm256_sll_epi16( _mm256_srl_epi16( b, counts[2] ), counts[5] );
+        _mm256_storeu_si256( (__m256i *)dst,
+                             _mm256_or_si256( r, _mm256_or_si256( g, b ) ) );
+    }
+}
+
+/* Shift counts used by yuv_rgb_store16() */
+static inline void yuv_rgb_counts( __m128i *counts, const rgb_layout_t *p )
+{
+    if( p->b_rgb32 )
+    {
+        const unsigned shifts[3] = { p->r_shift, p->g_shift, p->b_shift };
+        for( unsigned i = 0; i < 3; i++ )
+        {
+            counts[i] = _mm_cvtsi32_si128( shifts[i] );
+            counts[3 + i] = _mm_cvtsi32_si128( shifts[i] >= 16
+                                               ? shifts[i] - 16 : 16 );
+        }
+    }
+    else
+    {
+        counts[0] = _mm_cvtsi32_si128( 8 - p->r_bits );
+        counts[1] = _mm_cvtsi32_si128( 8 - p->g_bits );
+        counts[2] = _mm_cvtsi32_si128( 8 - p->b_bits );
+        counts[3] = _mm_cvtsi32_si128( p->r_shift );
+        counts[4] = _mm_cvtsi32_si128( p->g_shift );
+        counts[5] = _mm_cvtsi32_si128( p->b_shift );
+    }
+}
+
+/* AVX2 version of YuvRgbRow_C(), for the whole row */
+VLC_AVX2
+static inline void YuvRgbRow_AVX2( uint8_t *dst, const uint8_t *y,
+                                   const uint8_t *u, const uint8_t *v,
+                                   unsigned i_step, unsigned width,
+                                   const rgb_layout_t *p_layout )
+{
+    const unsigned i_size = p_layout->b_rgb32 ? 4 : 2;
+    const __m256i y_offset = _mm256_set1_epi16( 128 );
+    const __m256i c_offset = _mm256_set1_epi16( 1024 );
+    __m128i counts[6];
+    unsigned x = 0;
+
+    yuv_rgb_counts( counts, p_layout );
+
+    if( i_step == 1 )
+    {
+        for( ; x + 16 <= width; x += 16 )
+        {
+            __m128i mu = _mm_loadl_epi64( (const __m128i *)&u[x / 2] );
+            __m128i mv = _mm_loadl_epi64( (const __m128i *)&v[x / 2] );
+            __m256i ly = _mm256_cvtepu8_epi16(
+                                _mm_loadu_si128( (const __m128i *)&y[x] ) );
+            __m256i lu = _mm256_cvtepu8_epi16( _mm_unpacklo_epi8( mu, mu ) );
+            __m256i lv = _mm256_cvtepu8_epi16( _mm_unpacklo_epi8( mv, mv ) );
+
+            yuv_rgb_store16( &dst[i_size * x],
+                _mm256_sub_epi16( _mm256_slli_epi16( ly, 3 ), y_offset ),
+                _mm256_sub_epi16( _mm256_slli_epi16( lu, 3 ), c_offset ),
+                _mm256_sub_epi16( _mm256_slli_epi16( lv, 3 ), c_offset ),
+                p_layout, counts );
+        }
+    }
+    else
+    {
+        /* Duplicates every other byte: 16 bytes are loaded from both u and
+         * v, the last vector would read one byte past the chroma of NV21 */
+        const __m128i dup = _mm_setr_epi8( 0, 0, 2, 2, 4, 4, 6, 6,
+                                           8, 8, 10, 10, 12, 12, 14, 14 );
+        for( ; x + 16 < width; x += 16 )
+        {
+            __m128i mu = _mm_loadu_si128( (const __m128i *)&u[x] );
+            __m128i mv = _mm_loadu_si128( (const __m128i *)&v[x] );
+            __m256i ly = _mm256_cvtepu8_epi16(
+                                _mm_loadu_si128( (const __m128i *)&y[x] ) );
+            __m256i lu = _mm256_cvtepu8_epi16( _mm_shuffle_epi8( mu, dup ) );
+            __m256i lv = _mm256_cvtepu8_epi16( _mm_shuffle_epi8( mv, dup ) );
+
+            yuv_rgb_store16( &dst[i_size * x],
+                _mm256_sub_epi16( _mm256_slli_epi16( ly, 3 ), y_offset ),
+                _mm256_sub_epi16( _mm256_slli_epi16( lu, 3 ), c_offset ),
+                _mm256_sub_epi16( _mm256_slli_epi16( lv, 3 ), c_offset ),
+                p_layout, counts );
+        }
+    }
+    YuvRgbRow_C( dst, y, u, v, i_step, x, width, p_layout );
+}
+
+/* AVX2 version of Yuv10RgbRow_C(), for the whole row */
+VLC_AVX2
+static inline void Yuv10RgbRow_AVX2( uint8_t *dst, const uint16_t *y,
+                                     const uint16_t *u, const uint16_t *v,
+                                     unsigned width,
+                                     const rgb_layout_t *p_layout )
+{
+    const unsigned i_size = p_layout->b_rgb32 ? 4 : 2;
+    const __m256i y_offset = _mm256_set1_epi16( 128 );
+    const __m256i c_offset = _mm256_set1_epi16( 1024 );
+    __m128i counts[6];
+    unsigned x = 0;
+
+    yuv_rgb_counts( counts, p_layout );
+
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m128i mu = _mm_loadu_si128( (const __m128i *)&u[x / 2] );
+        __m128i mv = _mm_loadu_si128( (const __m128i *)&v[x / 2] );
+        __m256i ly = _mm256_loadu_si256( (const __m256i *)&y[x] );
+        __m256i lu = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256( _mm_unpacklo_epi16( mu, mu ) ),
+                        _mm_unpackhi_epi16( mu, mu ), 1 );
+        __m256i lv = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256( _mm_unpacklo_epi16( mv, mv ) ),
+                        _mm_unpackhi_epi16( mv, mv ), 1 );
+
+        yuv_rgb_store16( &dst[i_size * x],
+            _mm256_sub_epi16( _mm256_slli_epi16( ly, 1 ), y_offset ),
+            _mm256_sub_epi16( _mm256_slli_epi16( lu, 1 ), c_offset ),
+            _mm256_sub_epi16( _mm256_slli_epi16( lv, 1 ), c_offset ),
+            p_layout, counts );
+    }
+    Yuv10RgbRow_C( dst, y, u, v, x, width, p_layout );
+}
+
+/* AVX2 version of PlanarToPackedRow_C(), for the whole row */
+VLC_AVX2
+static inline void PlanarToPackedRow_AVX2( uint8_t *dst, const uint8_t *y,
+                                           const uint8_t *u, const uint8_t *v,
+                                           unsigned width, bool b_uyvy )
+{
+    unsigned x = 0;
+
+    for( ; x + 32 <= width; x += 32 )
+    {
+        __m128i mu = _mm_loadu_si128( (const __m128i *)&u[x / 2] );
+        __m128i mv = _mm_loadu_si128( (const __m128i *)&v[x / 2] );
+        __m256i ly = _mm256_loadu_si256( (const __m256i *)&y[x] );
+        __m256i uv = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256( _mm_unpacklo_epi8( mu, mv ) ),
+                        _mm_unpackhi_epi8( mu, mv ), 1 );
+        __m256i p0, p1;
+
+        if( b_uyvy )
+        {
+            p0 = _mm256_unpacklo_epi8( uv, ly ); /* 0-7, 16-23 */
+            p1 = _mm256_unpackhi_epi8( uv, ly ); /* 8-15, 24-31 */
+        }
+        else
+        {
+            p0 = _mm256_unpacklo_epi8( ly, uv );
+            p1 = _mm256_unpackhi_epi8( ly, uv );
+        }
+        _mm256_storeu_si256( (__m256i *)&dst[2 * x],
+                             _mm256_permute2x128_si256( p0, p1, 0x20 ) );
+        _mm256_storeu_si256( (__m256i *)&dst[2 * x + 32],
+                             _mm256_permute2x128_si256( p0, p1, 0x31 ) );
+    }
+    PlanarToPackedRow_C( dst, y, u, v, x, width, b_uyvy );
+}
+
+/* AVX2 version of PackedToPlanarRow_C(), for the whole row */
+VLC_AVX2
+static inline void PackedToPlanarRow_AVX2( uint8_t *y, uint8_t *u, uint8_t *v,
+                                           const uint8_t *src, unsigned width,
+                                           bool b_uyvy )
+{
+    const __m256i mask = _mm256_set1_epi16( 0x00ff );
+    unsigned x = 0;
+
+    for( ; x + 32 <= width; x += 32 )
+    {
+        __m256i a = _mm256_loadu_si256( (const __m256i *)&src[2 * x] );
+        __m256i b = _mm256_loadu_si256( (const __m256i *)&src[2 * x + 32] );
+        __m256i la, lb, ca, cb;
+
+        if( b_uyvy )
+        {
+            la = _mm256_srli_epi16( a, 8 );
+            lb = _mm256_srli_epi16( b, 8 );
+            ca = _mm256_and_si256( a, mask );
+            cb = _mm256_and_si256( b, mask );
+        }
+        else
+        {
+            la = _mm256_and_si256( a, mask );
+            lb = _mm256_and_si256( b, mask );
+            ca = _mm256_srli_epi16( a, 8 );
+            cb = _mm256_srli_epi16( b, 8 );
+        }
+
+        /* packus works within lanes: restore the order with a permute */
+        __m256i ly = _mm256_permute4x64_epi64( _mm256_packus_epi16( la, lb ),
+                                               0xD8 );
+        _mm256_storeu_si256( (__m256i *)&y[x], ly );
+
+        if( u != NULL )
+        {
+            __m256i c = _mm256_permute4x64_epi64( _mm256_packus_epi16( ca, cb ),
+                                                  0xD8 );
+            __m256i uv = _mm256_packus_epi16( _mm256_and_si256( c, mask ),
+                                              _mm256_srli_epi16( c, 8 ) );
+            uv = _mm256_permute4x64_epi64( uv, 0xD8 );
+            _mm_storeu_si128( (__m128i *)&u[x / 2],
+                              _mm256_castsi256_si128( uv ) );
+            _mm_storeu_si128( (__m128i *)&v[x / 2],
+                              _mm256_extracti128_si256( uv, 1 ) );
+        }
+    }
+    PackedToPlanarRow_C( y, u, v, src, x, width, b_uyvy );
+}
+#endif /* HAVE_AVX2_INTRINSICS */
+
+#endif
@@ -0,0 +1,202 @@
+/*****************************************************************************
+ * chroma_yuv_avx2.c: AVX2 planar/packed YUV chroma conversions
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "chroma_avx2.h"
+#include "../misc/slices.h"
+
+static int  Open (vlc_object_t *);
+static void Close(vlc_object_t *);
+
+vlc_module_begin ()
+    set_description (N_("AVX2 video chroma conversions"))
+    set_capability ("video filter2", 260)
+    set_callbacks (Open, Close)
+vlc_module_end ()
+
+struct filter_sys_t
+{
+    bool          b_pack;    /* planar to packed, else packed to planar */
+    bool          b_uyvy;    /* luma in the odd bytes of the packed picture */
+    bool          b_swap_uv; /* V before U */
+    unsigned      i_v_shift; /* vertical chroma subsampling of the planes */
+    slice_pool_t *pool;
+};
+
+typedef struct
+{
+    filter_t        *filter;
+    const picture_t *src;
+    picture_t       *dst;
+} convert_job_t;
+
+static void ConvertSlice(void *opaque, unsigned i_slice, unsigned i_count)
+{
+    const convert_job_t *job = opaque;
+    const filter_sys_t *sys = job->filter->p_sys;
+    const unsigned width = job->filter->fmt_in.video.i_visible_width;
+    const unsigned height = job->filter->fmt_in.video.i_visible_height;
+    const picture_t *planar = sys->b_pack ? job->src : job->dst;
+    const picture_t *packed = sys->b_pack ? job->dst : job->src;
+    const plane_t *y = &planar->p[Y_PLANE];
+    const plane_t *u = &planar->p[sys->b_swap_uv ? V_PLANE : U_PLANE];
+    const plane_t *v = &planar->p[sys->b_swap_uv ? U_PLANE : V_PLANE];
+    const plane_t *p = &packed->p[0];
+
+    for (unsigned j = SliceRow(height, i_slice, i_count, 2),
+                  end = SliceRow(height, i_slice + 1, i_count, 2);
+         j < end; j++)
+    {
+        const unsigned c = j >> sys->i_v_shift;
+        uint8_t *py = &y->p_pixels[j * y->i_pitch];
+        uint8_t *pu = &u->p_pixels[c * u->i_pitch];
+        uint8_t *pv = &v->p_pixels[c * v->i_pitch];
+        uint8_t *pp = &p->p_pixels[j * p->i_pitch];
+
+        if (sys->b_pack)
+            PlanarToPackedRow_AVX2(pp, py, pu, pv, width, sys->b_uyvy);
+        else
+        if (sys->i_v_shift == 0 || (j & 1) == 0)
+            PackedToPlanarRow_AVX2(py, pu, pv, pp, width, sys->b_uyvy);
+        else /* 4:2:0 chroma is taken from the even lines */
+            PackedToPlanarRow_AVX2(py, NULL, NULL, pp, width, sys->b_uyvy);
+    }
+}
+
+static void Convert(filter_t *filter, picture_t *src, picture_t *dst)
+{
+    convert_job_t job = { filter, src, dst };
+
+    SlicePoolRunAll(filter->p_sys->pool, ConvertSlice, &job);
+}
+VIDEO_FILTER_WRAPPER (Convert)
+
+/* Parses a planar chroma, returns false if not supported */
+static bool GetPlanar(vlc_fourcc_t i_chroma, bool *pb_swap_uv,
+                      unsigned *pi_v_shift)
+{
+    switch (i_chroma)
+    {
+        case VLC_CODEC_I420:
+            *pb_swap_uv = false;
+            *pi_v_shift = 1;
+            return true;
+        case VLC_CODEC_YV12:
+            *pb_swap_uv = true;
+            *pi_v_shift = 1;
+            return true;
+        case VLC_CODEC_I422:
+            *pb_swap_uv = false;
+            *pi_v_shift = 0;
+            return true;
+    }
+    return false;
+}
+
+/* Parses a packed chroma, returns false if not supported */
+static bool GetPacked(vlc_fourcc_t i_chroma, bool *pb_uyvy, bool *pb_swap_uv)
+{
+    switch (i_chroma)
+    {
+        case VLC_CODEC_YUYV:
+            *pb_uyvy = false;
+            *pb_swap_uv = false;
+            return true;
+        case VLC_CODEC_YVYU:
+            *pb_uyvy = false;
+            *pb_swap_uv = true;
+            return true;
+        case VLC_CODEC_UYVY:
+            *pb_uyvy = true;
+            *pb_swap_uv = false;
+            return true;
+        case VLC_CODEC_VYUY:
+            *pb_uyvy = true;
+            *pb_swap_uv = true;
+            return true;
+    }
+    return false;
+}
+
+static int Open(vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+    const video_format_t *in = &filter->fmt_in.video;
+    const video_format_t *out = &filter->fmt_out.video;
+    bool b_pack, b_uyvy, b_swap_planar, b_swap_packed;
+    unsigned i_v_shift;
+
+    if (!vlc_CPU_AVX2())
+        return VLC_EGENERIC;
+
+    if (in->i_visible_width != out->i_visible_width
+     || in->i_visible_height != out->i_visible_height
+     || in->orientation != out->orientation)
+        return VLC_EGENERIC;
+
+    if (GetPlanar(in->i_chroma, &b_swap_planar, &i_v_shift)
+     && GetPacked(out->i_chroma, &b_uyvy, &b_swap_packed))
+        b_pack = true;
+    else
+    if (GetPacked(in->i_chroma, &b_uyvy, &b_swap_packed)
+     && GetPlanar(out->i_chroma, &b_swap_planar, &i_v_shift))
+        b_pack = false;
+    else
+        return VLC_EGENERIC;
+
+    filter_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    sys->b_pack = b_pack;
+    sys->b_uyvy = b_uyvy;
+    sys->b_swap_uv = b_swap_planar != b_swap_packed;
+    sys->i_v_shift = i_v_shift;
+    sys->pool = SlicePoolNewForSize(obj, in->i_visible_width,
+                                    in->i_visible_height);
+
+    filter->p_sys = sys;
+    filter->pf_video_filter = Convert_Filter;
+
+    msg_Dbg(filter, "%4.4s(%ux%u) to %4.4s(%ux%u)",
+            (const char *)&in->i_chroma, in->i_visible_width,
+            in->i_visible_height, (const char *)&out->i_chroma,
+            out->i_visible_width, out->i_visible_height);
+    return VLC_SUCCESS;
+}
+
+static void Close(vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+    filter_sys_t *sys = filter->p_sys;
+
+    if (sys->pool != NULL)
+        SlicePoolDelete(sys->pool);
+    free(sys);
+}
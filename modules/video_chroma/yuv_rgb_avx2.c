@@ -0,0 +1,201 @@
+/*****************************************************************************
+ * yuv_rgb_avx2.c: AVX2 YUV to RGB chroma conversions
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_filter.h>
+#include <vlc_picture.h>
+#include <vlc_cpu.h>
+
+#include "chroma_avx2.h"
+#include "../misc/slices.h"
+
+static int  Open (vlc_object_t *);
+static void Close(vlc_object_t *);
+
+vlc_module_begin ()
+    set_description (N_("AVX2 video chroma YUV->RGB"))
+    set_capability ("video filter2", 250)
+    set_callbacks (Open, Close)
+vlc_module_end ()
+
+enum
+{
+    SOURCE_PLANAR,      /* I420, YV12 */
+    SOURCE_SEMIPLANAR,  /* NV12, NV21 */
+    SOURCE_PLANAR_10,   /* I420_10L */
+};
+
+struct filter_sys_t
+{
+    rgb_layout_t  layout;
+    int           i_source;
+    bool          b_swap_uv;
+    slice_pool_t *pool;
+};
+
+typedef struct
+{
+    filter_t        *filter;
+    const picture_t *src;
+    picture_t       *dst;
+} convert_job_t;
+
+static void ConvertSlice(void *opaque, unsigned i_slice, unsigned i_count)
+{
+    const convert_job_t *job = opaque;
+    const filter_sys_t *sys = job->filter->p_sys;
+    const picture_t *src = job->src;
+    const unsigned width = job->filter->fmt_in.video.i_visible_width;
+    const unsigned height = job->filter->fmt_in.video.i_visible_height;
+    const plane_t *y = &src->p[Y_PLANE];
+    const plane_t *u = &src->p[sys->b_swap_uv ? V_PLANE : U_PLANE];
+    const plane_t *v = &src->p[sys->b_swap_uv ? U_PLANE : V_PLANE];
+    const plane_t *out = &job->dst->p[0];
+
+    for (unsigned j = SliceRow(height, i_slice, i_count, 2),
+                  end = SliceRow(height, i_slice + 1, i_count, 2);
+         j < end; j++)
+    {
+        uint8_t *dst = &out->p_pixels[j * out->i_pitch];
+        const uint8_t *py = &y->p_pixels[j * y->i_pitch];
+
+        switch (sys->i_source)
+        {
+            case SOURCE_PLANAR:
+                YuvRgbRow_AVX2(dst, py, &u->p_pixels[(j / 2) * u->i_pitch],
+                               &v->p_pixels[(j / 2) * v->i_pitch], 1,
+                               width, &sys->layout);
+                break;
+            case SOURCE_SEMIPLANAR:
+            {
+                const plane_t *c = &src->p[1];
+                const uint8_t *uv = &c->p_pixels[(j / 2) * c->i_pitch];
+
+                YuvRgbRow_AVX2(dst, py, uv + sys->b_swap_uv,
+                               uv + !sys->b_swap_uv, 2, width, &sys->layout);
+                break;
+            }
+            case SOURCE_PLANAR_10:
+                Yuv10RgbRow_AVX2(dst, (const uint16_t *)py,
+                    (const uint16_t *)&u->p_pixels[(j / 2) * u->i_pitch],
+                    (const uint16_t *)&v->p_pixels[(j / 2) * v->i_pitch],
+                    width, &sys->layout);
+                break;
+        }
+    }
+}
+
+static void Convert(filter_t *filter, picture_t *src, picture_t *dst)
+{
+    convert_job_t job = { filter, src, dst };
+
+    SlicePoolRunAll(filter->p_sys->pool, ConvertSlice, &job);
+}
+VIDEO_FILTER_WRAPPER (Convert)
+
+static int Open(vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+    const video_format_t *in = &filter->fmt_in.video;
+    const video_format_t *out = &filter->fmt_out.video;
+
+    if (!vlc_CPU_AVX2())
+        return VLC_EGENERIC;
+
+    if (in->i_visible_width != out->i_visible_width
+     || in->i_visible_height != out->i_visible_height
+     || in->orientation != out->orientation)
+        return VLC_EGENERIC;
+
+    rgb_layout_t layout;
+    switch (out->i_chroma)
+    {
+        case VLC_CODEC_RGB32:
+            if (!rgb_layout_Init(&layout, true, out->i_rmask, out->i_gmask,
+                                 out->i_bmask))
+                return VLC_EGENERIC;
+            break;
+        case VLC_CODEC_RGB16:
+        case VLC_CODEC_RGB15:
+            if (!rgb_layout_Init(&layout, false, out->i_rmask, out->i_gmask,
+                                 out->i_bmask))
+                return VLC_EGENERIC;
+            break;
+        default:
+            return VLC_EGENERIC;
+    }
+
+    int i_source;
+    bool b_swap_uv = false;
+    switch (in->i_chroma)
+    {
+        case VLC_CODEC_YV12:
+            b_swap_uv = true;
+            /* fall through */
+        case VLC_CODEC_I420:
+            i_source = SOURCE_PLANAR;
+            break;
+        case VLC_CODEC_NV21:
+            b_swap_uv = true;
+            /* fall through */
+        case VLC_CODEC_NV12:
+            i_source = SOURCE_SEMIPLANAR;
+            break;
+        case VLC_CODEC_I420_10L:
+            i_source = SOURCE_PLANAR_10;
+            break;
+        default:
+            return VLC_EGENERIC;
+    }
+
+    filter_sys_t *sys = malloc(sizeof (*sys));
+    if (unlikely(sys == NULL))
+        return VLC_ENOMEM;
+
+    sys->layout = layout;
+    sys->i_source = i_source;
+    sys->b_swap_uv = b_swap_uv;
+    sys->pool = SlicePoolNewForSize(obj, in->i_visible_width,
+                                    in->i_visible_height);
+
+    filter->p_sys = sys;
+    filter->pf_video_filter = Convert_Filter;
+
+    msg_Dbg(filter, "%4.4s(%ux%u) to %4.4s(%ux%u)",
+            (const char *)&in->i_chroma, in->i_visible_width,
+            in->i_visible_height, (const char *)&out->i_chroma,
+            out->i_visible_width, out->i_visible_height);
+    return VLC_SUCCESS;
+}
+
+static void Close(vlc_object_t *obj)
+{
+    filter_t *filter = (filter_t *)obj;
+    filter_sys_t *sys = filter->p_sys;
+
+    if (sys->pool != NULL)
+        SlicePoolDelete(sys->pool);
+    free(sys);
+}
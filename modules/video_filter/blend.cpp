@@ -31,17 +31,34 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
+#ifdef HAVE_SSE2_INTRINSICS
+# include <emmintrin.h>
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+#endif
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+# define BLEND_NEON 1
+# include <arm_neon.h>
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
 static int  Open (vlc_object_t *);
 static void Close(vlc_object_t *);
 
+#define SIMD_TEXT N_("Use SIMD blending")
+#define SIMD_LONGTEXT N_("Use the vectorized blending routines when the " \
+    "processor supports them. Disable to use the reference implementation.")
+
 vlc_module_begin()
     set_description(N_("Video pictures blending"))
     set_capability("video blending", 100)
+    add_bool("blend-simd", true, SIMD_TEXT, SIMD_LONGTEXT, true)
     set_callbacks(Open, Close)
 vlc_module_end()
 
@@ -78,6 +95,18 @@ public:
     {
         return fmt;
     }
+    const picture_t *getPicture() const
+    {
+        return picture;
+    }
+    unsigned getX() const
+    {
+        return x;
+    }
+    unsigned getY() const
+    {
+        return y;
+    }
     bool isFull(unsigned) const
     {
         return true;
@@ -550,11 +579,13 @@ void Blend(const CPicture &dst_data, const CPicture &src_data,
 typedef void (*blend_function_t)(const CPicture &dst_data, const CPicture &src_data,
                                  unsigned width, unsigned height, int alpha);
 
-static const struct {
+struct blend_entry {
     vlc_fourcc_t     dst;
     vlc_fourcc_t     src;
     blend_function_t blend;
-} blends[] = {
+};
+
+static const blend_entry blends[] = {
 #undef RGB
 #undef YUV
 #define RGB(csp, picture, cvt) \
@@ -622,6 +653,374 @@ static const struct {
 #undef YUV
 };
 
+/*****************************************************************************
+ * Vectorized blending of YUVA and RGBA onto the most common chromas
+ *****************************************************************************/
+/* Pixels converted at once from RGBA, must be even */
+#define BLEND_CHUNK 256
+
+/* Blends YUVA or RGBA onto 4:2:0 planar or semi-planar pictures */
+template <class K, bool semiplanar, bool rgba, bool swap_uv>
+static void Blend420(const CPicture &dst_data, const CPicture &src_data,
+                     unsigned width, unsigned height, int alpha)
+{
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+    const unsigned dx = dst_data.getX(), dy = dst_data.getY();
+    const unsigned sx = src_data.getX(), sy = src_data.getY();
+    const plane_t *dp_u = &dst->p[swap_uv ? 2 : 1];
+    const plane_t *dp_v = &dst->p[swap_uv ? 1 : 2];
+    /* First source column on which the chroma is blended */
+    const unsigned cx = dx % 2;
+    uint8_t tmp[4][BLEND_CHUNK];
+
+    for (unsigned y = 0; y < height; y++) {
+        const bool chroma = ((dy + y) % 2) == 0;
+        uint8_t *dst_y = &dst->p[0].p_pixels[(dy + y) * dst->p[0].i_pitch + dx];
+        uint8_t *dst_u = &dp_u->p_pixels[(dy + y) / 2 * dp_u->i_pitch];
+        uint8_t *dst_v = semiplanar ? NULL
+                                    : &dp_v->p_pixels[(dy + y) / 2 * dp_v->i_pitch];
+        const uint8_t *s[4];
+
+        for (unsigned i = 0; i < (rgba ? 1 : 4); i++)
+            s[i] = &src->p[i].p_pixels[(sy + y) * src->p[i].i_pitch
+                                       + (rgba ? 4 : 1) * sx];
+
+        for (unsigned x = 0; x < width; x += BLEND_CHUNK) {
+            const unsigned n = __MIN(width - x, BLEND_CHUNK);
+            const uint8_t *p[4];
+
+            if (rgba) {
+                K::ConvertRGBAToYUVA(tmp[0], tmp[1], tmp[2], tmp[3],
+                                     &s[0][4 * x], n);
+                for (unsigned i = 0; i < 4; i++)
+                    p[i] = tmp[i];
+            } else {
+                for (unsigned i = 0; i < 4; i++)
+                    p[i] = &s[i][x];
+            }
+
+            K::BlendRow(&dst_y[x], p[0], p[3], n, alpha);
+            if (!chroma || n <= cx)
+                continue;
+
+            const unsigned count = (n - cx + 1) / 2;
+            const unsigned offset = (dx + x + cx) / 2;
+            if (semiplanar) {
+                K::BlendRowSub2UV(&dst_u[2 * offset], &p[1][cx], &p[2][cx],
+                                  &p[3][cx], count, alpha);
+            } else {
+                K::BlendRowSub2(&dst_u[offset], &p[1][cx], &p[3][cx],
+                                count, alpha);
+                K::BlendRowSub2(&dst_v[offset], &p[2][cx], &p[3][cx],
+                                count, alpha);
+            }
+        }
+    }
+}
+
+/* Blends RGBA onto 32-bits RGB, if the padding byte is the last one */
+template <class K>
+static void BlendRGB32(const CPicture &dst_data, const CPicture &src_data,
+                       unsigned width, unsigned height, int alpha)
+{
+    const video_format_t *fmt = dst_data.getFormat();
+#ifdef WORDS_BIGENDIAN
+    const unsigned offset_r = (32 - fmt->i_lrshift) / 8;
+    const unsigned offset_g = (32 - fmt->i_lgshift) / 8;
+    const unsigned offset_b = (32 - fmt->i_lbshift) / 8;
+#else
+    const unsigned offset_r = fmt->i_lrshift / 8;
+    const unsigned offset_g = fmt->i_lgshift / 8;
+    const unsigned offset_b = fmt->i_lbshift / 8;
+#endif
+    if (offset_g != 1 || offset_r + offset_b != 2 || offset_r == 1) {
+        Blend<CPictureRGB32, CPictureRGBA, compose<convertNone, convertNone> >
+            (dst_data, src_data, width, height, alpha);
+        return;
+    }
+
+    const picture_t *dst = dst_data.getPicture();
+    const picture_t *src = src_data.getPicture();
+    uint8_t *dst_line = &dst->p[0].p_pixels[dst_data.getY() * dst->p[0].i_pitch
+                                            + 4 * dst_data.getX()];
+    const uint8_t *src_line = &src->p[0].p_pixels[src_data.getY() * src->p[0].i_pitch
+                                                  + 4 * src_data.getX()];
+
+    for (unsigned y = 0; y < height; y++) {
+        K::BlendRowRGB32(dst_line, src_line, width, alpha, offset_r == 2);
+        dst_line += dst->p[0].i_pitch;
+        src_line += src->p[0].i_pitch;
+    }
+}
+
+#define SIMD_BLENDS(K) \
+    { VLC_CODEC_I420,  VLC_CODEC_YUVA, Blend420<K, false, false, false> }, \
+    { VLC_CODEC_J420,  VLC_CODEC_YUVA, Blend420<K, false, false, false> }, \
+    { VLC_CODEC_YV12,  VLC_CODEC_YUVA, Blend420<K, false, false, true > }, \
+    { VLC_CODEC_NV12,  VLC_CODEC_YUVA, Blend420<K, true,  false, false> }, \
+    { VLC_CODEC_I420,  VLC_CODEC_RGBA, Blend420<K, false, true,  false> }, \
+    { VLC_CODEC_J420,  VLC_CODEC_RGBA, Blend420<K, false, true,  false> }, \
+    { VLC_CODEC_YV12,  VLC_CODEC_RGBA, Blend420<K, false, true,  true > }, \
+    { VLC_CODEC_NV12,  VLC_CODEC_RGBA, Blend420<K, true,  true,  false> }, \
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, BlendRGB32<K> }
+
+/* Each instruction set provides the row functions of blend_simd.h, through
+ * the K template parameter of the functions above. */
+#define SIMD_KERNELS \
+    struct Kernels { \
+        static void BlendRow(uint8_t *d, const uint8_t *s, const uint8_t *a, \
+                             unsigned n, unsigned alpha) \
+        { simd::BlendRow(d, s, a, n, alpha); } \
+        static void BlendRowSub2(uint8_t *d, const uint8_t *s, \
+                                 const uint8_t *a, unsigned n, unsigned alpha) \
+        { simd::BlendRowSub2(d, s, a, n, alpha); } \
+        static void BlendRowSub2UV(uint8_t *d, const uint8_t *u, \
+                                   const uint8_t *v, const uint8_t *a, \
+                                   unsigned n, unsigned alpha) \
+        { simd::BlendRowSub2UV(d, u, v, a, n, alpha); } \
+        static void ConvertRGBAToYUVA(uint8_t *y, uint8_t *u, uint8_t *v, \
+                                      uint8_t *a, const uint8_t *s, unsigned n) \
+        { simd::ConvertRGBAToYUVA(y, u, v, a, s, n); } \
+        static void BlendRowRGB32(uint8_t *d, const uint8_t *s, unsigned n, \
+                                  unsigned alpha, bool swap_rb) \
+        { simd::BlendRowRGB32(d, s, n, alpha, swap_rb); } \
+    }; \
+    static const blend_entry blends[] = { SIMD_BLENDS(Kernels) };
+
+#ifdef HAVE_SSE2_INTRINSICS
+namespace sse2 {
+namespace simd {
+#define BLEND_TARGET __attribute__((__target__("sse2")))
+typedef __m128i vec;
+enum { LANES = 8 };
+
+BLEND_TARGET static inline vec set1(unsigned v) { return _mm_set1_epi16(v); }
+BLEND_TARGET static inline vec add(vec a, vec b) { return _mm_add_epi16(a, b); }
+BLEND_TARGET static inline vec sub(vec a, vec b) { return _mm_sub_epi16(a, b); }
+BLEND_TARGET static inline vec mul(vec a, vec b) { return _mm_mullo_epi16(a, b); }
+BLEND_TARGET static inline vec srl8(vec v) { return _mm_srli_epi16(v, 8); }
+BLEND_TARGET static inline vec sra8(vec v) { return _mm_srai_epi16(v, 8); }
+
+BLEND_TARGET
+static inline vec load(const uint8_t *p)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p),
+                             _mm_setzero_si128());
+}
+
+BLEND_TARGET
+static inline void load2(const uint8_t *p, vec *c0, vec *c1)
+{
+    const __m128i v = _mm_loadu_si128((const __m128i *)p);
+    *c0 = _mm_and_si128(v, _mm_set1_epi16(0xff));
+    *c1 = _mm_srli_epi16(v, 8);
+}
+
+BLEND_TARGET
+static inline void load4(const uint8_t *p, vec *c0, vec *c1, vec *c2, vec *c3)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i lo = _mm_loadu_si128((const __m128i *)p);
+    const __m128i hi = _mm_loadu_si128((const __m128i *)(p + 16));
+    *c0 = _mm_packs_epi32(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+    *c1 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), mask),
+                          _mm_and_si128(_mm_srli_epi32(hi, 8), mask));
+    *c2 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), mask),
+                          _mm_and_si128(_mm_srli_epi32(hi, 16), mask));
+    *c3 = _mm_packs_epi32(_mm_srli_epi32(lo, 24), _mm_srli_epi32(hi, 24));
+}
+
+BLEND_TARGET
+static inline void store(uint8_t *p, vec v)
+{
+    _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(v, v));
+}
+
+BLEND_TARGET
+static inline void store2(uint8_t *p, vec c0, vec c1)
+{
+    _mm_storeu_si128((__m128i *)p, _mm_or_si128(c0, _mm_slli_epi16(c1, 8)));
+}
+
+BLEND_TARGET
+static inline void store4(uint8_t *p, vec c0, vec c1, vec c2, vec c3)
+{
+    const __m128i lo = _mm_or_si128(c0, _mm_slli_epi16(c1, 8));
+    const __m128i hi = _mm_or_si128(c2, _mm_slli_epi16(c3, 8));
+    _mm_storeu_si128((__m128i *)p, _mm_unpacklo_epi16(lo, hi));
+    _mm_storeu_si128((__m128i *)(p + 16), _mm_unpackhi_epi16(lo, hi));
+}
+
+#include "blend_simd.h"
+#undef BLEND_TARGET
+}
+SIMD_KERNELS
+}
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+namespace avx2 {
+namespace simd {
+#define BLEND_TARGET __attribute__((__target__("avx2")))
+typedef __m256i vec;
+enum { LANES = 16 };
+
+BLEND_TARGET static inline vec set1(unsigned v) { return _mm256_set1_epi16(v); }
+BLEND_TARGET static inline vec add(vec a, vec b) { return _mm256_add_epi16(a, b); }
+BLEND_TARGET static inline vec sub(vec a, vec b) { return _mm256_sub_epi16(a, b); }
+BLEND_TARGET static inline vec mul(vec a, vec b) { return _mm256_mullo_epi16(a, b); }
+BLEND_TARGET static inline vec srl8(vec v) { return _mm256_srli_epi16(v, 8); }
+BLEND_TARGET static inline vec sra8(vec v) { return _mm256_srai_epi16(v, 8); }
+
+/* Packs 32-bits values, restoring the order mixed up by the 128-bits lanes */
+BLEND_TARGET
+static inline vec pack32(__m256i a, __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+                                    _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+BLEND_TARGET
+static inline vec load(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+BLEND_TARGET
+static inline void load2(const uint8_t *p, vec *c0, vec *c1)
+{
+    const __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    *c0 = _mm256_and_si256(v, _mm256_set1_epi16(0xff));
+    *c1 = _mm256_srli_epi16(v, 8);
+}
+
+BLEND_TARGET
+static inline void load4(const uint8_t *p, vec *c0, vec *c1, vec *c2, vec *c3)
+{
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    const __m256i lo = _mm256_loadu_si256((const __m256i *)p);
+    const __m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+    *c0 = pack32(_mm256_and_si256(lo, mask), _mm256_and_si256(hi, mask));
+    *c1 = pack32(_mm256_and_si256(_mm256_srli_epi32(lo, 8), mask),
+                 _mm256_and_si256(_mm256_srli_epi32(hi, 8), mask));
+    *c2 = pack32(_mm256_and_si256(_mm256_srli_epi32(lo, 16), mask),
+                 _mm256_and_si256(_mm256_srli_epi32(hi, 16), mask));
+    *c3 = pack32(_mm256_srli_epi32(lo, 24), _mm256_srli_epi32(hi, 24));
+}
+
+BLEND_TARGET
+static inline void store(uint8_t *p, vec v)
+{
+    const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v),
+                                                    _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128((__m128i *)p, _mm256_castsi256_si128(packed));
+}
+
+BLEND_TARGET
+static inline void store2(uint8_t *p, vec c0, vec c1)
+{
+    _mm256_storeu_si256((__m256i *)p,
+                        _mm256_or_si256(c0, _mm256_slli_epi16(c1, 8)));
+}
+
+BLEND_TARGET
+static inline void store4(uint8_t *p, vec c0, vec c1, vec c2, vec c3)
+{
+    const __m256i lo = _mm256_or_si256(c0, _mm256_slli_epi16(c1, 8));
+    const __m256i hi = _mm256_or_si256(c2, _mm256_slli_epi16(c3, 8));
+    const __m256i p0 = _mm256_unpacklo_epi16(lo, hi); /* pixels 0-3, 8-11 */
+    const __m256i p1 = _mm256_unpackhi_epi16(lo, hi); /* pixels 4-7, 12-15 */
+    _mm256_storeu_si256((__m256i *)p, _mm256_permute2x128_si256(p0, p1, 0x20));
+    _mm256_storeu_si256((__m256i *)(p + 32),
+                        _mm256_permute2x128_si256(p0, p1, 0x31));
+}
+
+#include "blend_simd.h"
+#undef BLEND_TARGET
+}
+SIMD_KERNELS
+}
+#endif
+
+#ifdef BLEND_NEON
+namespace neon {
+namespace simd {
+#define BLEND_TARGET
+typedef uint16x8_t vec;
+enum { LANES = 8 };
+
+static inline vec set1(unsigned v) { return vdupq_n_u16(v); }
+static inline vec add(vec a, vec b) { return vaddq_u16(a, b); }
+static inline vec sub(vec a, vec b) { return vsubq_u16(a, b); }
+static inline vec mul(vec a, vec b) { return vmulq_u16(a, b); }
+static inline vec srl8(vec v) { return vshrq_n_u16(v, 8); }
+static inline vec sra8(vec v)
+{
+    return vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(v), 8));
+}
+
+static inline vec load(const uint8_t *p)
+{
+    return vmovl_u8(vld1_u8(p));
+}
+
+static inline void load2(const uint8_t *p, vec *c0, vec *c1)
+{
+    const uint8x8x2_t v = vld2_u8(p);
+    *c0 = vmovl_u8(v.val[0]);
+    *c1 = vmovl_u8(v.val[1]);
+}
+
+static inline void load4(const uint8_t *p, vec *c0, vec *c1, vec *c2, vec *c3)
+{
+    const uint8x8x4_t v = vld4_u8(p);
+    *c0 = vmovl_u8(v.val[0]);
+    *c1 = vmovl_u8(v.val[1]);
+    *c2 = vmovl_u8(v.val[2]);
+    *c3 = vmovl_u8(v.val[3]);
+}
+
+static inline void store(uint8_t *p, vec v)
+{
+    vst1_u8(p, vmovn_u16(v));
+}
+
+static inline void store2(uint8_t *p, vec c0, vec c1)
+{
+    uint8x8x2_t v;
+    v.val[0] = vmovn_u16(c0);
+    v.val[1] = vmovn_u16(c1);
+    vst2_u8(p, v);
+}
+
+static inline void store4(uint8_t *p, vec c0, vec c1, vec c2, vec c3)
+{
+    uint8x8x4_t v;
+    v.val[0] = vmovn_u16(c0);
+    v.val[1] = vmovn_u16(c1);
+    v.val[2] = vmovn_u16(c2);
+    v.val[3] = vmovn_u16(c3);
+    vst4_u8(p, v);
+}
+
+#include "blend_simd.h"
+#undef BLEND_TARGET
+}
+SIMD_KERNELS
+}
+#endif
+
+static blend_function_t FindBlend(const blend_entry *table, size_t count,
+                                  vlc_fourcc_t src, vlc_fourcc_t dst)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].src == src && table[i].dst == dst)
+            return table[i].blend;
+    }
+    return NULL;
+}
+
 struct filter_sys_t {
     filter_sys_t() : blend(NULL)
     {
@@ -670,10 +1069,25 @@ static int Open(vlc_object_t *object)
     const vlc_fourcc_t dst = filter->fmt_out.video.i_chroma;
 
     filter_sys_t *sys = new filter_sys_t();
-    for (size_t i = 0; i < sizeof(blends) / sizeof(*blends); i++) {
-        if (blends[i].src == src && blends[i].dst == dst)
-            sys->blend = blends[i].blend;
+    if (var_InheritBool(filter, "blend-simd")) {
+#ifdef HAVE_AVX2_INTRINSICS
+        if (!sys->blend && vlc_CPU_AVX2())
+            sys->blend = FindBlend(avx2::blends, ARRAY_SIZE(avx2::blends),
+                                   src, dst);
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+        if (!sys->blend && vlc_CPU_SSE2())
+            sys->blend = FindBlend(sse2::blends, ARRAY_SIZE(sse2::blends),
+                                   src, dst);
+#endif
+#ifdef BLEND_NEON
+        if (!sys->blend)
+            sys->blend = FindBlend(neon::blends, ARRAY_SIZE(neon::blends),
+                                   src, dst);
+#endif
     }
+    if (!sys->blend)
+        sys->blend = FindBlend(blends, ARRAY_SIZE(blends), src, dst);
 
     if (!sys->blend) {
        msg_Err(filter, "no matching alpha blending routine (chroma: %4.4s -> %4.4s)",
@@ -0,0 +1,171 @@
+/*****************************************************************************
+ * blend_simd.h: vectorized alpha blending rows
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* This file is included once per instruction set by blend.cpp, inside a
+ * namespace providing:
+ *  - BLEND_TARGET, the function attributes enabling the instruction set,
+ *  - vec, a vector of LANES unsigned 16-bits values,
+ *  - load(), load2() and load4() to widen LANES (de)interleaved 8-bits
+ *    values per vector, and store(), store2() and store4() to narrow them,
+ *  - set1(), add(), sub(), mul(), srl8() and sra8().
+ *
+ * Every intermediate value fits in 16 bits, so the results are exactly
+ * those of div255() and merge() in blend.cpp. */
+
+BLEND_TARGET
+static inline vec Div255(vec v)
+{
+    return srl8(add(add(srl8(v), v), set1(1)));
+}
+
+BLEND_TARGET
+static inline vec Alpha(vec sa, unsigned alpha)
+{
+    return Div255(mul(sa, set1(alpha)));
+}
+
+BLEND_TARGET
+static inline vec Merge(vec d, vec s, vec a)
+{
+    return Div255(add(mul(sub(set1(255), a), d), mul(s, a)));
+}
+
+/* Blends n samples of a plane with the same sampling as the alpha plane */
+BLEND_TARGET
+static void BlendRow(uint8_t *dst, const uint8_t *src, const uint8_t *sa,
+                     unsigned n, unsigned alpha)
+{
+    unsigned i = 0;
+
+    for (; i + LANES <= n; i += LANES)
+        store(&dst[i], Merge(load(&dst[i]), load(&src[i]),
+                             Alpha(load(&sa[i]), alpha)));
+    for (; i < n; i++)
+        ::merge(&dst[i], src[i], div255(alpha * sa[i]));
+}
+
+/* Blends n samples of a plane subsampled by 2 horizontally, from every
+ * other source sample */
+BLEND_TARGET
+static void BlendRowSub2(uint8_t *dst, const uint8_t *src, const uint8_t *sa,
+                         unsigned n, unsigned alpha)
+{
+    unsigned i = 0;
+
+    /* The last vector would read one byte past the last used sample */
+    for (; i + LANES < n; i += LANES) {
+        vec s, a, unused;
+
+        load2(&src[2 * i], &s, &unused);
+        load2(&sa[2 * i], &a, &unused);
+        store(&dst[i], Merge(load(&dst[i]), s, Alpha(a, alpha)));
+    }
+    for (; i < n; i++)
+        ::merge(&dst[i], src[2 * i], div255(alpha * sa[2 * i]));
+}
+
+/* Same as BlendRowSub2() for an interleaved chroma plane */
+BLEND_TARGET
+static void BlendRowSub2UV(uint8_t *dst, const uint8_t *src_u,
+                           const uint8_t *src_v, const uint8_t *sa,
+                           unsigned n, unsigned alpha)
+{
+    unsigned i = 0;
+
+    for (; i + LANES < n; i += LANES) {
+        vec u, v, a, du, dv, unused;
+
+        load2(&src_u[2 * i], &u, &unused);
+        load2(&src_v[2 * i], &v, &unused);
+        load2(&sa[2 * i], &a, &unused);
+        load2(&dst[2 * i], &du, &dv);
+        a = Alpha(a, alpha);
+        store2(&dst[2 * i], Merge(du, u, a), Merge(dv, v, a));
+    }
+    for (; i < n; i++) {
+        const unsigned a = div255(alpha * sa[2 * i]);
+        ::merge(&dst[2 * i + 0], src_u[2 * i], a);
+        ::merge(&dst[2 * i + 1], src_v[2 * i], a);
+    }
+}
+
+/* Converts n RGBA pixels to planar YUVA, as rgb_to_yuv() does */
+BLEND_TARGET
+static void ConvertRGBAToYUVA(uint8_t *dst_y, uint8_t *dst_u, uint8_t *dst_v,
+                              uint8_t *dst_a, const uint8_t *src, unsigned n)
+{
+    unsigned i = 0;
+
+    for (; i + LANES <= n; i += LANES) {
+        vec r, g, b, a;
+
+        load4(&src[4 * i], &r, &g, &b, &a);
+        /* The chroma sums are negative in 2's complement, hence the
+         * arithmetic shift */
+        vec y = add(add(mul(r, set1(66)), mul(g, set1(129))),
+                    add(mul(b, set1(25)), set1(128)));
+        vec u = add(sub(mul(b, set1(112)), mul(r, set1(38))),
+                    sub(set1(128), mul(g, set1(74))));
+        vec v = add(sub(mul(r, set1(112)), mul(g, set1(94))),
+                    sub(set1(128), mul(b, set1(18))));
+
+        store(&dst_y[i], add(srl8(y), set1(16)));
+        store(&dst_u[i], add(sra8(u), set1(128)));
+        store(&dst_v[i], add(sra8(v), set1(128)));
+        store(&dst_a[i], a);
+    }
+    for (; i < n; i++) {
+        rgb_to_yuv(&dst_y[i], &dst_u[i], &dst_v[i],
+                   src[4 * i + 0], src[4 * i + 1], src[4 * i + 2]);
+        dst_a[i] = src[4 * i + 3];
+    }
+}
+
+/* Blends n RGBA pixels onto 32-bits RGB pixels whose padding byte is last,
+ * with red either first or, if swap_rb is set, third */
+BLEND_TARGET
+static void BlendRowRGB32(uint8_t *dst, const uint8_t *src, unsigned n,
+                          unsigned alpha, bool swap_rb)
+{
+    unsigned i = 0;
+
+    for (; i + LANES <= n; i += LANES) {
+        vec r, g, b, a, d0, d1, d2, d3;
+
+        load4(&src[4 * i], &r, &g, &b, &a);
+        load4(&dst[4 * i], &d0, &d1, &d2, &d3);
+        a = Alpha(a, alpha);
+        if (swap_rb) {
+            vec t = r;
+            r = b;
+            b = t;
+        }
+        store4(&dst[4 * i], Merge(d0, r, a), Merge(d1, g, a),
+               Merge(d2, b, a), d3);
+    }
+
+    const unsigned offset_r = swap_rb ? 2 : 0;
+    for (; i < n; i++) {
+        const unsigned a = div255(alpha * src[4 * i + 3]);
+        ::merge(&dst[4 * i + offset_r], src[4 * i + 0], a);
+        ::merge(&dst[4 * i + 1], src[4 * i + 1], a);
+        ::merge(&dst[4 * i + 2 - offset_r], src[4 * i + 2], a);
+    }
+}
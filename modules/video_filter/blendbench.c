@@ -215,53 +215,134 @@ static void Destroy( vlc_object_t *p_this )
 }
 
 /*****************************************************************************
- * Render: displays previously rendered output
+ * blendbench_Run: blends once onto p_out, then times the blending loops
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+static int blendbench_Run( filter_t *p_filter, bool b_simd, picture_t *p_out,
+                           picture_t *p_work, mtime_t *pi_time )
 {
     filter_sys_t *p_sys = p_filter->p_sys;
     filter_t *p_blend;
 
-    if( p_sys->b_done )
-        return p_pic;
-
     p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
     if( !p_blend )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
+        return VLC_ENOMEM;
+
+    /* The blend module falls back to its reference routines without SIMD */
+    var_Create( p_blend, "blend-simd", VLC_VAR_BOOL );
+    var_SetBool( p_blend, "blend-simd", b_simd );
+
     p_blend->fmt_out.video = p_sys->p_base_image->format;
     p_blend->fmt_in.video = p_sys->p_blend_image->format;
     p_blend->p_module = module_need( p_blend, "video blending", NULL, false );
     if( !p_blend->p_module )
     {
-        picture_Release( p_pic );
         vlc_object_release( p_blend );
-        return NULL;
+        return VLC_EGENERIC;
     }
 
+    picture_Copy( p_out, p_sys->p_base_image );
+    p_blend->pf_video_blend( p_blend, p_out, p_sys->p_blend_image,
+                             0, 0, p_sys->i_alpha );
+
+    picture_Copy( p_work, p_sys->p_base_image );
     mtime_t time = mdate();
     for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
     {
-        p_blend->pf_video_blend( p_blend,
-                                 p_sys->p_base_image, p_sys->p_blend_image,
+        p_blend->pf_video_blend( p_blend, p_work, p_sys->p_blend_image,
                                  0, 0, p_sys->i_alpha );
     }
-    time = mdate() - time;
+    *pi_time = __MAX( mdate() - time, 1 );
 
-    msg_Info( p_filter, "Blended %d images in %f sec", p_sys->i_loops,
-              time / 1000000.0f );
-    msg_Info( p_filter, "Speed is: %f images/second, %f pixels/second",
-              (float) p_sys->i_loops / time * 1000000,
+    module_unneed( p_blend, p_blend->p_module );
+    vlc_object_release( p_blend );
+    return VLC_SUCCESS;
+}
+
+static void blendbench_Report( filter_t *p_filter, const char *psz_name,
+                               mtime_t time )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    msg_Info( p_filter, "%s: blended %d images in %f sec", psz_name,
+              p_sys->i_loops, time / 1000000.0f );
+    msg_Info( p_filter, "%s: speed is %f images/second, %f pixels/second",
+              psz_name, (float) p_sys->i_loops / time * 1000000,
               (float) p_sys->i_loops / time * 1000000 *
                   p_sys->p_blend_image->p[Y_PLANE].i_visible_pitch *
                   p_sys->p_blend_image->p[Y_PLANE].i_visible_lines );
+}
 
-    module_unneed( p_blend, p_blend->p_module );
+/* Counts the visible bytes differing between two pictures */
+static unsigned blendbench_Compare( const picture_t *p_a, const picture_t *p_b )
+{
+    unsigned i_diff = 0;
 
-    vlc_object_release( p_blend );
+    for( int i = 0; i < p_a->i_planes; i++ )
+    {
+        const plane_t *a = &p_a->p[i], *b = &p_b->p[i];
+
+        for( int y = 0; y < a->i_visible_lines; y++ )
+        {
+            const uint8_t *pa = &a->p_pixels[y * a->i_pitch];
+            const uint8_t *pb = &b->p_pixels[y * b->i_pitch];
+
+            for( int x = 0; x < a->i_visible_pitch; x++ )
+                i_diff += pa[x] != pb[x];
+        }
+    }
+    return i_diff;
+}
 
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const video_format_t *p_fmt = &p_sys->p_base_image->format;
+    mtime_t i_time, i_ref_time;
+
+    if( p_sys->b_done )
+        return p_pic;
     p_sys->b_done = true;
+
+    picture_t *p_out = picture_NewFromFormat( p_fmt );
+    picture_t *p_ref = picture_NewFromFormat( p_fmt );
+    picture_t *p_work = picture_NewFromFormat( p_fmt );
+    if( !p_out || !p_ref || !p_work )
+        goto error;
+
+    if( blendbench_Run( p_filter, true, p_out, p_work, &i_time )
+     || blendbench_Run( p_filter, false, p_ref, p_work, &i_ref_time ) )
+    {
+        msg_Err( p_filter, "cannot blend %4.4s onto %4.4s",
+                 (char *)&p_sys->i_blend_chroma, (char *)&p_sys->i_base_chroma );
+        goto error;
+    }
+
+    blendbench_Report( p_filter, "Optimized", i_time );
+    blendbench_Report( p_filter, "Reference", i_ref_time );
+    msg_Info( p_filter, "Speed-up: %.2fx", (float) i_ref_time / i_time );
+
+    unsigned i_diff = blendbench_Compare( p_out, p_ref );
+    if( i_diff > 0 )
+        msg_Err( p_filter, "%u bytes differ from the reference blending",
+                 i_diff );
+    else
+        msg_Info( p_filter, "Output matches the reference blending" );
+
+    picture_Release( p_out );
+    picture_Release( p_ref );
+    picture_Release( p_work );
     return p_pic;
+
+error:
+    if( p_out )
+        picture_Release( p_out );
+    if( p_ref )
+        picture_Release( p_ref );
+    if( p_work )
+        picture_Release( p_work );
+    picture_Release( p_pic );
+    return NULL;
 }
@@ -32,7 +32,9 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
+#include "../misc/slices.h"
 
 
 #include "hqdn3d.h"
@@ -86,10 +88,19 @@ static const char *const filter_options[] = {
 /*****************************************************************************
  * filter_sys_t
  *****************************************************************************/
+typedef void (*denoise_vertical_t)(const unsigned char *, unsigned char *,
+                                   const unsigned int *, unsigned int *,
+                                   unsigned short *, long, long, int,
+                                   const int *, const int *);
+
 struct filter_sys_t
 {
     const vlc_chroma_description_t *chroma;
     int w[3], h[3];
+    int depth;
+
+    slice_pool_t *pool;
+    denoise_vertical_t pf_vertical;
 
     struct vf_priv_s cfg;
     bool   b_recalc_coefs;
@@ -100,6 +111,30 @@ struct filter_sys_t
 /*****************************************************************************
  * Open
  *****************************************************************************/
+/* Planar chromas with 9 or 10 bits samples in the native byte order */
+static bool IsHighDepth(vlc_fourcc_t fourcc)
+{
+    switch (fourcc) {
+#ifdef WORDS_BIGENDIAN
+        case VLC_CODEC_I420_9B:
+        case VLC_CODEC_I420_10B:
+        case VLC_CODEC_I422_9B:
+        case VLC_CODEC_I422_10B:
+        case VLC_CODEC_I444_9B:
+        case VLC_CODEC_I444_10B:
+#else
+        case VLC_CODEC_I420_9L:
+        case VLC_CODEC_I420_10L:
+        case VLC_CODEC_I422_9L:
+        case VLC_CODEC_I422_10L:
+        case VLC_CODEC_I444_9L:
+        case VLC_CODEC_I444_10L:
+#endif
+            return true;
+    }
+    return false;
+}
+
 static int Open(vlc_object_t *this)
 {
     filter_t *filter = (filter_t *)this;
@@ -113,7 +148,8 @@ static int Open(vlc_object_t *this)
 
     const vlc_chroma_description_t *chroma =
             vlc_fourcc_GetChromaDescription(fourcc_in);
-    if (!chroma || chroma->plane_count != 3 || chroma->pixel_size != 1) {
+    if (!chroma || chroma->plane_count != 3
+     || (chroma->pixel_size != 1 && !IsHighDepth(fourcc_in))) {
         msg_Err(filter, "Unsupported chroma (%4.4s)", (char*)&fourcc_in);
         return VLC_EGENERIC;
     }
@@ -131,6 +167,7 @@ static int Open(vlc_object_t *this)
     cfg = &sys->cfg;
 
     sys->chroma = chroma;
+    sys->depth = chroma->pixel_size == 1 ? 8 : chroma->pixel_bits;
 
     for (int i = 0; i < 3; ++i) {
         sys->w[i] = fmt_in->i_width  * chroma->p[i].w.num / chroma->p[i].w.den;
@@ -138,11 +175,21 @@ static int Open(vlc_object_t *this)
         sys->h[i] = fmt_out->i_height * chroma->p[i].h.num / chroma->p[i].h.den;
     }
     cfg->Line = malloc(wmax*sizeof(unsigned int));
-    if (!cfg->Line) {
+    cfg->Spatial = malloc(ROWS*wmax*sizeof(unsigned int));
+    if (!cfg->Line || !cfg->Spatial) {
+        free(cfg->Spatial);
+        free(cfg->Line);
         free(sys);
         return VLC_ENOMEM;
     }
 
+    sys->pf_vertical = deNoiseRowVertical_C;
+#ifdef HAVE_AVX2_INTRINSICS
+    if (vlc_CPU_AVX2())
+        sys->pf_vertical = deNoiseRowVertical_AVX2;
+#endif
+    sys->pool = SlicePoolNewForSize(this, fmt_in->i_width, fmt_in->i_height);
+
     config_ChainParse(filter, FILTER_PREFIX, filter_options,
                       filter->p_cfg);
 
@@ -181,9 +228,12 @@ static void Close(vlc_object_t *this)
 
     vlc_mutex_destroy( &sys->coefs_mutex );
 
+    if (sys->pool != NULL)
+        SlicePoolDelete(sys->pool);
     for (int i = 0; i < 3; ++i) {
         free(cfg->Frame[i]);
     }
+    free(cfg->Spatial);
     free(cfg->Line);
     free(sys);
 }
@@ -191,6 +241,104 @@ static void Close(vlc_object_t *this)
 /*****************************************************************************
  * Filter
  *****************************************************************************/
+typedef struct
+{
+    filter_sys_t *sys;
+    const plane_t *src;
+    plane_t *dst;
+    unsigned short *FrameAnt;
+    int W, y0, y1;
+    const int *Horizontal, *Vertical, *Temporal;
+} denoise_job_t;
+
+/* Horizontal pass of the rows y0 to y1, split across slices */
+static void HorizontalSlice(void *opaque, unsigned i_slice, unsigned i_count)
+{
+    const denoise_job_t *job = opaque;
+    const int depth = job->sys->depth;
+    const int pitch = job->src->i_pitch;
+    const int rows = job->y1 - job->y0;
+    const int end = SliceRow(rows, i_slice + 1, i_count, 4);
+    const unsigned char *Frame = &job->src->p_pixels[job->y0 * pitch];
+    unsigned int *LineH = job->sys->cfg.Spatial;
+    int y = SliceRow(rows, i_slice, i_count, 4);
+
+    for (; y + 4 <= end; y += 4) {
+        /* Constant depth, so that the 8-bits path gets specialized */
+        if (depth == 8)
+            deNoiseRowsHorizontal4(&Frame[y * pitch], pitch, &LineH[y * job->W],
+                                   job->W, job->W, 8, job->Horizontal);
+        else
+            deNoiseRowsHorizontal4(&Frame[y * pitch], pitch, &LineH[y * job->W],
+                                   job->W, job->W, depth, job->Horizontal);
+    }
+    for (; y < end; y++)
+        deNoiseRowHorizontal(&Frame[y * pitch], &LineH[y * job->W], job->W,
+                             depth, job->Horizontal);
+}
+
+/* Vertical and temporal passes of the rows y0 to y1: the vertical filter is
+ * recursive from the top row, so the slices are bands of columns. */
+static void VerticalSlice(void *opaque, unsigned i_slice, unsigned i_count)
+{
+    const denoise_job_t *job = opaque;
+    const filter_sys_t *sys = job->sys;
+    const long X0 = SliceRow(job->W, i_slice, i_count, 8);
+    const long X1 = SliceRow(job->W, i_slice + 1, i_count, 8);
+
+    for (int y = job->y0; y < job->y1; y++) {
+        const unsigned int *LineH = NULL;
+        const int *Vertical = NULL;
+
+        if (job->Horizontal != NULL) {
+            LineH = &sys->cfg.Spatial[(y - job->y0) * job->W];
+            if (y > 0)
+                Vertical = job->Vertical;
+        }
+        sys->pf_vertical(&job->src->p_pixels[y * job->src->i_pitch],
+                         &job->dst->p_pixels[y * job->dst->i_pitch],
+                         LineH, sys->cfg.Line, &job->FrameAnt[y * job->W],
+                         X0, X1, sys->depth, Vertical, job->Temporal);
+    }
+}
+
+static void DenoisePlane(filter_sys_t *sys, const plane_t *src, plane_t *dst,
+                         int i, const int *Horizontal, const int *Vertical,
+                         const int *Temporal)
+{
+    const int W = sys->w[i], H = sys->h[i];
+    unsigned short *FrameAnt = sys->cfg.Frame[i];
+
+    if (!FrameAnt) {
+        sys->cfg.Frame[i] = FrameAnt = malloc(W*H*sizeof(unsigned short));
+        if (!FrameAnt)
+            return;
+        deNoiseInit(src->p_pixels, FrameAnt, W, H, src->i_pitch, sys->depth);
+    }
+
+    denoise_job_t job = {
+        .sys = sys, .src = src, .dst = dst, .FrameAnt = FrameAnt, .W = W,
+        .Horizontal = Horizontal, .Vertical = Vertical, .Temporal = Temporal,
+    };
+
+    if (!Horizontal[0] && !Vertical[0]) {
+        /* Temporal only */
+        job.Horizontal = job.Vertical = NULL;
+        job.y0 = 0;
+        job.y1 = H;
+        SlicePoolRunAll(sys->pool, VerticalSlice, &job);
+        return;
+    }
+    if (!Temporal[0])
+        job.Temporal = NULL;
+
+    for (job.y0 = 0; job.y0 < H; job.y0 = job.y1) {
+        job.y1 = __MIN(job.y0 + ROWS, H);
+        SlicePoolRunAll(sys->pool, HorizontalSlice, &job);
+        SlicePoolRunAll(sys->pool, VerticalSlice, &job);
+    }
+}
+
 static picture_t *Filter(filter_t *filter, picture_t *src)
 {
     picture_t *dst;
@@ -220,24 +368,12 @@ static picture_t *Filter(filter_t *filter, picture_t *src)
     }
     vlc_mutex_unlock( &sys->coefs_mutex );
 
-    deNoise(src->p[0].p_pixels, dst->p[0].p_pixels,
-            cfg->Line, &cfg->Frame[0], sys->w[0], sys->h[0],
-            src->p[0].i_pitch, dst->p[0].i_pitch,
-            cfg->Coefs[0],
-            cfg->Coefs[0],
-            cfg->Coefs[1]);
-    deNoise(src->p[1].p_pixels, dst->p[1].p_pixels,
-            cfg->Line, &cfg->Frame[1], sys->w[1], sys->h[1],
-            src->p[1].i_pitch, dst->p[1].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
-    deNoise(src->p[2].p_pixels, dst->p[2].p_pixels,
-            cfg->Line, &cfg->Frame[2], sys->w[2], sys->h[2],
-            src->p[2].i_pitch, dst->p[2].i_pitch,
-            cfg->Coefs[2],
-            cfg->Coefs[2],
-            cfg->Coefs[3]);
+    DenoisePlane(sys, &src->p[0], &dst->p[0], 0,
+                 cfg->Coefs[0], cfg->Coefs[0], cfg->Coefs[1]);
+    DenoisePlane(sys, &src->p[1], &dst->p[1], 1,
+                 cfg->Coefs[2], cfg->Coefs[2], cfg->Coefs[3]);
+    DenoisePlane(sys, &src->p[2], &dst->p[2], 2,
+                 cfg->Coefs[2], cfg->Coefs[2], cfg->Coefs[3]);
 
     if(unlikely(!cfg->Frame[0] || !cfg->Frame[1] || !cfg->Frame[2]))
     {
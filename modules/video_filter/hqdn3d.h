@@ -33,151 +33,216 @@
 struct vf_priv_s {
         int Coefs[4][512*16];
         unsigned int *Line;
+        unsigned int *Spatial; /* horizontally filtered rows, see ROWS */
         unsigned short *Frame[3];
 };
 
+/* Number of rows filtered horizontally before the vertical and temporal
+ * passes run on them */
+#define ROWS 64
 
 /***************************************************************************/
 
-static /*inline*/ unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul, int* Coef){
+/* Samples of Depth bits are scaled to 24 bits (Shift = 24 - Depth), so that
+ * all depths share the same coefficient tables. The previous frame keeps the
+ * 16 most significant bits. */
+
+static inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul, const int* Coef){
 //    int dMul= (PrevMul&0xFFFFFF)-(CurrMul&0xFFFFFF);
     int dMul= PrevMul-CurrMul;
     unsigned int d=((dMul+0x10007FF)>>12);
     return CurrMul + Coef[d];
 }
 
-static void deNoiseTemporal(
-                    unsigned char *Frame,        // mpi->planes[x]
-                    unsigned char *FrameDest,    // dmpi->planes[x]
-                    unsigned short *FrameAnt,
-                    int W, int H, int sStride, int dStride,
-                    int *Temporal)
+static inline unsigned int ReadPixel(const unsigned char *Frame, long X, int Depth)
 {
-    unsigned int PixelDst;
+    /* Out of range samples would overflow the coefficient tables */
+    if (Depth > 8)
+        return ((const uint16_t *)Frame)[X] & ((1 << Depth) - 1);
+    return Frame[X];
+}
 
-    for (long Y = 0; Y < H; Y++){
-        for (long X = 0; X < W; X++){
-            PixelDst = LowPassMul(FrameAnt[X]<<8, Frame[X]<<16, Temporal);
-            FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
-        }
-        Frame += sStride;
-        FrameDest += dStride;
-        FrameAnt += W;
-    }
+static inline void WritePixel(unsigned char *FrameDest, long X, int Depth,
+                              unsigned int PixelDst)
+{
+    const int Shift = 24 - Depth;
+    unsigned int v = ((PixelDst + 0x10000000 + (1 << (Shift - 1)) - 1) >> Shift)
+                   & ((1 << Depth) - 1);
+
+    if (Depth > 8)
+        ((uint16_t *)FrameDest)[X] = v;
+    else
+        FrameDest[X] = v;
 }
 
-static void deNoiseSpacial(
-                    unsigned char *Frame,        // mpi->planes[x]
-                    unsigned char *FrameDest,    // dmpi->planes[x]
-                    unsigned int *LineAnt,       // vf->priv->Line (width bytes)
-                    int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical)
+/* Horizontal pass of one row: each pixel is low-passed with its left
+ * neighbour. */
+static inline void deNoiseRowHorizontal(const unsigned char *Frame,
+                                        unsigned int *LineH, int W, int Depth,
+                                        const int *Horizontal)
 {
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
-    unsigned int PixelDst;
+    const int Shift = 24 - Depth;
+    unsigned int PixelAnt = LineH[0] = ReadPixel(Frame, 0, Depth) << Shift;
+
+    for (long X = 1; X < W; X++)
+        LineH[X] = PixelAnt = LowPassMul(PixelAnt,
+                                         ReadPixel(Frame, X, Depth) << Shift,
+                                         Horizontal);
+}
 
-    /* First pixel has no left nor top neighbor. */
-    PixelDst = LineAnt[0] = PixelAnt = Frame[0]<<16;
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+/* Same as deNoiseRowHorizontal() for 4 rows at once: the filter is serial
+ * within a row, interleaving independent rows hides the table latency. */
+static inline void deNoiseRowsHorizontal4(const unsigned char *Frame,
+                                          int sStride, unsigned int *LineH,
+                                          int hStride, int W, int Depth,
+                                          const int *Horizontal)
+{
+    const int Shift = 24 - Depth;
+    const unsigned char *F0 = Frame, *F1 = F0 + sStride,
+                        *F2 = F1 + sStride, *F3 = F2 + sStride;
+    unsigned int *L0 = LineH, *L1 = L0 + hStride,
+                 *L2 = L1 + hStride, *L3 = L2 + hStride;
+    unsigned int P0 = L0[0] = ReadPixel(F0, 0, Depth) << Shift;
+    unsigned int P1 = L1[0] = ReadPixel(F1, 0, Depth) << Shift;
+    unsigned int P2 = L2[0] = ReadPixel(F2, 0, Depth) << Shift;
+    unsigned int P3 = L3[0] = ReadPixel(F3, 0, Depth) << Shift;
 
-    /* First line has no top neighbor, only left. */
     for (long X = 1; X < W; X++){
-        PixelDst = LineAnt[X] = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
+        L0[X] = P0 = LowPassMul(P0, ReadPixel(F0, X, Depth) << Shift, Horizontal);
+        L1[X] = P1 = LowPassMul(P1, ReadPixel(F1, X, Depth) << Shift, Horizontal);
+        L2[X] = P2 = LowPassMul(P2, ReadPixel(F2, X, Depth) << Shift, Horizontal);
+        L3[X] = P3 = LowPassMul(P3, ReadPixel(F3, X, Depth) << Shift, Horizontal);
     }
+}
+
+/* Vertical and temporal passes of the pixels X0 to X1 of one row.
+ * LineH is the horizontally filtered row, or NULL without spatial filter.
+ * Vertical is NULL on the first row, Temporal is NULL without temporal
+ * filter. */
+static inline void deNoiseRowVertical_C(const unsigned char *Frame,
+                                        unsigned char *FrameDest,
+                                        const unsigned int *LineH,
+                                        unsigned int *LineAnt,
+                                        unsigned short *FrameAnt,
+                                        long X0, long X1, int Depth,
+                                        const int *Vertical,
+                                        const int *Temporal)
+{
+    const int Shift = 24 - Depth;
 
-    for (long Y = 1; Y < H; Y++){
-        unsigned int PixelAnt;
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        PixelDst = LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (long X = 1; X < W; X++){
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+    for (long X = X0; X < X1; X++){
+        unsigned int PixelDst;
+
+        if (LineH == NULL)
+            PixelDst = ReadPixel(Frame, X, Depth) << Shift;
+        else if (Vertical == NULL)
+            PixelDst = LineAnt[X] = LineH[X];
+        else
+            PixelDst = LineAnt[X] = LowPassMul(LineAnt[X], LineH[X], Vertical);
+
+        if (Temporal != NULL){
+            PixelDst = LowPassMul(FrameAnt[X]<<8, PixelDst, Temporal);
+            FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
         }
+        WritePixel(FrameDest, X, Depth, PixelDst);
     }
 }
 
-static void deNoise(unsigned char *Frame,        // mpi->planes[x]
-                    unsigned char *FrameDest,    // dmpi->planes[x]
-                    unsigned int *LineAnt,      // vf->priv->Line (width bytes)
-                    unsigned short **FrameAntPtr,
-                    int W, int H, int sStride, int dStride,
-                    int *Horizontal, int *Vertical, int *Temporal)
+#ifdef HAVE_AVX2_INTRINSICS
+# include <immintrin.h>
+
+/* Narrows 8 32-bits lanes (below 65536) to 16 bits */
+__attribute__ ((__target__ ("avx2")))
+static inline __m128i Pack32To16(__m256i v)
 {
-    long sLineOffs = 0, dLineOffs = 0;
-    unsigned int PixelAnt;
-    unsigned int PixelDst;
-    unsigned short* FrameAnt=(*FrameAntPtr);
-
-    if(!FrameAnt){
-        (*FrameAntPtr)=FrameAnt=malloc(W*H*sizeof(unsigned short));
-        if(!FrameAnt)
-            return;
-        for (long Y = 0; Y < H; Y++){
-            unsigned short* dst=&FrameAnt[Y*W];
-            unsigned char* src=Frame+Y*sStride;
-            for (long X = 0; X < W; X++) dst[X]=src[X]<<8;
-        }
-    }
+    v = _mm256_packus_epi32(v, v);
+    return _mm256_castsi256_si128(_mm256_permute4x64_epi64(v, 0x08));
+}
 
-    if(!Horizontal[0] && !Vertical[0]){
-        deNoiseTemporal(Frame, FrameDest, FrameAnt,
-                        W, H, sStride, dStride, Temporal);
-        return;
-    }
-    if(!Temporal[0]){
-        deNoiseSpacial(Frame, FrameDest, LineAnt,
-                       W, H, sStride, dStride, Horizontal, Vertical);
-        return;
-    }
+__attribute__ ((__target__ ("avx2")))
+static inline __m256i LowPassMul8(__m256i PrevMul, __m256i CurrMul,
+                                  const int *Coef)
+{
+    __m256i d = _mm256_srli_epi32(_mm256_add_epi32(
+                    _mm256_sub_epi32(PrevMul, CurrMul),
+                    _mm256_set1_epi32(0x10007FF)), 12);
+    return _mm256_add_epi32(CurrMul, _mm256_i32gather_epi32(Coef, d, 4));
+}
 
-    /* First pixel has no left nor top neighbor. Only previous frame */
-    LineAnt[0] = PixelAnt = Frame[0]<<16;
-    PixelDst = LowPassMul(FrameAnt[0]<<8, PixelAnt, Temporal);
-    FrameAnt[0] = ((PixelDst+0x1000007F)>>8);
-    FrameDest[0]= ((PixelDst+0x10007FFF)>>16);
+/* AVX2 version of deNoiseRowVertical_C(), 8 pixels at a time */
+__attribute__ ((__target__ ("avx2")))
+static void deNoiseRowVertical_AVX2(const unsigned char *Frame,
+                                    unsigned char *FrameDest,
+                                    const unsigned int *LineH,
+                                    unsigned int *LineAnt,
+                                    unsigned short *FrameAnt,
+                                    long X0, long X1, int Depth,
+                                    const int *Vertical, const int *Temporal)
+{
+    const int Shift = 24 - Depth;
+    const __m128i vShift = _mm_cvtsi32_si128(Shift);
+    const __m256i Round = _mm256_set1_epi32(0x10000000 + (1 << (Shift - 1)) - 1);
+    const __m256i Max = _mm256_set1_epi32((1 << Depth) - 1);
+    long X = X0;
 
-    /* First line has no top neighbor. Only left one for each pixel and
-     * last frame */
-    for (long X = 1; X < W; X++){
-        LineAnt[X] = PixelAnt = LowPassMul(PixelAnt, Frame[X]<<16, Horizontal);
-        PixelDst = LowPassMul(FrameAnt[X]<<8, PixelAnt, Temporal);
-        FrameAnt[X] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[X]= ((PixelDst+0x10007FFF)>>16);
-    }
+    for (; X + 8 <= X1; X += 8){
+        __m256i PixelDst;
+
+        if (LineH == NULL){
+            __m256i v;
+            if (Depth > 8)
+                v = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm_loadu_si128(
+                                (const __m128i *)&((const uint16_t *)Frame)[X])),
+                                     Max);
+            else
+                v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+                                (const __m128i *)&Frame[X]));
+            PixelDst = _mm256_sll_epi32(v, vShift);
+        }else{
+            PixelDst = _mm256_loadu_si256((const __m256i *)&LineH[X]);
+            if (Vertical != NULL)
+                PixelDst = LowPassMul8(
+                        _mm256_loadu_si256((const __m256i *)&LineAnt[X]),
+                        PixelDst, Vertical);
+            _mm256_storeu_si256((__m256i *)&LineAnt[X], PixelDst);
+        }
 
-    for (long Y = 1; Y < H; Y++){
-        unsigned int PixelAnt;
-        unsigned short* LinePrev=&FrameAnt[Y*W];
-        sLineOffs += sStride, dLineOffs += dStride;
-        /* First pixel on each line doesn't have previous pixel */
-        PixelAnt = Frame[sLineOffs]<<16;
-        LineAnt[0] = LowPassMul(LineAnt[0], PixelAnt, Vertical);
-        PixelDst = LowPassMul(LinePrev[0]<<8, LineAnt[0], Temporal);
-        LinePrev[0] = ((PixelDst+0x1000007F)>>8);
-        FrameDest[dLineOffs]= ((PixelDst+0x10007FFF)>>16);
-
-        for (long X = 1; X < W; X++){
-            unsigned int PixelDst;
-            /* The rest are normal */
-            PixelAnt = LowPassMul(PixelAnt, Frame[sLineOffs+X]<<16, Horizontal);
-            LineAnt[X] = LowPassMul(LineAnt[X], PixelAnt, Vertical);
-            PixelDst = LowPassMul(LinePrev[X]<<8, LineAnt[X], Temporal);
-            LinePrev[X] = ((PixelDst+0x1000007F)>>8);
-            FrameDest[dLineOffs+X]= ((PixelDst+0x10007FFF)>>16);
+        if (Temporal != NULL){
+            __m256i Ant = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+                                        (const __m128i *)&FrameAnt[X]));
+            PixelDst = LowPassMul8(_mm256_slli_epi32(Ant, 8), PixelDst,
+                                   Temporal);
+            Ant = _mm256_srli_epi32(_mm256_add_epi32(PixelDst,
+                                    _mm256_set1_epi32(0x1000007F)), 8);
+            Ant = _mm256_and_si256(Ant, _mm256_set1_epi32(0xFFFF));
+            _mm_storeu_si128((__m128i *)&FrameAnt[X], Pack32To16(Ant));
         }
+
+        __m256i v = _mm256_and_si256(_mm256_srl_epi32(
+                        _mm256_add_epi32(PixelDst, Round), vShift), Max);
+        __m128i v16 = Pack32To16(v);
+        if (Depth > 8)
+            _mm_storeu_si128((__m128i *)&((uint16_t *)FrameDest)[X], v16);
+        else
+            _mm_storel_epi64((__m128i *)&FrameDest[X],
+                             _mm_packus_epi16(v16, v16));
     }
+    deNoiseRowVertical_C(Frame, FrameDest, LineH, LineAnt, FrameAnt,
+                         X, X1, Depth, Vertical, Temporal);
 }
+#endif
 
+/* Initializes the previous frame from the first one */
+static void deNoiseInit(const unsigned char *Frame, unsigned short *FrameAnt,
+                        int W, int H, int sStride, int Depth)
+{
+    for (long Y = 0; Y < H; Y++){
+        unsigned short* dst=&FrameAnt[Y*W];
+        const unsigned char* src=Frame+Y*sStride;
+        for (long X = 0; X < W; X++)
+            dst[X]=ReadPixel(src, X, Depth)<<(16-Depth);
+    }
+}
 
 //===========================================================================//
 
@@ -32,22 +32,29 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 
+#include <assert.h>
 #include <math.h>
 #include <limits.h> /* INT_MAX */
 
 #include <vlc_filter.h>
 #include <vlc_image.h>
+#include <vlc_picture_pool.h>
 
 #include "mosaic.h"
+#include "../misc/slices.h"
 
 #define BLANK_DELAY INT64_C(1000000)
 
+/* Canvas pictures: one being drawn, others held by the video output */
+#define CANVAS_COUNT 3
+
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 static int  CreateFilter    ( vlc_object_t * );
 static void DestroyFilter   ( vlc_object_t * );
 static subpicture_t *Filter ( filter_t *, mtime_t );
+static void ResetTiles       ( filter_sys_t *, int );
 
 static int MosaicCallback   ( vlc_object_t *, char const *, vlc_value_t,
                               vlc_value_t, void * );
@@ -55,6 +62,26 @@ static int MosaicCallback   ( vlc_object_t *, char const *, vlc_value_t,
 /*****************************************************************************
  * filter_sys_t : filter descriptor
  *****************************************************************************/
+
+/* Slot of the canvas */
+typedef struct
+{
+    picture_t *p_source;      /* Displayed picture of the element (held) */
+    picture_t *p_scaled;      /* Same picture scaled to the canvas format */
+    image_handler_t *p_image;
+    int i_alpha;              /* Alpha of the element */
+    unsigned i_stamp;         /* Changes with p_scaled, 0 if blank */
+    bool b_used;              /* Element found during this frame */
+} mosaic_tile_t;
+
+/* Picture of the canvas pool */
+typedef struct
+{
+    const uint8_t *p_pixels;  /* Identifies the pool picture */
+    unsigned i_generation;    /* Layout the picture was drawn with */
+    unsigned *pi_stamps;      /* Stamp of the tile drawn in each slot */
+} mosaic_canvas_t;
+
 struct filter_sys_t
 {
     vlc_mutex_t lock;         /* Internal filter lock */
@@ -79,6 +106,21 @@ struct filter_sys_t
     int i_offsets_length;
 
     mtime_t i_delay;
+
+    /* Shared canvas */
+    bool b_canvas;
+    slice_pool_t *p_slices;
+    picture_pool_t *p_canvas_pool;
+    video_format_t canvas_fmt;
+    mosaic_canvas_t canvases[CANVAS_COUNT];
+    mosaic_tile_t *p_tiles;
+    int i_tiles;
+    unsigned i_generation;
+    struct
+    {
+        int i_rows, i_cols, i_borderw, i_borderh;
+        bool b_ar;
+    } layout;                 /* Layout of the tiles */
 };
 
 /*****************************************************************************
@@ -151,6 +193,14 @@ struct filter_sys_t
         "(only used if positioning method is set to \"offsets\"). You " \
         "must give a comma-separated list of coordinates (eg: 10,10,150,10)." )
 
+#define CANVAS_TEXT N_("Shared canvas")
+#define CANVAS_LONGTEXT N_( \
+        "Compose the elements in a persistent picture: each new picture " \
+        "of an element is scaled once, in parallel with the others, and " \
+        "only the changed elements are redrawn. Not used with the " \
+        "\"offsets\" positioning method, the original picture size or " \
+        "elements positioned by the \"mosaic-bridge\" module." )
+
 #define DELAY_TEXT N_("Delay")
 #define DELAY_LONGTEXT N_( \
         "Pictures coming from the mosaic elements will be delayed " \
@@ -223,13 +273,16 @@ vlc_module_begin ()
 
     add_integer( CFG_PREFIX "delay", 0, DELAY_TEXT, DELAY_LONGTEXT,
                  false )
+
+    add_bool( CFG_PREFIX "canvas", false, CANVAS_TEXT, CANVAS_LONGTEXT,
+              true )
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
     "alpha", "height", "width", "align", "xoffset", "yoffset",
     "borderw", "borderh", "position", "rows", "cols",
     "keep-aspect-ratio", "keep-picture", "order", "offsets",
-    "delay", NULL
+    "delay", "canvas", NULL
 };
 
 /*****************************************************************************
@@ -285,7 +338,7 @@ static int CreateFilter( vlc_object_t *p_this )
     int i_command;
 
     /* Allocate structure */
-    p_sys = p_filter->p_sys = malloc( sizeof( filter_sys_t ) );
+    p_sys = p_filter->p_sys = calloc( 1, sizeof( filter_sys_t ) );
     if( p_sys == NULL )
         return VLC_ENOMEM;
 
@@ -367,6 +420,11 @@ static int CreateFilter( vlc_object_t *p_this )
     free( psz_offsets );
     var_AddCallback( p_filter, CFG_PREFIX "offsets", MosaicCallback, p_sys );
 
+    p_sys->b_canvas = var_InheritBool( p_filter, CFG_PREFIX "canvas" )
+                   && !p_sys->b_keep;
+    if( p_sys->b_canvas )
+        p_sys->p_slices = SlicePoolNew( p_this, SLICE_MAX_THREADS );
+
     vlc_mutex_unlock( &p_sys->lock );
 
     return VLC_SUCCESS;
@@ -406,6 +464,14 @@ static void DestroyFilter( vlc_object_t *p_this )
         image_HandlerDelete( p_sys->p_image );
     }
 
+    ResetTiles( p_sys, 0 );
+    for( int i = 0; i < CANVAS_COUNT; i++ )
+        free( p_sys->canvases[i].pi_stamps );
+    if( p_sys->p_canvas_pool != NULL )
+        picture_pool_Release( p_sys->p_canvas_pool );
+    if( p_sys->p_slices != NULL )
+        SlicePoolDelete( p_sys->p_slices );
+
     if( p_sys->i_order_length )
     {
         for( int i_index = 0; i_index < p_sys->i_order_length; i_index++ )
@@ -425,6 +491,517 @@ static void DestroyFilter( vlc_object_t *p_this )
     free( p_sys );
 }
 
+/*****************************************************************************
+ * ComputeGrid: number of rows and columns for the automatic positioning
+ *****************************************************************************/
+static void ComputeGrid( filter_sys_t *p_sys, const bridge_t *p_bridge )
+{
+    int i_numpics = p_sys->i_order_length; /* keep slots and all */
+    for( int i_index = 0; i_index < p_bridge->i_es_num; i_index++ )
+    {
+        bridged_es_t *p_es = p_bridge->pp_es[i_index];
+        if ( !p_es->b_empty )
+        {
+            i_numpics ++;
+            if( p_sys->i_order_length && p_es->psz_id != NULL )
+            {
+                /* We also want to leave slots for images given in
+                 * mosaic-order that are not available in p_vout_picture */
+                for( int i = 0; i < p_sys->i_order_length ; i++ )
+                {
+                    if( !strcmp( p_sys->ppsz_order[i], p_es->psz_id ) )
+                    {
+                        i_numpics--;
+                        break;
+                    }
+                }
+
+            }
+        }
+    }
+    p_sys->i_rows = ceil(sqrt( (double)i_numpics ));
+    p_sys->i_cols = ( i_numpics % p_sys->i_rows == 0 ?
+                        i_numpics / p_sys->i_rows :
+                        i_numpics / p_sys->i_rows + 1 );
+}
+
+/*****************************************************************************
+ * UpdatePicture: drops the pictures of an element which are too old
+ *****************************************************************************/
+static void UpdatePicture( filter_t *p_filter, bridged_es_t *p_es,
+                           mtime_t date )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    while ( p_es->p_picture != NULL
+             && p_es->p_picture->date + p_sys->i_delay < date )
+    {
+        if ( p_es->p_picture->p_next != NULL )
+        {
+            picture_t *p_next = p_es->p_picture->p_next;
+            picture_Release( p_es->p_picture );
+            p_es->p_picture = p_next;
+        }
+        else if ( p_es->p_picture->date + p_sys->i_delay + BLANK_DELAY <
+                    date )
+        {
+            /* Display blank */
+            picture_Release( p_es->p_picture );
+            p_es->p_picture = NULL;
+            p_es->pp_last = &p_es->p_picture;
+            break;
+        }
+        else
+        {
+            msg_Dbg( p_filter, "too late picture for %s (%"PRId64 ")",
+                     p_es->psz_id,
+                     date - p_es->p_picture->date - p_sys->i_delay );
+            break;
+        }
+    }
+}
+
+/*****************************************************************************
+ * GetIndex: position of an element in the mosaic, from mosaic-order
+ *****************************************************************************/
+static int GetIndex( const filter_sys_t *p_sys, const bridged_es_t *p_es,
+                     int i_real_index, int *pi_greatest_real_index_used )
+{
+    if ( p_sys->i_order_length == 0 )
+        return i_real_index + 1;
+
+    for ( int i = 0; i < p_sys->i_order_length; i++ )
+        if ( strcmp( p_es->psz_id, p_sys->ppsz_order[i] ) == 0 )
+            return i;
+    return ++*pi_greatest_real_index_used;
+}
+
+/*****************************************************************************
+ * FitAspectRatio: shrinks the output format to the input aspect ratio
+ *****************************************************************************/
+static void FitAspectRatio( video_format_t *p_fmt_out,
+                            const video_format_t *p_fmt_in )
+{
+    if( (float)p_fmt_out->i_width / (float)p_fmt_out->i_height
+          > (float)p_fmt_in->i_width / (float)p_fmt_in->i_height )
+    {
+        p_fmt_out->i_width = ( p_fmt_out->i_height * p_fmt_in->i_width )
+                             / p_fmt_in->i_height;
+    }
+    else
+    {
+        p_fmt_out->i_height = ( p_fmt_out->i_width * p_fmt_in->i_height )
+                              / p_fmt_in->i_width;
+    }
+}
+
+/*****************************************************************************
+ * ResetTiles: releases the tiles of the canvas and allocates i_tiles new ones
+ *****************************************************************************/
+static void ResetTiles( filter_sys_t *p_sys, int i_tiles )
+{
+    for( int i = 0; i < p_sys->i_tiles; i++ )
+    {
+        mosaic_tile_t *p_tile = &p_sys->p_tiles[i];
+
+        if( p_tile->p_source != NULL )
+            picture_Release( p_tile->p_source );
+        if( p_tile->p_scaled != NULL )
+            picture_Release( p_tile->p_scaled );
+        if( p_tile->p_image != NULL )
+            image_HandlerDelete( p_tile->p_image );
+    }
+    free( p_sys->p_tiles );
+    p_sys->p_tiles = NULL;
+    p_sys->i_tiles = 0;
+
+    if( i_tiles <= 0 )
+        return;
+
+    p_sys->p_tiles = calloc( i_tiles, sizeof( *p_sys->p_tiles ) );
+    if( unlikely(p_sys->p_tiles == NULL) )
+        return;
+
+    for( int i = 0; i < CANVAS_COUNT; i++ )
+    {
+        mosaic_canvas_t *p_canvas = &p_sys->canvases[i];
+        unsigned *pi_stamps = realloc( p_canvas->pi_stamps,
+                                       i_tiles * sizeof( *pi_stamps ) );
+        if( unlikely(pi_stamps == NULL) )
+        {
+            free( p_sys->p_tiles );
+            p_sys->p_tiles = NULL;
+            return;
+        }
+        p_canvas->pi_stamps = pi_stamps;
+    }
+    p_sys->i_tiles = i_tiles;
+}
+
+/*****************************************************************************
+ * UpdateCanvas: follows the size and the layout of the mosaic
+ *****************************************************************************/
+static bool UpdateCanvas( filter_t *p_filter )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->p_canvas_pool == NULL
+     || p_sys->canvas_fmt.i_width != (unsigned)p_sys->i_width
+     || p_sys->canvas_fmt.i_height != (unsigned)p_sys->i_height )
+    {
+        if( p_sys->p_canvas_pool != NULL )
+            picture_pool_Release( p_sys->p_canvas_pool );
+        for( int i = 0; i < CANVAS_COUNT; i++ )
+            p_sys->canvases[i].p_pixels = NULL;
+
+        video_format_Init( &p_sys->canvas_fmt, VLC_CODEC_YUVA );
+        p_sys->canvas_fmt.i_width =
+        p_sys->canvas_fmt.i_visible_width = p_sys->i_width;
+        p_sys->canvas_fmt.i_height =
+        p_sys->canvas_fmt.i_visible_height = p_sys->i_height;
+        p_sys->canvas_fmt.i_sar_num = p_sys->canvas_fmt.i_sar_den = 1;
+
+        p_sys->p_canvas_pool = picture_pool_NewFromFormat( &p_sys->canvas_fmt,
+                                                           CANVAS_COUNT );
+        if( p_sys->p_canvas_pool == NULL )
+        {
+            msg_Err( p_filter, "cannot allocate the mosaic canvas" );
+            return false;
+        }
+        p_sys->i_generation++;
+    }
+
+    const int i_tiles = p_sys->i_rows * p_sys->i_cols;
+    if( p_sys->i_tiles != i_tiles
+     || p_sys->layout.i_rows != p_sys->i_rows
+     || p_sys->layout.i_cols != p_sys->i_cols
+     || p_sys->layout.i_borderw != p_sys->i_borderw
+     || p_sys->layout.i_borderh != p_sys->i_borderh
+     || p_sys->layout.b_ar != p_sys->b_ar )
+    {
+        ResetTiles( p_sys, i_tiles );
+        if( p_sys->i_tiles != i_tiles )
+            return false;
+
+        p_sys->layout.i_rows = p_sys->i_rows;
+        p_sys->layout.i_cols = p_sys->i_cols;
+        p_sys->layout.i_borderw = p_sys->i_borderw;
+        p_sys->layout.i_borderh = p_sys->i_borderh;
+        p_sys->layout.b_ar = p_sys->b_ar;
+        p_sys->i_generation++;
+    }
+    return true;
+}
+
+/*****************************************************************************
+ * CanvasUsable: whether the elements can be drawn into the shared canvas
+ *****************************************************************************/
+static bool CanvasUsable( const filter_sys_t *p_sys, const bridge_t *p_bridge )
+{
+    if( !p_sys->b_canvas || p_sys->i_position == position_offsets
+     || p_sys->i_rows <= 0 || p_sys->i_cols <= 0
+     || p_sys->i_rows > 64 || p_sys->i_cols > 64 )
+        return false;
+
+    /* Each slot must be at least one pixel large */
+    if( p_sys->i_width - ( p_sys->i_cols - 1 ) * p_sys->i_borderw
+            < p_sys->i_cols
+     || p_sys->i_height - ( p_sys->i_rows - 1 ) * p_sys->i_borderh
+            < p_sys->i_rows )
+        return false;
+
+    /* Elements positioned by the bridge may lie outside of the canvas */
+    for( int i_index = 0; i_index < p_bridge->i_es_num; i_index++ )
+    {
+        const bridged_es_t *p_es = p_bridge->pp_es[i_index];
+        if( !p_es->b_empty && p_es->i_x >= 0 && p_es->i_y >= 0 )
+            return false;
+    }
+    return true;
+}
+
+typedef struct
+{
+    filter_t *p_filter;
+    unsigned i_width, i_height; /* Inner size of a slot */
+} scale_job_t;
+
+/*****************************************************************************
+ * ScaleTile: converts the new picture of a tile to the canvas format
+ *****************************************************************************/
+static void ScaleTile( void *opaque, unsigned i_slot, unsigned i_count )
+{
+    const scale_job_t *p_job = opaque;
+    filter_sys_t *p_sys = p_job->p_filter->p_sys;
+    mosaic_tile_t *p_tile = &p_sys->p_tiles[i_slot];
+    video_format_t fmt_in, fmt_out;
+
+    VLC_UNUSED(i_count);
+    if( p_tile->p_source == NULL || p_tile->p_scaled != NULL
+     || p_tile->p_image == NULL )
+        return;
+
+    memset( &fmt_in, 0, sizeof( video_format_t ) );
+    memset( &fmt_out, 0, sizeof( video_format_t ) );
+
+    fmt_in.i_chroma = p_tile->p_source->format.i_chroma;
+    fmt_in.i_height = p_tile->p_source->format.i_height;
+    fmt_in.i_width = p_tile->p_source->format.i_width;
+
+    fmt_out.i_chroma = VLC_CODEC_YUVA;
+    fmt_out.i_width = p_job->i_width;
+    fmt_out.i_height = p_job->i_height;
+    if( p_sys->b_ar )
+        FitAspectRatio( &fmt_out, &fmt_in );
+    if( fmt_out.i_width == 0 || fmt_out.i_height == 0 )
+        return;
+    fmt_out.i_visible_width = fmt_out.i_width;
+    fmt_out.i_visible_height = fmt_out.i_height;
+
+    p_tile->p_scaled = image_Convert( p_tile->p_image, p_tile->p_source,
+                                      &fmt_in, &fmt_out );
+    if( p_tile->p_scaled == NULL )
+        msg_Warn( p_job->p_filter,
+                  "image resizing and chroma conversion failed" );
+}
+
+/*****************************************************************************
+ * ClearRect: makes a rectangle of the canvas transparent
+ *****************************************************************************/
+static void ClearRect( picture_t *p_canvas, int i_x, int i_y,
+                       int i_width, int i_height )
+{
+    plane_t *p_alpha = &p_canvas->p[A_PLANE];
+
+    for( int y = 0; y < i_height; y++ )
+        memset( &p_alpha->p_pixels[( i_y + y ) * p_alpha->i_pitch + i_x],
+                0, i_width );
+}
+
+/*****************************************************************************
+ * DrawTile: copies a scaled tile into its slot of the canvas
+ *****************************************************************************/
+static void DrawTile( const filter_sys_t *p_sys, picture_t *p_canvas,
+                      int i_slot, int i_inner_width, int i_inner_height )
+{
+    const mosaic_tile_t *p_tile = &p_sys->p_tiles[i_slot];
+    const picture_t *p_scaled = p_tile->p_scaled;
+    const int i_row = i_slot / p_sys->i_cols;
+    const int i_col = i_slot % p_sys->i_cols;
+    const int i_x = i_col * ( p_sys->i_width / p_sys->i_cols )
+                  + ( i_col * p_sys->i_borderw ) / p_sys->i_cols;
+    const int i_y = i_row * ( p_sys->i_height / p_sys->i_rows )
+                  + ( i_row * p_sys->i_borderh ) / p_sys->i_rows;
+    const int i_max_width = __MIN( i_inner_width, p_sys->i_width - i_x );
+    const int i_max_height = __MIN( i_inner_height, p_sys->i_height - i_y );
+
+    if( i_max_width <= 0 || i_max_height <= 0 )
+        return;
+
+    ClearRect( p_canvas, i_x, i_y, i_max_width, i_max_height );
+    if( p_scaled == NULL )
+        return;
+
+    const int i_width = __MIN( (int)p_scaled->format.i_visible_width,
+                               i_max_width );
+    const int i_height = __MIN( (int)p_scaled->format.i_visible_height,
+                                i_max_height );
+
+    for( int i_plane = 0; i_plane < p_canvas->i_planes; i_plane++ )
+    {
+        const plane_t *p_src = &p_scaled->p[i_plane];
+        plane_t *p_dst = &p_canvas->p[i_plane];
+
+        for( int y = 0; y < i_height; y++ )
+        {
+            const uint8_t *p_in = &p_src->p_pixels[y * p_src->i_pitch];
+            uint8_t *p_out = &p_dst->p_pixels[( i_y + y ) * p_dst->i_pitch
+                                              + i_x];
+
+            if( i_plane == A_PLANE && p_tile->i_alpha != 255 )
+            {
+                /* The element alpha is applied once, when drawing */
+                for( int x = 0; x < i_width; x++ )
+                    p_out[x] = ( p_in[x] * p_tile->i_alpha + 127 ) / 255;
+            }
+            else
+                memcpy( p_out, p_in, i_width );
+        }
+    }
+}
+
+/*****************************************************************************
+ * GetCanvas: picture of the canvas pool with the slots it was drawn with
+ *****************************************************************************/
+static mosaic_canvas_t *GetCanvas( filter_sys_t *p_sys, picture_t *p_pic )
+{
+    mosaic_canvas_t *p_free = NULL;
+
+    for( int i = 0; i < CANVAS_COUNT; i++ )
+    {
+        mosaic_canvas_t *p_canvas = &p_sys->canvases[i];
+
+        if( p_canvas->p_pixels == p_pic->p[0].p_pixels )
+            return p_canvas;
+        if( p_canvas->p_pixels == NULL && p_free == NULL )
+            p_free = p_canvas;
+    }
+
+    /* The pool has CANVAS_COUNT pictures */
+    assert( p_free != NULL );
+    p_free->p_pixels = p_pic->p[0].p_pixels;
+    p_free->i_generation = p_sys->i_generation - 1;
+    return p_free;
+}
+
+/*****************************************************************************
+ * FilterCanvas: draws the elements into a single region
+ *****************************************************************************
+ * This is called with both locks held, and releases VLC_MOSAIC_MUTEX. The
+ * elements are scaled only when they get a new picture, on several threads,
+ * and only their slots are redrawn in the recycled canvas picture.
+ *****************************************************************************/
+static bool FilterCanvas( filter_t *p_filter, subpicture_t *p_spu,
+                          bridge_t *p_bridge, mtime_t date )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    int i_real_index = 0;
+    int i_greatest_real_index_used = p_sys->i_order_length - 1;
+    unsigned i_pending = 0;
+
+    if( !UpdateCanvas( p_filter ) )
+    {
+        vlc_global_unlock( VLC_MOSAIC_MUTEX );
+        return false;
+    }
+
+    for( int i = 0; i < p_sys->i_tiles; i++ )
+        p_sys->p_tiles[i].b_used = false;
+
+    /* Pick the current picture of each element */
+    for( int i_index = 0; i_index < p_bridge->i_es_num; i_index++ )
+    {
+        bridged_es_t *p_es = p_bridge->pp_es[i_index];
+
+        if ( p_es->b_empty )
+            continue;
+
+        UpdatePicture( p_filter, p_es, date );
+        if ( p_es->p_picture == NULL )
+            continue;
+
+        i_real_index = GetIndex( p_sys, p_es, i_real_index,
+                                 &i_greatest_real_index_used );
+
+        const int i_slot = ( ( i_real_index / p_sys->i_cols ) % p_sys->i_rows )
+                           * p_sys->i_cols + i_real_index % p_sys->i_cols;
+        mosaic_tile_t *p_tile = &p_sys->p_tiles[i_slot];
+
+        /* Several elements in the same slot: the first one wins */
+        if( p_tile->b_used )
+            continue;
+        p_tile->b_used = true;
+
+        if( p_tile->i_alpha != p_es->i_alpha )
+        {
+            p_tile->i_alpha = p_es->i_alpha;
+            p_tile->i_stamp++;
+        }
+        if( p_tile->p_source == p_es->p_picture )
+            continue;
+
+        if( p_tile->p_source != NULL )
+            picture_Release( p_tile->p_source );
+        if( p_tile->p_scaled != NULL )
+            picture_Release( p_tile->p_scaled );
+        p_tile->p_source = picture_Hold( p_es->p_picture );
+        p_tile->p_scaled = NULL;
+        p_tile->i_stamp++;
+        i_pending++;
+    }
+
+    vlc_global_unlock( VLC_MOSAIC_MUTEX );
+
+    /* Elements gone from the bridge leave a blank slot */
+    for( int i = 0; i < p_sys->i_tiles; i++ )
+    {
+        mosaic_tile_t *p_tile = &p_sys->p_tiles[i];
+
+        if( p_tile->b_used || p_tile->p_source == NULL )
+            continue;
+        picture_Release( p_tile->p_source );
+        if( p_tile->p_scaled != NULL )
+            picture_Release( p_tile->p_scaled );
+        p_tile->p_source = NULL;
+        p_tile->p_scaled = NULL;
+        p_tile->i_stamp++;
+    }
+
+    const int i_inner_width = ( p_sys->i_width - ( p_sys->i_cols - 1 )
+                                * p_sys->i_borderw ) / p_sys->i_cols;
+    const int i_inner_height = ( p_sys->i_height - ( p_sys->i_rows - 1 )
+                                 * p_sys->i_borderh ) / p_sys->i_rows;
+
+    if( i_pending > 0 )
+    {
+        scale_job_t job = {
+            .p_filter = p_filter,
+            .i_width = i_inner_width,
+            .i_height = i_inner_height,
+        };
+
+        for( int i = 0; i < p_sys->i_tiles; i++ )
+        {
+            mosaic_tile_t *p_tile = &p_sys->p_tiles[i];
+            if( p_tile->p_source != NULL && p_tile->p_image == NULL )
+                p_tile->p_image = image_HandlerCreate( p_filter );
+        }
+
+        if( p_sys->p_slices != NULL && i_pending > 1 )
+            SlicePoolRun( p_sys->p_slices, ScaleTile, &job, p_sys->i_tiles );
+        else
+            for( int i = 0; i < p_sys->i_tiles; i++ )
+                ScaleTile( &job, i, p_sys->i_tiles );
+    }
+
+    picture_t *p_pic = picture_pool_Get( p_sys->p_canvas_pool );
+    if( p_pic == NULL )
+    {
+        msg_Dbg( p_filter, "no free canvas picture" );
+        return false;
+    }
+
+    mosaic_canvas_t *p_canvas = GetCanvas( p_sys, p_pic );
+    if( p_canvas->i_generation != p_sys->i_generation )
+    {
+        ClearRect( p_pic, 0, 0, p_sys->i_width, p_sys->i_height );
+        memset( p_canvas->pi_stamps, 0,
+                p_sys->i_tiles * sizeof( *p_canvas->pi_stamps ) );
+        p_canvas->i_generation = p_sys->i_generation;
+    }
+
+    for( int i = 0; i < p_sys->i_tiles; i++ )
+    {
+        if( p_canvas->pi_stamps[i] == p_sys->p_tiles[i].i_stamp )
+            continue;
+        DrawTile( p_sys, p_pic, i, i_inner_width, i_inner_height );
+        p_canvas->pi_stamps[i] = p_sys->p_tiles[i].i_stamp;
+    }
+
+    subpicture_region_t *p_region =
+        subpicture_region_NewFromPicture( &p_sys->canvas_fmt, p_pic );
+    if( p_region == NULL )
+    {
+        msg_Err( p_filter, "cannot allocate SPU region" );
+        return false;
+    }
+    p_region->i_x = p_sys->i_xoffset;
+    p_region->i_y = p_sys->i_yoffset;
+    p_region->i_align = p_sys->i_align;
+    p_spu->p_region = p_region;
+    return true;
+}
+
 /*****************************************************************************
  * Filter
  *****************************************************************************/
@@ -484,34 +1061,18 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
     }
 
     if ( p_sys->i_position == position_auto )
+        ComputeGrid( p_sys, p_bridge );
+
+    if ( CanvasUsable( p_sys, p_bridge ) )
     {
-        int i_numpics = p_sys->i_order_length; /* keep slots and all */
-        for( int i_index = 0; i_index < p_bridge->i_es_num; i_index++ )
+        if ( !FilterCanvas( p_filter, p_spu, p_bridge, date ) )
         {
-            bridged_es_t *p_es = p_bridge->pp_es[i_index];
-            if ( !p_es->b_empty )
-            {
-                i_numpics ++;
-                if( p_sys->i_order_length && p_es->psz_id != NULL )
-                {
-                    /* We also want to leave slots for images given in
-                     * mosaic-order that are not available in p_vout_picture */
-                    for( int i = 0; i < p_sys->i_order_length ; i++ )
-                    {
-                        if( !strcmp( p_sys->ppsz_order[i], p_es->psz_id ) )
-                        {
-                            i_numpics--;
-                            break;
-                        }
-                    }
-
-                }
-            }
+            /* The previous subpicture stays on screen */
+            subpicture_Delete( p_spu );
+            p_spu = NULL;
         }
-        p_sys->i_rows = ceil(sqrt( (double)i_numpics ));
-        p_sys->i_cols = ( i_numpics % p_sys->i_rows == 0 ?
-                            i_numpics / p_sys->i_rows :
-                            i_numpics / p_sys->i_rows + 1 );
+        vlc_mutex_unlock( &p_sys->lock );
+        return p_spu;
     }
 
     col_inner_width  = ( ( p_sys->i_width - ( p_sys->i_cols - 1 )
@@ -533,55 +1094,12 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
         if ( p_es->b_empty )
             continue;
 
-        while ( p_es->p_picture != NULL
-                 && p_es->p_picture->date + p_sys->i_delay < date )
-        {
-            if ( p_es->p_picture->p_next != NULL )
-            {
-                picture_t *p_next = p_es->p_picture->p_next;
-                picture_Release( p_es->p_picture );
-                p_es->p_picture = p_next;
-            }
-            else if ( p_es->p_picture->date + p_sys->i_delay + BLANK_DELAY <
-                        date )
-            {
-                /* Display blank */
-                picture_Release( p_es->p_picture );
-                p_es->p_picture = NULL;
-                p_es->pp_last = &p_es->p_picture;
-                break;
-            }
-            else
-            {
-                msg_Dbg( p_filter, "too late picture for %s (%"PRId64 ")",
-                         p_es->psz_id,
-                         date - p_es->p_picture->date - p_sys->i_delay );
-                break;
-            }
-        }
-
+        UpdatePicture( p_filter, p_es, date );
         if ( p_es->p_picture == NULL )
             continue;
 
-        if ( p_sys->i_order_length == 0 )
-        {
-            i_real_index++;
-        }
-        else
-        {
-            int i;
-            for ( i = 0; i <= p_sys->i_order_length; i++ )
-            {
-                if ( i == p_sys->i_order_length ) break;
-                if ( strcmp( p_es->psz_id, p_sys->ppsz_order[i] ) == 0 )
-                {
-                    i_real_index = i;
-                    break;
-                }
-            }
-            if ( i == p_sys->i_order_length )
-                i_real_index = ++i_greatest_real_index_used;
-        }
+        i_real_index = GetIndex( p_sys, p_es, i_real_index,
+                                 &i_greatest_real_index_used );
         i_row = ( i_real_index / p_sys->i_cols ) % p_sys->i_rows;
         i_col = i_real_index % p_sys->i_cols ;
 
@@ -601,19 +1119,7 @@ static subpicture_t *Filter( filter_t *p_filter, mtime_t date )
             fmt_out.i_height = row_inner_height;
 
             if( p_sys->b_ar ) /* keep aspect ratio */
-            {
-                if( (float)fmt_out.i_width / (float)fmt_out.i_height
-                      > (float)fmt_in.i_width / (float)fmt_in.i_height )
-                {
-                    fmt_out.i_width = ( fmt_out.i_height * fmt_in.i_width )
-                                         / fmt_in.i_height;
-                }
-                else
-                {
-                    fmt_out.i_height = ( fmt_out.i_width * fmt_in.i_height )
-                                        / fmt_in.i_width;
-                }
-             }
+                FitAspectRatio( &fmt_out, &fmt_in );
 
             fmt_out.i_visible_width = fmt_out.i_width;
             fmt_out.i_visible_height = fmt_out.i_height;
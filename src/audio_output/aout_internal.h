@@ -45,12 +45,21 @@ struct aout_request_vout
 typedef struct aout_volume aout_volume_t;
 typedef struct aout_dev aout_dev_t;
 
+/** Loudness measurements, see vlc_audio_meter_Publish() */
+struct vlc_audio_meter
+{
+    atomic_uint sequence; /**< odd while being written, 0 if unknown */
+    atomic_uint values[4]; /**< representations of the float values */
+};
+
 typedef struct
 {
     vlc_mutex_t lock;
     module_t *module; /**< Output plugin (or NULL if inactive) */
     aout_filters_t *filters;
     aout_volume_t *volume;
+    vlc_var_handle_t *volume_var; /**< "volume" variable */
+    vlc_var_handle_t *mute_var; /**< "mute" variable */
 
     struct
     {
@@ -83,6 +92,8 @@ typedef struct
     atomic_uint buffers_lost;
     atomic_uint buffers_played;
     atomic_uchar restart;
+
+    vlc_audio_meter_t meter; /**< "audio-meter" variable */
 } aout_owner_t;
 
 typedef struct
@@ -192,14 +192,19 @@ audio_output_t *aout_New (vlc_object_t *parent)
     owner->req.device = (char *)unset_str;
     owner->req.volume = -1.f;
     owner->req.mute = -1;
+    atomic_init (&owner->meter.sequence, 0);
+    for (unsigned i = 0; i < ARRAY_SIZE(owner->meter.values); i++)
+        atomic_init (&owner->meter.values[i], 0);
 
     vlc_object_set_destructor (aout, aout_Destructor);
 
     /* Audio output module callbacks */
     var_Create (aout, "volume", VLC_VAR_FLOAT);
     var_AddCallback (aout, "volume", var_Copy, parent);
+    owner->volume_var = var_Acquire (aout, "volume");
     var_Create (aout, "mute", VLC_VAR_BOOL | VLC_VAR_DOINHERIT);
     var_AddCallback (aout, "mute", var_Copy, parent);
+    owner->mute_var = var_Acquire (aout, "mute");
     var_Create (aout, "device", VLC_VAR_STRING);
     var_AddCallback (aout, "device", var_CopyDevice, parent);
 
@@ -290,6 +295,9 @@ audio_output_t *aout_New (vlc_object_t *parent)
     text.psz_string = _("Audio filters");
     var_Change (aout, "audio-filter", VLC_VAR_SETTEXT, &text, NULL);
 
+    /* Loudness meters, written by the audio filter */
+    var_Create (aout, "audio-meter", VLC_VAR_ADDRESS);
+    var_SetAddress (aout, "audio-meter", &owner->meter);
 
     var_Create (aout, "audio-visual", VLC_VAR_STRING | VLC_VAR_DOINHERIT);
     text.psz_string = _("Audio visualizations");
@@ -349,6 +357,8 @@ static void aout_Destructor (vlc_object_t *obj)
     audio_output_t *aout = (audio_output_t *)obj;
     aout_owner_t *owner = aout_owner (aout);
 
+    var_Release (aout, owner->volume_var);
+    var_Release (aout, owner->mute_var);
     vlc_mutex_destroy (&owner->dev.lock);
     for (aout_dev_t *dev = owner->dev.list, *next; dev != NULL; dev = next)
     {
@@ -591,7 +601,7 @@ void aout_OutputUnlock (audio_output_t *aout)
  */
 float aout_VolumeGet (audio_output_t *aout)
 {
-    return var_GetFloat (aout, "volume");
+    return var_HandleGetFloat (aout_owner (aout)->volume_var);
 }
 
 /**
@@ -619,7 +629,7 @@ int aout_VolumeSet (audio_output_t *aout, float vol)
  */
 int aout_MuteGet (audio_output_t *aout)
 {
-    return var_InheritBool (aout, "mute");
+    return var_HandleGetBool (aout_owner (aout)->mute_var);
 }
 
 /**
@@ -709,3 +719,68 @@ int aout_DevicesList (audio_output_t *aout, char ***ids, char ***names)
 
     return count;
 }
+
+typedef union
+{
+    float f;
+    unsigned u;
+} meter_value_t;
+
+void vlc_audio_meter_Publish (vlc_audio_meter_t *meter,
+                              const vlc_audio_loudness_t *loudness)
+{
+    static_assert (sizeof (float) == sizeof (unsigned), "Float size");
+
+    if (loudness == NULL)
+    {
+        atomic_store_explicit (&meter->sequence, 0, memory_order_release);
+        return;
+    }
+
+    const float values[4] = {
+        loudness->momentary, loudness->short_term,
+        loudness->integrated, loudness->true_peak,
+    };
+    unsigned seq = atomic_load_explicit (&meter->sequence,
+                                         memory_order_relaxed);
+
+    /* Sequence lock: readers retry if the sequence was odd or changed */
+    atomic_store_explicit (&meter->sequence, seq + 1, memory_order_relaxed);
+    atomic_thread_fence (memory_order_release);
+    for (unsigned i = 0; i < 4; i++)
+    {
+        meter_value_t v = { .f = values[i] };
+        atomic_store_explicit (&meter->values[i], v.u, memory_order_relaxed);
+    }
+    seq += 2;
+    if (unlikely(seq == 0))
+        seq = 2;
+    atomic_store_explicit (&meter->sequence, seq, memory_order_release);
+}
+
+int aout_LoudnessGet (audio_output_t *aout, vlc_audio_loudness_t *loudness)
+{
+    vlc_audio_meter_t *meter = &aout_owner (aout)->meter;
+    meter_value_t values[4];
+    unsigned seq;
+
+    do
+    {
+        seq = atomic_load_explicit (&meter->sequence, memory_order_acquire);
+        if (seq == 0)
+            return -1;
+        for (unsigned i = 0; i < 4; i++)
+            values[i].u = atomic_load_explicit (&meter->values[i],
+                                                memory_order_relaxed);
+        atomic_thread_fence (memory_order_acquire);
+    }
+    while ((seq & 1)
+        || seq != atomic_load_explicit (&meter->sequence,
+                                        memory_order_relaxed));
+
+    loudness->momentary = values[0].f;
+    loudness->short_term = values[1].f;
+    loudness->integrated = values[2].f;
+    loudness->true_peak = values[3].f;
+    return 0;
+}
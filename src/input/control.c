@@ -101,7 +101,8 @@ int input_vaControl( input_thread_t *p_input, int i_query, va_list args )
 
         case INPUT_GET_RATE:
             pi_int = (int*)va_arg( args, int * );
-            *pi_int = INPUT_RATE_DEFAULT / var_GetFloat( p_input, "rate" );
+            *pi_int = INPUT_RATE_DEFAULT
+                    / var_HandleGetFloat( p_input->p->p_rate_var );
             return VLC_SUCCESS;
 
         case INPUT_SET_RATE:
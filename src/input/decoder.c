@@ -125,6 +125,27 @@ struct decoder_owner_sys_t
 
     /* Delay */
     mtime_t i_ts_delay;
+
+    /* Video decoding stage, when the packetizer runs on the decoder thread
+     * and the decoder on its own thread (see "packetizer-thread") */
+    struct
+    {
+        bool         b_enabled;
+        vlc_thread_t thread;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait; /* to the decoding stage: queue not empty */
+        vlc_cond_t   wait_done; /* to the decoder thread: queue not full */
+        struct
+        {
+            block_t *p_block;
+            mtime_t  i_date; /* when the packetizer output the block */
+        } queue[8];
+        unsigned     i_first;
+        unsigned     i_count;
+        bool         b_busy;
+        bool         b_exit;
+        atomic_bool  b_error; /* p_dec->b_error, as seen by the decoder thread */
+    } split;
 };
 
 /* Pictures which are DECODER_BOGUS_VIDEO_DELAY or more in advance probably have
@@ -967,6 +988,25 @@ static int DecoderQueueVideo( decoder_t *p_dec, picture_t *p_pic )
     return ret;
 }
 
+/* Only when split: the single thread model has no stages to measure */
+static void DecoderUpdateStatPipeline( decoder_t *p_dec, unsigned packetized,
+                                       mtime_t packetizer_time,
+                                       mtime_t decoder_time )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    input_thread_t *p_input = p_owner->p_input;
+
+    if( p_input == NULL || !p_owner->split.b_enabled )
+        return;
+
+    vlc_mutex_lock( &p_input->p->counters.counters_lock );
+    stats_Update( p_input->p->counters.p_packetized_video, packetized, NULL );
+    stats_Update( p_input->p->counters.p_packetizer_latency, packetizer_time,
+                  NULL );
+    stats_Update( p_input->p->counters.p_decoder_latency, decoder_time, NULL );
+    vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+}
+
 static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
 {
     picture_t      *p_pic;
@@ -983,6 +1023,165 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
     DecoderUpdateStatVideo( p_dec, i_decoded, i_lost );
 }
 
+/**
+ * The video decoding stage main loop, when the packetizer runs separately
+ */
+static void *DecoderSplitThread( void *p_data )
+{
+    decoder_t *p_dec = p_data;
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    vlc_mutex_lock( &p_owner->split.lock );
+    for( ;; )
+    {
+        if( p_owner->split.i_count == 0 )
+        {
+            if( p_owner->split.b_exit )
+                break;
+            vlc_cond_wait( &p_owner->split.wait, &p_owner->split.lock );
+            continue;
+        }
+
+        unsigned i_first = p_owner->split.i_first;
+        block_t *p_block = p_owner->split.queue[i_first].p_block;
+        mtime_t i_date = p_owner->split.queue[i_first].i_date;
+
+        p_owner->split.i_first = (i_first + 1)
+                               % ARRAY_SIZE(p_owner->split.queue);
+        p_owner->split.i_count--;
+        p_owner->split.b_busy = true;
+        vlc_mutex_unlock( &p_owner->split.lock );
+
+        if( likely(!atomic_load( &p_owner->split.b_error )) )
+        {
+            DecoderDecodeVideo( p_dec, p_block );
+            /* The decoder module flags its errors on this thread */
+            if( p_dec->b_error )
+                atomic_store( &p_owner->split.b_error, true );
+            DecoderUpdateStatPipeline( p_dec, 0, 0, mdate() - i_date );
+        }
+        else
+            block_Release( p_block );
+
+        vlc_mutex_lock( &p_owner->lock );
+        vlc_mutex_lock( &p_owner->split.lock );
+        p_owner->split.b_busy = false;
+        vlc_cond_signal( &p_owner->split.wait_done );
+        /* Let input_DecoderWait() notice if both stages are now idle */
+        vlc_cond_signal( &p_owner->wait_acknowledge );
+        vlc_mutex_unlock( &p_owner->lock );
+    }
+    vlc_mutex_unlock( &p_owner->split.lock );
+    return NULL;
+}
+
+/**
+ * Hands a packetized block over to the decoding stage. Waits for room if the
+ * decoding stage is lagging behind.
+ */
+static void DecoderSplitQueue( decoder_t *p_dec, block_t *p_block )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    const unsigned i_size = ARRAY_SIZE(p_owner->split.queue);
+
+    vlc_mutex_lock( &p_owner->split.lock );
+    while( p_owner->split.i_count >= i_size )
+        vlc_cond_wait( &p_owner->split.wait_done, &p_owner->split.lock );
+
+    unsigned i_last = (p_owner->split.i_first + p_owner->split.i_count)
+                    % i_size;
+    p_owner->split.queue[i_last].p_block = p_block;
+    p_owner->split.queue[i_last].i_date = mdate();
+    p_owner->split.i_count++;
+    vlc_cond_signal( &p_owner->split.wait );
+    vlc_mutex_unlock( &p_owner->split.lock );
+}
+
+/* Releases the blocks the decoding stage has not started decoding yet */
+static void DecoderSplitDiscardLocked( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    vlc_assert_locked( &p_owner->split.lock );
+    while( p_owner->split.i_count > 0 )
+    {
+        unsigned i_first = p_owner->split.i_first;
+
+        block_Release( p_owner->split.queue[i_first].p_block );
+        p_owner->split.i_first = (i_first + 1)
+                               % ARRAY_SIZE(p_owner->split.queue);
+        p_owner->split.i_count--;
+    }
+}
+
+/**
+ * Waits until the decoding stage is idle, optionally discarding the blocks
+ * it has not started decoding yet. The decoder module can then be used
+ * (drained, flushed or restarted) from the calling thread.
+ */
+static void DecoderSplitBarrier( decoder_t *p_dec, bool b_discard )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( !p_owner->split.b_enabled )
+        return;
+
+    vlc_mutex_lock( &p_owner->split.lock );
+    if( b_discard )
+        DecoderSplitDiscardLocked( p_dec );
+    while( p_owner->split.i_count > 0 || p_owner->split.b_busy )
+        vlc_cond_wait( &p_owner->split.wait_done, &p_owner->split.lock );
+    vlc_mutex_unlock( &p_owner->split.lock );
+}
+
+static bool DecoderSplitIsIdle( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    bool b_idle;
+
+    if( !p_owner->split.b_enabled )
+        return true;
+
+    vlc_mutex_lock( &p_owner->split.lock );
+    b_idle = p_owner->split.i_count == 0 && !p_owner->split.b_busy;
+    vlc_mutex_unlock( &p_owner->split.lock );
+    return b_idle;
+}
+
+/**
+ * Checks for decoder errors from the decoder thread. When split, the decoder
+ * module runs, and sets p_dec->b_error, on the decoding stage thread.
+ */
+static bool DecoderHasError( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( p_owner->split.b_enabled )
+        return atomic_load( &p_owner->split.b_error );
+    return p_dec->b_error;
+}
+
+/**
+ * Terminates the decoding stage. The decoder thread must be joined already.
+ */
+static void DecoderSplitStop( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+
+    if( !p_owner->split.b_enabled )
+        return;
+
+    vlc_mutex_lock( &p_owner->split.lock );
+    /* The decoder is being deleted: pending blocks would not be displayed */
+    DecoderSplitDiscardLocked( p_dec );
+    p_owner->split.b_exit = true;
+    vlc_cond_signal( &p_owner->split.wait );
+    vlc_mutex_unlock( &p_owner->split.lock );
+
+    vlc_join( p_owner->split.thread, NULL );
+    p_owner->split.b_enabled = false;
+}
+
 /* This function process a video block
  */
 static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block )
@@ -994,23 +1193,33 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block )
         block_t *p_packetized_block;
         block_t **pp_block = p_block ? &p_block : NULL;
         decoder_t *p_packetizer = p_owner->p_packetizer;
+        unsigned i_packetized = 0;
+        mtime_t i_packetizer_time = 0;
 
-        while( (p_packetized_block =
-                p_packetizer->pf_packetize( p_packetizer, pp_block ) ) )
+        for( ;; )
         {
+            mtime_t i_start = mdate();
+            p_packetized_block = p_packetizer->pf_packetize( p_packetizer,
+                                                             pp_block );
+            i_packetizer_time += mdate() - i_start;
+            if( p_packetized_block == NULL )
+                break;
+
             if( !es_format_IsSimilar( &p_dec->fmt_in, &p_packetizer->fmt_out ) )
             {
                 msg_Dbg( p_dec, "restarting module due to input format change");
 
                 /* Drain the decoder module */
+                DecoderSplitBarrier( p_dec, false );
                 DecoderDecodeVideo( p_dec, NULL );
                 /* Restart the decoder module */
                 UnloadDecoder( p_dec );
                 if( LoadDecoder( p_dec, false, &p_packetizer->fmt_out ) )
                 {
                     p_dec->b_error = true;
+                    atomic_store( &p_owner->split.b_error, true );
                     block_ChainRelease( p_packetized_block );
-                    return;
+                    break;
                 }
             }
 
@@ -1021,15 +1230,24 @@ static void DecoderProcessVideo( decoder_t *p_dec, block_t *p_block )
             {
                 block_t *p_next = p_packetized_block->p_next;
                 p_packetized_block->p_next = NULL;
+                i_packetized++;
 
-                DecoderDecodeVideo( p_dec, p_packetized_block );
+                if( p_owner->split.b_enabled )
+                    DecoderSplitQueue( p_dec, p_packetized_block );
+                else
+                    DecoderDecodeVideo( p_dec, p_packetized_block );
 
                 p_packetized_block = p_next;
             }
         }
+        DecoderUpdateStatPipeline( p_dec, i_packetized, i_packetizer_time, 0 );
+
         /* Drain the decoder after the packetizer is drained */
-        if( !pp_block )
+        if( !pp_block && !DecoderHasError( p_dec ) )
+        {
+            DecoderSplitBarrier( p_dec, false );
             DecoderDecodeVideo( p_dec, NULL );
+        }
     }
     else
     {
@@ -1313,7 +1531,7 @@ static void DecoderProcess( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
-    if( p_dec->b_error )
+    if( DecoderHasError( p_dec ) )
     {
         if( p_block )
             block_Release( p_block );
@@ -1366,9 +1584,12 @@ static void DecoderProcessFlush( decoder_t *p_dec )
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
     decoder_t *p_packetizer = p_owner->p_packetizer;
 
-    if( p_dec->b_error )
+    if( DecoderHasError( p_dec ) )
         return;
 
+    /* Pending packetized blocks are obsolete */
+    DecoderSplitBarrier( p_dec, true );
+
     if( p_packetizer != NULL && p_packetizer->pf_flush != NULL )
         p_packetizer->pf_flush( p_packetizer );
 
@@ -1594,6 +1815,16 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
     vlc_cond_init( &p_owner->wait_fifo );
     vlc_cond_init( &p_owner->wait_timed );
 
+    p_owner->split.b_enabled = false;
+    atomic_init( &p_owner->split.b_error, false );
+    vlc_mutex_init( &p_owner->split.lock );
+    vlc_cond_init( &p_owner->split.wait );
+    vlc_cond_init( &p_owner->split.wait_done );
+    p_owner->split.i_first = 0;
+    p_owner->split.i_count = 0;
+    p_owner->split.b_busy = false;
+    p_owner->split.b_exit = false;
+
     /* Set buffers allocation callbacks for the decoders */
     p_dec->pf_aout_format_update = aout_update_format;
     p_dec->pf_vout_format_update = vout_update_format;
@@ -1665,6 +1896,11 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
         p_owner->cc.pp_decoder[i] = NULL;
     }
     p_owner->i_ts_delay = 0;
+
+    /* Decode video on a second thread, packetize on the decoder thread */
+    p_owner->split.b_enabled = p_sout == NULL && p_owner->p_packetizer != NULL
+                            && p_dec->fmt_out.i_cat == VIDEO_ES
+                            && var_InheritBool( p_dec, "packetizer-thread" );
     return p_dec;
 }
 
@@ -1739,6 +1975,9 @@ static void DeleteDecoder( decoder_t * p_dec )
         vlc_object_release( p_owner->p_packetizer );
     }
 
+    vlc_cond_destroy( &p_owner->split.wait_done );
+    vlc_cond_destroy( &p_owner->split.wait );
+    vlc_mutex_destroy( &p_owner->split.lock );
     vlc_cond_destroy( &p_owner->wait_timed );
     vlc_cond_destroy( &p_owner->wait_fifo );
     vlc_cond_destroy( &p_owner->wait_acknowledge );
@@ -1804,10 +2043,19 @@ static decoder_t *decoder_New( vlc_object_t *p_parent, input_thread_t *p_input,
     else
         i_priority = VLC_THREAD_PRIORITY_VIDEO;
 
+    if( p_dec->p_owner->split.b_enabled
+     && vlc_clone( &p_dec->p_owner->split.thread, DecoderSplitThread, p_dec,
+                   i_priority ) )
+    {
+        msg_Warn( p_dec, "cannot spawn video decoding thread" );
+        p_dec->p_owner->split.b_enabled = false;
+    }
+
     /* Spawn the decoder thread */
     if( vlc_clone( &p_dec->p_owner->thread, DecoderThread, p_dec, i_priority ) )
     {
         msg_Err( p_dec, "cannot spawn decoder thread" );
+        DecoderSplitStop( p_dec );
         DeleteDecoder( p_dec );
         return NULL;
     }
@@ -1878,6 +2126,9 @@ void input_DecoderDelete( decoder_t *p_dec )
 
     vlc_join( p_owner->thread, NULL );
 
+    /* The decoding stage exits once it has emptied its queue */
+    DecoderSplitStop( p_dec );
+
     /* */
     if( p_dec->p_owner->cc.b_supported )
     {
@@ -1933,7 +2184,8 @@ bool input_DecoderIsEmpty( decoder_t * p_dec )
 
     assert( !p_owner->b_waiting );
 
-    if( block_FifoCount( p_dec->p_owner->p_fifo ) > 0 )
+    if( block_FifoCount( p_dec->p_owner->p_fifo ) > 0
+     || !DecoderSplitIsIdle( p_dec ) )
         return false;
 
     bool b_empty;
@@ -2151,7 +2403,8 @@ void input_DecoderWait( decoder_t *p_dec )
         if( p_owner->paused )
             break;
         vlc_fifo_Lock( p_owner->p_fifo );
-        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo ) )
+        if( p_owner->b_idle && vlc_fifo_IsEmpty( p_owner->p_fifo )
+         && DecoderSplitIsIdle( p_dec ) )
         {
             msg_Err( p_dec, "buffer deadlock prevented" );
             vlc_fifo_Unlock( p_owner->p_fifo );
@@ -74,6 +74,89 @@ static const char *demux_FromContentType(const char *mime)
     return (type != NULL) ? type->demux : "any";
 }
 
+struct demux_magic
+{
+    unsigned short offset;
+    unsigned char  length;
+    const char    *bytes;
+};
+
+/* Bytes needed by the furthest signature (M2TS second sync byte) */
+#define MAGIC_PEEK 197
+
+/**
+ * Looks up the demuxers to try first from the stream header.
+ *
+ * Only formats with a strong signature are listed, each with all the
+ * demuxers accepting it, in decreasing score order. The demuxers are still
+ * probed: if none accepts the stream, all the others are tried as usual.
+ */
+static const char *demux_FromMagic( stream_t *s, char *list, size_t size )
+{
+#define M(off, str) { off, sizeof (str) - 1, str }
+    static const struct
+    {
+        struct demux_magic magic[2];
+        char demux[10];
+    } magics[] =
+    {
+        { { M(4, "ftyp") }, "mp4" }, { { M(4, "moov") }, "mp4" },
+        { { M(4, "moof") }, "mp4" }, { { M(4, "mdat") }, "mp4" },
+        { { M(4, "free") }, "mp4" }, { { M(4, "skip") }, "mp4" },
+        { { M(4, "wide") }, "mp4" }, { { M(4, "pnot") }, "mp4" },
+        { { M(0, "RIFF"), M(8, "AVI ") }, "avi" },
+        { { M(0, "\x30\x26\xB2\x75\x8E\x66\xCF\x11") }, "asf" },
+        { { M(0, "fLaC") }, "flac" },
+        { { M(0, "MPCK") }, "mpc" }, { { M(0, "MP+") }, "mpc" },
+        { { M(0, "TTA1") }, "tta" },
+        { { M(0, "caff") }, "caf" },
+        { { M(0, "RIFF"), M(8, "WAVE") }, "mpga,wav" },
+        { { M(0, "\x1A\x45\xDF\xA3") }, "mkv" },
+        { { M(0, "OggS") }, "ogg" },
+        { { M(0, "BBCD") }, "dirac" },
+        { { M(0, "MThd") }, "smf" }, { { M(0, "RIFF"), M(8, "RMID") }, "smf" },
+        { { M(0, "\x47"), M(188, "\x47") }, "ts" },
+        { { M(4, "\x47"), M(196, "\x47") }, "ts" },
+        { { M(0, "FORM"), M(8, "AIFF") }, "aiff" },
+        { { M(0, "FORM"), M(8, "AIFC") }, "aiff" },
+        { { M(0, ".snd") }, "au" },
+        { { M(0, "NSVf") }, "nsv" }, { { M(0, "NSVs") }, "nsv" },
+        { { M(0, "Creative Voice File\x1A") }, "voc" },
+        { { M(0, "\x00\x00\x01\xBA") }, "ps" },
+    };
+#undef M
+    const uint8_t *p_peek;
+    ssize_t i_peek = stream_Peek( s, &p_peek, MAGIC_PEEK );
+    size_t len = 0;
+
+    for( size_t i = 0; i < ARRAY_SIZE(magics) && i_peek > 0; i++ )
+    {
+        bool b_match = true;
+
+        for( unsigned j = 0; j < 2 && b_match; j++ )
+        {
+            const struct demux_magic *m = &magics[i].magic[j];
+
+            b_match = m->length == 0
+                   || (m->offset + m->length <= (size_t)i_peek
+                    && !memcmp( p_peek + m->offset, m->bytes, m->length ));
+        }
+
+        size_t n = strlen( magics[i].demux );
+        if( !b_match || len + n + 1 >= size )
+            continue;
+        if( len > 0 )
+            list[len++] = ',';
+        memcpy( list + len, magics[i].demux, n );
+        len += n;
+    }
+
+    if( len == 0 )
+        return "any";
+    list[len] = '\0';
+    return list;
+}
+
 /*****************************************************************************
  * demux_New:
  *  if s is NULL then load a access_demux
@@ -217,6 +300,13 @@ demux_t *demux_NewAdvanced( vlc_object_t *p_obj, input_thread_t *p_parent_input,
           ;
         SkipAPETag( p_demux );
 
+        /* Try the demuxers matching the stream signature first, rather
+         * than probing all of them in score order */
+        char magic_list[32];
+        if( !strcmp( psz_module, "any" ) )
+            psz_module = demux_FromMagic( p_demux->s, magic_list,
+                                          sizeof (magic_list) );
+
         p_demux->p_module =
             module_need( p_demux, "demux", psz_module,
                          !strcmp( psz_module, p_demux->psz_demux ) );
@@ -2698,6 +2698,31 @@ static int EsOutControlLocked( es_out_t *out, int i_query, va_list args )
         input_clock_ChangeSystemOrigin( p_pgrm->p_clock, b_absolute, i_system );
         return VLC_SUCCESS;
     }
+    case ES_OUT_ADD_RECEPTION_STATS:
+    {
+        input_thread_t *p_input = p_sys->p_input;
+        const unsigned i_received  = va_arg( args, unsigned );
+        const size_t   i_bytes     = va_arg( args, size_t );
+        const unsigned i_lost      = va_arg( args, unsigned );
+        const unsigned i_late      = va_arg( args, unsigned );
+        const unsigned i_recovered = va_arg( args, unsigned );
+
+        if( !libvlc_stats( p_input ) )
+            return VLC_SUCCESS;
+
+        uint64_t i_total;
+
+        vlc_mutex_lock( &p_input->p->counters.counters_lock );
+        stats_Update( p_input->p->counters.p_read_packets, i_received, NULL );
+        stats_Update( p_input->p->counters.p_read_bytes, i_bytes, &i_total );
+        stats_Update( p_input->p->counters.p_input_bitrate, i_total, NULL );
+        stats_Update( p_input->p->counters.p_lost_packets, i_lost, NULL );
+        stats_Update( p_input->p->counters.p_late_packets, i_late, NULL );
+        stats_Update( p_input->p->counters.p_recovered_packets, i_recovered,
+                      NULL );
+        vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+        return VLC_SUCCESS;
+    }
     case ES_OUT_SET_EOS:
     {
         for (int i = 0; i < p_sys->i_es; i++) {
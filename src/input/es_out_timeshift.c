@@ -728,6 +728,9 @@ static int ControlLocked( es_out_t *p_out, int i_query, va_list args )
         int *pi_group = va_arg( args, int * );
         return es_out_Control( p_sys->p_out, ES_OUT_GET_GROUP_FORCED, pi_group );
     }
+    /* Not delayed: the reception happens now, whatever is being played */
+    case ES_OUT_ADD_RECEPTION_STATS:
+        return es_out_vaControl( p_sys->p_out, i_query, args );
 
     default:
         msg_Err( p_sys->p_input, "Unknown es_out_Control query !" );
@@ -231,6 +231,9 @@ static void input_Destructor( vlc_object_t *obj )
     free( psz_name );
 #endif
 
+    if( p_input->p->p_rate_var != NULL )
+        var_Release( p_input, p_input->p->p_rate_var );
+
     if( p_input->p->p_es_out_display )
         es_out_Delete( p_input->p->p_es_out_display );
 
@@ -400,6 +403,7 @@ static input_thread_t *Create( vlc_object_t *p_parent, input_item_t *p_item,
 
     /* Create Objects variables for public Get and Set */
     input_ControlVarInit( p_input );
+    p_input->p->p_rate_var = var_Acquire( p_input, "rate" );
 
     /* */
     if( !p_input->b_preparsing )
@@ -786,6 +790,9 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( read_packets, COUNTER );
         INIT_COUNTER( demux_read, COUNTER );
         INIT_COUNTER( input_bitrate, DERIVATIVE );
+        INIT_COUNTER( lost_packets, COUNTER );
+        INIT_COUNTER( late_packets, COUNTER );
+        INIT_COUNTER( recovered_packets, COUNTER );
         INIT_COUNTER( demux_bitrate, DERIVATIVE );
         INIT_COUNTER( demux_corrupted, COUNTER );
         INIT_COUNTER( demux_discontinuity, COUNTER );
@@ -796,6 +803,9 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( decoded_audio, COUNTER );
         INIT_COUNTER( decoded_video, COUNTER );
         INIT_COUNTER( decoded_sub, COUNTER );
+        INIT_COUNTER( packetized_video, COUNTER );
+        INIT_COUNTER( packetizer_latency, COUNTER );
+        INIT_COUNTER( decoder_latency, COUNTER );
         p_input->p->counters.p_sout_send_bitrate = NULL;
         p_input->p->counters.p_sout_sent_packets = NULL;
         p_input->p->counters.p_sout_sent_bytes = NULL;
@@ -1263,6 +1273,9 @@ error:
         EXIT_COUNTER( read_packets );
         EXIT_COUNTER( demux_read );
         EXIT_COUNTER( input_bitrate );
+        EXIT_COUNTER( lost_packets );
+        EXIT_COUNTER( late_packets );
+        EXIT_COUNTER( recovered_packets );
         EXIT_COUNTER( demux_bitrate );
         EXIT_COUNTER( demux_corrupted );
         EXIT_COUNTER( demux_discontinuity );
@@ -1273,6 +1286,9 @@ error:
         EXIT_COUNTER( decoded_audio );
         EXIT_COUNTER( decoded_video );
         EXIT_COUNTER( decoded_sub );
+        EXIT_COUNTER( packetized_video );
+        EXIT_COUNTER( packetizer_latency );
+        EXIT_COUNTER( decoder_latency );
 
         if( p_input->p->p_sout )
         {
@@ -1328,6 +1344,9 @@ static void End( input_thread_t * p_input )
             CL_CO( read_packets );
             CL_CO( demux_read );
             CL_CO( input_bitrate );
+            CL_CO( lost_packets );
+            CL_CO( late_packets );
+            CL_CO( recovered_packets );
             CL_CO( demux_bitrate );
             CL_CO( demux_corrupted );
             CL_CO( demux_discontinuity );
@@ -1338,6 +1357,9 @@ static void End( input_thread_t * p_input )
             CL_CO( decoded_audio) ;
             CL_CO( decoded_video );
             CL_CO( decoded_sub) ;
+            CL_CO( packetized_video );
+            CL_CO( packetizer_latency );
+            CL_CO( decoder_latency );
         }
 
         /* Close optional stream output instance */
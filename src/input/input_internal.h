@@ -92,6 +92,7 @@ struct input_thread_private_t
     bool        is_stopped;
     bool        b_recording;
     int         i_rate;
+    vlc_var_handle_t *p_rate_var; /* "rate" */
 
     /* Playtime configuration and state */
     int64_t     i_start;    /* :start-time,0 by default */
@@ -142,6 +143,9 @@ struct input_thread_private_t
         counter_t *p_read_packets;
         counter_t *p_read_bytes;
         counter_t *p_input_bitrate;
+        counter_t *p_lost_packets;
+        counter_t *p_late_packets;
+        counter_t *p_recovered_packets;
         counter_t *p_demux_read;
         counter_t *p_demux_bitrate;
         counter_t *p_demux_corrupted;
@@ -149,6 +153,9 @@ struct input_thread_private_t
         counter_t *p_decoded_audio;
         counter_t *p_decoded_video;
         counter_t *p_decoded_sub;
+        counter_t *p_packetized_video;
+        counter_t *p_packetizer_latency;
+        counter_t *p_decoder_latency;
         counter_t *p_sout_sent_packets;
         counter_t *p_sout_sent_bytes;
         counter_t *p_sout_send_bitrate;
@@ -90,6 +90,10 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->i_read_packets = stats_GetTotal(input->p->counters.p_read_packets);
     st->i_read_bytes = stats_GetTotal(input->p->counters.p_read_bytes);
     st->f_input_bitrate = stats_GetRate(input->p->counters.p_input_bitrate);
+    st->i_lost_packets = stats_GetTotal(input->p->counters.p_lost_packets);
+    st->i_late_packets = stats_GetTotal(input->p->counters.p_late_packets);
+    st->i_recovered_packets =
+        stats_GetTotal(input->p->counters.p_recovered_packets);
     st->i_demux_read_bytes = stats_GetTotal(input->p->counters.p_demux_read);
     st->f_demux_bitrate = stats_GetRate(input->p->counters.p_demux_bitrate);
     st->i_demux_corrupted = stats_GetTotal(input->p->counters.p_demux_corrupted);
@@ -98,6 +102,17 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     /* Decoders */
     st->i_decoded_video = stats_GetTotal(input->p->counters.p_decoded_video);
     st->i_decoded_audio = stats_GetTotal(input->p->counters.p_decoded_audio);
+    st->i_packetized_video =
+        stats_GetTotal(input->p->counters.p_packetized_video);
+    if (st->i_packetized_video > 0)
+    {
+        st->i_packetizer_latency =
+            stats_GetTotal(input->p->counters.p_packetizer_latency)
+            / st->i_packetized_video;
+        st->i_decoder_latency =
+            stats_GetTotal(input->p->counters.p_decoder_latency)
+            / st->i_packetized_video;
+    }
 
     /* Sout */
     if (input->p->counters.p_sout_send_bitrate)
@@ -124,12 +139,16 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     vlc_mutex_lock( &p_stats->lock );
     p_stats->i_read_packets = p_stats->i_read_bytes =
     p_stats->f_input_bitrate = p_stats->f_average_input_bitrate =
+    p_stats->i_lost_packets = p_stats->i_late_packets =
+    p_stats->i_recovered_packets =
     p_stats->i_demux_read_packets = p_stats->i_demux_read_bytes =
     p_stats->f_demux_bitrate = p_stats->f_average_demux_bitrate =
     p_stats->i_demux_corrupted = p_stats->i_demux_discontinuity =
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
+    p_stats->i_packetized_video = p_stats->i_packetizer_latency =
+    p_stats->i_decoder_latency =
     p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
      = 0;
     vlc_mutex_unlock( &p_stats->lock );
@@ -0,0 +1,479 @@
+/*****************************************************************************
+ * thumbnailer.c: fast thumbnail extraction
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_thumbnailer.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_codec.h>
+#include <vlc_image.h>
+#include <vlc_meta.h>
+#include <vlc_modules.h>
+#include <vlc_stream.h>
+#include "../libvlc.h"
+
+/* Give up looking for a key frame after that many video blocks */
+#define THUMBNAILER_MAX_BLOCKS 1000
+/* Give up if the demuxer does not output video after that many calls */
+#define THUMBNAILER_MAX_DEMUX  20000
+
+struct es_out_id_t
+{
+    es_out_id_t *p_next;
+    es_format_t  fmt;
+};
+
+struct vlc_thumbnailer_t
+{
+    vlc_object_t    *p_obj;
+    stream_t        *p_stream; /* until owned by the demuxer */
+    demux_t         *p_demux;
+    es_out_t         out;
+    image_handler_t *p_image;
+
+    es_out_id_t     *p_ids;
+    es_out_id_t     *p_video; /* the first video ES, the only one decoded */
+    decoder_t       *p_packetizer;
+    decoder_t       *p_decoder;
+
+    /* State of the current request */
+    bool             b_waiting;  /* no key frame found yet */
+    unsigned         i_blocks;
+    picture_t       *p_picture;
+};
+
+/*****************************************************************************
+ * Decoder owner
+ *****************************************************************************/
+static int VoutFormatUpdate( decoder_t *p_dec )
+{
+    p_dec->fmt_out.video.i_chroma = p_dec->fmt_out.i_codec;
+    return 0;
+}
+
+static picture_t *VoutBufferNew( decoder_t *p_dec )
+{
+    return picture_NewFromFormat( &p_dec->fmt_out.video );
+}
+
+static int QueueVideo( decoder_t *p_dec, picture_t *p_pic )
+{
+    vlc_thumbnailer_t *p_th = (vlc_thumbnailer_t *)p_dec->p_owner;
+
+    /* Only the first picture after the key frame is wanted */
+    if( p_th->p_picture == NULL )
+        p_th->p_picture = p_pic;
+    else
+        picture_Release( p_pic );
+    return 0;
+}
+
+static decoder_t *ModuleNew( vlc_thumbnailer_t *p_th, const es_format_t *p_fmt,
+                             bool b_packetizer )
+{
+    decoder_t *p_dec = vlc_custom_create( p_th->p_obj, sizeof( *p_dec ),
+                                          b_packetizer ? "packetizer"
+                                                       : "decoder" );
+    if( p_dec == NULL )
+        return NULL;
+
+    es_format_Copy( &p_dec->fmt_in, p_fmt );
+    es_format_Init( &p_dec->fmt_out, UNKNOWN_ES, 0 );
+    p_dec->b_frame_drop_allowed = false;
+
+    p_dec->p_owner = (decoder_owner_sys_t *)p_th;
+    p_dec->pf_vout_format_update = VoutFormatUpdate;
+    p_dec->pf_vout_buffer_new = VoutBufferNew;
+    p_dec->pf_queue_video = QueueVideo;
+
+    if( b_packetizer )
+        p_dec->p_module = module_need( p_dec, "packetizer", "$packetizer",
+                                       false );
+    else
+        p_dec->p_module = module_need( p_dec, "decoder", "$codec", false );
+    if( p_dec->p_module == NULL )
+    {
+        es_format_Clean( &p_dec->fmt_in );
+        vlc_object_release( p_dec );
+        return NULL;
+    }
+    return p_dec;
+}
+
+static void ModuleDelete( decoder_t *p_dec )
+{
+    module_unneed( p_dec, p_dec->p_module );
+    es_format_Clean( &p_dec->fmt_in );
+    es_format_Clean( &p_dec->fmt_out );
+    if( p_dec->p_description != NULL )
+        vlc_meta_Delete( p_dec->p_description );
+    vlc_object_release( p_dec );
+}
+
+static void Decode( vlc_thumbnailer_t *p_th, block_t *p_block )
+{
+    decoder_t *p_dec = p_th->p_decoder;
+    block_t **pp_block = p_block ? &p_block : NULL;
+    picture_t *p_pic;
+
+    while( (p_pic = p_dec->pf_decode_video( p_dec, pp_block )) != NULL )
+        QueueVideo( p_dec, p_pic );
+}
+
+/* Handles one packetized (complete) frame */
+static void DecodeFrame( vlc_thumbnailer_t *p_th, block_t *p_block )
+{
+    if( !p_th->b_waiting || p_th->i_blocks++ >= THUMBNAILER_MAX_BLOCKS )
+    {
+        block_Release( p_block );
+        return;
+    }
+
+    /* Skip frames known not to be key frames */
+    if( (p_block->i_flags & BLOCK_FLAG_TYPE_MASK)
+     && !(p_block->i_flags & BLOCK_FLAG_TYPE_I) )
+    {
+        block_Release( p_block );
+        return;
+    }
+
+    /* Use the packetized format, as the input decoder does */
+    const es_format_t *p_fmt = &p_th->p_video->fmt;
+    if( p_th->p_packetizer != NULL )
+        p_fmt = &p_th->p_packetizer->fmt_out;
+
+    if( p_th->p_decoder != NULL
+     && !es_format_IsSimilar( &p_th->p_decoder->fmt_in, p_fmt ) )
+    {
+        ModuleDelete( p_th->p_decoder );
+        p_th->p_decoder = NULL;
+    }
+    if( p_th->p_decoder == NULL )
+    {
+        p_th->p_decoder = ModuleNew( p_th, p_fmt, false );
+        if( p_th->p_decoder == NULL )
+        {
+            msg_Err( p_th->p_obj, "no decoder for `%4.4s'",
+                     (const char *)&p_fmt->i_codec );
+            p_th->i_blocks = THUMBNAILER_MAX_BLOCKS;
+            block_Release( p_block );
+            return;
+        }
+    }
+
+    p_block->i_flags &= ~BLOCK_FLAG_PREROLL;
+    Decode( p_th, p_block );
+
+    /* Decoders with a delay keep the picture until drained: do not demux up
+     * to the next key frame for it */
+    if( p_th->p_picture == NULL )
+    {
+        Decode( p_th, NULL );
+        if( p_th->p_picture == NULL && p_th->p_decoder->pf_flush != NULL )
+            p_th->p_decoder->pf_flush( p_th->p_decoder );
+    }
+
+    if( p_th->p_picture != NULL )
+        p_th->b_waiting = false;
+}
+
+/*****************************************************************************
+ * ES output
+ *****************************************************************************/
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *p_fmt )
+{
+    vlc_thumbnailer_t *p_th = (vlc_thumbnailer_t *)out->p_sys;
+    es_out_id_t *id = malloc( sizeof( *id ) );
+    if( unlikely(id == NULL) )
+        return NULL;
+
+    es_format_Copy( &id->fmt, p_fmt );
+    id->p_next = p_th->p_ids;
+    p_th->p_ids = id;
+
+    if( p_th->p_video == NULL && p_fmt->i_cat == VIDEO_ES )
+    {
+        p_th->p_video = id;
+        if( !p_fmt->b_packetized )
+        {
+            es_format_t fmt;
+
+            es_format_Copy( &fmt, p_fmt );
+            p_th->p_packetizer = ModuleNew( p_th, &fmt, true );
+            es_format_Clean( &fmt );
+        }
+    }
+    return id;
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *p_block )
+{
+    vlc_thumbnailer_t *p_th = (vlc_thumbnailer_t *)out->p_sys;
+
+    if( id != p_th->p_video || !p_th->b_waiting )
+    {
+        block_Release( p_block );
+        return VLC_SUCCESS;
+    }
+
+    decoder_t *p_pack = p_th->p_packetizer;
+    if( p_pack == NULL )
+    {
+        DecodeFrame( p_th, p_block );
+        return VLC_SUCCESS;
+    }
+
+    block_t *p_out;
+    while( (p_out = p_pack->pf_packetize( p_pack, &p_block )) != NULL )
+    {
+        while( p_out != NULL )
+        {
+            block_t *p_next = p_out->p_next;
+
+            p_out->p_next = NULL;
+            DecodeFrame( p_th, p_out );
+            p_out = p_next;
+        }
+    }
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    (void) out; (void) id;
+    /* Kept until the thumbnailer is released */
+}
+
+static int EsOutControl( es_out_t *out, int i_query, va_list args )
+{
+    vlc_thumbnailer_t *p_th = (vlc_thumbnailer_t *)out->p_sys;
+
+    switch( i_query )
+    {
+        case ES_OUT_GET_ES_STATE:
+        {
+            es_out_id_t *id = va_arg( args, es_out_id_t * );
+            *va_arg( args, bool * ) = id == p_th->p_video;
+            return VLC_SUCCESS;
+        }
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static void EsOutDestroy( es_out_t *out )
+{
+    (void) out;
+}
+
+/*****************************************************************************
+ * Public API
+ *****************************************************************************/
+#undef vlc_thumbnailer_Create
+vlc_thumbnailer_t *vlc_thumbnailer_Create( vlc_object_t *p_parent,
+                                           const char *psz_mrl )
+{
+    vlc_thumbnailer_t *p_th = calloc( 1, sizeof( *p_th ) );
+    if( unlikely(p_th == NULL) )
+        return NULL;
+
+    p_th->p_obj = vlc_object_create( p_parent, sizeof( vlc_object_t ) );
+    if( unlikely(p_th->p_obj == NULL) )
+    {
+        free( p_th );
+        return NULL;
+    }
+
+    p_th->out.pf_add = EsOutAdd;
+    p_th->out.pf_send = EsOutSend;
+    p_th->out.pf_del = EsOutDel;
+    p_th->out.pf_control = EsOutControl;
+    p_th->out.pf_destroy = EsOutDestroy;
+    p_th->out.p_sys = (es_out_sys_t *)p_th;
+
+    p_th->p_image = image_HandlerCreate( p_th->p_obj );
+    if( unlikely(p_th->p_image == NULL) )
+        goto error;
+
+    p_th->p_stream = stream_UrlNew( p_th->p_obj, psz_mrl );
+    if( p_th->p_stream == NULL )
+    {
+        msg_Err( p_th->p_obj, "cannot open %s", psz_mrl );
+        goto error;
+    }
+
+    const char *psz_location = strstr( psz_mrl, "://" );
+    psz_location = (psz_location != NULL) ? psz_location + 3 : psz_mrl;
+
+    p_th->p_demux = demux_New( p_th->p_obj, "any", psz_location,
+                               p_th->p_stream, &p_th->out );
+    if( p_th->p_demux == NULL )
+    {
+        msg_Err( p_th->p_obj, "cannot demux %s", psz_mrl );
+        goto error;
+    }
+    p_th->p_stream = NULL; /* deleted with the demuxer */
+
+    /* Most demuxers declare their ES when opening, others on the fly */
+    for( unsigned i = 0; p_th->p_video == NULL && i < 100; i++ )
+        if( demux_Demux( p_th->p_demux ) <= 0 )
+            break;
+
+    if( p_th->p_video == NULL )
+    {
+        msg_Err( p_th->p_obj, "no video track in %s", psz_mrl );
+        goto error;
+    }
+    return p_th;
+
+error:
+    vlc_thumbnailer_Release( p_th );
+    return NULL;
+}
+
+void vlc_thumbnailer_Release( vlc_thumbnailer_t *p_th )
+{
+    if( p_th->p_demux != NULL )
+        demux_Delete( p_th->p_demux );
+    if( p_th->p_stream != NULL )
+        stream_Delete( p_th->p_stream );
+
+    if( p_th->p_picture != NULL )
+        picture_Release( p_th->p_picture );
+    if( p_th->p_decoder != NULL )
+        ModuleDelete( p_th->p_decoder );
+    if( p_th->p_packetizer != NULL )
+        ModuleDelete( p_th->p_packetizer );
+
+    while( p_th->p_ids != NULL )
+    {
+        es_out_id_t *id = p_th->p_ids;
+
+        p_th->p_ids = id->p_next;
+        es_format_Clean( &id->fmt );
+        free( id );
+    }
+
+    if( p_th->p_image != NULL )
+        image_HandlerDelete( p_th->p_image );
+    vlc_object_release( p_th->p_obj );
+    free( p_th );
+}
+
+mtime_t vlc_thumbnailer_GetLength( vlc_thumbnailer_t *p_th )
+{
+    int64_t i_length;
+
+    if( demux_Control( p_th->p_demux, DEMUX_GET_LENGTH, &i_length ) )
+        return 0;
+    return i_length;
+}
+
+static int Seek( vlc_thumbnailer_t *p_th, mtime_t i_time )
+{
+    /* Not precise: the demuxer can stop at the key frame before */
+    if( demux_Control( p_th->p_demux, DEMUX_SET_TIME, (int64_t)i_time,
+                       false ) == VLC_SUCCESS )
+        return VLC_SUCCESS;
+
+    mtime_t i_length = vlc_thumbnailer_GetLength( p_th );
+    if( i_length <= 0 )
+        return VLC_EGENERIC;
+    return demux_Control( p_th->p_demux, DEMUX_SET_POSITION,
+                          (double)i_time / i_length, false );
+}
+
+picture_t *vlc_thumbnailer_Get( vlc_thumbnailer_t *p_th, mtime_t i_time,
+                                video_format_t *p_fmt )
+{
+    if( Seek( p_th, i_time ) )
+    {
+        msg_Warn( p_th->p_obj, "cannot seek to %"PRId64" us", i_time );
+        return NULL;
+    }
+
+    if( p_th->p_packetizer != NULL && p_th->p_packetizer->pf_flush != NULL )
+        p_th->p_packetizer->pf_flush( p_th->p_packetizer );
+    if( p_th->p_decoder != NULL && p_th->p_decoder->pf_flush != NULL )
+        p_th->p_decoder->pf_flush( p_th->p_decoder );
+
+    p_th->b_waiting = true;
+    p_th->i_blocks = 0;
+    assert( p_th->p_picture == NULL );
+
+    for( unsigned i = 0; p_th->b_waiting && i < THUMBNAILER_MAX_DEMUX; i++ )
+    {
+        if( p_th->i_blocks >= THUMBNAILER_MAX_BLOCKS )
+            break;
+        if( demux_Demux( p_th->p_demux ) <= 0 )
+            break;
+    }
+    p_th->b_waiting = false;
+
+    picture_t *p_pic = p_th->p_picture;
+    p_th->p_picture = NULL;
+    if( p_pic == NULL )
+    {
+        msg_Warn( p_th->p_obj, "no key frame decoded at %"PRId64" us",
+                  i_time );
+        return NULL;
+    }
+
+    /* Scale and convert as requested, keeping the display aspect ratio of
+     * the visible area: the coded size includes the decoder padding */
+    const video_format_t *p_src = &p_th->p_decoder->fmt_out.video;
+    unsigned i_sar_num = p_src->i_sar_num, i_sar_den = p_src->i_sar_den;
+    unsigned i_width = p_src->i_visible_width;
+    unsigned i_height = p_src->i_visible_height;
+
+    if( !i_width || !i_height )
+    {
+        i_width = p_src->i_width;
+        i_height = p_src->i_height;
+    }
+    if( !i_sar_num || !i_sar_den )
+        i_sar_num = i_sar_den = 1;
+    if( !p_fmt->i_chroma )
+        p_fmt->i_chroma = p_src->i_chroma;
+    if( !p_fmt->i_width && p_fmt->i_height )
+        p_fmt->i_width = (int64_t)i_width * i_sar_num *
+                         p_fmt->i_height / i_height / i_sar_den;
+    if( !p_fmt->i_height && p_fmt->i_width )
+        p_fmt->i_height = (int64_t)i_height * i_sar_den *
+                          p_fmt->i_width / i_width / i_sar_num;
+    if( !p_fmt->i_width )
+        p_fmt->i_width = i_width;
+    if( !p_fmt->i_height )
+        p_fmt->i_height = i_height;
+    p_fmt->i_visible_width = p_fmt->i_width;
+    p_fmt->i_visible_height = p_fmt->i_height;
+    p_fmt->i_sar_num = p_fmt->i_sar_den = 1;
+
+    video_format_t fmt_in = *p_src;
+    picture_t *p_out = image_Convert( p_th->p_image, p_pic, &fmt_in, p_fmt );
+    picture_Release( p_pic );
+    return p_out;
+}
@@ -463,6 +463,12 @@ static const char *const ppsz_pos_descriptions[] =
     "Enables framedropping on MPEG2 stream. Framedropping " \
     "occurs when your computer is not powerful enough" )
 
+#define VIDEO_PIPELINE_TEXT N_("Prepare pictures ahead")
+#define VIDEO_PIPELINE_LONGTEXT N_( \
+    "Run the interactive video filters and blend the subtitles of the next " \
+    "picture on a separate thread, while the current picture waits to be " \
+    "displayed." )
+
 #define DROP_LATE_FRAMES_TEXT N_("Drop late frames")
 #define DROP_LATE_FRAMES_LONGTEXT N_( \
     "This drops frames that are late (arrive to the video output after " \
@@ -554,6 +560,11 @@ static const char *const ppsz_clock_descriptions[] =
     "for outgoing UDP streams (or IPv4 Type Of Service, " \
     "or IPv6 Traffic Class). This is used for network Quality of Service.")
 
+#define SOUT_PACING_TEXT N_("Pace network output packets")
+#define SOUT_PACING_LONGTEXT N_( \
+    "Spread the packets of network stream outputs evenly at the stream " \
+    "rate, rather than sending them in bursts.")
+
 #define INPUT_PROGRAM_TEXT N_("Program")
 #define INPUT_PROGRAM_LONGTEXT N_( \
     "Choose the program to select by giving its Service ID. " \
@@ -892,6 +903,12 @@ static const char *const ppsz_prefres[] = {
     "before trying the other ones. Only advanced users should " \
     "alter this option as it can break playback of all your streams." )
 
+#define PACKETIZER_THREAD_TEXT N_("Packetize video on a separate thread")
+#define PACKETIZER_THREAD_LONGTEXT N_( \
+    "Run the video packetizer and the video decoder on two threads, so " \
+    "that parsing the next frames overlaps with decoding the current one. " \
+    "This mostly helps high bitrate streams with software decoders.")
+
 #define ENCODER_TEXT N_("Preferred encoders list")
 #define ENCODER_LONGTEXT N_( \
     "This allows you to select a list of encoders that VLC will use in " \
@@ -1502,6 +1519,8 @@ vlc_module_begin ()
         change_private ()
     add_bool( "drop-late-frames", 1, DROP_LATE_FRAMES_TEXT,
               DROP_LATE_FRAMES_LONGTEXT, true )
+    add_bool( "video-pipeline", false, VIDEO_PIPELINE_TEXT,
+              VIDEO_PIPELINE_LONGTEXT, true )
     /* Used in vout_synchro */
     add_bool( "skip-frames", 1, SKIP_FRAMES_TEXT,
               SKIP_FRAMES_LONGTEXT, true )
@@ -1864,6 +1883,8 @@ vlc_module_begin ()
                 CODEC_LONGTEXT, true )
     add_string( "encoder",  NULL, ENCODER_TEXT,
                 ENCODER_LONGTEXT, true )
+    add_bool( "packetizer-thread", false, PACKETIZER_THREAD_TEXT,
+              PACKETIZER_THREAD_LONGTEXT, true )
 
     set_subcategory( SUBCAT_INPUT_ACCESS )
     add_category_hint( N_("Input"), INPUT_CAT_LONGTEXT , false )
@@ -1920,6 +1941,8 @@ vlc_module_begin ()
     add_string( "miface", NULL, MIFACE_TEXT, MIFACE_LONGTEXT, true )
     add_obsolete_string( "miface-addr" ) /* since 2.0.0 */
     add_integer( "dscp", 0, DSCP_TEXT, DSCP_LONGTEXT, true )
+    add_bool( "sout-pacing", false, SOUT_PACING_TEXT, SOUT_PACING_LONGTEXT,
+              true )
 
     set_subcategory( SUBCAT_SOUT_PACKETIZER )
     add_module( "packetizer", "packetizer", NULL,
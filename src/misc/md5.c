@@ -40,10 +40,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#include <fcntl.h>
 
 #include <vlc_common.h>
 #include <vlc_md5.h>
 
+#ifndef HAVE_POSIX_FADVISE
+# define posix_fadvise(fd, off, len, adv)
+#endif
+
 typedef uint32_t u32;
 typedef uint8_t byte;
 #define rol(x,n) ( ((x) << (n)) | ((x) >> (32-(n))) )
@@ -233,8 +242,13 @@ md5_write( void *context, const void *inbuf_arg , size_t inlen)
 
   if( hd->count )
     {
-      for( ; inlen && hd->count < 64; inlen-- )
-        hd->buf[hd->count++] = *inbuf++;
+      size_t n = 64 - hd->count;
+      if( n > inlen )
+        n = inlen;
+      memcpy( &hd->buf[hd->count], inbuf, n );
+      hd->count += n;
+      inbuf += n;
+      inlen -= n;
       md5_write( hd, NULL, 0 );
       if( !inlen )
         return;
@@ -248,9 +262,8 @@ md5_write( void *context, const void *inbuf_arg , size_t inlen)
       inlen -= 64;
       inbuf += 64;
     }
-  for( ; inlen && hd->count < 64; inlen-- )
-    hd->buf[hd->count++] = *inbuf++;
-
+  memcpy( &hd->buf[hd->count], inbuf, inlen );
+  hd->count += inlen;
 }
 
 
@@ -347,3 +360,34 @@ void EndMD5( struct md5_s *h )
 {
     md5_final( h );
 }
+
+#define MD5_FILE_CHUNK (1 << 20)
+
+int AddMD5File( struct md5_s *restrict h, int fd )
+{
+    /* Large page-aligned reads: as few system calls as possible, and direct
+     * copies from the page cache. */
+    unsigned char *buf = vlc_memalign( 4096, MD5_FILE_CHUNK );
+    if( unlikely(buf == NULL) )
+        return -1;
+
+    posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+
+    int ret = 0;
+    for( ;; )
+    {
+        ssize_t val = read( fd, buf, MD5_FILE_CHUNK );
+        if( val == 0 )
+            break;
+        if( val < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            ret = -1;
+            break;
+        }
+        md5_write( h, buf, val );
+    }
+    vlc_free( buf );
+    return ret;
+}
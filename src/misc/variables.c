@@ -76,6 +76,10 @@ struct variable_t
 
     /** The variable's exported value */
     vlc_value_t  val;
+    /** Lock-free copy of scalar values, for variable handles */
+    atomic_uint_least64_t scalar;
+    /** The object holding the variable, to check handles */
+    vlc_object_t *p_obj;
 
     /** The variable display name, mainly for use by the interfaces */
     char *       psz_text;
@@ -162,6 +166,34 @@ static variable_t *Lookup( vlc_object_t *obj, const char *psz_name )
     return (pp_var != NULL) ? *pp_var : NULL;
 }
 
+/**
+ * Mirrors the value of a scalar variable for lock-free handle reads.
+ * \note Must be called with the variable lock held, whenever val changes.
+ */
+static void Publish( variable_t *var )
+{
+    uint_least64_t bits;
+
+    switch( var->i_type & VLC_VAR_CLASS )
+    {
+        case VLC_VAR_BOOL:
+            bits = var->val.b_bool;
+            break;
+        case VLC_VAR_INTEGER:
+            bits = var->val.i_int;
+            break;
+        case VLC_VAR_FLOAT:
+        {
+            union { float f; uint32_t u; } u = { .f = var->val.f_float };
+            bits = u.u;
+            break;
+        }
+        default:
+            return;
+    }
+    atomic_store_explicit( &var->scalar, bits, memory_order_release );
+}
+
 static void Destroy( variable_t *p_var )
 {
     p_var->ops->pf_free( &p_var->val );
@@ -326,6 +358,7 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
 
     p_var->psz_name = strdup( psz_name );
     p_var->psz_text = NULL;
+    p_var->p_obj = p_this;
 
     p_var->i_type = i_type & ~VLC_VAR_DOINHERIT;
 
@@ -393,6 +426,9 @@ int var_Create( vlc_object_t *p_this, const char *psz_name, int i_type )
         }
     }
 
+    atomic_init( &p_var->scalar, 0 );
+    Publish( p_var );
+
     vlc_object_internals_t *p_priv = vlc_internals( p_this );
     variable_t **pp_var, *p_oldvar;
     int ret = VLC_SUCCESS;
@@ -684,6 +720,7 @@ int var_Change( vlc_object_t *p_this, const char *psz_name,
             break;
     }
 
+    Publish( p_var );
     vlc_mutex_unlock( &p_priv->var_lock );
 
     return ret;
@@ -752,6 +789,7 @@ int var_GetAndSet( vlc_object_t *p_this, const char *psz_name, int i_action,
     /*  Check boundaries */
     CheckValue( p_var, &p_var->val );
     *p_val = p_var->val;
+    Publish( p_var );
 
     /* Deal with callbacks.*/
     TriggerCallback( p_this, p_var, psz_name, oldval );
@@ -789,26 +827,15 @@ int var_Type( vlc_object_t *p_this, const char *psz_name )
     return i_type;
 }
 
-#undef var_SetChecked
-int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
-                    int expected_type, vlc_value_t val )
+/**
+ * Sets the value of a variable and triggers its callbacks.
+ * \note Must be called with the variable lock held.
+ */
+static void SetValue( vlc_object_t *p_this, variable_t *p_var,
+                      vlc_value_t val )
 {
-    variable_t *p_var;
     vlc_value_t oldval;
 
-    assert( p_this );
-
-    vlc_object_internals_t *p_priv = vlc_internals( p_this );
-
-    p_var = Lookup( p_this, psz_name );
-    if( p_var == NULL )
-    {
-        vlc_mutex_unlock( &p_priv->var_lock );
-        return VLC_ENOVAR;
-    }
-
-    assert( expected_type == 0 ||
-            (p_var->i_type & VLC_VAR_CLASS) == expected_type );
     assert ((p_var->i_type & VLC_VAR_CLASS) != VLC_VAR_VOID);
 
     WaitUnused( p_this, p_var );
@@ -824,12 +851,36 @@ int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
 
     /* Set the variable */
     p_var->val = val;
+    Publish( p_var );
 
     /* Deal with callbacks */
-    TriggerCallback( p_this, p_var, psz_name, oldval );
+    TriggerCallback( p_this, p_var, p_var->psz_name, oldval );
 
     /* Free data if needed */
     p_var->ops->pf_free( &oldval );
+}
+
+#undef var_SetChecked
+int var_SetChecked( vlc_object_t *p_this, const char *psz_name,
+                    int expected_type, vlc_value_t val )
+{
+    variable_t *p_var;
+
+    assert( p_this );
+
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    p_var = Lookup( p_this, psz_name );
+    if( p_var == NULL )
+    {
+        vlc_mutex_unlock( &p_priv->var_lock );
+        return VLC_ENOVAR;
+    }
+
+    assert( expected_type == 0 ||
+            (p_var->i_type & VLC_VAR_CLASS) == expected_type );
+
+    SetValue( p_this, p_var, val );
 
     vlc_mutex_unlock( &p_priv->var_lock );
     return VLC_SUCCESS;
@@ -892,6 +943,98 @@ int var_Get( vlc_object_t *p_this, const char *psz_name, vlc_value_t *p_val )
     return var_GetChecked( p_this, psz_name, 0, p_val );
 }
 
+#undef var_Acquire
+/**
+ * Resolves a variable to a handle
+ *
+ * The handle holds a reference to the variable, as var_Create() would do on
+ * an existing variable, so that it remains valid until var_Release().
+ *
+ * \param p_this The object that holds the variable
+ * \param psz_name The name of the variable
+ * \return a handle, or NULL if the variable does not exist
+ */
+vlc_var_handle_t *var_Acquire( vlc_object_t *p_this, const char *psz_name )
+{
+    assert( p_this );
+
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+    variable_t *p_var = Lookup( p_this, psz_name );
+
+    if( p_var != NULL )
+        p_var->i_usage++;
+    vlc_mutex_unlock( &p_priv->var_lock );
+    return p_var;
+}
+
+#undef var_Release
+/**
+ * Releases a variable handle obtained with var_Acquire()
+ */
+void var_Release( vlc_object_t *p_this, vlc_var_handle_t *p_var )
+{
+    assert( p_var->p_obj == p_this );
+    var_Destroy( p_this, p_var->psz_name );
+}
+
+#undef var_HandleSet
+/**
+ * Sets a variable's value through a handle
+ *
+ * This behaves like var_Set() without the name lookup: callbacks are
+ * triggered and the variable lock is taken.
+ *
+ * \param p_this The object that holds the variable, as passed to
+ *               var_Acquire()
+ * \return VLC_SUCCESS, or VLC_ENOVAR if the handle belongs to another object
+ */
+int var_HandleSet( vlc_object_t *p_this, vlc_var_handle_t *p_var,
+                   vlc_value_t val )
+{
+    assert( p_this );
+    /* The lock of another object would not protect the variable */
+    assert( p_var->p_obj == p_this );
+    if( unlikely(p_var->p_obj != p_this) )
+        return VLC_ENOVAR;
+
+    vlc_object_internals_t *p_priv = vlc_internals( p_this );
+
+    vlc_mutex_lock( &p_priv->var_lock );
+    SetValue( p_this, p_var, val );
+    vlc_mutex_unlock( &p_priv->var_lock );
+    return VLC_SUCCESS;
+}
+
+/**
+ * Gets a boolean value through a handle, without locking
+ */
+bool var_HandleGetBool( vlc_var_handle_t *p_var )
+{
+    assert( (p_var->i_type & VLC_VAR_CLASS) == VLC_VAR_BOOL );
+    return atomic_load_explicit( &p_var->scalar, memory_order_acquire ) != 0;
+}
+
+/**
+ * Gets an integer value through a handle, without locking
+ */
+int64_t var_HandleGetInteger( vlc_var_handle_t *p_var )
+{
+    assert( (p_var->i_type & VLC_VAR_CLASS) == VLC_VAR_INTEGER );
+    return atomic_load_explicit( &p_var->scalar, memory_order_acquire );
+}
+
+/**
+ * Gets a float value through a handle, without locking
+ */
+float var_HandleGetFloat( vlc_var_handle_t *p_var )
+{
+    assert( (p_var->i_type & VLC_VAR_CLASS) == VLC_VAR_FLOAT );
+
+    union { float f; uint32_t u; } u;
+    u.u = atomic_load_explicit( &p_var->scalar, memory_order_acquire );
+    return u.f;
+}
+
 typedef enum
 {
     vlc_value_callback,
@@ -35,67 +35,217 @@
  * they typically require one thread per timer plus one thread per iteration,
  * which is inefficient and overkill (unless you need multiple iteration
  * of the same timer concurrently).
- * Thus, this is a generic manual implementation of timers using a thread.
+ * Thus, this is a generic manual implementation of timers. All armed timers
+ * are kept in a single queue, ordered by deadline, and served by a small pool
+ * of threads shared by all timers. One thread is started with the first
+ * timer, others on demand, and all are stopped when the last timer is
+ * destroyed (unless that happens from a callback: they are then kept for
+ * the next timer).
+ * Callbacks run on at most VLC_TIMER_MAX_THREADS threads. If that many
+ * callbacks block at once, the other due timers are delayed until one of them
+ * returns: callbacks must not block for long.
  */
 
+#define VLC_TIMER_MAX_THREADS 8
+#define VLC_TIMER_UNQUEUED ((size_t)-1)
+
 struct vlc_timer
 {
-    vlc_thread_t thread;
-    vlc_cond_t   reschedule;
-    vlc_mutex_t  lock;
     void       (*func) (void *);
     void        *data;
     mtime_t      value, interval;
+    size_t       index; /**< position in the queue, if armed */
+    bool         running; /**< callback being executed */
+    bool         rescheduled; /**< rescheduled while running */
+    bool         destroyed; /**< destroyed from its own callback */
     atomic_uint  overruns;
 };
 
-VLC_NORETURN
-static void *vlc_timer_thread (void *data)
+static vlc_mutex_t setup_lock = VLC_STATIC_MUTEX;
+/** Timer whose callback the calling thread is executing, if any */
+static __thread struct vlc_timer *vlc_timer_current = NULL;
+
+static struct
 {
-    struct vlc_timer *timer = data;
+    vlc_mutex_t lock;
+    vlc_cond_t wait; /**< queue changed */
+    vlc_cond_t done; /**< a callback returned */
+    struct vlc_timer **queue; /**< binary min-heap on value */
+    size_t count, size;
+    unsigned users;
+    unsigned threads, idle;
+    bool quit;
+    vlc_thread_t thread[VLC_TIMER_MAX_THREADS];
+} timers = {
+    .lock = VLC_STATIC_MUTEX,
+};
 
-    vlc_mutex_lock (&timer->lock);
-    mutex_cleanup_push (&timer->lock);
+static void vlc_timer_queue_set (size_t i, struct vlc_timer *timer)
+{
+    timers.queue[i] = timer;
+    timer->index = i;
+}
+
+static void vlc_timer_queue_up (size_t i)
+{
+    struct vlc_timer *timer = timers.queue[i];
+
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+
+        if (timers.queue[parent]->value <= timer->value)
+            break;
+        vlc_timer_queue_set (i, timers.queue[parent]);
+        i = parent;
+    }
+    vlc_timer_queue_set (i, timer);
+}
+
+static void vlc_timer_queue_down (size_t i)
+{
+    struct vlc_timer *timer = timers.queue[i];
 
     for (;;)
     {
-        while (timer->value == 0)
-            vlc_cond_wait (&timer->reschedule, &timer->lock);
+        size_t child = 2 * i + 1;
+
+        if (child >= timers.count)
+            break;
+        if (child + 1 < timers.count
+         && timers.queue[child + 1]->value < timers.queue[child]->value)
+            child++;
+        if (timer->value <= timers.queue[child]->value)
+            break;
+        vlc_timer_queue_set (i, timers.queue[child]);
+        i = child;
+    }
+    vlc_timer_queue_set (i, timer);
+}
+
+static void vlc_timer_queue_insert (struct vlc_timer *timer)
+{
+    assert (timer->index == VLC_TIMER_UNQUEUED);
+    assert (timers.count < timers.size); /* see vlc_timer_create() */
+
+    vlc_timer_queue_set (timers.count, timer);
+    vlc_timer_queue_up (timers.count++);
+
+    if (timer->index == 0) /* new earliest deadline */
+        vlc_cond_broadcast (&timers.wait);
+}
+
+static void vlc_timer_queue_remove (struct vlc_timer *timer)
+{
+    size_t i = timer->index;
+
+    assert (i < timers.count && timers.queue[i] == timer);
+    timer->index = VLC_TIMER_UNQUEUED;
+
+    if (i == --timers.count)
+        return;
+
+    vlc_timer_queue_set (i, timers.queue[timers.count]);
+    vlc_timer_queue_up (i);
+    vlc_timer_queue_down (timers.queue[i]->index);
+}
+
+static void *vlc_timer_thread (void *data);
+
+/**
+ * Starts one more thread if none is available to serve the queue.
+ * Failing that is only fatal for the first thread: the others merely add
+ * parallelism between callbacks.
+ * \return 0 on success, a system error code otherwise
+ */
+static int vlc_timer_spawn (void)
+{
+    if (timers.idle > 0 || timers.threads >= VLC_TIMER_MAX_THREADS)
+        return 0;
+
+    int val = vlc_clone (&timers.thread[timers.threads], vlc_timer_thread,
+                         NULL, VLC_THREAD_PRIORITY_INPUT);
+    if (val == 0)
+    {
+        timers.threads++;
+        timers.idle++;
+    }
+    return val;
+}
+
+static void *vlc_timer_thread (void *data)
+{
+    vlc_mutex_lock (&timers.lock);
+
+    while (!timers.quit)
+    {
+        if (timers.count == 0)
+        {
+            vlc_cond_wait (&timers.wait, &timers.lock);
+            continue;
+        }
+
+        struct vlc_timer *timer = timers.queue[0];
 
-        if (vlc_cond_timedwait (&timer->reschedule, &timer->lock,
-                                timer->value) == 0)
+        if (timer->value > mdate ())
+        {
+            vlc_cond_timedwait (&timers.wait, &timers.lock, timer->value);
             continue;
+        }
+
+        vlc_timer_queue_remove (timer);
         if (timer->interval == 0)
             timer->value = 0; /* disarm */
-        vlc_mutex_unlock (&timer->lock);
+        timer->running = true;
+        timers.idle--;
+        if (timers.count > 0)
+            vlc_timer_spawn ();
+        vlc_mutex_unlock (&timers.lock);
 
         int canc = vlc_savecancel ();
+        vlc_timer_current = timer;
         timer->func (timer->data);
+        vlc_timer_current = NULL;
         vlc_restorecancel (canc);
 
         mtime_t now = mdate ();
-        unsigned misses;
 
-        vlc_mutex_lock (&timer->lock);
-        if (timer->interval == 0)
-            continue;
+        vlc_mutex_lock (&timers.lock);
+        timers.idle++;
+        timer->running = false;
 
-        misses = (now - timer->value) / timer->interval;
-        timer->value += timer->interval;
-        /* Try to compensate for one miss (mwait() will return immediately)
-         * but no more. Otherwise, we might busy loop, after extended periods
-         * without scheduling (suspend, SIGSTOP, RT preemption, ...). */
-        if (misses > 1)
+        if (timer->destroyed)
+            free (timer);
+        else if (timer->rescheduled)
+        {   /* Follow the new schedule as is */
+            timer->rescheduled = false;
+            if (timer->value != 0)
+                vlc_timer_queue_insert (timer);
+        }
+        else if (timer->interval != 0)
         {
-            misses--;
-            timer->value += misses * timer->interval;
-            atomic_fetch_add_explicit (&timer->overruns, misses,
-                                       memory_order_relaxed);
+            unsigned misses = (now - timer->value) / timer->interval;
+
+            timer->value += timer->interval;
+            /* Try to compensate for one miss (the thread will fire again
+             * immediately) but no more. Otherwise, we might busy loop, after
+             * extended periods without scheduling (suspend, SIGSTOP, RT
+             * preemption, ...). */
+            if (misses > 1)
+            {
+                misses--;
+                timer->value += misses * timer->interval;
+                atomic_fetch_add_explicit (&timer->overruns, misses,
+                                           memory_order_relaxed);
+            }
+            vlc_timer_queue_insert (timer);
         }
+        vlc_cond_broadcast (&timers.done);
     }
 
-    vlc_cleanup_pop ();
-    vlc_assert_unreachable ();
+    vlc_mutex_unlock (&timers.lock);
+    (void) data;
+    return NULL;
 }
 
 int vlc_timer_create (vlc_timer_t *id, void (*func) (void *), void *data)
@@ -104,35 +254,119 @@ int vlc_timer_create (vlc_timer_t *id, void (*func) (void *), void *data)
 
     if (unlikely(timer == NULL))
         return ENOMEM;
-    vlc_mutex_init (&timer->lock);
-    vlc_cond_init (&timer->reschedule);
     assert (func);
     timer->func = func;
     timer->data = data;
     timer->value = 0;
     timer->interval = 0;
+    timer->index = VLC_TIMER_UNQUEUED;
+    timer->running = false;
+    timer->rescheduled = false;
+    timer->destroyed = false;
     atomic_init(&timer->overruns, 0);
 
-    if (vlc_clone (&timer->thread, vlc_timer_thread, timer,
-                   VLC_THREAD_PRIORITY_INPUT))
+    int val = 0;
+
+    vlc_mutex_lock (&setup_lock);
+    vlc_mutex_lock (&timers.lock);
+    if (timers.threads == 0)
     {
-        vlc_cond_destroy (&timer->reschedule);
-        vlc_mutex_destroy (&timer->lock);
-        free (timer);
-        return ENOMEM;
+        vlc_cond_init (&timers.wait);
+        vlc_cond_init (&timers.done);
+        timers.quit = false;
+    }
+
+    /* A timer is queued at most once: make room now, so that arming it
+     * cannot fail later on. */
+    if (timers.users == timers.size)
+    {
+        size_t size = timers.size ? (timers.size * 2) : 16;
+        struct vlc_timer **queue = realloc (timers.queue,
+                                            size * sizeof (*queue));
+        if (likely(queue != NULL))
+        {
+            timers.queue = queue;
+            timers.size = size;
+        }
+        else
+            val = ENOMEM;
     }
 
+    /* The queue is served by at least one thread while there are timers */
+    if (val == 0 && timers.threads == 0)
+        val = vlc_timer_spawn ();
+
+    if (val == 0)
+        timers.users++;
+    else if (timers.threads == 0)
+    {
+        free (timers.queue);
+        timers.queue = NULL;
+        timers.size = 0;
+        vlc_cond_destroy (&timers.done);
+        vlc_cond_destroy (&timers.wait);
+    }
+    vlc_mutex_unlock (&timers.lock);
+    vlc_mutex_unlock (&setup_lock);
+
+    if (val != 0)
+    {
+        free (timer);
+        return val;
+    }
     *id = timer;
     return 0;
 }
 
 void vlc_timer_destroy (vlc_timer_t timer)
 {
-    vlc_cancel (timer->thread);
-    vlc_join (timer->thread, NULL);
-    vlc_cond_destroy (&timer->reschedule);
-    vlc_mutex_destroy (&timer->lock);
-    free (timer);
+    bool self = timer == vlc_timer_current;
+
+    vlc_mutex_lock (&timers.lock);
+    if (timer->index != VLC_TIMER_UNQUEUED)
+        vlc_timer_queue_remove (timer);
+    timer->value = 0;
+    timer->rescheduled = true; /* do not requeue if running */
+    if (self)
+        /* Called from the callback: the thread frees the timer after it */
+        timer->destroyed = true;
+    else
+    {
+        while (timer->running)
+            vlc_cond_wait (&timers.done, &timers.lock);
+    }
+    vlc_mutex_unlock (&timers.lock);
+    if (!self)
+        free (timer);
+
+    vlc_mutex_lock (&setup_lock);
+    vlc_mutex_lock (&timers.lock);
+    /* A thread cannot join itself: if called from a callback, the threads
+     * are kept, and stopped along with the next last timer instead. */
+    if (--timers.users > 0 || vlc_timer_current != NULL)
+    {
+        vlc_mutex_unlock (&timers.lock);
+        vlc_mutex_unlock (&setup_lock);
+        return;
+    }
+
+    /* Last timer: stop the threads */
+    assert (timers.count == 0);
+    timers.quit = true;
+    vlc_cond_broadcast (&timers.wait);
+    vlc_mutex_unlock (&timers.lock);
+
+    for (unsigned i = 0; i < timers.threads; i++)
+        vlc_join (timers.thread[i], NULL);
+
+    timers.threads = 0;
+    timers.idle = 0;
+    free (timers.queue);
+    timers.queue = NULL;
+    timers.size = 0;
+    vlc_cond_destroy (&timers.done);
+    vlc_cond_destroy (&timers.wait);
+    vlc_mutex_unlock (&setup_lock);
 }
 
 void vlc_timer_schedule (vlc_timer_t timer, bool absolute,
@@ -141,11 +375,20 @@ void vlc_timer_schedule (vlc_timer_t timer, bool absolute,
     if (!absolute && value != 0)
         value += mdate();
 
-    vlc_mutex_lock (&timer->lock);
+    vlc_mutex_lock (&timers.lock);
+    if (timer->index != VLC_TIMER_UNQUEUED)
+        vlc_timer_queue_remove (timer);
     timer->value = value;
     timer->interval = interval;
-    vlc_cond_signal (&timer->reschedule);
-    vlc_mutex_unlock (&timer->lock);
+
+    if (timer->running)
+        timer->rescheduled = true; /* requeued once the callback returns */
+    else if (value != 0)
+    {
+        vlc_timer_spawn ();
+        vlc_timer_queue_insert (timer);
+    }
+    vlc_mutex_unlock (&timers.lock);
 }
 
 unsigned vlc_timer_getoverrun (vlc_timer_t timer)
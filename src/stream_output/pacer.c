@@ -0,0 +1,164 @@
+/*****************************************************************************
+ * pacer.c : stream output packet pacing
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_sout.h>
+
+/* Span of timestamps over which the output rate is measured */
+#define RATE_WINDOW    (CLOCK_FREQ / 5)
+/* Timestamp gap (or backward jump) treated as a discontinuity */
+#define RATE_RESET     (2 * CLOCK_FREQ)
+/* Maximum delay added to a packet to spread a burst */
+#define MAX_LAG        (CLOCK_FREQ / 20)
+/* Lateness above which a packet is counted as late */
+#define LATE_THRESHOLD (CLOCK_FREQ / 50)
+#define REPORT_PERIOD  (10 * CLOCK_FREQ)
+
+struct sout_pacer_t
+{
+    vlc_object_t *obj;
+    mtime_t       i_delay;
+    mtime_t       i_max_lag;
+    bool          b_spread;
+
+    /* Rate estimation, from the packet timestamps */
+    mtime_t       i_window_start;
+    uint64_t      i_window_bytes;
+    uint64_t      i_rate; /* bytes per second, 0 if unknown */
+
+    /* Scheduling */
+    mtime_t       i_next;
+
+    /* Measurements */
+    mtime_t       i_last_sent;
+    mtime_t       i_last_date;
+    mtime_t       i_jitter;
+    unsigned      i_late;
+    mtime_t       i_report;
+};
+
+#undef sout_PacerNew
+sout_pacer_t *sout_PacerNew( vlc_object_t *obj, mtime_t i_delay )
+{
+    sout_pacer_t *p = malloc( sizeof( *p ) );
+    if( unlikely(p == NULL) )
+        return NULL;
+
+    p->obj = obj;
+    p->i_delay = i_delay;
+    p->i_max_lag = __MIN( i_delay / 2, MAX_LAG );
+    p->b_spread = var_InheritBool( obj, "sout-pacing" );
+    p->i_rate = 0;
+    p->i_jitter = 0;
+    p->i_late = 0;
+    p->i_report = 0;
+    sout_PacerReset( p );
+    return p;
+}
+
+void sout_PacerDelete( sout_pacer_t *p )
+{
+    free( p );
+}
+
+void sout_PacerReset( sout_pacer_t *p )
+{
+    p->i_window_start = VLC_TS_INVALID;
+    p->i_window_bytes = 0;
+    p->i_next = VLC_TS_INVALID;
+    p->i_last_sent = VLC_TS_INVALID;
+    p->i_last_date = VLC_TS_INVALID;
+}
+
+static void UpdateRate( sout_pacer_t *p, mtime_t i_dts, size_t i_size )
+{
+    if( p->i_window_start <= VLC_TS_INVALID || i_dts < p->i_window_start
+     || i_dts - p->i_window_start > RATE_RESET )
+    {
+        p->i_window_start = i_dts;
+        p->i_window_bytes = i_size;
+        return;
+    }
+
+    mtime_t i_span = i_dts - p->i_window_start;
+    if( i_span >= RATE_WINDOW )
+    {
+        uint64_t i_rate = p->i_window_bytes * CLOCK_FREQ / i_span;
+        /* Exponential smoothing, 1/8 weight for the latest window */
+        p->i_rate = p->i_rate ? (7 * p->i_rate + i_rate) / 8 : i_rate;
+        p->i_window_start = i_dts;
+        p->i_window_bytes = 0;
+    }
+    p->i_window_bytes += i_size;
+}
+
+mtime_t sout_PacerSchedule( sout_pacer_t *p, mtime_t i_dts, size_t i_size )
+{
+    mtime_t i_deadline = i_dts + p->i_delay;
+
+    UpdateRate( p, i_dts, i_size );
+    if( !p->b_spread || p->i_rate == 0 )
+        return i_deadline;
+
+    /* Packets leave at the measured rate (plus a little headroom, so that
+     * the lag accumulated during a burst is absorbed afterwards), never
+     * before their timestamp and never more than i_max_lag after it. */
+    mtime_t i_date = i_deadline;
+    if( p->i_next > i_date )
+        i_date = __MIN( p->i_next, i_deadline + p->i_max_lag );
+
+    p->i_next = i_date + i_size * CLOCK_FREQ / (p->i_rate + p->i_rate / 16);
+    return i_date;
+}
+
+void sout_PacerSent( sout_pacer_t *p, mtime_t i_date, mtime_t i_sent )
+{
+    if( p->i_last_sent > VLC_TS_INVALID )
+    {
+        /* Jitter as in RFC 3550: difference between the actual and the
+         * scheduled inter-departure times, smoothed over 16 packets */
+        mtime_t d = (i_sent - p->i_last_sent) - (i_date - p->i_last_date);
+        if( d < 0 )
+            d = -d;
+        p->i_jitter += (d - p->i_jitter) / 16;
+    }
+    p->i_last_sent = i_sent;
+    p->i_last_date = i_date;
+
+    if( i_sent > i_date + LATE_THRESHOLD )
+        p->i_late++;
+
+    if( i_sent >= p->i_report )
+    {
+        if( p->i_report != 0 )
+            msg_Dbg( p->obj, "pacing: %"PRIu64" kb/s, jitter %"PRId64" us, "
+                     "%u late packets", p->i_rate * 8 / 1000, p->i_jitter,
+                     p->i_late );
+        p->i_late = 0;
+        p->i_report = i_sent + REPORT_PERIOD;
+    }
+}
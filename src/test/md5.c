@@ -25,8 +25,10 @@
 # include <config.h>
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <vlc_common.h>
 #include <vlc_md5.h>
@@ -72,9 +74,74 @@ static void test_config_StringEscape()
     }
 }
 
+static void check_hash( struct md5_s *md5, const char *psz_expected )
+{
+    char *psz_hash = psz_md5_hash( md5 );
+    if( strcmp( psz_hash, psz_expected ) )
+    {
+        printf( "Output: %s\nExpected: %s\n", psz_hash, psz_expected );
+        abort();
+    }
+    free( psz_hash );
+}
+
+/* Splits the input at odd offsets, so that the block buffer gets partially
+ * filled, then completed, then bypassed. */
+static void test_chunks( void )
+{
+    for( int i = 0; md5_samples[i].psz_string; i++ )
+    {
+        const char *psz = md5_samples[i].psz_string;
+        size_t i_len = strlen( psz );
+
+        for( size_t i_chunk = 1; i_chunk <= 67; i_chunk += 3 )
+        {
+            struct md5_s md5;
+            InitMD5( &md5 );
+            for( size_t i_pos = 0; i_pos < i_len; i_pos += i_chunk )
+                AddMD5( &md5, &psz[i_pos], __MIN( i_chunk, i_len - i_pos ) );
+            EndMD5( &md5 );
+            check_hash( &md5, md5_samples[i].psz_md5 );
+        }
+    }
+}
+
+static void test_file( void )
+{
+    const size_t i_len = (3 << 20) + 17;
+    unsigned char *p_buf = malloc( i_len );
+    if( p_buf == NULL )
+        abort();
+    for( size_t i = 0; i < i_len; i++ )
+        p_buf[i] = i * 7 + (i >> 11);
+
+    struct md5_s md5;
+    InitMD5( &md5 );
+    AddMD5( &md5, p_buf, i_len );
+    EndMD5( &md5 );
+    char *psz_expected = psz_md5_hash( &md5 );
+
+    FILE *file = tmpfile();
+    if( file == NULL || fwrite( p_buf, 1, i_len, file ) != i_len
+     || fflush( file ) || fseek( file, 0, SEEK_SET ) )
+        abort();
+
+    InitMD5( &md5 );
+    if( AddMD5File( &md5, fileno( file ) ) )
+        abort();
+    EndMD5( &md5 );
+    check_hash( &md5, psz_expected );
+
+    fclose( file );
+    free( psz_expected );
+    free( p_buf );
+}
+
 int main( void )
 {
     test_config_StringEscape();
+    test_chunks();
+    test_file();
 
     return 0;
 }
@@ -28,12 +28,12 @@
 #include <assert.h>
 
 #include <vlc_common.h>
-#undef msleep
 
 struct timer_data
 {
     vlc_timer_t timer;
     vlc_mutex_t lock;
+    vlc_cond_t wait;
     unsigned count;
 };
 
@@ -43,9 +43,165 @@ static void callback (void *ptr)
 
     vlc_mutex_lock (&data->lock);
     data->count += 1 + vlc_timer_getoverrun (data->timer);
+    vlc_cond_signal (&data->wait);
     vlc_mutex_unlock (&data->lock);
 }
 
+/* Waits for a timer to fire at least that many times */
+static void wait_count (struct timer_data *data, unsigned count)
+{
+    vlc_mutex_lock (&data->lock);
+    while (data->count < count)
+        vlc_cond_wait (&data->wait, &data->lock);
+    printf ("Count = %u\n", data->count);
+    data->count = 0;
+    vlc_mutex_unlock (&data->lock);
+}
+
+struct timer_once
+{
+    vlc_timer_t timer;
+    mtime_t deadline;
+    mtime_t fired;
+    unsigned count;
+};
+
+static vlc_mutex_t once_lock = VLC_STATIC_MUTEX;
+static vlc_cond_t once_wait;
+static unsigned once_pending;
+
+static void callback_once (void *ptr)
+{
+    struct timer_once *t = ptr;
+
+    t->fired = mdate ();
+    t->count++;
+    vlc_mutex_lock (&once_lock);
+    once_pending--;
+    vlc_cond_signal (&once_wait);
+    vlc_mutex_unlock (&once_lock);
+}
+
+/* One-shot timers fire once each, and never before their deadline */
+static void test_once (void)
+{
+    const unsigned n = 16;
+    struct timer_once tab[n];
+    mtime_t now = mdate ();
+
+    vlc_cond_init (&once_wait);
+    once_pending = n;
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        tab[i].count = 0;
+        assert (vlc_timer_create (&tab[i].timer, callback_once, &tab[i]) == 0);
+    }
+    /* Scheduled in reverse order of the deadlines */
+    for (unsigned i = n; i-- > 0;)
+    {
+        tab[i].deadline = now + (i + 1) * (CLOCK_FREQ / 100);
+        vlc_timer_schedule (tab[i].timer, true, tab[i].deadline, 0);
+    }
+
+    vlc_mutex_lock (&once_lock);
+    while (once_pending > 0)
+        vlc_cond_wait (&once_wait, &once_lock);
+    vlc_mutex_unlock (&once_lock);
+
+    for (unsigned i = 0; i < n; i++)
+        vlc_timer_destroy (tab[i].timer);
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        assert (tab[i].count == 1);
+        assert (tab[i].fired >= tab[i].deadline);
+    }
+    vlc_cond_destroy (&once_wait);
+}
+
+struct timer_many
+{
+    vlc_timer_t timer;
+    unsigned count;
+};
+
+static vlc_mutex_t many_lock = VLC_STATIC_MUTEX;
+static vlc_cond_t many_wait;
+static unsigned many_pending;
+
+static void callback_many (void *ptr)
+{
+    struct timer_many *t = ptr;
+
+    /* Occurrences of one timer are serialized: no locking needed */
+    unsigned count = t->count;
+
+    t->count += 1 + vlc_timer_getoverrun (t->timer);
+    if (count < 5 && t->count >= 5)
+    {
+        vlc_mutex_lock (&many_lock);
+        many_pending--;
+        vlc_cond_signal (&many_wait);
+        vlc_mutex_unlock (&many_lock);
+    }
+}
+
+/* Many concurrent timers are served by a shared set of threads */
+static void test_many (void)
+{
+    const unsigned n = 4096;
+    struct timer_many *tab = malloc (n * sizeof (*tab));
+    assert (tab != NULL);
+
+    vlc_cond_init (&many_wait);
+    many_pending = n;
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        tab[i].count = 0;
+        assert (vlc_timer_create (&tab[i].timer, callback_many, &tab[i]) == 0);
+    }
+
+    for (unsigned i = 0; i < n; i++)
+        vlc_timer_schedule (tab[i].timer, false, 1 + (i % 100) * 100,
+                            CLOCK_FREQ / 50);
+
+    /* Every timer fires repeatedly */
+    vlc_mutex_lock (&many_lock);
+    while (many_pending > 0)
+        vlc_cond_wait (&many_wait, &many_lock);
+    vlc_mutex_unlock (&many_lock);
+
+    for (unsigned i = 0; i < n; i++)
+        vlc_timer_destroy (tab[i].timer);
+    for (unsigned i = 0; i < n; i++)
+        assert (tab[i].count >= 5);
+    vlc_cond_destroy (&many_wait);
+    free (tab);
+}
+
+static vlc_sem_t self_done;
+
+static void callback_self (void *ptr)
+{
+    vlc_timer_t *timer = ptr;
+
+    /* The last timer destroys itself: no deadlock */
+    vlc_timer_destroy (*timer);
+    vlc_sem_post (&self_done);
+}
+
+static void test_self (void)
+{
+    vlc_timer_t timer;
+
+    vlc_sem_init (&self_done, 0);
+    assert (vlc_timer_create (&timer, callback_self, &timer) == 0);
+    vlc_timer_schedule (timer, false, 1, 0);
+    vlc_sem_wait (&self_done);
+    vlc_sem_destroy (&self_done);
+}
 
 int main (void)
 {
@@ -53,6 +209,7 @@ int main (void)
     int val;
 
     vlc_mutex_init (&data.lock);
+    vlc_cond_init (&data.wait);
     data.count = 0;
 
     val = vlc_timer_create (&data.timer, callback, &data);
@@ -71,28 +228,23 @@ int main (void)
 
     /* Relative timer */
     vlc_timer_schedule (data.timer, false, 1, CLOCK_FREQ / 100);
-    msleep (CLOCK_FREQ / 10);
-    vlc_mutex_lock (&data.lock);
-    data.count += vlc_timer_getoverrun (data.timer);
-    printf ("Count = %u\n", data.count);
-    assert (data.count >= 10);
-    data.count = 0;
-    vlc_mutex_unlock (&data.lock);
+    wait_count (&data, 10);
     vlc_timer_schedule (data.timer, false, 0, 0);
 
     /* Absolute timer */
-    mtime_t now = mdate ();
-
-    vlc_timer_schedule (data.timer, true, now, CLOCK_FREQ / 100);
-    msleep (CLOCK_FREQ / 10);
-    vlc_mutex_lock (&data.lock);
-    data.count += vlc_timer_getoverrun (data.timer);
-    printf ("Count = %u\n", data.count);
-    assert (data.count >= 10);
-    vlc_mutex_unlock (&data.lock);
+    vlc_timer_schedule (data.timer, true, mdate (), CLOCK_FREQ / 100);
+    wait_count (&data, 10);
 
     vlc_timer_destroy (data.timer);
+    vlc_cond_destroy (&data.wait);
     vlc_mutex_destroy (&data.lock);
 
+    test_once ();
+    test_many ();
+    test_self ();
+
+    /* The threads kept after test_self() serve new timers */
+    test_once ();
+
     return 0;
 }
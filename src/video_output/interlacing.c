@@ -30,6 +30,7 @@
 #include <vlc_vout.h>
 
 #include "interlacing.h"
+#include "vout_internal.h"
 
 /*****************************************************************************
  * Deinterlacing
@@ -141,9 +142,9 @@ static int DeinterlaceCallback(vlc_object_t *object, char const *cmd,
     vout_thread_t *vout = (vout_thread_t *)object;
 
     /* */
-    const int  deinterlace_state = var_GetInteger(vout, "deinterlace");
+    const int  deinterlace_state = var_HandleGetInteger(vout->p->deinterlace.state);
     char       *mode             = var_GetString(vout,  "deinterlace-mode");
-    const bool is_needed         = var_GetBool(vout,    "deinterlace-needed");
+    const bool is_needed         = var_HandleGetBool(vout->p->deinterlace.needed);
     if (!mode || !DeinterlaceIsModeValid(mode))
         return VLC_EGENERIC;
 
@@ -174,6 +175,7 @@ void vout_InitInterlacingSupport(vout_thread_t *vout, bool is_interlaced)
     /* Create the configuration variables */
     /* */
     var_Create(vout, "deinterlace", VLC_VAR_INTEGER | VLC_VAR_DOINHERIT | VLC_VAR_HASCHOICE);
+    vout->p->deinterlace.state = var_Acquire(vout, "deinterlace");
     int deinterlace_state = var_GetInteger(vout, "deinterlace");
     deinterlace_state = VLC_CLIP(deinterlace_state, -1, 1);
 
@@ -211,6 +213,7 @@ void vout_InitInterlacingSupport(vout_thread_t *vout, bool is_interlaced)
     var_AddCallback(vout, "deinterlace-mode", DeinterlaceCallback, NULL);
     /* */
     var_Create(vout, "deinterlace-needed", VLC_VAR_BOOL);
+    vout->p->deinterlace.needed = var_Acquire(vout, "deinterlace-needed");
     var_AddCallback(vout, "deinterlace-needed", DeinterlaceCallback, NULL);
 
     /* Override the initial value from filters if present */
@@ -233,6 +236,12 @@ void vout_InitInterlacingSupport(vout_thread_t *vout, bool is_interlaced)
     free(deinterlace_mode);
 }
 
+void vout_CleanInterlacingSupport(vout_thread_t *vout)
+{
+    var_Release(vout, vout->p->deinterlace.state);
+    var_Release(vout, vout->p->deinterlace.needed);
+}
+
 void vout_SetInterlacingState(vout_thread_t *vout, vout_interlacing_support_t *state, bool is_interlaced)
 {
      /* Wait 30s before quiting interlacing mode */
@@ -241,7 +250,7 @@ void vout_SetInterlacingState(vout_thread_t *vout, vout_interlacing_support_t *s
         (interlacing_change == -1 && state->date + 30000000 < mdate())) {
         msg_Dbg(vout, "Detected %s video",
                  is_interlaced ? "interlaced" : "progressive");
-        var_SetBool(vout, "deinterlace-needed", is_interlaced);
+        var_HandleSetBool(vout, vout->p->deinterlace.needed, is_interlaced);
 
         state->is_interlaced = is_interlaced;
     }
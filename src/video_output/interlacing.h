@@ -30,6 +30,7 @@ typedef struct {
 } vout_interlacing_support_t;
 
 void vout_InitInterlacingSupport(vout_thread_t *, bool is_interlaced);
+void vout_CleanInterlacingSupport(vout_thread_t *);
 void vout_SetInterlacingState(vout_thread_t *, vout_interlacing_support_t *, bool is_interlaced);
 
 #endif
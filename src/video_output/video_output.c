@@ -57,6 +57,7 @@
  * Local prototypes
  *****************************************************************************/
 static void *Thread(void *);
+static void *ThreadPipeline(void *);
 static void VoutDestructor(vlc_object_t *);
 
 /* Maximum delay between 2 displayed pictures.
@@ -288,6 +289,8 @@ static void VoutDestructor(vlc_object_t *object)
 
     free(vout->p->splitter_name);
 
+    vout_CleanInterlacingSupport(vout);
+
     /* Destroy the locks */
     vlc_mutex_destroy(&vout->p->spu_lock);
     vlc_mutex_destroy(&vout->p->filter.lock);
@@ -641,8 +644,12 @@ static picture_t *VoutVideoFilterStaticNewPicture(filter_t *filter)
     return picture_NewFromFormat(&filter->fmt_out.video);
 }
 
+static void ThreadPipelineDiscard(vout_thread_t *);
+
 static void ThreadFilterFlush(vout_thread_t *vout, bool is_locked)
 {
+    ThreadPipelineDiscard(vout);
+
     if (vout->p->displayed.current)
         picture_Release( vout->p->displayed.current );
     vout->p->displayed.current = NULL;
@@ -817,127 +824,275 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
     return VLC_SUCCESS;
 }
 
-static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
+static void ThreadRenderSetup(vout_thread_t *vout, vout_render_cfg_t *cfg,
+                              bool do_snapshot)
 {
     vout_thread_sys_t *sys = vout->p;
     vout_display_t *vd = vout->p->display.vd;
 
-    picture_t *torender = picture_Hold(vout->p->displayed.current);
-
-    vout_chrono_Start(&vout->p->render);
-
-    vlc_mutex_lock(&vout->p->filter.lock);
-    picture_t *filtered = filter_chain_VideoFilter(vout->p->filter.chain_interactive, torender);
-    vlc_mutex_unlock(&vout->p->filter.lock);
-
-    if (!filtered)
-        return VLC_EGENERIC;
-
-    if (filtered->date != vout->p->displayed.current->date)
-        msg_Warn(vout, "Unsupported timestamp modifications done by chain_interactive");
+    cfg->do_snapshot = do_snapshot;
 
     /*
      * Get the subpicture to be displayed
      */
-    const bool do_snapshot = vout_snapshot_IsRequested(&vout->p->snapshot);
-    mtime_t render_subtitle_date;
-    if (vout->p->pause.is_on)
-        render_subtitle_date = vout->p->pause.date;
-    else
-        render_subtitle_date = filtered->date > 1 ? filtered->date : mdate();
-    mtime_t render_osd_date = mdate(); /* FIXME wrong */
-
-    /*
-     * Get the subpicture to be displayed
-     */
-    const bool do_dr_spu = !do_snapshot &&
-                           vd->info.subpicture_chromas &&
-                           *vd->info.subpicture_chromas != 0;
+    cfg->do_dr_spu = !do_snapshot &&
+                     vd->info.subpicture_chromas &&
+                     *vd->info.subpicture_chromas != 0;
 
     //FIXME: Denying do_early_spu if vd->source.orientation != ORIENT_NORMAL
     //will have the effect that snapshots miss the subpictures. We do this
     //because there is currently no way to transform subpictures to match
     //the source format.
-    const bool do_early_spu = !do_dr_spu &&
-                               vd->source.orientation == ORIENT_NORMAL &&
-                              (vd->info.is_slow ||
-                               sys->display.use_dr ||
-                               do_snapshot ||
-                               !vout_IsDisplayFiltered(vd) ||
-                               vd->fmt.i_width * vd->fmt.i_height <= vd->source.i_width * vd->source.i_height);
-
-    const vlc_fourcc_t *subpicture_chromas;
-    video_format_t fmt_spu;
-    if (do_dr_spu) {
+    cfg->do_early_spu = !cfg->do_dr_spu &&
+                         vd->source.orientation == ORIENT_NORMAL &&
+                        (vd->info.is_slow ||
+                         sys->display.use_dr ||
+                         do_snapshot ||
+                         !vout_IsDisplayFiltered(vd) ||
+                         vd->fmt.i_width * vd->fmt.i_height <= vd->source.i_width * vd->source.i_height);
+
+    video_format_t *fmt_spu = &cfg->fmt_spu;
+    if (cfg->do_dr_spu) {
         vout_display_place_t place;
         vout_display_PlacePicture(&place, &vd->source, vd->cfg, false);
 
-        fmt_spu = vd->source;
-        if (fmt_spu.i_width * fmt_spu.i_height < place.width * place.height) {
-            fmt_spu.i_sar_num = vd->cfg->display.sar.num;
-            fmt_spu.i_sar_den = vd->cfg->display.sar.den;
-            fmt_spu.i_width          =
-            fmt_spu.i_visible_width  = place.width;
-            fmt_spu.i_height         =
-            fmt_spu.i_visible_height = place.height;
+        *fmt_spu = vd->source;
+        if (fmt_spu->i_width * fmt_spu->i_height < place.width * place.height) {
+            fmt_spu->i_sar_num = vd->cfg->display.sar.num;
+            fmt_spu->i_sar_den = vd->cfg->display.sar.den;
+            fmt_spu->i_width          =
+            fmt_spu->i_visible_width  = place.width;
+            fmt_spu->i_height         =
+            fmt_spu->i_visible_height = place.height;
         }
-        subpicture_chromas = vd->info.subpicture_chromas;
+        cfg->subpicture_chromas = vd->info.subpicture_chromas;
     } else {
-        if (do_early_spu) {
-            fmt_spu = vd->source;
+        if (cfg->do_early_spu) {
+            *fmt_spu = vd->source;
         } else {
-            fmt_spu = vd->fmt;
-            fmt_spu.i_sar_num = vd->cfg->display.sar.num;
-            fmt_spu.i_sar_den = vd->cfg->display.sar.den;
+            *fmt_spu = vd->fmt;
+            fmt_spu->i_sar_num = vd->cfg->display.sar.num;
+            fmt_spu->i_sar_den = vd->cfg->display.sar.den;
         }
-        subpicture_chromas = NULL;
+        cfg->subpicture_chromas = NULL;
 
         if (vout->p->spu_blend &&
-            vout->p->spu_blend->fmt_out.video.i_chroma != fmt_spu.i_chroma) {
+            vout->p->spu_blend->fmt_out.video.i_chroma != fmt_spu->i_chroma) {
             filter_DeleteBlend(vout->p->spu_blend);
             vout->p->spu_blend = NULL;
             vout->p->spu_blend_chroma = 0;
         }
-        if (!vout->p->spu_blend && vout->p->spu_blend_chroma != fmt_spu.i_chroma) {
-            vout->p->spu_blend_chroma = fmt_spu.i_chroma;
-            vout->p->spu_blend = filter_NewBlend(VLC_OBJECT(vout), &fmt_spu);
+        if (!vout->p->spu_blend && vout->p->spu_blend_chroma != fmt_spu->i_chroma) {
+            vout->p->spu_blend_chroma = fmt_spu->i_chroma;
+            vout->p->spu_blend = filter_NewBlend(VLC_OBJECT(vout), fmt_spu);
             if (!vout->p->spu_blend)
                 msg_Err(vout, "Failed to create blending filter, OSD/Subtitles will not work");
         }
     }
+}
+
+/* Runs the interactive filters on a picture and renders its subpictures,
+ * blending them already if the configuration asks for it. It does not touch
+ * the display, so it can run on the pipeline thread. */
+static int ThreadRenderCompose(vout_thread_t *vout,
+                               const vout_render_cfg_t *cfg,
+                               picture_t *source,
+                               picture_t **todisplay, subpicture_t **subpic)
+{
+    vout_display_t *vd = vout->p->display.vd;
+
+    vout_chrono_Start(&vout->p->render_filter);
+
+    vlc_mutex_lock(&vout->p->filter.lock);
+    picture_t *filtered = filter_chain_VideoFilter(vout->p->filter.chain_interactive,
+                                                   picture_Hold(source));
+    vlc_mutex_unlock(&vout->p->filter.lock);
+
+    vout_chrono_Stop(&vout->p->render_filter);
+
+    if (!filtered)
+        return VLC_EGENERIC;
+
+    if (filtered->date != source->date)
+        msg_Warn(vout, "Unsupported timestamp modifications done by chain_interactive");
+
+    vout_chrono_Start(&vout->p->render_spu);
+
+    mtime_t render_subtitle_date;
+    if (vout->p->pause.is_on)
+        render_subtitle_date = vout->p->pause.date;
+    else
+        render_subtitle_date = filtered->date > 1 ? filtered->date : mdate();
+    mtime_t render_osd_date = mdate(); /* FIXME wrong */
 
     video_format_t fmt_spu_rot;
-    video_format_ApplyRotation(&fmt_spu_rot, &fmt_spu);
-    subpicture_t *subpic = spu_Render(vout->p->spu,
-                                      subpicture_chromas, &fmt_spu_rot,
-                                      &vd->source,
-                                      render_subtitle_date, render_osd_date,
-                                      do_snapshot);
-    /*
-     * Perform rendering
-     *
-     * We have to:
-     * - be sure to end up with a direct buffer.
-     * - blend subtitles, and in a fast access buffer
-     */
-    bool is_direct = vout->p->decoder_pool == vout->p->display_pool;
-    picture_t *todisplay = filtered;
-    if (do_early_spu && subpic) {
+    video_format_ApplyRotation(&fmt_spu_rot, &cfg->fmt_spu);
+    subpicture_t *subpicture = spu_Render(vout->p->spu,
+                                          cfg->subpicture_chromas, &fmt_spu_rot,
+                                          &vd->source,
+                                          render_subtitle_date, render_osd_date,
+                                          cfg->do_snapshot);
+
+    /* Blend subtitles early, in a fast access buffer */
+    picture_t *picture = filtered;
+    if (cfg->do_early_spu && subpicture) {
         if (vout->p->spu_blend) {
             picture_t *blent = picture_pool_Get(vout->p->private_pool);
             if (blent) {
                 VideoFormatCopyCropAr(&blent->format, &filtered->format);
                 picture_Copy(blent, filtered);
-                if (picture_BlendSubpicture(blent, vout->p->spu_blend, subpic)) {
-                    picture_Release(todisplay);
-                    todisplay = blent;
+                if (picture_BlendSubpicture(blent, vout->p->spu_blend, subpicture)) {
+                    picture_Release(picture);
+                    picture = blent;
                 } else
                     picture_Release(blent);
             }
         }
-        subpicture_Delete(subpic);
-        subpic = NULL;
+        subpicture_Delete(subpicture);
+        subpicture = NULL;
+    }
+
+    vout_chrono_Stop(&vout->p->render_spu);
+
+    *todisplay = picture;
+    *subpic    = subpicture;
+    return VLC_SUCCESS;
+}
+
+static void *ThreadPipeline(void *object)
+{
+    vout_thread_t *vout = object;
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    for (;;) {
+        while (!sys->pipeline.pending && !sys->pipeline.exit)
+            vlc_cond_wait(&sys->pipeline.wait_request, &sys->pipeline.lock);
+        if (!sys->pipeline.pending)
+            break;
+        vlc_mutex_unlock(&sys->pipeline.lock);
+
+        if (ThreadRenderCompose(vout, &sys->pipeline.cfg, sys->pipeline.source,
+                                &sys->pipeline.picture, &sys->pipeline.subpic)) {
+            sys->pipeline.picture = NULL;
+            sys->pipeline.subpic  = NULL;
+        }
+
+        vlc_mutex_lock(&sys->pipeline.lock);
+        sys->pipeline.pending = false;
+        vlc_cond_signal(&sys->pipeline.wait_done);
     }
+    vlc_mutex_unlock(&sys->pipeline.lock);
+    return NULL;
+}
+
+/* The pipeline state is only touched by the vout thread while no request is
+ * pending, that is outside of ThreadDisplayRenderPicture(). */
+static void ThreadPipelineDiscard(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (sys->pipeline.picture)
+        picture_Release(sys->pipeline.picture);
+    if (sys->pipeline.subpic)
+        subpicture_Delete(sys->pipeline.subpic);
+    if (sys->pipeline.source)
+        picture_Release(sys->pipeline.source);
+    sys->pipeline.picture = NULL;
+    sys->pipeline.subpic  = NULL;
+    sys->pipeline.source  = NULL;
+}
+
+static void ThreadPipelineStart(vout_thread_t *vout, picture_t *source)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (sys->pipeline.source == source)
+        return; /* Already done */
+    ThreadPipelineDiscard(vout);
+
+    ThreadRenderSetup(vout, &sys->pipeline.cfg, false);
+    sys->pipeline.source = picture_Hold(source);
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    sys->pipeline.pending = true;
+    vlc_cond_signal(&sys->pipeline.wait_request);
+    vlc_mutex_unlock(&sys->pipeline.lock);
+}
+
+static void ThreadPipelineWait(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->pipeline.lock);
+    while (sys->pipeline.pending)
+        vlc_cond_wait(&sys->pipeline.wait_done, &sys->pipeline.lock);
+    vlc_mutex_unlock(&sys->pipeline.lock);
+}
+
+/* Takes the result of the pipeline if it was computed for the current
+ * picture with the same configuration. */
+static bool ThreadPipelineTake(vout_thread_t *vout, const vout_render_cfg_t *cfg,
+                               picture_t **todisplay, subpicture_t **subpic)
+{
+    vout_thread_sys_t *sys = vout->p;
+    const vout_render_cfg_t *done = &sys->pipeline.cfg;
+
+    if (sys->pipeline.source == NULL)
+        return false;
+    if (sys->pipeline.source != sys->displayed.current) {
+        if (sys->pipeline.source != sys->displayed.next)
+            ThreadPipelineDiscard(vout);
+        return false;
+    }
+
+    bool usable = sys->pipeline.picture != NULL &&
+                  done->do_snapshot  == cfg->do_snapshot &&
+                  done->do_dr_spu    == cfg->do_dr_spu &&
+                  done->do_early_spu == cfg->do_early_spu &&
+                  done->subpicture_chromas == cfg->subpicture_chromas &&
+                  video_format_IsSimilar(&done->fmt_spu, &cfg->fmt_spu);
+    if (usable) {
+        *todisplay = sys->pipeline.picture;
+        *subpic    = sys->pipeline.subpic;
+        sys->pipeline.picture = NULL;
+        sys->pipeline.subpic  = NULL;
+    }
+    ThreadPipelineDiscard(vout);
+    return usable;
+}
+
+static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
+{
+    vout_thread_sys_t *sys = vout->p;
+    vout_display_t *vd = vout->p->display.vd;
+
+    vout_chrono_Start(&vout->p->render);
+
+    vout_render_cfg_t cfg;
+    ThreadRenderSetup(vout, &cfg, vout_snapshot_IsRequested(&vout->p->snapshot));
+
+    picture_t *todisplay;
+    subpicture_t *subpic;
+    if (!sys->pipeline.enabled ||
+        !ThreadPipelineTake(vout, &cfg, &todisplay, &subpic)) {
+        if (ThreadRenderCompose(vout, &cfg, vout->p->displayed.current,
+                                &todisplay, &subpic)) {
+            vout_chrono_Stop(&vout->p->render);
+            return VLC_EGENERIC;
+        }
+    }
+
+    /*
+     * Perform rendering
+     *
+     * We have to:
+     * - be sure to end up with a direct buffer.
+     * - blend subtitles, and in a fast access buffer
+     */
+    vout_chrono_Start(&vout->p->render_prepare);
+
+    bool is_direct = vout->p->decoder_pool == vout->p->display_pool;
 
     assert(vout_IsDisplayFiltered(vd) == !sys->display.use_dr);
     if (sys->display.use_dr && !is_direct) {
@@ -948,6 +1103,8 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
             picture_Release(todisplay);
             if (subpic)
                 subpicture_Delete(subpic);
+            vout_chrono_Stop(&vout->p->render_prepare);
+            vout_chrono_Stop(&vout->p->render);
             return VLC_EGENERIC;
         }
 
@@ -964,7 +1121,7 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
     /*
      * Take a snapshot if requested
      */
-    if (do_snapshot)
+    if (cfg.do_snapshot)
         vout_snapshot_Set(&vout->p->snapshot, &vd->source, todisplay);
 
     /* Render the direct buffer */
@@ -977,20 +1134,23 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
         {
             if (subpic != NULL)
                 subpicture_Delete(subpic);
+            vout_chrono_Stop(&vout->p->render_prepare);
+            vout_chrono_Stop(&vout->p->render);
             return VLC_EGENERIC;
         }
 
-        if (!do_dr_spu && !do_early_spu && vout->p->spu_blend && subpic)
+        if (!cfg.do_dr_spu && !cfg.do_early_spu && vout->p->spu_blend && subpic)
             picture_BlendSubpicture(todisplay, vout->p->spu_blend, subpic);
-        vout_display_Prepare(vd, todisplay, do_dr_spu ? subpic : NULL);
+        vout_display_Prepare(vd, todisplay, cfg.do_dr_spu ? subpic : NULL);
 
-        if (!do_dr_spu && subpic)
+        if (!cfg.do_dr_spu && subpic)
         {
             subpicture_Delete(subpic);
             subpic = NULL;
         }
     }
 
+    vout_chrono_Stop(&vout->p->render_prepare);
     vout_chrono_Stop(&vout->p->render);
 #if 0
         {
@@ -1001,6 +1161,10 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
         }
 #endif
 
+    /* Prepare the next picture while this one waits for its date */
+    if (sys->pipeline.enabled && vout->p->displayed.next != NULL)
+        ThreadPipelineStart(vout, vout->p->displayed.next);
+
     /* Wait the real date (for rendering jitter) */
 #if 0
     mtime_t delay = direct->date - mdate();
@@ -1016,6 +1180,9 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
 
     vout_statistic_AddDisplayed(&vout->p->statistic, 1);
 
+    if (sys->pipeline.enabled)
+        ThreadPipelineWait(vout);
+
     return VLC_SUCCESS;
 }
 
@@ -1365,6 +1532,8 @@ error:
 
 static void ThreadStop(vout_thread_t *vout, vout_display_state_t *state)
 {
+    ThreadPipelineDiscard(vout);
+
     if (vout->p->spu_blend)
         filter_DeleteBlend(vout->p->spu_blend);
 
@@ -1396,10 +1565,47 @@ static void ThreadInit(vout_thread_t *vout)
     vout->p->pause.date      = VLC_TS_INVALID;
 
     vout_chrono_Init(&vout->p->render, 5, 10000); /* Arbitrary initial time */
+    vout_chrono_Init(&vout->p->render_filter, 5, 1000);
+    vout_chrono_Init(&vout->p->render_spu, 5, 1000);
+    vout_chrono_Init(&vout->p->render_prepare, 5, 1000);
+
+    vlc_mutex_init(&vout->p->pipeline.lock);
+    vlc_cond_init(&vout->p->pipeline.wait_request);
+    vlc_cond_init(&vout->p->pipeline.wait_done);
+    vout->p->pipeline.pending = false;
+    vout->p->pipeline.exit    = false;
+    vout->p->pipeline.source  = NULL;
+    vout->p->pipeline.picture = NULL;
+    vout->p->pipeline.subpic  = NULL;
+    vout->p->pipeline.enabled = var_InheritBool(vout, "video-pipeline");
+    if (vout->p->pipeline.enabled &&
+        vlc_clone(&vout->p->pipeline.thread, ThreadPipeline, vout,
+                  VLC_THREAD_PRIORITY_OUTPUT)) {
+        msg_Warn(vout, "cannot spawn the render pipeline thread");
+        vout->p->pipeline.enabled = false;
+    }
 }
 
 static void ThreadClean(vout_thread_t *vout)
 {
+    if (vout->p->pipeline.enabled) {
+        vlc_mutex_lock(&vout->p->pipeline.lock);
+        vout->p->pipeline.exit = true;
+        vlc_cond_signal(&vout->p->pipeline.wait_request);
+        vlc_mutex_unlock(&vout->p->pipeline.lock);
+        vlc_join(vout->p->pipeline.thread, NULL);
+    }
+    vlc_cond_destroy(&vout->p->pipeline.wait_done);
+    vlc_cond_destroy(&vout->p->pipeline.wait_request);
+    vlc_mutex_destroy(&vout->p->pipeline.lock);
+
+    msg_Dbg(vout, "render time: avg %"PRId64" us, filters %"PRId64" us, "
+            "subpictures %"PRId64" us, prepare %"PRId64" us",
+            vout->p->render.avg, vout->p->render_filter.avg,
+            vout->p->render_spu.avg, vout->p->render_prepare.avg);
+    vout_chrono_Clean(&vout->p->render_prepare);
+    vout_chrono_Clean(&vout->p->render_spu);
+    vout_chrono_Clean(&vout->p->render_filter);
     vout_chrono_Clean(&vout->p->render);
     vout->p->dead = true;
     vout_control_Dead(&vout->p->control);
@@ -43,6 +43,15 @@
  */
 #define VOUT_MAX_PICTURES (20)
 
+/* How the subpictures of a picture are rendered and blended */
+typedef struct {
+    bool               do_snapshot;
+    bool               do_dr_spu;    /* rendered by the display */
+    bool               do_early_spu; /* blended before display conversion */
+    const vlc_fourcc_t *subpicture_chromas;
+    video_format_t     fmt_spu;
+} vout_render_cfg_t;
+
 /* */
 struct vout_thread_sys_t
 {
@@ -112,6 +121,12 @@ struct vout_thread_sys_t
     /* */
     bool            is_late_dropped;
 
+    /* Deinterlacing variables */
+    struct {
+        vlc_var_handle_t *state;  /* "deinterlace" */
+        vlc_var_handle_t *needed; /* "deinterlace-needed" */
+    } deinterlace;
+
     /* Video filter2 chain */
     struct {
         vlc_mutex_t     lock;
@@ -130,6 +145,25 @@ struct vout_thread_sys_t
     picture_pool_t  *decoder_pool;
     picture_fifo_t  *decoder_fifo;
     vout_chrono_t   render;           /**< picture render time estimator */
+    vout_chrono_t   render_filter;    /**< interactive filters time */
+    vout_chrono_t   render_spu;       /**< subpicture render and blend time */
+    vout_chrono_t   render_prepare;   /**< conversion and prepare time */
+
+    /* Interactive filtering and subpicture blending of the next picture,
+     * done while the current one is waiting to be displayed */
+    struct {
+        bool              enabled;
+        vlc_thread_t      thread;
+        vlc_mutex_t       lock;
+        vlc_cond_t        wait_request;
+        vlc_cond_t        wait_done;
+        bool              pending;
+        bool              exit;
+        vout_render_cfg_t cfg;
+        picture_t         *source;
+        picture_t         *picture;
+        subpicture_t      *subpic;
+    } pipeline;
 };
 
 /* TODO to move them to vlc_vout.h */
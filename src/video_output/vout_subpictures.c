@@ -69,6 +69,8 @@ struct spu_private_t {
 
     int channel;             /**< number of subpicture channels registered */
     filter_t *text;                              /**< text renderer module */
+    vlc_var_handle_t *text_elapsed;           /**< "spu-elapsed" of text */
+    vlc_var_handle_t *text_rerender;        /**< "text-rerender" of text */
     filter_t *scale_yuvp;                     /**< scaling module for YUVP */
     filter_t *scale;                    /**< scaling module (all but YUVP) */
     bool force_crop;                     /**< force cropping of subpicture */
@@ -272,12 +274,12 @@ static void SpuRenderText(spu_t *spu, bool *rerender_text,
      * least show up on screen, but the effect won't change
      * the text over time.
      */
-    var_SetInteger(text, "spu-elapsed", elapsed_time);
-    var_SetBool(text, "text-rerender", false);
+    var_HandleSetInteger(text, spu->p->text_elapsed, elapsed_time);
+    var_HandleSetBool(text, spu->p->text_rerender, false);
 
     if ( region->p_text )
         text->pf_render(text, region, region, chroma_list);
-    *rerender_text = var_GetBool(text, "text-rerender");
+    *rerender_text = var_HandleGetBool(spu->p->text_rerender);
 }
 
 /**
@@ -1217,6 +1219,10 @@ spu_t *spu_Create(vlc_object_t *object)
 
     /* Load text and scale module */
     sys->text = SpuRenderCreateAndLoadText(spu);
+    if (sys->text) {
+        sys->text_elapsed  = var_Acquire(sys->text, "spu-elapsed");
+        sys->text_rerender = var_Acquire(sys->text, "text-rerender");
+    }
 
     /* XXX spu->p_scale is used for all conversion/scaling except yuvp to
      * yuva/rgba */
@@ -1243,8 +1249,11 @@ void spu_Destroy(spu_t *spu)
 {
     spu_private_t *sys = spu->p;
 
-    if (sys->text)
+    if (sys->text) {
+        var_Release(sys->text, sys->text_elapsed);
+        var_Release(sys->text, sys->text_rerender);
         FilterRelease(sys->text);
+    }
 
     if (sys->scale_yuvp)
         FilterRelease(sys->scale_yuvp);
@@ -0,0 +1,150 @@
+/*****************************************************************************
+ * loudness.c: tests the EBU R 128 loudness measurement
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#undef log /* used by the measurement */
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include <vlc_aout.h>
+#include <vlc_cpu.h>
+#include "../modules/audio_filter/loudness.h"
+
+#define MAX_FRAMES (48000 * 80)
+
+static float samples[MAX_FRAMES * 6];
+static loudness_t loudness;
+
+/* Implementation under test: the C one, or the AVX2 one */
+static loudness_peak_t impl(bool b_avx2)
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    if (b_avx2)
+        return loudness_Peak_AVX2;
+#endif
+    VLC_UNUSED(b_avx2);
+    return loudness_Peak_C;
+}
+
+/* Appends a sine of the given level on all channels */
+static unsigned sine(unsigned offset, unsigned frames, unsigned channels,
+                     unsigned rate, double freq, double dbfs, double phase)
+{
+    const double amplitude = pow(10., dbfs / 20.);
+
+    for (unsigned i = 0; i < frames; i++)
+        for (unsigned c = 0; c < channels; c++)
+            samples[(offset + i) * channels + c] =
+                amplitude * sin(2. * M_PI * freq * i / rate + phase);
+    return offset + frames;
+}
+
+/* Feeds the samples in irregular blocks, as an audio output would */
+static void measure(unsigned frames, unsigned channels, unsigned rate,
+                    uint32_t physical, loudness_peak_t pf)
+{
+    loudness_Init(&loudness, rate, channels, physical, pf);
+    for (unsigned i = 0, n = 0; i < frames; i += n) {
+        n = 300 + (i / 7) % 2000;
+        if (n > frames - i)
+            n = frames - i;
+        loudness_Process(&loudness, &samples[i * channels], n);
+    }
+}
+
+static void assert_near(float value, double expected, double tolerance)
+{
+    if (fabs(value - expected) > tolerance) {
+        fprintf(stderr, "%f instead of %f\n", value, expected);
+        abort();
+    }
+}
+
+int main(void)
+{
+    test_init();
+
+    bool b_avx2 = false;
+#ifdef HAVE_AVX2_INTRINSICS
+    b_avx2 = vlc_CPU_AVX2();
+#endif
+
+    /* EBU Tech 3341, test 1: stereo 1 kHz sine at -23 dBFS */
+    static const unsigned rates[] = { 44100, 48000 };
+    for (size_t i = 0; i < ARRAY_SIZE(rates); i++) {
+        unsigned frames = sine(0, 20 * rates[i], 2, rates[i], 1000., -23., 0.);
+
+        measure(frames, 2, rates[i], AOUT_CHANS_STEREO, loudness_Peak_C);
+        assert_near(loudness.momentary, -23., .1);
+        assert_near(loudness.short_term, -23., .1);
+        assert_near(loudness.integrated, -23., .1);
+    }
+
+    /* EBU Tech 3341, test 3: the quiet parts are below the relative gate */
+    unsigned frames = sine(0, 10 * 48000, 2, 48000, 1000., -36., 0.);
+    frames = sine(frames, 60 * 48000, 2, 48000, 1000., -23., 0.);
+    frames = sine(frames, 10 * 48000, 2, 48000, 1000., -36., 0.);
+    measure(frames, 2, 48000, AOUT_CHANS_STEREO, loudness_Peak_C);
+    assert_near(loudness.integrated, -23., .1);
+    assert_near(loudness.momentary, -36., .1);
+
+    /* Surround channels weigh 1.5 dB more, the LFE does not count (the
+     * power of a sine is half its squared amplitude): it gets a much
+     * louder tone that would dominate the result otherwise */
+    frames = sine(0, 10 * 48000, 6, 48000, 1000., -30., 0.);
+    for (unsigned i = 0; i < frames; i++) /* LFE, last in WG4 order */
+        samples[i * 6 + 5] = pow(10., -10. / 20.)
+                             * sin(2. * M_PI * 1000. * i / 48000);
+    measure(frames, 6, 48000, AOUT_CHANS_5_1, loudness_Peak_C);
+    assert_near(loudness.integrated,
+                -30. + 10. * log10((3. + 2. * 1.41) / 2.), .1);
+
+    /* True peak: a quarter of the sample rate, with samples at 45 degrees
+     * from the peaks, is 3 dB above its sample peak */
+    for (int avx2 = 0; avx2 <= b_avx2; avx2++) {
+        frames = sine(0, 48000, 2, 48000, 12000., -6., M_PI / 4.);
+        measure(frames, 2, 48000, AOUT_CHANS_STEREO, impl(avx2));
+        assert_near(loudness.true_peak, -6., .2);
+    }
+
+    /* The implementations agree on noise */
+    srand(42);
+    for (unsigned i = 0; i < 48000 * 2; i++)
+        samples[i] = (rand() - RAND_MAX / 2) / (float)RAND_MAX;
+    measure(48000, 2, 48000, AOUT_CHANS_STEREO, loudness_Peak_C);
+    const float peak = loudness.peak;
+    if (b_avx2) {
+        measure(48000, 2, 48000, AOUT_CHANS_STEREO, impl(true));
+        assert_near(loudness.peak, peak, 1e-6);
+    }
+
+    /* 20 seconds of 5.1 noise */
+    for (unsigned i = 0; i < 20 * 48000 * 6; i++)
+        samples[i] = (rand() - RAND_MAX / 2) / (float)RAND_MAX;
+    for (int avx2 = 0; avx2 <= b_avx2; avx2++) {
+        mtime_t i_start = mdate();
+        measure(20 * 48000, 6, 48000, AOUT_CHANS_5_1, impl(avx2));
+        printf("%-5s 5.1 48 kHz: %6"PRId64" us per second of audio\n",
+               avx2 ? "AVX2" : "C", (mdate() - i_start) / 20);
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+/*****************************************************************************
+ * polyphase.c: tests the polyphase resampler quality and speed
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#undef log /* used by the filter design */
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include "../modules/audio_filter/resampler/polyphase.h"
+
+#define CHANNELS   2
+#define MAX_FRAMES (96000 * 4)
+/* Output frames ignored at both ends, where the window is incomplete */
+#define MARGIN     (POLYPHASE_MAX_TAPS)
+
+static float in[MAX_FRAMES * CHANNELS];
+static float out[2 * MAX_FRAMES * CHANNELS];
+static polyphase_t resampler;
+
+/* Implementation under test: the C one, or the AVX2 one */
+static polyphase_frame_t impl(bool b_avx2)
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    if (b_avx2)
+        return polyphase_Frame_AVX2;
+#endif
+    VLC_UNUSED(b_avx2);
+    return polyphase_Frame_C;
+}
+
+static void sine(unsigned frames, unsigned rate, double freq)
+{
+    for (unsigned i = 0; i < frames; i++)
+        for (unsigned c = 0; c < CHANNELS; c++)
+            in[i * CHANNELS + c] = .9 * sin(2. * M_PI * freq * i / rate + c);
+}
+
+/* Resamples in irregular blocks, the input rate alternating between
+ * in_rate and in_rate + drift */
+static unsigned resample(unsigned frames, unsigned in_rate, unsigned out_rate,
+                         int drift, polyphase_frame_t pf)
+{
+    unsigned count = 0;
+
+    assert(!polyphase_Init(&resampler, CHANNELS, in_rate, out_rate, pf));
+    /* The first output is the first input frame */
+    assert(polyphase_Delay(&resampler) == 0.);
+    for (unsigned i = 0, n = 0, b = 0; i < frames; i += n, b++) {
+        const unsigned rate = in_rate + ((b & 1) ? drift : 0);
+
+        n = 200 + (i / 3) % 1500;
+        if (n > frames - i)
+            n = frames - i;
+        unsigned max = polyphase_MaxOutput(&resampler, rate, n);
+        assert(count + max <= ARRAY_SIZE(out) / CHANNELS);
+        count += polyphase_Process(&resampler, rate, &in[i * CHANNELS], n,
+                                   &out[count * CHANNELS], max);
+    }
+    polyphase_Clean(&resampler);
+    return count;
+}
+
+/* Total harmonic distortion and noise of a resampled sine, in dB, from the
+ * difference with the ideal output */
+static double thdn(unsigned frames, unsigned in_rate, unsigned out_rate,
+                   double freq, polyphase_frame_t pf)
+{
+    sine(frames, in_rate, freq);
+    unsigned count = resample(frames, in_rate, out_rate, 0, pf);
+    /* Only the outputs lacking following input frames are missing */
+    assert(count + resampler.taps >= (uint64_t)frames * out_rate / in_rate);
+
+    double signal = 0., noise = 0.;
+    for (unsigned i = MARGIN; i < count - MARGIN; i++)
+        for (unsigned c = 0; c < CHANNELS; c++) {
+            double ref = .9 * sin(2. * M_PI * freq * i / out_rate + c);
+            double err = out[i * CHANNELS + c] - ref;
+
+            signal += ref * ref;
+            noise += err * err;
+        }
+    return 10. * log10(noise / signal);
+}
+
+/* Level of the output, in dB relative to the input, for a tone which should
+ * be filtered out */
+static double rejection(unsigned frames, unsigned in_rate, unsigned out_rate,
+                        double freq)
+{
+    sine(frames, in_rate, freq);
+    unsigned count = resample(frames, in_rate, out_rate, 0, polyphase_Frame_C);
+
+    double power = 0.;
+    for (unsigned i = MARGIN; i < count - MARGIN; i++)
+        power += out[i * CHANNELS] * out[i * CHANNELS];
+    power /= count - 2 * MARGIN;
+    return 10. * log10(power / (.9 * .9 / 2.));
+}
+
+static void check(double value, double max, const char *what)
+{
+    printf("%-32s %7.1f dB\n", what, value);
+    if (!(value <= max)) {
+        fprintf(stderr, "%s: %.1f dB above %.1f dB\n", what, value, max);
+        abort();
+    }
+}
+
+int main(void)
+{
+    test_init();
+
+    bool b_avx2 = false;
+#ifdef HAVE_AVX2_INTRINSICS
+    b_avx2 = vlc_CPU_AVX2();
+#endif
+
+    for (int avx2 = 0; avx2 <= b_avx2; avx2++) {
+        printf("%s:\n", avx2 ? "AVX2" : "C");
+        check(thdn(44100, 44100, 48000, 1000., impl(avx2)), -90.,
+              "THD+N 1 kHz 44.1 to 48 kHz");
+        check(thdn(48000, 48000, 44100, 1000., impl(avx2)), -90.,
+              "THD+N 1 kHz 48 to 44.1 kHz");
+        check(thdn(48000, 48000, 44100, 15000., impl(avx2)), -80.,
+              "THD+N 15 kHz 48 to 44.1 kHz");
+        check(thdn(96000, 96000, 44100, 1000., impl(avx2)), -90.,
+              "THD+N 1 kHz 96 to 44.1 kHz");
+    }
+
+    /* Images and aliases are attenuated */
+    check(rejection(48000, 48000, 44100, 23000.), -80.,
+          "23 kHz 48 to 44.1 kHz");
+    check(rejection(96000, 96000, 48000, 30000.), -80.,
+          "30 kHz 96 to 48 kHz");
+
+    /* Same rates: the samples are passed through */
+    sine(10000, 48000, 1000.);
+    assert(resample(10000, 48000, 48000, 0, polyphase_Frame_C)
+           == 10000 - POLYPHASE_TAPS / 2);
+    for (unsigned i = 0; i < 10000 - POLYPHASE_TAPS; i++)
+        assert(out[i] == in[i]);
+
+    /* Drift compensation: the rate changes on every other block, without
+     * any discontinuity */
+    sine(48000 * 4, 48000, 1000.);
+    unsigned count = resample(48000 * 4, 48000, 48000, 48, polyphase_Frame_C);
+    assert(abs((int)count - (48000 * 4 - 48000 * 4 / 2000)) < 4 * 48);
+    float max_diff = 0.f;
+    for (unsigned i = MARGIN; i < count - MARGIN; i++) {
+        float diff = fabsf(out[i * CHANNELS] - out[(i - 1) * CHANNELS]);
+        if (diff > max_diff)
+            max_diff = diff;
+    }
+    /* Largest difference between two samples of the sine */
+    assert(max_diff < .9 * 2. * M_PI * 1000. / 48000. * 1.01);
+
+    /* The implementations agree */
+    srand(42);
+    for (unsigned i = 0; i < 48000 * CHANNELS; i++)
+        in[i] = (rand() - RAND_MAX / 2) / (float)RAND_MAX;
+    static float ref[2 * MAX_FRAMES * CHANNELS];
+    count = resample(48000, 48000, 44100, 10, polyphase_Frame_C);
+    memcpy(ref, out, count * CHANNELS * sizeof (*out));
+    if (b_avx2) {
+        assert(resample(48000, 48000, 44100, 10, impl(true)) == count);
+        for (unsigned j = 0; j < count * CHANNELS; j++)
+            assert(fabsf(out[j] - ref[j]) < 1e-5f);
+    }
+
+    /* Speed: stereo, 4 seconds of 44.1 kHz to 48 kHz with drift */
+    for (unsigned i = 0; i < 44100 * 4 * CHANNELS; i++)
+        in[i] = (rand() - RAND_MAX / 2) / (float)RAND_MAX;
+    for (int avx2 = 0; avx2 <= b_avx2; avx2++) {
+        mtime_t i_start = mdate();
+        resample(44100 * 4, 44100, 48000, 20, impl(avx2));
+        printf("%-5s stereo 44.1 to 48 kHz: %5"PRId64" us per second\n",
+               avx2 ? "AVX2" : "C", (mdate() - i_start) / 4);
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*****************************************************************************
+ * subtitle.c: subtitle demux index test
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vlc_common.h>
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+
+/* Large enough for the demux to index the file rather than to load it */
+#define COUNT 20000
+#define PERIOD (2 * CLOCK_FREQ)
+/* These two are written in reverse order */
+#define SWAPPED 100
+
+static mtime_t start_of(unsigned i)
+{
+    return i * PERIOD;
+}
+
+static void write_entry(FILE *file, unsigned i)
+{
+    mtime_t start = start_of(i) / 1000, stop = start + 1000;
+
+    fprintf(file, "%u\n%02u:%02u:%02u,%03u --> %02u:%02u:%02u,%03u\n"
+            "Subtitle %u, padded to make the file larger than the index "
+            "threshold\n\n", i + 1,
+            (unsigned)(start / 3600000), (unsigned)(start / 60000 % 60),
+            (unsigned)(start / 1000 % 60), (unsigned)(start % 1000),
+            (unsigned)(stop / 3600000), (unsigned)(stop / 60000 % 60),
+            (unsigned)(stop / 1000 % 60), (unsigned)(stop % 1000), i);
+}
+
+/* Last subtitle sent by the demux */
+static unsigned sent;
+static mtime_t sent_pts;
+static int dummy_id;
+
+static es_out_id_t *EsOutAdd(es_out_t *out, const es_format_t *fmt)
+{
+    (void) out;
+    assert(fmt->i_cat == SPU_ES);
+    return (es_out_id_t *)&dummy_id;
+}
+
+static int EsOutSend(es_out_t *out, es_out_id_t *id, block_t *block)
+{
+    (void) out;
+    assert(id == (es_out_id_t *)&dummy_id);
+    assert(sscanf((const char *)block->p_buffer, "Subtitle %u,", &sent) == 1);
+    sent_pts = block->i_pts;
+    block_Release(block);
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel(es_out_t *out, es_out_id_t *id)
+{
+    (void) out; (void) id;
+}
+
+static int EsOutControl(es_out_t *out, int query, va_list args)
+{
+    (void) out; (void) query; (void) args;
+    return VLC_EGENERIC;
+}
+
+/* Demuxes the first subtitle from the current position, expected to be i */
+static void expect(demux_t *demux, unsigned i)
+{
+    sent = UINT_MAX;
+    assert(demux_Control(demux, DEMUX_SET_NEXT_DEMUX_TIME,
+                         start_of(i) + 1) == VLC_SUCCESS);
+    assert(demux_Demux(demux) == 1);
+    assert(sent == i);
+    assert(sent_pts == VLC_TS_0 + start_of(i));
+}
+
+int main(void)
+{
+    const char *argv[] = {
+        "-v",
+        "--ignore-config",
+    };
+    char path[] = "/tmp/libvlc_XXXXXX";
+
+    test_init();
+
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    FILE *file = fdopen(fd, "w");
+    assert(file != NULL);
+    for (unsigned i = 0; i < COUNT; i++)
+        write_entry(file, (i == SWAPPED) ? (i + 1)
+                        : (i == SWAPPED + 1) ? (i - 1) : i);
+    assert(ftell(file) > (1 << 20));
+    assert(fclose(file) == 0);
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    char *url = vlc_path2uri(path, NULL);
+    assert(url != NULL);
+    stream_t *s = stream_UrlNew(obj, url);
+    assert(s != NULL);
+    free(url);
+
+    es_out_t out = {
+        .pf_add = EsOutAdd,
+        .pf_send = EsOutSend,
+        .pf_del = EsOutDel,
+        .pf_control = EsOutControl,
+    };
+    demux_t *demux = demux_New(obj, "subtitle", path, s, &out);
+    assert(demux != NULL);
+
+    int64_t length;
+    assert(demux_Control(demux, DEMUX_GET_LENGTH, &length) == VLC_SUCCESS);
+    assert(length == start_of(COUNT - 1) + CLOCK_FREQ);
+
+    /* Sequential reading, with the entries sorted by start date */
+    expect(demux, 0);
+    expect(demux, 1);
+    assert(demux_Control(demux, DEMUX_SET_TIME,
+                         start_of(SWAPPED)) == VLC_SUCCESS);
+    expect(demux, SWAPPED);
+    expect(demux, SWAPPED + 1);
+
+    /* Seeking within a subtitle, and between two subtitles */
+    log("seeking by time\n");
+    assert(demux_Control(demux, DEMUX_SET_TIME,
+                         start_of(12345) + CLOCK_FREQ / 2) == VLC_SUCCESS);
+    expect(demux, 12345);
+    assert(demux_Control(demux, DEMUX_SET_TIME,
+                         start_of(12345) + 3 * CLOCK_FREQ / 2) == VLC_SUCCESS);
+    expect(demux, 12346);
+
+    /* Seeking by position, to the first subtitle starting after it */
+    log("seeking by position\n");
+    assert(demux_Control(demux, DEMUX_SET_POSITION,
+                         (double)(start_of(7000) - 1) / length) == VLC_SUCCESS);
+    double pos;
+    int64_t start = start_of(7000);
+    assert(demux_Control(demux, DEMUX_GET_POSITION, &pos) == VLC_SUCCESS);
+    assert(pos == (double)start / length);
+    expect(demux, 7000);
+
+    /* Past the end */
+    assert(demux_Control(demux, DEMUX_SET_TIME,
+                         length + CLOCK_FREQ) != VLC_SUCCESS);
+
+    demux_Delete(demux);
+    libvlc_release(vlc);
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*****************************************************************************
+ * mp4spill.c: MP4 muxer sample table spill test
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include "../modules/mux/mp4/libmp4mux.h"
+#include "../modules/mux/mp4/spill.h"
+
+#define ENTRIES 100000
+#define BATCH   16383 /* as spilled by the muxer, all entries but one */
+
+static void entry(mp4mux_entry_t *e, unsigned i)
+{
+    static uint64_t pos;
+
+    if (i == 0)
+        pos = 0;
+
+    e->i_size = 2000 + (i * 7919) % 30000;
+    e->i_pos = pos;
+    /* B-frames reordering, with negative offsets */
+    e->i_pts_dts = ((int)(i % 3) - 1) * 40000;
+    e->i_length = 40000 + (i & 1);
+    e->i_flags = (i % 12) ? BLOCK_FLAG_TYPE_P : BLOCK_FLAG_TYPE_I;
+    pos += e->i_size;
+    /* a chunk of another track every now and then */
+    if (i % 25 == 24)
+        pos += 100000;
+}
+
+int main(void)
+{
+    static mp4mux_entry_t in[ENTRIES], out[ENTRIES];
+    mp4mux_spill_t spill;
+
+    test_init();
+
+    for (unsigned i = 0; i < ENTRIES; i++)
+        entry(&in[i], i);
+    /* extreme values must survive too */
+    in[ENTRIES - 1].i_pos = UINT64_C(1) << 40;
+    in[ENTRIES - 1].i_pts_dts = INT64_MIN / 2;
+
+    mp4mux_spill_Init(&spill);
+    assert(mp4mux_spill_Read(&spill, out) == 0); /* nothing spilled */
+
+    for (unsigned i = 0; i < ENTRIES; i += BATCH) {
+        unsigned count = __MIN(BATCH, ENTRIES - i);
+
+        assert(mp4mux_spill_Write(&spill, &in[i], count) == 0);
+        assert(spill.count == i + count);
+    }
+
+    /* The compact form is the whole point of the spill format */
+    off_t size = ftello(spill.file);
+    printf("%u entries spilled in %jd bytes\n", spill.count, (intmax_t)size);
+    assert(size < ENTRIES * 10);
+
+    memset(out, 0, sizeof (out));
+    assert(mp4mux_spill_Read(&spill, out) == 0);
+    for (unsigned i = 0; i < ENTRIES; i++) {
+        assert(out[i].i_pos == in[i].i_pos);
+        assert(out[i].i_size == in[i].i_size);
+        assert(out[i].i_pts_dts == in[i].i_pts_dts);
+        assert(out[i].i_length == in[i].i_length);
+        assert(out[i].i_flags == in[i].i_flags);
+    }
+
+    /* Entries can still be appended after a read */
+    assert(mp4mux_spill_Write(&spill, in, 1) == 0);
+    assert(ftello(spill.file) > size);
+
+    /* A truncated file fails to read */
+    spill.count++;
+    assert(mp4mux_spill_Read(&spill, out) != 0);
+
+    mp4mux_spill_Clean(&spill);
+    assert(spill.file == NULL && spill.count == 0);
+    return 0;
+}
@@ -138,11 +138,44 @@ static void test_annexb()
     runtest(6, "startcode repeat / empty nal");
 }
 
+/* more NALs than the converter initially tracks, mixed startcodes */
+static void test_annexb_many()
+{
+    uint8_t annexb[40 * 6], avc[3][40 * 6];
+    const uint8_t *p_res[3] = { avc[0], avc[1], avc[2] };
+    size_t i_annexb = 0, rgi_res[3] = { 0, 0, 0 };
+
+    printf("\nTEST many nals\n");
+    for( unsigned i=0; i<40; i++ )
+    {
+        const uint8_t i_payload = 1 + i % 2;
+        if( i % 3 )
+            annexb[i_annexb++] = 0;
+        annexb[i_annexb++] = 0;
+        annexb[i_annexb++] = 0;
+        annexb[i_annexb++] = 1;
+
+        for( unsigned j=0; j<3; j++ )
+        {
+            for( unsigned k=1; k<(1U << j); k++ )
+                avc[j][rgi_res[j]++] = 0;
+            avc[j][rgi_res[j]++] = i_payload;
+            for( unsigned k=0; k<i_payload; k++ )
+                avc[j][rgi_res[j]++] = 0x10 + i;
+        }
+        for( unsigned k=0; k<i_payload; k++ )
+            annexb[i_annexb++] = 0x10 + i;
+    }
+
+    testannexbin( annexb, i_annexb, p_res, rgi_res );
+}
+
 int main( void )
 {
     test_init();
 
     test_annexb();
+    test_annexb_many();
 
     return 0;
 }
@@ -0,0 +1,169 @@
+/*****************************************************************************
+ * startcode.c: tests startcode lookup helpers
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include "../modules/packetizer/startcode_helper.h"
+
+typedef const uint8_t * (*finder_t)( const uint8_t *, const uint8_t * );
+
+static const uint8_t * startcode_FindAnnexB_Ref( const uint8_t *p, const uint8_t *end )
+{
+    for( end -= 2; p < end; p++ )
+        if( p[0] == 0 && p[1] == 0 && p[2] == 1 )
+            return p;
+    return NULL;
+}
+
+static const struct
+{
+    const char *psz_name;
+    finder_t pf_find;
+} finders[] = {
+    { "C", startcode_FindAnnexB_C },
+#if defined(CAN_COMPILE_SSE2) || defined(HAVE_SSE2_INTRINSICS)
+    { "SSE2", startcode_FindAnnexB_SSE2 },
+#endif
+#ifdef HAVE_AVX2_INTRINSICS
+    { "AVX2", startcode_FindAnnexB_AVX2 },
+#endif
+#ifdef STARTCODE_NEON
+    { "NEON", startcode_FindAnnexB_NEON },
+#endif
+    { "dispatch", startcode_FindAnnexB },
+};
+
+static bool finder_usable( const char *psz_name )
+{
+#if defined(__i386__) || defined(__x86_64__)
+    if( !strcmp( psz_name, "SSE2" ) )
+        return vlc_CPU_SSE2();
+    if( !strcmp( psz_name, "AVX2" ) )
+        return vlc_CPU_AVX2();
+#endif
+    (void) psz_name;
+    return true;
+}
+
+/* Walks all startcodes of the buffer, from every misalignment, and checks
+ * every implementation finds the same ones as the byte-wise reference. */
+static void check_buffer( const uint8_t *p_buf, size_t i_buf )
+{
+    for( size_t i_start = 0; i_start < 64 && i_start < i_buf; i_start++ )
+    {
+        const uint8_t *end = &p_buf[i_buf];
+        for( size_t i = 0; i < ARRAY_SIZE(finders); i++ )
+        {
+            if( !finder_usable( finders[i].psz_name ) )
+                continue;
+
+            const uint8_t *p = &p_buf[i_start];
+            for( ;; )
+            {
+                const uint8_t *p_ref = startcode_FindAnnexB_Ref( p, end );
+                const uint8_t *p_res = finders[i].pf_find( p, end );
+                if( p_ref != p_res )
+                {
+                    fprintf( stderr, "%s mismatch from offset %zu: %td != %td\n",
+                             finders[i].psz_name, (size_t)(p - p_buf),
+                             p_res ? p_res - p_buf : -1,
+                             p_ref ? p_ref - p_buf : -1 );
+                    abort();
+                }
+                if( p_ref == NULL )
+                    break;
+                p = p_ref + 1;
+            }
+        }
+    }
+}
+
+static void bench( const uint8_t *p_buf, size_t i_buf )
+{
+    for( size_t i = 0; i < ARRAY_SIZE(finders); i++ )
+    {
+        if( !finder_usable( finders[i].psz_name ) )
+            continue;
+
+        unsigned i_found = 0;
+        mtime_t i_start = mdate();
+        for( unsigned j = 0; j < 64; j++ )
+        {
+            const uint8_t *p = p_buf;
+            while( (p = finders[i].pf_find( p, &p_buf[i_buf] )) )
+            {
+                p++;
+                i_found++;
+            }
+        }
+        printf( "%-8s %8"PRId64" us (%u startcodes)\n", finders[i].psz_name,
+                mdate() - i_start, i_found );
+    }
+}
+
+int main( void )
+{
+    test_init();
+
+    const size_t i_buf = 1 << 20;
+    uint8_t *p_buf = malloc( i_buf );
+    assert( p_buf );
+
+    /* Small set of edge cases: startcodes on boundaries, runs of zeros */
+    static const uint8_t edges[][8] = {
+        { 0, 0, 1, 0, 0, 0, 0, 0 },
+        { 0, 0, 0, 0, 0, 0, 0, 1 },
+        { 1, 0, 0, 0, 0, 0, 1, 0 },
+        { 0, 1, 0, 0, 1, 0, 0, 1 },
+    };
+    for( size_t i = 0; i < ARRAY_SIZE(edges); i++ )
+    {
+        for( size_t j = 0; j < i_buf; j++ )
+            p_buf[j] = edges[i][j % 8];
+        for( size_t j = 1; j < 200; j++ )
+            check_buffer( &p_buf[i_buf - j], j );
+        check_buffer( p_buf, 4096 );
+    }
+
+    /* Random data biased toward 0 and 1 to get many candidates */
+    srand( 42 );
+    for( size_t j = 0; j < i_buf; j++ )
+    {
+        int r = rand() & 7;
+        p_buf[j] = r < 3 ? 0 : r < 4 ? 1 : rand();
+    }
+    check_buffer( p_buf, 65536 );
+
+    /* ES-like payload: sparse startcodes among random data */
+    for( size_t j = 0; j < i_buf; j++ )
+        p_buf[j] = 0x80 | rand();
+    for( size_t j = 0; j + 4 < i_buf; j += 1500 + (rand() & 0x3FFF) )
+        memcpy( &p_buf[j], (const uint8_t[]) { 0, 0, 0, 1 }, 4 );
+    check_buffer( p_buf, 65536 );
+    bench( p_buf, i_buf );
+
+    free( p_buf );
+    return 0;
+}
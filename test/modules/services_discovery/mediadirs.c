@@ -0,0 +1,309 @@
+/*****************************************************************************
+ * mediadirs.c: media directories services discovery test
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <vlc_common.h>
+#include <vlc_events.h>
+#include <vlc_input_item.h>
+#include <vlc_services_discovery.h>
+
+#define MAX_ITEMS 8
+
+/* Items currently published by the services discovery */
+static struct
+{
+    input_item_t *item;
+    char *category;
+} items[MAX_ITEMS];
+static unsigned count;
+static vlc_mutex_t lock;
+static vlc_cond_t wait;
+
+static void item_added(const vlc_event_t *event, void *data)
+{
+    const char *category = event->u.services_discovery_item_added.psz_category;
+
+    (void) data;
+    vlc_mutex_lock(&lock);
+    assert(count < MAX_ITEMS);
+    items[count].item =
+        input_item_Hold(event->u.services_discovery_item_added.p_new_item);
+    items[count].category = category ? strdup(category) : NULL;
+    count++;
+    vlc_cond_signal(&wait);
+    vlc_mutex_unlock(&lock);
+}
+
+static void item_removed(const vlc_event_t *event, void *data)
+{
+    input_item_t *item = event->u.services_discovery_item_removed.p_item;
+    unsigned i = 0;
+
+    (void) data;
+    vlc_mutex_lock(&lock);
+    while (i < count && items[i].item != item)
+        i++;
+    assert(i < count);
+    input_item_Release(items[i].item);
+    free(items[i].category);
+    items[i] = items[--count];
+    vlc_cond_signal(&wait);
+    vlc_mutex_unlock(&lock);
+}
+
+/* Waits until the services discovery settles on that many items */
+static void wait_for(unsigned expected)
+{
+    mtime_t deadline = mdate() + 5 * CLOCK_FREQ;
+
+    vlc_mutex_lock(&lock);
+    while (count != expected)
+        assert(vlc_cond_timedwait(&wait, &lock, deadline) == 0);
+    vlc_mutex_unlock(&lock);
+}
+
+static bool has(const char *name, const char *category)
+{
+    bool found = false;
+
+    vlc_mutex_lock(&lock);
+    for (unsigned i = 0; i < count && !found; i++)
+    {
+        char *item_name = input_item_GetName(items[i].item);
+
+        found = !strcmp(item_name, name)
+             && (category ? items[i].category != NULL
+                            && !strcmp(items[i].category, category)
+                          : items[i].category == NULL);
+        free(item_name);
+    }
+    vlc_mutex_unlock(&lock);
+    return found;
+}
+
+static void clear(void)
+{
+    vlc_mutex_lock(&lock);
+    while (count > 0)
+    {
+        count--;
+        input_item_Release(items[count].item);
+        free(items[count].category);
+    }
+    vlc_mutex_unlock(&lock);
+}
+
+static services_discovery_t *start(vlc_object_t *obj)
+{
+    services_discovery_t *sd = vlc_sd_Create(obj, "video_dir");
+    assert(sd != NULL);
+
+    vlc_event_manager_t *em = services_discovery_EventManager(sd);
+    vlc_event_attach(em, vlc_ServicesDiscoveryItemAdded, item_added, NULL);
+    vlc_event_attach(em, vlc_ServicesDiscoveryItemRemoved, item_removed, NULL);
+    assert(vlc_sd_Start(sd));
+    return sd;
+}
+
+static void stop(services_discovery_t *sd)
+{
+    vlc_sd_StopAndDestroy(sd);
+    clear();
+}
+
+static void touch(const char *root, const char *name)
+{
+    char *path;
+
+    assert(asprintf(&path, "%s/videos/%s", root, name) != -1);
+    FILE *file = fopen(path, "w");
+    assert(file != NULL);
+    fclose(file);
+    free(path);
+}
+
+static void make_dir(const char *root, const char *name)
+{
+    char *path;
+
+    assert(asprintf(&path, "%s/%s", root, name) != -1);
+    assert(mkdir(path, 0700) == 0);
+    free(path);
+}
+
+static void remove_file(const char *root, const char *name)
+{
+    char *path;
+
+    assert(asprintf(&path, "%s/%s", root, name) != -1);
+    assert(unlink(path) == 0);
+    free(path);
+}
+
+static void remove_dir(const char *root, const char *name)
+{
+    char *path;
+
+    assert(asprintf(&path, "%s/%s", root, name) != -1);
+    assert(rmdir(path) == 0);
+    free(path);
+}
+
+/* Adds a file the scanner can only know from the snapshot, to the
+ * snapshot entry of a directory */
+static void forge_snapshot(const char *snapshot, const char *dir,
+                           const char *name)
+{
+    char *tmp, *line = NULL;
+    size_t size = 0;
+    size_t dirlen = strlen(dir);
+    bool found = false;
+
+    assert(asprintf(&tmp, "%s.test", snapshot) != -1);
+    FILE *in = fopen(snapshot, "r"), *out = fopen(tmp, "w");
+    assert(in != NULL && out != NULL);
+    while (getline(&line, &size, in) != -1)
+    {
+        size_t len = strlen(line);
+
+        fputs(line, out);
+        if (line[0] == 'd' && len > dirlen
+         && !strncmp(line + len - dirlen - 1, dir, dirlen))
+        {
+            fprintf(out, "f %s\n", name);
+            found = true;
+        }
+    }
+    free(line);
+    fclose(in);
+    assert(fclose(out) == 0);
+    assert(found);
+    assert(rename(tmp, snapshot) == 0);
+    free(tmp);
+}
+
+int main(void)
+{
+    const char *argv[] = {
+        "-v",
+        "--ignore-config",
+    };
+    char root[] = "/tmp/libvlc_XXXXXX";
+    char *path, *snapshot;
+
+    test_init();
+    vlc_mutex_init(&lock);
+    vlc_cond_init(&wait);
+
+    /* The user directories and the cache all live in a temporary tree */
+    assert(mkdtemp(root) != NULL);
+    make_dir(root, "videos");
+    make_dir(root, "videos/sub");
+    make_dir(root, "cache");
+    assert(asprintf(&path, "%s/user-dirs.dirs", root) != -1);
+    FILE *file = fopen(path, "w");
+    assert(file != NULL);
+    fprintf(file, "XDG_VIDEOS_DIR=\"%s/videos\"\n", root);
+    fclose(file);
+    free(path);
+    setenv("XDG_CONFIG_HOME", root, 1);
+    assert(asprintf(&path, "%s/cache", root) != -1);
+    setenv("XDG_CACHE_HOME", path, 1);
+    free(path);
+    assert(asprintf(&snapshot, "%s/cache/vlc/mediadirs-video.txt",
+                    root) != -1);
+
+    touch(root, "a.mkv");
+    touch(root, "sub/b.mkv");
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    /* First run: full scan, the category is the relative directory */
+    services_discovery_t *sd = start(obj);
+    wait_for(2);
+    assert(has("a.mkv", NULL));
+    assert(has("b.mkv", "sub"));
+
+#ifdef HAVE_SYS_INOTIFY_H
+    /* Live updates */
+    log("adding and removing files\n");
+    touch(root, "c.mkv");
+    wait_for(3);
+    assert(has("c.mkv", NULL));
+    remove_file(root, "videos/a.mkv");
+    wait_for(2);
+    assert(!has("a.mkv", NULL));
+    make_dir(root, "videos/new");
+    touch(root, "new/d.mkv");
+    wait_for(3);
+    assert(has("d.mkv", "new"));
+    remove_file(root, "videos/new/d.mkv");
+    remove_dir(root, "videos/new");
+    wait_for(2);
+#else
+    remove_file(root, "videos/a.mkv");
+    touch(root, "c.mkv");
+#endif
+    stop(sd);
+
+    /* The snapshot is saved once the scan is complete */
+    assert(access(snapshot, R_OK) == 0);
+
+    /* Second run: the unchanged directory is taken from the snapshot
+     * without reading it, so the forged entry shows up */
+    forge_snapshot(snapshot, "sub", "ghost.mkv");
+    sd = start(obj);
+    wait_for(3);
+    assert(has("b.mkv", "sub"));
+    assert(has("ghost.mkv", "sub"));
+    assert(has("c.mkv", NULL));
+    stop(sd);
+
+    libvlc_release(vlc);
+
+    remove_file(root, "videos/sub/b.mkv");
+    remove_file(root, "videos/c.mkv");
+    remove_file(root, "cache/vlc/mediadirs-video.txt");
+    remove_file(root, "user-dirs.dirs");
+    remove_dir(root, "videos/sub");
+    remove_dir(root, "videos");
+    remove_dir(root, "cache/vlc");
+    remove_dir(root, "cache");
+    rmdir(root);
+    free(snapshot);
+    vlc_cond_destroy(&wait);
+    vlc_mutex_destroy(&lock);
+    return 0;
+}
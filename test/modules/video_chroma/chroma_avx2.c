@@ -0,0 +1,284 @@
+/*****************************************************************************
+ * chroma_avx2.c: tests AVX2 chroma conversion rows
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include "../modules/video_chroma/chroma_avx2.h"
+
+#define MAX_WIDTH 3840
+
+static const struct
+{
+    bool b_rgb32;
+    uint32_t rmask, gmask, bmask;
+} layouts[] = {
+    { true,  0x00ff0000, 0x0000ff00, 0x000000ff },
+    { true,  0x000000ff, 0x0000ff00, 0x00ff0000 },
+    { true,  0xff000000, 0x00ff0000, 0x0000ff00 },
+    { true,  0x0000ff00, 0x00ff0000, 0xff000000 },
+    { false, 0xf800, 0x07e0, 0x001f },
+    { false, 0x7c00, 0x03e0, 0x001f },
+};
+
+static int clip( int v )
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/* Places an 8-bits component in the mask */
+static uint32_t put( unsigned c, uint32_t mask )
+{
+    unsigned shift = 0, bits = 0;
+
+    while( !(mask & 1) )
+    {
+        mask >>= 1;
+        shift++;
+    }
+    while( mask & 1 )
+    {
+        mask >>= 1;
+        bits++;
+    }
+    return (uint32_t)(c >> (8 - bits)) << shift;
+}
+
+/* Reference BT.601 conversion, written after the SSE2 i420_rgb module:
+ * 11-bits samples, 16-bits products keeping the high half */
+static uint32_t ref_pixel( int y, int u, int v, unsigned i_bits, unsigned l )
+{
+    const int s = 11 - i_bits;
+    int yy = (y << s) - 128, uu = (u << s) - 1024, vv = (v << s) - 1024;
+
+    if( yy < 0 )
+        yy = 0;
+    yy = (yy * 9535) >> 16;
+    int r = clip( yy + ((vv * 13074) >> 16) );
+    int g = clip( yy + ((uu * -3203) >> 16) + ((vv * -6660) >> 16) );
+    int b = clip( yy + ((uu * 16531) >> 16) );
+
+    return put( r, layouts[l].rmask ) | put( g, layouts[l].gmask )
+         | put( b, layouts[l].bmask );
+}
+
+static void check_pixel( const uint8_t *row, unsigned x, uint32_t ref,
+                         unsigned l, const char *psz_name )
+{
+    uint32_t px;
+
+    if( layouts[l].b_rgb32 )
+        memcpy( &px, &row[4 * x], 4 );
+    else
+    {
+        uint16_t px16;
+        memcpy( &px16, &row[2 * x], 2 );
+        px = px16;
+    }
+    if( px != ref )
+    {
+        fprintf( stderr, "%s layout %u pixel %u: %08"PRIx32" != %08"PRIx32"\n",
+                 psz_name, l, x, px, ref );
+        abort();
+    }
+}
+
+static uint8_t y8[MAX_WIDTH], uv8[MAX_WIDTH + 1], u8[MAX_WIDTH], v8[MAX_WIDTH];
+static uint16_t y16[MAX_WIDTH], u16[MAX_WIDTH], v16[MAX_WIDTH];
+static uint8_t out[4 * MAX_WIDTH + 64];
+
+static void fill( void )
+{
+    for( unsigned i = 0; i < MAX_WIDTH; i++ )
+    {
+        y8[i] = rand();
+        u8[i] = rand();
+        v8[i] = rand();
+        uv8[i] = rand();
+        y16[i] = rand() & 0x3ff;
+        u16[i] = rand() & 0x3ff;
+        v16[i] = rand() & 0x3ff;
+    }
+    /* Extremes, to exercise the clipping */
+    for( unsigned i = 0; i < 32; i++ )
+    {
+        y8[i] = (i & 1) ? 255 : 0;
+        u8[i] = uv8[i] = (i & 2) ? 255 : 0;
+        v8[i] = (i & 4) ? 255 : 0;
+    }
+}
+
+static void check_rgb( unsigned width, bool b_avx2 )
+{
+    const char *psz_name = b_avx2 ? "AVX2" : "C";
+
+    for( unsigned l = 0; l < ARRAY_SIZE(layouts); l++ )
+    {
+        rgb_layout_t layout;
+        bool ok = rgb_layout_Init( &layout, layouts[l].b_rgb32,
+                                   layouts[l].rmask, layouts[l].gmask,
+                                   layouts[l].bmask );
+        assert( ok );
+
+        /* Planar 8 bits */
+#ifdef HAVE_AVX2_INTRINSICS
+        if( b_avx2 )
+            YuvRgbRow_AVX2( out, y8, u8, v8, 1, width, &layout );
+        else
+#endif
+            YuvRgbRow_C( out, y8, u8, v8, 1, 0, width, &layout );
+        for( unsigned x = 0; x < width; x++ )
+            check_pixel( out, x, ref_pixel( y8[x], u8[x / 2], v8[x / 2], 8, l ),
+                         l, psz_name );
+
+        /* Semi-planar 8 bits, both chroma orders, exactly sized chroma */
+        const unsigned i_uv = 2 * ((width + 1) / 2);
+        uint8_t *uv = &uv8[MAX_WIDTH + 1 - i_uv];
+        for( unsigned swap = 0; swap < 2; swap++ )
+        {
+#ifdef HAVE_AVX2_INTRINSICS
+            if( b_avx2 )
+                YuvRgbRow_AVX2( out, y8, uv + swap, uv + !swap, 2, width,
+                                &layout );
+            else
+#endif
+                YuvRgbRow_C( out, y8, uv + swap, uv + !swap, 2, 0, width,
+                             &layout );
+            for( unsigned x = 0; x < width; x++ )
+            {
+                const uint8_t *c = &uv[2 * (x / 2)];
+                check_pixel( out, x, ref_pixel( y8[x], c[swap], c[!swap], 8, l ),
+                             l, psz_name );
+            }
+        }
+
+        /* Planar 10 bits */
+#ifdef HAVE_AVX2_INTRINSICS
+        if( b_avx2 )
+            Yuv10RgbRow_AVX2( out, y16, u16, v16, width, &layout );
+        else
+#endif
+            Yuv10RgbRow_C( out, y16, u16, v16, 0, width, &layout );
+        for( unsigned x = 0; x < width; x++ )
+            check_pixel( out, x,
+                         ref_pixel( y16[x], u16[x / 2], v16[x / 2], 10, l ),
+                         l, psz_name );
+    }
+}
+
+static void check_yuv( unsigned width, bool b_avx2 )
+{
+    static uint8_t py[MAX_WIDTH], pu[MAX_WIDTH], pv[MAX_WIDTH];
+
+    for( unsigned uyvy = 0; uyvy < 2; uyvy++ )
+    {
+        const unsigned l = uyvy, c = 1 - uyvy;
+
+#ifdef HAVE_AVX2_INTRINSICS
+        if( b_avx2 )
+            PlanarToPackedRow_AVX2( out, y8, u8, v8, width, uyvy );
+        else
+#endif
+            PlanarToPackedRow_C( out, y8, u8, v8, 0, width, uyvy );
+        for( unsigned x = 0; x < width; x++ )
+            assert( out[2 * x + l] == y8[x]
+                 && out[2 * x + c] == ((x & 1) ? v8 : u8)[x / 2] );
+
+        memset( pu, 0x55, sizeof (pu) );
+        memset( pv, 0x55, sizeof (pv) );
+#ifdef HAVE_AVX2_INTRINSICS
+        if( b_avx2 )
+            PackedToPlanarRow_AVX2( py, pu, pv, out, width, uyvy );
+        else
+#endif
+            PackedToPlanarRow_C( py, pu, pv, out, 0, width, uyvy );
+        assert( !memcmp( py, y8, width ) );
+        assert( !memcmp( pu, u8, width / 2 ) && !memcmp( pv, v8, width / 2 ) );
+        if( width & 1 )
+            assert( pu[width / 2] == u8[width / 2] );
+        assert( pu[(width + 1) / 2] == 0x55 && pv[(width + 1) / 2] == 0x55 );
+    }
+}
+
+static void bench( bool b_avx2 )
+{
+    rgb_layout_t layout;
+    rgb_layout_Init( &layout, true, 0x00ff0000, 0x0000ff00, 0x000000ff );
+
+    mtime_t i_start = mdate();
+    for( unsigned j = 0; j < 2160; j++ )
+#ifdef HAVE_AVX2_INTRINSICS
+        if( b_avx2 )
+            YuvRgbRow_AVX2( out, y8, u8, v8, 1, MAX_WIDTH, &layout );
+        else
+#endif
+            YuvRgbRow_C( out, y8, u8, v8, 1, 0, MAX_WIDTH, &layout );
+    mtime_t i_rgb = mdate() - i_start;
+
+    i_start = mdate();
+    for( unsigned j = 0; j < 2160; j++ )
+#ifdef HAVE_AVX2_INTRINSICS
+        if( b_avx2 )
+            PlanarToPackedRow_AVX2( out, y8, u8, v8, MAX_WIDTH, false );
+        else
+#endif
+            PlanarToPackedRow_C( out, y8, u8, v8, 0, MAX_WIDTH, false );
+    mtime_t i_yuv = mdate() - i_start;
+
+    printf( "%-5s 2160p I420->RV32 %6"PRId64" us, I420->YUYV %6"PRId64" us\n",
+            b_avx2 ? "AVX2" : "C", i_rgb, i_yuv );
+}
+
+int main( void )
+{
+    test_init();
+
+    bool b_avx2 = false;
+#ifdef HAVE_AVX2_INTRINSICS
+    b_avx2 = vlc_CPU_AVX2();
+#endif
+
+    srand( 42 );
+    fill();
+    for( unsigned width = 1; width < 200; width++ )
+    {
+        check_rgb( width, false );
+        check_yuv( width, false );
+        if( b_avx2 )
+        {
+            check_rgb( width, true );
+            check_yuv( width, true );
+        }
+    }
+    check_rgb( MAX_WIDTH, false );
+    check_yuv( MAX_WIDTH - 2, false );
+    bench( false );
+    if( b_avx2 )
+    {
+        check_rgb( MAX_WIDTH, true );
+        check_yuv( MAX_WIDTH - 2, true );
+        bench( true );
+    }
+    return 0;
+}
@@ -0,0 +1,234 @@
+/*****************************************************************************
+ * hqdn3d.c: tests the hqdn3d denoiser passes
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#undef log /* used by the coefficients computation */
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+#include "../modules/video_filter/hqdn3d.h"
+#include "../modules/misc/slices.h"
+
+#define WIDTH  1920
+#define HEIGHT 1080
+#define FRAMES 4
+
+typedef void (*vertical_t)(const unsigned char *, unsigned char *,
+                           const unsigned int *, unsigned int *,
+                           unsigned short *, long, long, int,
+                           const int *, const int *);
+
+/* Plain per-pixel loops of the original 8-bits filter, with the samples of
+ * higher depths scaled as 8.16 fixed point values too */
+static void ref_denoise(const uint8_t *Frame, uint8_t *FrameDest,
+                        unsigned int *LineAnt, unsigned short *FrameAnt,
+                        int W, int H, int Depth, const int *Horizontal,
+                        const int *Vertical, const int *Temporal)
+{
+    const int Shift = 24 - Depth;
+    const unsigned int Round = 0x10000000 + (1 << (Shift - 1)) - 1;
+    bool spatial = Horizontal[0] || Vertical[0];
+    bool temporal = Temporal[0] || !spatial;
+
+    for (int y = 0; y < H; y++) {
+        unsigned int PixelAnt = 0;
+
+        for (int x = 0; x < W; x++) {
+            const int i = y * W + x;
+            unsigned int Pixel = (Depth > 8 ? ((const uint16_t *)Frame)[i]
+                                            : Frame[i]) << Shift;
+
+            if (spatial) {
+                PixelAnt = x ? LowPassMul(PixelAnt, Pixel, Horizontal) : Pixel;
+                Pixel = LineAnt[x] = y ? LowPassMul(LineAnt[x], PixelAnt, Vertical)
+                                       : PixelAnt;
+            }
+            if (temporal) {
+                Pixel = LowPassMul(FrameAnt[i] << 8, Pixel, Temporal);
+                FrameAnt[i] = (Pixel + 0x1000007F) >> 8;
+            }
+
+            unsigned int v = ((Pixel + Round) >> Shift) & ((1 << Depth) - 1);
+            if (Depth > 8)
+                ((uint16_t *)FrameDest)[i] = v;
+            else
+                FrameDest[i] = v;
+        }
+    }
+}
+
+static unsigned int Spatial[ROWS * WIDTH], LineAnt[WIDTH];
+
+/* Same decomposition as the filter: horizontal pass on row bands, vertical
+ * and temporal passes on i_bands column bands */
+static void denoise(vertical_t pf, const uint8_t *Frame, uint8_t *FrameDest,
+                    unsigned short *FrameAnt, int W, int H, int Depth,
+                    const int *Horizontal, const int *Vertical,
+                    const int *Temporal, unsigned i_bands)
+{
+    const int pitch = W * (Depth > 8 ? 2 : 1);
+
+    if (!Horizontal[0] && !Vertical[0])
+        Horizontal = Vertical = NULL;
+    else if (!Temporal[0])
+        Temporal = NULL;
+
+    for (int y0 = 0; y0 < H; y0 += ROWS) {
+        const int y1 = __MIN(y0 + ROWS, H);
+        int y = y0;
+
+        if (Horizontal != NULL) {
+            for (; y + 4 <= y1; y += 4)
+                deNoiseRowsHorizontal4(&Frame[y * pitch], pitch,
+                                       &Spatial[(y - y0) * W], W, W, Depth,
+                                       Horizontal);
+            for (; y < y1; y++)
+                deNoiseRowHorizontal(&Frame[y * pitch], &Spatial[(y - y0) * W],
+                                     W, Depth, Horizontal);
+        }
+        for (unsigned i = 0; i < i_bands; i++)
+            for (y = y0; y < y1; y++)
+                pf(&Frame[y * pitch], &FrameDest[y * pitch],
+                   Horizontal ? &Spatial[(y - y0) * W] : NULL, LineAnt,
+                   &FrameAnt[y * W], SliceRow(W, i, i_bands, 8),
+                   SliceRow(W, i + 1, i_bands, 8), Depth,
+                   (Horizontal && y > 0) ? Vertical : NULL, Temporal);
+    }
+}
+
+static bool b_avx2;
+
+/* Implementation under test: the C one, or the AVX2 one */
+static vertical_t impl(bool avx2)
+{
+#ifdef HAVE_AVX2_INTRINSICS
+    if (avx2)
+        return deNoiseRowVertical_AVX2;
+#endif
+    VLC_UNUSED(avx2);
+    return deNoiseRowVertical_C;
+}
+
+static int Coefs[4][512*16];
+static uint8_t frames[FRAMES][WIDTH * HEIGHT];
+static uint16_t frames10[FRAMES][WIDTH * HEIGHT];
+static uint8_t out[2 * WIDTH * HEIGHT], ref[2 * WIDTH * HEIGHT];
+static unsigned short prev[WIDTH * HEIGHT], prev_ref[WIDTH * HEIGHT];
+
+/* Checks every implementation against the reference */
+static void check(int W, int H, int Depth, unsigned i_bands)
+{
+    const uint8_t *input[FRAMES];
+    const int size = W * H * (Depth > 8 ? 2 : 1);
+
+    for (unsigned f = 0; f < FRAMES; f++)
+        input[f] = Depth > 8 ? (const uint8_t *)frames10[f] : frames[f];
+
+    for (int avx2 = 0; avx2 <= b_avx2; avx2++) {
+        /* spatial and temporal, spatial only, temporal only */
+        static const int modes[][3] = { { 0, 1, 2 }, { 0, 1, 3 }, { 3, 3, 2 } };
+        for (size_t m = 0; m < ARRAY_SIZE(modes); m++) {
+            const int *h = Coefs[modes[m][0]], *v = Coefs[modes[m][1]],
+                      *t = Coefs[modes[m][2]];
+
+            deNoiseInit(input[0], prev, W, H, size / H, Depth);
+            deNoiseInit(input[0], prev_ref, W, H, size / H, Depth);
+            for (unsigned f = 0; f < FRAMES; f++) {
+                denoise(impl(avx2), input[f], out, prev, W, H, Depth, h, v, t,
+                        i_bands);
+                ref_denoise(input[f], ref, LineAnt, prev_ref, W, H, Depth,
+                            h, v, t);
+                if (memcmp(out, ref, size)
+                 || memcmp(prev, prev_ref, W * H * sizeof (*prev))) {
+                    fprintf(stderr, "%s mismatch, %dx%d, %d bits, %u bands, "
+                            "mode %zu\n", avx2 ? "AVX2" : "C", W, H, Depth,
+                            i_bands, m);
+                    abort();
+                }
+            }
+        }
+    }
+}
+
+static void bench(void)
+{
+    for (int avx2 = 0; avx2 <= b_avx2; avx2++) {
+        deNoiseInit(frames[0], prev, WIDTH, HEIGHT, WIDTH, 8);
+        mtime_t i_start = mdate();
+        for (unsigned f = 0; f < FRAMES; f++)
+            denoise(impl(avx2), frames[f], out, prev, WIDTH, HEIGHT, 8,
+                    Coefs[0], Coefs[1], Coefs[2], 1);
+        mtime_t i_time = mdate() - i_start;
+
+        deNoiseInit(frames[0], prev_ref, WIDTH, HEIGHT, WIDTH, 8);
+        i_start = mdate();
+        for (unsigned f = 0; f < FRAMES; f++)
+            ref_denoise(frames[f], ref, LineAnt, prev_ref, WIDTH, HEIGHT, 8,
+                        Coefs[0], Coefs[1], Coefs[2]);
+        printf("%-5s 1080p luma: %6"PRId64" us per frame (reference %6"PRId64
+               " us)\n", avx2 ? "AVX2" : "C", i_time / FRAMES,
+               (mdate() - i_start) / FRAMES);
+    }
+}
+
+int main(void)
+{
+    test_init();
+
+#ifdef HAVE_AVX2_INTRINSICS
+    b_avx2 = vlc_CPU_AVX2();
+#endif
+
+    PrecalcCoefs(Coefs[0], 4.0);
+    PrecalcCoefs(Coefs[1], 6.0);
+    PrecalcCoefs(Coefs[2], 20.0);
+    PrecalcCoefs(Coefs[3], 0.0);
+
+    /* Noisy gradients, so that both small and large differences occur */
+    srand(42);
+    for (unsigned f = 0; f < FRAMES; f++)
+        for (unsigned i = 0; i < WIDTH * HEIGHT; i++) {
+            int v = (i % WIDTH) / 8 + (rand() % 24) - 12;
+            frames[f][i] = v < 0 ? 0 : v > 255 ? 255 : v;
+            if (rand() % 64 == 0)
+                frames[f][i] = rand();
+        }
+
+    /* 10-bits samples: the 8-bits data with two more bits of noise */
+    for (unsigned f = 0; f < FRAMES; f++)
+        for (unsigned i = 0; i < WIDTH * HEIGHT; i++)
+            frames10[f][i] = (frames[f][i] << 2) | (rand() & 3);
+
+    for (int W = 1; W < 40; W += 3)
+        check(W, 7, 8, 2);
+    check(333, 150, 8, 3);
+    check(WIDTH, 200, 8, 8);
+
+    for (int W = 1; W < 40; W += 3)
+        check(W, 7, 10, 2);
+    check(333, 150, 10, 3);
+    check(WIDTH / 2, 300, 10, 3);
+
+    bench();
+    return 0;
+}
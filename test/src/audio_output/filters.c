@@ -0,0 +1,217 @@
+/*****************************************************************************
+ * filters.c: audio filters pipeline test and benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+#undef log /* conflicts with math.h */
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <math.h>
+#include <inttypes.h>
+#include <vlc_common.h>
+#include <vlc_aout.h>
+#include <vlc_aout_volume.h>
+#include <vlc_input.h>
+#include <vlc_modules.h>
+
+#define RATE    48000
+#define FRAMES  1024 /* per block, as decoders typically output */
+#define SECONDS 10
+
+/* Expected output frame, for the reference (scalar) implementations */
+typedef void (*expect_t)(float *, const float *);
+
+static void Expect_5_1_to_2_0(float *out, const float *in)
+{
+    out[0] = in[0] + 0.7071f * (in[4] + in[2]);
+    out[1] = in[1] + 0.7071f * (in[4] + in[3]);
+}
+
+static void Expect_7_1_to_2_0(float *out, const float *in)
+{
+    float ctr = in[6] * 0.7071f;
+    out[0] = ctr + in[0] + in[2] / 4 + in[4] / 4;
+    out[1] = ctr + in[1] + in[3] / 4 + in[5] / 4;
+}
+
+/* Left and right swapped by the remap filter */
+static void Expect_5_1_swapped(float *out, const float *in)
+{
+    out[0] = in[1];
+    out[1] = in[0];
+    memcpy(&out[2], &in[2], 4 * sizeof (*out));
+}
+
+/* Left and right moved to the rear: the remap filter outputs 4.0, with
+ * silent front channels */
+static void Expect_2_0_to_rear(float *out, const float *in)
+{
+    out[0] = out[1] = 0.f;
+    out[2] = in[0];
+    out[3] = in[1];
+}
+
+static void fill(block_t *block, unsigned channels, unsigned n)
+{
+    float *p = (float *)block->p_buffer;
+
+    for (unsigned i = 0; i < FRAMES; i++)
+        for (unsigned c = 0; c < channels; c++)
+            p[i * channels + c] = sinf(.001f * (n * FRAMES + i) + c);
+}
+
+static void format(audio_sample_format_t *fmt, uint32_t chans)
+{
+    memset(fmt, 0, sizeof (*fmt));
+    fmt->i_format = VLC_CODEC_FL32;
+    fmt->i_rate = RATE;
+    fmt->i_physical_channels = fmt->i_original_channels = chans;
+    aout_FormatPrepare(fmt);
+}
+
+/* Plays blocks through a filters pipeline, checks their output and prints
+ * the time spent per second of audio. remap gives the remap filter output
+ * channels of the left and right inputs, if not NULL. */
+static void pipeline(vlc_object_t *parent, const char *name,
+                     const char *audio_filter, const int *remap,
+                     uint32_t in_chans, uint32_t out_chans, expect_t expect)
+{
+    audio_sample_format_t infmt, outfmt;
+    static float src[FRAMES * AOUT_CHAN_MAX];
+    float ref[AOUT_CHAN_MAX];
+
+    vlc_object_t *obj = vlc_object_create(parent, sizeof (*obj));
+    assert(obj != NULL);
+    var_Create(obj, "audio-filter", VLC_VAR_STRING);
+    var_SetString(obj, "audio-filter", audio_filter);
+    if (remap != NULL) {
+        var_Create(obj, "aout-remap-channel-left", VLC_VAR_INTEGER);
+        var_SetInteger(obj, "aout-remap-channel-left", remap[0]);
+        var_Create(obj, "aout-remap-channel-right", VLC_VAR_INTEGER);
+        var_SetInteger(obj, "aout-remap-channel-right", remap[1]);
+    }
+
+    format(&infmt, in_chans);
+    format(&outfmt, out_chans);
+    aout_filters_t *filters = aout_FiltersNew(obj, &infmt, &outfmt, NULL);
+    assert(filters != NULL);
+
+    mtime_t total = 0;
+    for (unsigned n = 0; n < SECONDS * RATE / FRAMES; n++) {
+        block_t *in = block_Alloc(FRAMES * infmt.i_bytes_per_frame);
+        assert(in != NULL);
+        fill(in, infmt.i_channels, n);
+        in->i_nb_samples = FRAMES;
+        in->i_pts = VLC_TS_0 + n * FRAMES * CLOCK_FREQ / RATE;
+        in->i_length = FRAMES * CLOCK_FREQ / RATE;
+
+        memcpy(src, in->p_buffer, in->i_buffer);
+
+        mtime_t start = mdate();
+        block_t *out = aout_FiltersPlay(filters, in, INPUT_RATE_DEFAULT);
+        total += mdate() - start;
+
+        assert(out != NULL);
+        assert(out->i_nb_samples == FRAMES);
+        assert(out->i_buffer == FRAMES * outfmt.i_bytes_per_frame);
+        /* The channels are mixed in place, unless there are more of them */
+        if (outfmt.i_channels <= infmt.i_channels)
+            assert(out == in);
+
+        const float *p = (const float *)out->p_buffer;
+        for (unsigned i = 0; i < FRAMES; i++) {
+            expect(ref, &src[i * infmt.i_channels]);
+            for (unsigned c = 0; c < outfmt.i_channels; c++)
+                assert(fabsf(p[i * outfmt.i_channels + c] - ref[c]) < 1e-5f);
+        }
+        block_Release(out);
+    }
+
+    printf("%-24s %5"PRId64" us per second\n", name, total / SECONDS);
+    aout_FiltersDelete((vlc_object_t *)NULL, filters);
+    vlc_object_release(obj);
+}
+
+/* Applies the software volume to stereo blocks */
+static void volume(vlc_object_t *parent)
+{
+    audio_volume_t *vol = vlc_object_create(parent, sizeof (*vol));
+    assert(vol != NULL);
+    vol->format = VLC_CODEC_FL32;
+
+    module_t *module = module_need(vol, "audio volume", NULL, false);
+    assert(module != NULL);
+
+    block_t *block = block_Alloc(FRAMES * 2 * sizeof (float));
+    assert(block != NULL);
+
+    mtime_t total = 0;
+    for (unsigned n = 0; n < SECONDS * RATE / FRAMES; n++) {
+        fill(block, 2, n);
+
+        mtime_t start = mdate();
+        vol->amplify(vol, block, .5f);
+        total += mdate() - start;
+
+        const float *p = (const float *)block->p_buffer;
+        assert(fabsf(p[FRAMES * 2 - 1]
+                     - .5f * sinf(.001f * (n * FRAMES + FRAMES - 1) + 1)) < 1e-6f);
+    }
+
+    printf("%-24s %5"PRId64" us per second\n", "volume stereo", total / SECONDS);
+    block_Release(block);
+    module_unneed(vol, module);
+    vlc_object_release(vol);
+}
+
+int main(void)
+{
+    const char *argv[] = {
+        "-v",
+        "--ignore-config",
+        "--no-audio-time-stretch",
+        "--audio-resampler=none",
+    };
+    /* Indexes of the remap filter channel options */
+    static const int swap[] = { 2, 0 }, rear[] = { 3, 5 };
+
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = (vlc_object_t *)vlc->p_libvlc_int;
+
+    pipeline(obj, "simple 5.1 to stereo", "", NULL, AOUT_CHANS_5_1,
+             AOUT_CHANS_STEREO, Expect_5_1_to_2_0);
+    pipeline(obj, "simple 7.1 to stereo", "", NULL, AOUT_CHANS_7_1,
+             AOUT_CHANS_STEREO, Expect_7_1_to_2_0);
+    pipeline(obj, "remap 5.1", "remap", swap, AOUT_CHANS_5_1,
+             AOUT_CHANS_5_1, Expect_5_1_swapped);
+    pipeline(obj, "remap stereo to rear", "remap", rear, AOUT_CHANS_STEREO,
+             AOUT_CHANS_4_0, Expect_2_0_to_rear);
+    volume(obj);
+
+    libvlc_release(vlc);
+    return 0;
+}
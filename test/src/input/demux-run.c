@@ -0,0 +1,568 @@
+/*****************************************************************************
+ * demux-run.c: demux, packetizer and decoder benchmark
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Runs a local file through a demuxer as fast as possible, with a null ES
+ * output, and optionally through packetizers and decoders. Reports the
+ * throughput and the CPU time spent in each stage.
+ *
+ * Usage: test_src_input_demux_run [-p] [-d] [-m demux] file
+ *        test_src_input_demux_run -o [-m demux] file...
+ *   -p  packetize all elementary streams
+ *   -d  decode all elementary streams (implies -p where needed)
+ *   -m  demux module to use (default: any)
+ *   -o  only open each file, and report the time taken to find its demuxer
+ *
+ * Without a file, the program exits with the automake "skipped" status.
+ */
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#include <vlc_demux.h>
+#include <vlc_es_out.h>
+#include <vlc_codec.h>
+#include <vlc_aout.h>
+#include <vlc_meta.h>
+#include <vlc_modules.h>
+#include <vlc_picture.h>
+#include <vlc_subpicture.h>
+#include <vlc_stream.h>
+#include <vlc_url.h>
+
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+/* CPU time of the calling thread: all stages run synchronously in it */
+static mtime_t cputime( void )
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec ts;
+
+    if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) == 0 )
+        return INT64_C(1000000) * ts.tv_sec + ts.tv_nsec / 1000;
+#endif
+    return mdate();
+}
+
+struct es_out_id_t
+{
+    struct es_out_id_t *p_next;
+    int i_id;
+    es_format_t fmt;
+
+    decoder_t *p_packetizer;
+    decoder_t *p_decoder;
+    bool b_no_decoder;
+
+    uint64_t i_blocks;
+    uint64_t i_bytes;
+    uint64_t i_frames;
+    mtime_t  i_packetize_time;
+    mtime_t  i_decode_time;
+};
+
+struct es_out_sys_t
+{
+    vlc_object_t *p_obj;
+    bool b_packetize;
+    bool b_decode;
+
+    es_out_id_t *p_ids;
+    int i_next_id;
+    mtime_t i_send_time;
+};
+
+/*****************************************************************************
+ * Null decoder owner
+ *****************************************************************************/
+static int VoutFormatUpdate( decoder_t *p_dec )
+{
+    (void) p_dec;
+    return 0;
+}
+
+static picture_t *VoutBufferNew( decoder_t *p_dec )
+{
+    return picture_NewFromFormat( &p_dec->fmt_out.video );
+}
+
+static int AoutFormatUpdate( decoder_t *p_dec )
+{
+    if( p_dec->fmt_out.audio.i_format == 0 )
+        p_dec->fmt_out.audio.i_format = p_dec->fmt_out.i_codec;
+    aout_FormatPrepare( &p_dec->fmt_out.audio );
+    return 0;
+}
+
+static subpicture_t *SpuBufferNew( decoder_t *p_dec,
+                                   const subpicture_updater_t *p_upd )
+{
+    (void) p_dec;
+    return subpicture_New( p_upd );
+}
+
+static int QueueVideo( decoder_t *p_dec, picture_t *p_pic )
+{
+    es_out_id_t *id = (es_out_id_t *)p_dec->p_owner;
+
+    id->i_frames++;
+    picture_Release( p_pic );
+    return 0;
+}
+
+static int QueueAudio( decoder_t *p_dec, block_t *p_block )
+{
+    es_out_id_t *id = (es_out_id_t *)p_dec->p_owner;
+
+    id->i_frames++;
+    block_Release( p_block );
+    return 0;
+}
+
+static int QueueSub( decoder_t *p_dec, subpicture_t *p_spu )
+{
+    es_out_id_t *id = (es_out_id_t *)p_dec->p_owner;
+
+    id->i_frames++;
+    subpicture_Delete( p_spu );
+    return 0;
+}
+
+static decoder_t *ModuleNew( vlc_object_t *p_obj, const es_format_t *p_fmt,
+                             bool b_packetizer, es_out_id_t *id )
+{
+    decoder_t *p_dec = vlc_object_create( p_obj, sizeof( *p_dec ) );
+    if( p_dec == NULL )
+        return NULL;
+
+    es_format_Copy( &p_dec->fmt_in, p_fmt );
+    es_format_Init( &p_dec->fmt_out, UNKNOWN_ES, 0 );
+
+    /* The owner is the ES, used to count output frames */
+    p_dec->p_owner = (decoder_owner_sys_t *)id;
+    p_dec->pf_vout_format_update = VoutFormatUpdate;
+    p_dec->pf_vout_buffer_new = VoutBufferNew;
+    p_dec->pf_aout_format_update = AoutFormatUpdate;
+    p_dec->pf_spu_buffer_new = SpuBufferNew;
+    p_dec->pf_queue_video = QueueVideo;
+    p_dec->pf_queue_audio = QueueAudio;
+    p_dec->pf_queue_sub = QueueSub;
+
+    p_dec->p_module = module_need( p_dec,
+                                   b_packetizer ? "packetizer" : "decoder",
+                                   b_packetizer ? "$packetizer" : "$codec",
+                                   false );
+    if( p_dec->p_module == NULL )
+    {
+        msg_Warn( p_obj, "no %s for %4.4s", b_packetizer ? "packetizer"
+                  : "decoder", (const char *)&p_fmt->i_codec );
+        es_format_Clean( &p_dec->fmt_in );
+        vlc_object_release( p_dec );
+        return NULL;
+    }
+    return p_dec;
+}
+
+static void ModuleDelete( decoder_t *p_dec )
+{
+    module_unneed( p_dec, p_dec->p_module );
+    es_format_Clean( &p_dec->fmt_in );
+    es_format_Clean( &p_dec->fmt_out );
+    if( p_dec->p_description != NULL )
+        vlc_meta_Delete( p_dec->p_description );
+    vlc_object_release( p_dec );
+}
+
+/* Decodes one block, or drains the decoder if pp_block is NULL */
+static void Decode( es_out_id_t *id, block_t **pp_block )
+{
+    decoder_t *p_dec = id->p_decoder;
+    mtime_t i_start = cputime();
+
+    switch( p_dec->fmt_in.i_cat )
+    {
+        case VIDEO_ES:
+        {
+            picture_t *p_pic;
+            while( (p_pic = p_dec->pf_decode_video( p_dec, pp_block )) )
+                QueueVideo( p_dec, p_pic );
+            break;
+        }
+        case AUDIO_ES:
+        {
+            block_t *p_out;
+            while( (p_out = p_dec->pf_decode_audio( p_dec, pp_block )) )
+                QueueAudio( p_dec, p_out );
+            break;
+        }
+        case SPU_ES:
+        {
+            subpicture_t *p_spu;
+            while( (p_spu = p_dec->pf_decode_sub( p_dec, pp_block )) )
+                QueueSub( p_dec, p_spu );
+            break;
+        }
+        default:
+            if( pp_block != NULL && *pp_block != NULL )
+                block_Release( *pp_block );
+            break;
+    }
+    id->i_decode_time += cputime() - i_start;
+}
+
+static void DecodeChain( es_out_sys_t *p_sys, es_out_id_t *id,
+                         block_t *p_block )
+{
+    if( id->p_decoder == NULL && p_sys->b_decode && !id->b_no_decoder )
+    {   /* Use the packetized format once known, as the input core does */
+        const es_format_t *p_fmt = &id->fmt;
+        if( id->p_packetizer != NULL && id->p_packetizer->fmt_out.i_codec )
+            p_fmt = &id->p_packetizer->fmt_out;
+        id->p_decoder = ModuleNew( p_sys->p_obj, p_fmt, false, id );
+        id->b_no_decoder = id->p_decoder == NULL;
+    }
+
+    if( id->p_decoder != NULL )
+        Decode( id, p_block ? &p_block : NULL );
+    else if( p_block != NULL )
+        block_ChainRelease( p_block );
+}
+
+static void Packetize( es_out_sys_t *p_sys, es_out_id_t *id, block_t *p_block )
+{
+    decoder_t *p_pack = id->p_packetizer;
+    block_t **pp_block = p_block ? &p_block : NULL;
+
+    for( ;; )
+    {
+        mtime_t i_start = cputime();
+        block_t *p_out = p_pack->pf_packetize( p_pack, pp_block );
+        id->i_packetize_time += cputime() - i_start;
+        if( p_out == NULL )
+            break;
+
+        while( p_out != NULL )
+        {
+            block_t *p_next = p_out->p_next;
+
+            p_out->p_next = NULL;
+            DecodeChain( p_sys, id, p_out );
+            p_out = p_next;
+        }
+    }
+}
+
+/*****************************************************************************
+ * Null ES output
+ *****************************************************************************/
+static es_out_id_t *EsOutAdd( es_out_t *out, const es_format_t *p_fmt )
+{
+    es_out_sys_t *p_sys = out->p_sys;
+    es_out_id_t *id = calloc( 1, sizeof( *id ) );
+    if( unlikely(id == NULL) )
+        return NULL;
+
+    id->i_id = p_sys->i_next_id++;
+    es_format_Copy( &id->fmt, p_fmt );
+
+    if( p_sys->b_packetize || (p_sys->b_decode && !p_fmt->b_packetized) )
+    {
+        es_format_t fmt;
+
+        es_format_Copy( &fmt, p_fmt );
+        fmt.b_packetized = false;
+        id->p_packetizer = ModuleNew( p_sys->p_obj, &fmt, true, id );
+        es_format_Clean( &fmt );
+    }
+
+    id->p_next = p_sys->p_ids;
+    p_sys->p_ids = id;
+    return id;
+}
+
+static int EsOutSend( es_out_t *out, es_out_id_t *id, block_t *p_block )
+{
+    es_out_sys_t *p_sys = out->p_sys;
+    mtime_t i_start = cputime();
+
+    id->i_blocks++;
+    id->i_bytes += p_block->i_buffer;
+
+    if( id->p_packetizer != NULL )
+        Packetize( p_sys, id, p_block );
+    else
+        DecodeChain( p_sys, id, p_block );
+
+    p_sys->i_send_time += cputime() - i_start;
+    return VLC_SUCCESS;
+}
+
+static void EsOutDel( es_out_t *out, es_out_id_t *id )
+{
+    (void) out; (void) id;
+    /* Kept until the end for the report */
+}
+
+static int EsOutControl( es_out_t *out, int i_query, va_list args )
+{
+    (void) out;
+
+    switch( i_query )
+    {
+        case ES_OUT_GET_ES_STATE:
+            va_arg( args, es_out_id_t * );
+            *va_arg( args, bool * ) = true;
+            return VLC_SUCCESS;
+        default:
+            return VLC_EGENERIC;
+    }
+}
+
+static void EsOutDestroy( es_out_t *out )
+{
+    es_out_sys_t *p_sys = out->p_sys;
+
+    while( p_sys->p_ids != NULL )
+    {
+        es_out_id_t *id = p_sys->p_ids;
+
+        p_sys->p_ids = id->p_next;
+        if( id->p_packetizer != NULL )
+            ModuleDelete( id->p_packetizer );
+        if( id->p_decoder != NULL )
+            ModuleDelete( id->p_decoder );
+        es_format_Clean( &id->fmt );
+        free( id );
+    }
+}
+
+static void Drain( es_out_sys_t *p_sys )
+{
+    /* Only audio and video are drained, as in the input core */
+    for( es_out_id_t *id = p_sys->p_ids; id != NULL; id = id->p_next )
+    {
+        if( id->fmt.i_cat != VIDEO_ES && id->fmt.i_cat != AUDIO_ES )
+            continue;
+        if( id->p_packetizer != NULL )
+            Packetize( p_sys, id, NULL );
+        if( id->p_decoder != NULL )
+            Decode( id, NULL );
+    }
+}
+
+/*****************************************************************************
+ * Report
+ *****************************************************************************/
+static void Report( demux_t *p_demux, es_out_sys_t *p_sys, uint64_t i_size,
+                    mtime_t i_wall, mtime_t i_cpu )
+{
+    const double f_wall = (i_wall > 0 ? i_wall : 1) / (double)CLOCK_FREQ;
+    uint64_t i_blocks = 0;
+
+    for( es_out_id_t *id = p_sys->p_ids; id != NULL; id = id->p_next )
+        i_blocks += id->i_blocks;
+
+    printf( "input    : %"PRIu64" bytes in %.3f s, %.2f MB/s, "
+            "%.0f packets/s\n", i_size, f_wall,
+            i_size / f_wall / 1000000., i_blocks / f_wall );
+    printf( "demux    : %-12s %8.3f s CPU\n",
+            module_get_object( p_demux->p_module ),
+            (i_cpu - p_sys->i_send_time) / (double)CLOCK_FREQ );
+
+    for( es_out_id_t *id = p_sys->p_ids; id != NULL; id = id->p_next )
+    {
+        printf( "es %-5d : %4.4s %"PRIu64" packets, %"PRIu64" bytes\n",
+                id->i_id, (const char *)&id->fmt.i_codec,
+                id->i_blocks, id->i_bytes );
+        if( id->p_packetizer != NULL )
+            printf( "  packetizer %-12s %8.3f s CPU\n",
+                    module_get_object( id->p_packetizer->p_module ),
+                    id->i_packetize_time / (double)CLOCK_FREQ );
+        if( id->p_decoder != NULL )
+            printf( "  decoder    %-12s %8.3f s CPU, %"PRIu64" frames\n",
+                    module_get_object( id->p_decoder->p_module ),
+                    id->i_decode_time / (double)CLOCK_FREQ, id->i_frames );
+    }
+}
+
+/* Measures the open latency, mostly the demuxers probing, of each file */
+static int OpenLatency( vlc_object_t *p_obj, const char *psz_demux,
+                        es_out_t *out, int i_files, char *const *ppsz_files )
+{
+    mtime_t i_total = 0;
+    int i_opened = 0;
+
+    for( int i = 0; i < i_files; i++ )
+    {
+        char *psz_url = vlc_path2uri( ppsz_files[i], NULL );
+        if( psz_url == NULL )
+            continue;
+
+        stream_t *s = stream_UrlNew( p_obj, psz_url );
+        if( s == NULL )
+        {
+            fprintf( stderr, "cannot open %s\n", ppsz_files[i] );
+            free( psz_url );
+            continue;
+        }
+
+        const char *psz_location = strstr( psz_url, "://" );
+        psz_location = psz_location ? psz_location + 3 : psz_url;
+
+        mtime_t i_time = mdate();
+        demux_t *p_demux = demux_New( p_obj, psz_demux, psz_location, s, out );
+        i_time = mdate() - i_time;
+
+        printf( "%9.3f ms  %-12s %s\n", i_time / 1000.,
+                p_demux ? module_get_object( p_demux->p_module ) : "(none)",
+                ppsz_files[i] );
+        if( p_demux != NULL )
+        {
+            i_total += i_time;
+            i_opened++;
+            demux_Delete( p_demux );
+        }
+        stream_Delete( s );
+        free( psz_url );
+    }
+
+    if( i_opened > 0 )
+        printf( "open     : %d/%d files in %.3f ms, %.3f ms on average\n",
+                i_opened, i_files, i_total / 1000.,
+                i_total / 1000. / i_opened );
+    return i_opened != i_files;
+}
+
+static void Usage( const char *psz_prog )
+{
+    fprintf( stderr, "Usage: %s [-p] [-d] [-m demux] file\n"
+             "       %s -o [-m demux] file...\n"
+             "  -p  packetize elementary streams\n"
+             "  -d  decode elementary streams\n"
+             "  -m  demux module name (default: any)\n"
+             "  -o  measure the open latency of each file\n",
+             psz_prog, psz_prog );
+}
+
+int main( int argc, char *argv[] )
+{
+    const char *psz_demux = "any";
+    es_out_sys_t sys = { .p_obj = NULL };
+    bool b_open = false;
+    int c;
+
+    while( (c = getopt( argc, argv, "pdm:o" )) != -1 )
+    {
+        switch( c )
+        {
+            case 'p': sys.b_packetize = true; break;
+            case 'd': sys.b_decode = true; break;
+            case 'm': psz_demux = optarg; break;
+            case 'o': b_open = true; break;
+            default:
+                Usage( argv[0] );
+                return 1;
+        }
+    }
+
+    if( optind >= argc )
+    {
+        Usage( argv[0] );
+        return 77; /* skipped */
+    }
+
+    test_init();
+
+    const char *args[] = {
+        "-q",
+        "--ignore-config",
+        "--no-media-library",
+    };
+    libvlc_instance_t *p_vlc = libvlc_new( ARRAY_SIZE(args), args );
+    if( p_vlc == NULL )
+        return 1;
+
+    vlc_object_t *p_obj = VLC_OBJECT(p_vlc->p_libvlc_int);
+    char *psz_url = NULL;
+    int i_ret = 1;
+
+    sys.p_obj = p_obj;
+    es_out_t out = {
+        .pf_add = EsOutAdd,
+        .pf_send = EsOutSend,
+        .pf_del = EsOutDel,
+        .pf_control = EsOutControl,
+        .pf_destroy = EsOutDestroy,
+        .p_sys = &sys,
+    };
+
+    if( b_open )
+    {
+        i_ret = OpenLatency( p_obj, psz_demux, &out, argc - optind,
+                             argv + optind );
+        EsOutDestroy( &out );
+        goto out;
+    }
+
+    psz_url = vlc_path2uri( argv[optind], NULL );
+    if( psz_url == NULL )
+        goto out;
+
+    stream_t *s = stream_UrlNew( p_obj, psz_url );
+    if( s == NULL )
+    {
+        fprintf( stderr, "cannot open %s\n", argv[optind] );
+        goto out;
+    }
+
+    const char *psz_location = strstr( psz_url, "://" );
+    psz_location = psz_location ? psz_location + 3 : psz_url;
+
+    mtime_t i_wall = mdate();
+    mtime_t i_cpu = cputime();
+
+    demux_t *p_demux = demux_New( p_obj, psz_demux, psz_location, s, &out );
+    if( p_demux == NULL )
+    {
+        fprintf( stderr, "cannot demux %s\n", argv[optind] );
+        stream_Delete( s );
+        goto out;
+    }
+
+    int i_val;
+    while( (i_val = demux_Demux( p_demux )) > 0 );
+
+    Drain( &sys );
+    i_cpu = cputime() - i_cpu;
+    i_wall = mdate() - i_wall;
+
+    Report( p_demux, &sys, stream_Tell( s ), i_wall, i_cpu );
+    i_ret = i_val < 0;
+
+    demux_Delete( p_demux );
+    stream_Delete( s );
+    EsOutDestroy( &out );
+out:
+    free( psz_url );
+    libvlc_release( p_vlc );
+    return i_ret;
+}
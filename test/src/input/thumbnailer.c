@@ -0,0 +1,127 @@
+/*****************************************************************************
+ * thumbnailer.c: thumbnail extraction test
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vlc_common.h>
+#include <vlc_picture.h>
+#include <vlc_thumbnailer.h>
+
+/* Raw I420 video, with 2:1 pixels: the display aspect ratio is 4:1 */
+#define WIDTH  64
+#define HEIGHT 32
+#define FRAMES 5
+#define FPS    25
+
+/* Every frame has its own luma */
+static unsigned luma(unsigned frame)
+{
+    return 16 + 40 * frame;
+}
+
+static void write_video(int fd)
+{
+    static uint8_t frame[WIDTH * HEIGHT * 3 / 2];
+
+    for (unsigned i = 0; i < FRAMES; i++) {
+        memset(frame, luma(i), WIDTH * HEIGHT);
+        memset(frame + WIDTH * HEIGHT, 128, WIDTH * HEIGHT / 2);
+        assert(write(fd, frame, sizeof (frame)) == sizeof (frame));
+    }
+}
+
+static void check(vlc_thumbnailer_t *th, unsigned frame, unsigned width,
+                  unsigned height, unsigned exp_width, unsigned exp_height)
+{
+    video_format_t fmt;
+
+    memset(&fmt, 0, sizeof (fmt));
+    fmt.i_chroma = VLC_CODEC_I420;
+    fmt.i_width = width;
+    fmt.i_height = height;
+
+    picture_t *pic = vlc_thumbnailer_Get(th, frame * CLOCK_FREQ / FPS, &fmt);
+    assert(pic != NULL);
+    log("frame %u: %ux%u\n", frame, fmt.i_width, fmt.i_height);
+    assert(fmt.i_width == exp_width && fmt.i_height == exp_height);
+    assert(pic->format.i_chroma == VLC_CODEC_I420);
+
+    /* Scaling a flat picture keeps it flat */
+    const plane_t *y = &pic->p[Y_PLANE];
+    int value = y->p_pixels[(y->i_visible_lines / 2) * y->i_pitch
+                            + y->i_visible_pitch / 2];
+    assert(abs(value - (int)luma(frame)) <= 2);
+    picture_Release(pic);
+}
+
+int main(void)
+{
+    const char *argv[] = {
+        "-v",
+        "--ignore-config",
+        "--rawvid-width=64",
+        "--rawvid-height=32",
+        "--rawvid-fps=25",
+        "--rawvid-chroma=I420",
+        "--rawvid-aspect-ratio=2:1",
+    };
+    char path[] = "/tmp/libvlc_XXXXXX.yuv";
+    char *mrl;
+
+    test_init();
+
+    int fd = mkstemps(path, 4);
+    assert(fd != -1);
+    write_video(fd);
+    close(fd);
+    assert(asprintf(&mrl, "file://%s", path) != -1);
+
+    libvlc_instance_t *vlc = libvlc_new(ARRAY_SIZE(argv), argv);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = VLC_OBJECT(vlc->p_libvlc_int);
+
+    assert(vlc_thumbnailer_Create(obj, "file:///nonexistent.yuv") == NULL);
+
+    vlc_thumbnailer_t *th = vlc_thumbnailer_Create(obj, mrl);
+    assert(th != NULL);
+
+    /* Source dimensions */
+    check(th, 0, 0, 0, WIDTH, HEIGHT);
+    /* Only one dimension: the other one follows the display aspect ratio */
+    check(th, 3, 128, 0, 128, 32);
+    check(th, 1, 0, 16, 64, 16);
+    /* Requests can go back and forth */
+    check(th, 4, 40, 10, 40, 10);
+    check(th, 2, 0, 0, WIDTH, HEIGHT);
+
+    vlc_thumbnailer_Release(th);
+    libvlc_release(vlc);
+    unlink(path);
+    free(mrl);
+    return 0;
+}
@@ -382,6 +382,94 @@ static void test_creation_and_type( libvlc_int_t *p_libvlc )
     assert( var_Get( p_libvlc, "bla", &val ) == VLC_ENOVAR );
 }
 
+static void test_handles( libvlc_int_t *p_libvlc )
+{
+    var_Create( p_libvlc, "handle-int", VLC_VAR_INTEGER );
+    var_Create( p_libvlc, "handle-bool", VLC_VAR_BOOL );
+    var_Create( p_libvlc, "handle-float", VLC_VAR_FLOAT );
+
+    assert( var_Acquire( p_libvlc, "handle-none" ) == NULL );
+
+    vlc_var_handle_t *p_int = var_Acquire( p_libvlc, "handle-int" );
+    vlc_var_handle_t *p_bool = var_Acquire( p_libvlc, "handle-bool" );
+    vlc_var_handle_t *p_float = var_Acquire( p_libvlc, "handle-float" );
+    assert( p_int != NULL && p_bool != NULL && p_float != NULL );
+
+    /* Named and handle accesses see the same value */
+    var_SetInteger( p_libvlc, "handle-int", INT64_C(0x123456789) );
+    assert( var_HandleGetInteger( p_int ) == INT64_C(0x123456789) );
+    var_SetInteger( p_libvlc, "handle-int", -42 );
+    assert( var_HandleGetInteger( p_int ) == -42 );
+    var_HandleSetInteger( p_libvlc, p_int, 1664 );
+    assert( var_GetInteger( p_libvlc, "handle-int" ) == 1664 );
+    var_IncInteger( p_libvlc, "handle-int" );
+    assert( var_HandleGetInteger( p_int ) == 1665 );
+
+    var_SetBool( p_libvlc, "handle-bool", true );
+    assert( var_HandleGetBool( p_bool ) );
+    var_ToggleBool( p_libvlc, "handle-bool" );
+    assert( !var_HandleGetBool( p_bool ) );
+
+    var_HandleSetFloat( p_libvlc, p_float, 0.75f );
+    assert( var_GetFloat( p_libvlc, "handle-float" ) == 0.75f );
+    var_SetFloat( p_libvlc, "handle-float", -2.5f );
+    assert( var_HandleGetFloat( p_float ) == -2.5f );
+
+    /* Boundaries also apply to the published value */
+    vlc_value_t val;
+    val.i_int = 10;
+    var_Change( p_libvlc, "handle-int", VLC_VAR_SETMAX, &val, NULL );
+    assert( var_HandleGetInteger( p_int ) == 10 );
+
+    /* The handle keeps the variable alive */
+    var_Destroy( p_libvlc, "handle-int" );
+    assert( var_Type( p_libvlc, "handle-int" ) != 0 );
+    var_Release( p_libvlc, p_int );
+    assert( var_Type( p_libvlc, "handle-int" ) == 0 );
+
+    var_Release( p_libvlc, p_bool );
+    var_Release( p_libvlc, p_float );
+    var_Destroy( p_libvlc, "handle-bool" );
+    var_Destroy( p_libvlc, "handle-float" );
+}
+
+static void bench_handles( libvlc_int_t *p_libvlc )
+{
+    const unsigned i_loops = 1000000;
+    int64_t i_sum = 0;
+
+    /* Populate the tree so that the named lookup is realistic */
+    char psz_name[16];
+    for( unsigned i = 0; i < 64; i++ )
+    {
+        snprintf( psz_name, sizeof(psz_name), "bench-%02u", i );
+        var_Create( p_libvlc, psz_name, VLC_VAR_INTEGER );
+    }
+    var_SetInteger( p_libvlc, "bench-42", 1 );
+    vlc_var_handle_t *p_var = var_Acquire( p_libvlc, "bench-42" );
+
+    mtime_t i_start = mdate();
+    for( unsigned i = 0; i < i_loops; i++ )
+        i_sum += var_GetInteger( p_libvlc, "bench-42" );
+    mtime_t i_named = mdate() - i_start;
+
+    i_start = mdate();
+    for( unsigned i = 0; i < i_loops; i++ )
+        i_sum += var_HandleGetInteger( p_var );
+    mtime_t i_handle = mdate() - i_start;
+
+    assert( i_sum == 2 * i_loops );
+    log( "%u reads: named %"PRId64" us, handle %"PRId64" us\n",
+         i_loops, i_named, i_handle );
+
+    var_Release( p_libvlc, p_var );
+    for( unsigned i = 0; i < 64; i++ )
+    {
+        snprintf( psz_name, sizeof(psz_name), "bench-%02u", i );
+        var_Destroy( p_libvlc, psz_name );
+    }
+}
+
 static void test_variables( libvlc_instance_t *p_vlc )
 {
     libvlc_int_t *p_libvlc = p_vlc->p_libvlc_int;
@@ -416,6 +504,12 @@ static void test_variables( libvlc_instance_t *p_vlc )
 
     log( "Testing type at creation\n" );
     test_creation_and_type( p_libvlc );
+
+    log( "Testing variable handles\n" );
+    test_handles( p_libvlc );
+
+    log( "Benchmarking variable handles\n" );
+    bench_handles( p_libvlc );
 }
 
 
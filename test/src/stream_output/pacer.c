@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * pacer.c: stream output packet pacing test
+ *****************************************************************************
+ * Copyright (C) 2016 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "../../libvlc/test.h"
+#include "../lib/libvlc_internal.h"
+
+#ifdef NDEBUG
+ #undef NDEBUG
+#endif
+#include <assert.h>
+#include <vlc_common.h>
+#include <vlc_sout.h>
+
+#define DELAY   300000 /* caching */
+#define MAX_LAG  50000 /* min(DELAY / 2, 50 ms) */
+#define CHUNK    40000 /* one chunk of packets per 40 ms */
+#define PACKETS  4     /* sharing the timestamp of their chunk */
+#define SIZE     1250  /* 1 Mb/s */
+
+static vlc_object_t *create(vlc_object_t *parent, bool pacing)
+{
+    vlc_object_t *obj = vlc_object_create(parent, sizeof (*obj));
+    assert(obj != NULL);
+    var_Create(obj, "sout-pacing", VLC_VAR_BOOL);
+    var_SetBool(obj, "sout-pacing", pacing);
+    return obj;
+}
+
+/* Without pacing, the packets leave at their timestamp plus the delay */
+static void test_burst(vlc_object_t *parent)
+{
+    vlc_object_t *obj = create(parent, false);
+    sout_pacer_t *pacer = sout_PacerNew(obj, DELAY);
+    assert(pacer != NULL);
+
+    for (unsigned n = 0; n < 50; n++) {
+        mtime_t dts = VLC_TS_0 + n * CHUNK;
+
+        for (unsigned i = 0; i < PACKETS; i++) {
+            mtime_t date = sout_PacerSchedule(pacer, dts, SIZE);
+
+            assert(date == dts + DELAY);
+            sout_PacerSent(pacer, date, date + 100);
+        }
+    }
+    sout_PacerDelete(pacer);
+    vlc_object_release(obj);
+}
+
+/* With pacing, the packets of a chunk are spread at the stream rate */
+static void test_spread(vlc_object_t *parent)
+{
+    vlc_object_t *obj = create(parent, true);
+    sout_pacer_t *pacer = sout_PacerNew(obj, DELAY);
+    assert(pacer != NULL);
+    /* time to send one packet, at the stream rate plus 1/16 of headroom */
+    const mtime_t interval = SIZE * CLOCK_FREQ * 16
+                           / ((PACKETS * SIZE * CLOCK_FREQ / CHUNK) * 17);
+    mtime_t last = VLC_TS_INVALID;
+    unsigned spread = 0;
+
+    for (unsigned n = 0; n < 100; n++) {
+        mtime_t dts = VLC_TS_0 + n * CHUNK;
+
+        for (unsigned i = 0; i < PACKETS; i++) {
+            mtime_t date = sout_PacerSchedule(pacer, dts, SIZE);
+
+            /* never early, never later than the maximum lag */
+            assert(date >= dts + DELAY);
+            assert(date <= dts + DELAY + MAX_LAG);
+            /* never out of order */
+            assert(date >= last);
+
+            if (i > 0 && date > last) {
+                /* once the rate is known, at the rate */
+                assert(date - last >= interval - 1);
+                spread++;
+            }
+            sout_PacerSent(pacer, date, date);
+            last = date;
+        }
+    }
+    /* all but the first chunks (while the rate is measured) are spread */
+    assert(spread >= 90 * (PACKETS - 1));
+
+    /* After a reset, a packet leaves at its date, whatever came before */
+    sout_PacerReset(pacer);
+    mtime_t dts = VLC_TS_0 + 1000 * CHUNK;
+    assert(sout_PacerSchedule(pacer, dts, SIZE) == dts + DELAY);
+
+    sout_PacerDelete(pacer);
+    vlc_object_release(obj);
+}
+
+int main(void)
+{
+    test_init();
+
+    libvlc_instance_t *vlc = libvlc_new(test_defaults_nargs,
+                                        test_defaults_args);
+    assert(vlc != NULL);
+
+    vlc_object_t *obj = (vlc_object_t *)vlc->p_libvlc_int;
+    test_burst(obj);
+    test_spread(obj);
+
+    libvlc_release(vlc);
+    return 0;
+}